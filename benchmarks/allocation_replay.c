@@ -0,0 +1,322 @@
+#include "Spark/core/clock.h"
+#include "Spark/core/smemory.h"
+#include "Spark/defines.h"
+#include "Spark/core/logging.h"
+
+#include "Spark/containers/unordered_map.h"
+#include "Spark/entry.h"
+#include "Spark/memory/allocation_trace.h"
+#include "Spark/memory/dynamic_allocator.h"
+#include "Spark/memory/freelist.h"
+#include "Spark/memory/slab_allocator.h"
+#include "Spark/platform/platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Replays a trace recorded with SPARK_ALLOCATION_TRACE against every backend:
+//     allocation_replay <trace> [repeat count]
+
+// =========================
+// CONFIG
+// =========================
+#define FREELIST_MEMORY_SIZE (1024ull * MB)
+const u32 default_repeat_count = 5;
+
+// =========================
+// STATE
+// =========================
+typedef enum : u8 {
+    REPLAY_ALLOCATE,
+    REPLAY_FREE,
+    REPLAY_REALLOCATE,
+} replay_op_t;
+
+// Trace records with block addresses replaced by dense slots into the live block array
+typedef struct replay_operation {
+    u32 slot;
+    u32 size;
+    replay_op_t op;
+} replay_operation_t;
+
+typedef struct replay_backend {
+    const char* name;
+    void (*create)();
+    void (*destroy)();
+    void* (*allocate)(u64 size);
+    void (*free)(void* block);
+    void* (*reallocate)(void* block, u64 old_size, u64 new_size);
+} replay_backend_t;
+
+hashmap_type(trace_slot_map, u64, u32);
+hashmap_impl(trace_slot_map, u64, u32, hash_passthrough, u64_compare, hash_passthrough);
+
+static replay_operation_t* operations;
+static u32 operation_count;
+static void** live_blocks;
+static u32* live_sizes;
+static u32 slot_count;
+
+static dynamic_allocator_t dynamic_allocator;
+static slab_allocator_t slab_allocator;
+static freelist_t freelist;
+static void* freelist_memory;
+
+b8 create_game(game_t *out_game) {
+    return true;
+}
+
+// =========================
+// BACKENDS
+// =========================
+SINLINE void malloc_create() {}
+SINLINE void malloc_destroy() {}
+SINLINE void* malloc_allocate(u64 size) {
+    return malloc(size);
+}
+SINLINE void malloc_free(void* block) {
+    free(block);
+}
+SINLINE void* malloc_reallocate(void* block, u64 old_size, u64 new_size) {
+    return realloc(block, new_size);
+}
+
+SINLINE void freelist_backend_create() {
+    freelist_memory = platform_reserve_memory(FREELIST_MEMORY_SIZE, 0, false);
+    platform_commit_memory(freelist_memory, FREELIST_MEMORY_SIZE);
+    freelist_create(freelist_memory, FREELIST_MEMORY_SIZE, &freelist);
+}
+SINLINE void freelist_backend_destroy() {
+    platform_release_memory(freelist_memory, FREELIST_MEMORY_SIZE);
+}
+SINLINE void* freelist_backend_allocate(u64 size) {
+    return freelist_allocate(&freelist, size);
+}
+SINLINE void freelist_backend_free(void* block) {
+    freelist_free(&freelist, block);
+}
+SINLINE void* freelist_backend_reallocate(void* block, u64 old_size, u64 new_size) {
+    return freelist_reallocate(&freelist, block, new_size);
+}
+
+SINLINE void dynamic_create() {
+    dynamic_allocator_create(128 * MB, &dynamic_allocator);
+}
+SINLINE void dynamic_destroy() {
+    dynamic_allocator_destroy(&dynamic_allocator);
+}
+SINLINE void* dynamic_allocate(u64 size) {
+    return dynamic_allocator_allocate(&dynamic_allocator, size);
+}
+SINLINE void dynamic_free(void* block) {
+    dynamic_allocator_free(&dynamic_allocator, block);
+}
+SINLINE void* dynamic_reallocate(void* block, u64 old_size, u64 new_size) {
+    return dynamic_allocator_reallocate(&dynamic_allocator, block, new_size);
+}
+
+// Small blocks from the slab allocator and the rest from the dynamic allocator, like sallocate
+SINLINE void slab_create() {
+    dynamic_create();
+    slab_allocator_create(&slab_allocator);
+}
+SINLINE void slab_destroy() {
+    slab_allocator_destroy(&slab_allocator);
+    dynamic_destroy();
+}
+SINLINE void* slab_allocate(u64 size) {
+    return size <= SLAB_ALLOCATOR_MAX_SIZE ? slab_allocator_allocate(&slab_allocator, size) : dynamic_allocate(size);
+}
+SINLINE void slab_free(void* block) {
+    if (slab_allocator_owns(&slab_allocator, block)) {
+        slab_allocator_free(&slab_allocator, block);
+    } else {
+        dynamic_free(block);
+    }
+}
+SINLINE void* slab_reallocate(void* block, u64 old_size, u64 new_size) {
+    if (slab_allocator_owns(&slab_allocator, block) || new_size <= SLAB_ALLOCATOR_MAX_SIZE) {
+        void* new_block = slab_allocate(new_size);
+        platform_copy_memory(new_block, block, old_size < new_size ? old_size : new_size);
+        slab_free(block);
+        return new_block;
+    }
+    return dynamic_reallocate(block, old_size, new_size);
+}
+
+const replay_backend_t backends[] = {
+    { "Malloc        ", malloc_create, malloc_destroy, malloc_allocate, malloc_free, malloc_reallocate },
+    { "Freelist      ", freelist_backend_create, freelist_backend_destroy, freelist_backend_allocate, freelist_backend_free, freelist_backend_reallocate },
+    { "Dynamic       ", dynamic_create, dynamic_destroy, dynamic_allocate, dynamic_free, dynamic_reallocate },
+    { "Slab + Dynamic", slab_create, slab_destroy, slab_allocate, slab_free, slab_reallocate },
+};
+
+// =========================
+// TRACE LOADING
+// =========================
+int sort_records(const void* a, const void* b) {
+    const allocation_trace_record_t* _a = *(allocation_trace_record_t**)a;
+    const allocation_trace_record_t* _b = *(allocation_trace_record_t**)b;
+    if (_a->time_ns != _b->time_ns) {
+        return _a->time_ns < _b->time_ns ? -1 : 1;
+    }
+    // Keeps the two records of a reallocation in order
+    return _a < _b ? -1 : _a > _b;
+}
+
+// Reads the trace in recording order and turns block addresses into slots. Records of blocks allocated before the
+// trace started, or lost when a size limited trace wrapped around, are dropped.
+b8 load_trace(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        SERROR("Failed to open trace '%s'.", path);
+        return false;
+    }
+
+    allocation_trace_header_t header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != ALLOCATION_TRACE_MAGIC || header.version != ALLOCATION_TRACE_VERSION) {
+        SERROR("'%s' is not an allocation trace of version %d.", path, ALLOCATION_TRACE_VERSION);
+        fclose(file);
+        return false;
+    }
+
+    allocation_trace_record_t* records = malloc(sizeof(allocation_trace_record_t) * header.record_count);
+    const u64 read_count = fread(records, sizeof(allocation_trace_record_t), header.record_count, file);
+    fclose(file);
+    SASSERT(read_count == header.record_count, "Trace '%s' is truncated, read %lu of %lu records.", path, read_count, header.record_count);
+
+    // Oldest record first, then by time across threads
+    allocation_trace_record_t** ordered = malloc(sizeof(allocation_trace_record_t*) * header.record_count);
+    for (u64 i = 0; i < header.record_count; i++) {
+        ordered[i] = &records[(header.first_record + i) % header.record_count];
+    }
+    qsort(ordered, header.record_count, sizeof(allocation_trace_record_t*), sort_records);
+
+    // Every record adds at most one operation, plus one free for each stale slot
+    operations = malloc(sizeof(replay_operation_t) * header.record_count * 2);
+    operation_count = 0;
+    u32* free_slots = malloc(sizeof(u32) * header.record_count);
+    u32 free_slot_count = 0;
+    slot_count = 0;
+
+    trace_slot_map_t slots;
+    trace_slot_map_create(65521, &slots);
+    // Reallocation waiting for the size of its REALLOCATE_TO record
+    replay_operation_t* reallocation = NULL;
+    for (u64 i = 0; i < header.record_count; i++) {
+        const allocation_trace_record_t* record = ordered[i];
+        u32 slot = INVALID_ID;
+        const b8 live = trace_slot_map_try_get(&slots, record->block, &slot);
+        if (live && (record->op == ALLOCATION_TRACE_ALLOCATE || record->op == ALLOCATION_TRACE_REALLOCATE_TO)) {
+            // The address was handed out again without its free being recorded, e.g. the free was lost with the
+            // records of a thread past ALLOCATION_TRACE_MAX_THREADS. Free the stale slot so it can be reused.
+            trace_slot_map_remove(&slots, record->block);
+            free_slots[free_slot_count++] = slot;
+            operations[operation_count++] = (replay_operation_t) { .slot = slot, .op = REPLAY_FREE };
+        }
+
+        switch (record->op) {
+            case ALLOCATION_TRACE_ALLOCATE:
+            case ALLOCATION_TRACE_REALLOCATE_TO: {
+                // A reallocation of an unknown block is replayed as an allocation
+                if (record->op == ALLOCATION_TRACE_REALLOCATE_TO && reallocation) {
+                    reallocation->size = record->size;
+                    trace_slot_map_insert(&slots, record->block, reallocation->slot);
+                } else {
+                    slot = free_slot_count ? free_slots[--free_slot_count] : slot_count++;
+                    operations[operation_count++] = (replay_operation_t) { .slot = slot, .size = record->size, .op = REPLAY_ALLOCATE };
+                    trace_slot_map_insert(&slots, record->block, slot);
+                }
+                reallocation = NULL;
+            } break;
+            case ALLOCATION_TRACE_FREE: {
+                if (live) {
+                    trace_slot_map_remove(&slots, record->block);
+                    free_slots[free_slot_count++] = slot;
+                    operations[operation_count++] = (replay_operation_t) { .slot = slot, .op = REPLAY_FREE };
+                }
+            } break;
+            case ALLOCATION_TRACE_REALLOCATE_FROM: {
+                if (live) {
+                    trace_slot_map_remove(&slots, record->block);
+                    reallocation = &operations[operation_count++];
+                    *reallocation = (replay_operation_t) { .slot = slot, .op = REPLAY_REALLOCATE };
+                }
+            } break;
+        }
+    }
+
+    trace_slot_map_destroy(&slots);
+    free(free_slots);
+    free(ordered);
+    free(records);
+
+    live_blocks = malloc(sizeof(void*) * slot_count);
+    live_sizes = malloc(sizeof(u32) * slot_count);
+    SINFO("Loaded %lu records: %u operations over %u slots.", header.record_count, operation_count, slot_count);
+    return true;
+}
+
+// =========================
+// REPLAY
+// =========================
+f64 replay(const replay_backend_t* backend) {
+    backend->create();
+    for (u32 i = 0; i < slot_count; i++) {
+        live_blocks[i] = NULL;
+    }
+
+    spark_clock_t clock;
+    clock_start(&clock);
+    for (u32 i = 0; i < operation_count; i++) {
+        const replay_operation_t* operation = &operations[i];
+        switch (operation->op) {
+            case REPLAY_ALLOCATE:
+                live_blocks[operation->slot] = backend->allocate(operation->size);
+                live_sizes[operation->slot] = operation->size;
+                break;
+            case REPLAY_FREE:
+                backend->free(live_blocks[operation->slot]);
+                live_blocks[operation->slot] = NULL;
+                break;
+            case REPLAY_REALLOCATE:
+                live_blocks[operation->slot] = backend->reallocate(live_blocks[operation->slot], live_sizes[operation->slot], operation->size);
+                live_sizes[operation->slot] = operation->size;
+                break;
+        }
+    }
+    clock_update(&clock);
+
+    // Blocks that were still live when the trace stopped
+    for (u32 i = 0; i < slot_count; i++) {
+        if (live_blocks[i]) {
+            backend->free(live_blocks[i]);
+        }
+    }
+    backend->destroy();
+    return clock.elapsed_time;
+}
+
+s32 main(s32 argc, char** argv) {
+    if (argc < 2) {
+        SERROR("Usage: %s <trace> [repeat count]", argv[0]);
+        return 1;
+    }
+    initialize_memory();
+    if (!load_trace(argv[1])) {
+        return 1;
+    }
+    const u32 repeat_count = argc > 2 ? atoi(argv[2]) : default_repeat_count;
+
+    for (u32 b = 0; b < sizeof(backends) / sizeof(replay_backend_t); b++) {
+        f64 min_time = 1000000000;
+        f64 total_time = 0;
+        for (u32 i = 0; i < repeat_count; i++) {
+            const f64 time = replay(&backends[b]);
+            min_time = time < min_time ? time : min_time;
+            total_time += time;
+        }
+
+        SINFO("[%s] Avg time: %fms", backends[b].name, total_time / repeat_count * 1000);
+        SINFO("[%s] Min time: %fms (%.2f Mops/s)", backends[b].name, min_time * 1000, operation_count / min_time / 1000000);
+    }
+}
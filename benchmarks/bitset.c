@@ -0,0 +1,115 @@
+#include "Spark/core/clock.h"
+#include "Spark/core/smemory.h"
+#include "Spark/defines.h"
+#include "Spark/core/logging.h"
+
+#include "Spark/containers/bitset.h"
+#include "Spark/entry.h"
+
+// =========================
+// CONFIG
+// =========================
+const u32 bit_counts[] = { 1024, 65536, 1048576 };
+const u32 iteration_count = 200;
+
+// =========================
+// STATE
+// =========================
+// Visible and active flags of every object, as bool arrays and as bitsets
+static b8* visible_flags;
+static b8* active_flags;
+static b8* result_flags;
+static bitset_t visible_bits;
+static bitset_t active_bits;
+static bitset_t result_bits;
+
+b8 create_game(game_t *out_game) {
+    return true;
+}
+
+static u32 random_state = 1;
+
+SINLINE u32 benchmark_random() {
+    random_state = random_state * 1664525u + 1013904223u;
+    return random_state >> 8;
+}
+
+// Objects that are active but not visible, counted and then visited
+SINLINE u64 bool_array_frame(u32 bit_count) {
+    u64 checksum = 0;
+    for (u32 i = 0; i < bit_count; i++) {
+        result_flags[i] = active_flags[i] && !visible_flags[i];
+    }
+    u32 count = 0;
+    for (u32 i = 0; i < bit_count; i++) {
+        count += result_flags[i];
+    }
+    for (u32 i = 0; i < bit_count; i++) {
+        if (result_flags[i]) {
+            checksum += i;
+        }
+    }
+    return checksum + count;
+}
+
+SINLINE u64 bitset_frame() {
+    u64 checksum = 0;
+    bitset_andnot(&result_bits, &active_bits, &visible_bits);
+    const u32 count = bitset_count(&result_bits);
+    for (u32 i = bitset_next(&result_bits, 0); i != INVALID_ID; i = bitset_next(&result_bits, i + 1)) {
+        checksum += i;
+    }
+    return checksum + count;
+}
+
+s32 main(s32 argc, char** argv) {
+    initialize_memory();
+
+    for (u32 i = 0; i < sizeof(bit_counts) / sizeof(u32); i++) {
+        const u32 bit_count = bit_counts[i];
+        visible_flags = sallocate(bit_count, MEMORY_TAG_ARRAY);
+        active_flags = sallocate(bit_count, MEMORY_TAG_ARRAY);
+        result_flags = sallocate(bit_count, MEMORY_TAG_ARRAY);
+        bitset_create(bit_count, &visible_bits);
+        bitset_create(bit_count, &active_bits);
+        bitset_create(bit_count, &result_bits);
+
+        // Most objects are visible, a quarter are active
+        for (u32 j = 0; j < bit_count; j++) {
+            visible_flags[j] = benchmark_random() % 8 != 0;
+            active_flags[j] = benchmark_random() % 4 == 0;
+            bitset_assign(&visible_bits, j, visible_flags[j]);
+            bitset_assign(&active_bits, j, active_flags[j]);
+        }
+
+        spark_clock_t clock;
+        u64 bool_checksum = 0;
+        clock_start(&clock);
+        for (u32 j = 0; j < iteration_count; j++) {
+            bool_checksum += bool_array_frame(bit_count);
+        }
+        clock_update(&clock);
+        const f64 bool_time = clock.elapsed_time;
+
+        u64 bitset_checksum = 0;
+        clock_start(&clock);
+        for (u32 j = 0; j < iteration_count; j++) {
+            bitset_checksum += bitset_frame();
+        }
+        clock_update(&clock);
+        const f64 bitset_time = clock.elapsed_time;
+
+        if (bool_checksum != bitset_checksum) {
+            SERROR("Bool array and bitset results differ for %d bits.", bit_count);
+        }
+        SINFO("%d bits: bool array %.3f ms, bitset %.3f ms (%.1fx)", bit_count,
+                bool_time * 1000 / iteration_count, bitset_time * 1000 / iteration_count, bool_time / bitset_time);
+
+        bitset_destroy(&result_bits);
+        bitset_destroy(&active_bits);
+        bitset_destroy(&visible_bits);
+        sfree(result_flags, bit_count, MEMORY_TAG_ARRAY);
+        sfree(active_flags, bit_count, MEMORY_TAG_ARRAY);
+        sfree(visible_flags, bit_count, MEMORY_TAG_ARRAY);
+    }
+}
@@ -6,6 +6,8 @@
 #include "Spark/entry.h"
 #include "Spark/math/smath.h"
 #include "Spark/memory/dynamic_allocator.h"
+#include "Spark/memory/slab_allocator.h"
+#include "Spark/threading/thread.h"
 #include <stdlib.h>
 
 // =========================
@@ -26,20 +28,31 @@ const u32 alloc_sizes[] = {
 };
 const u32 test_count = 300;
 
+#define THREADED_MAX_THREADS 8
+#define THREADED_LIVE_ALLOCATIONS 64
+const u32 threaded_thread_counts[] = { 1, 2, 4, 8 };
+const u32 threaded_iteration_count = 20000;
+
 // =========================
 // STATE
 // =========================
 static u32 allocation_size = 1024;
 u32 rand_vector[RAND_ALLOC_COUNT];
 u32* rand_alloc_ints[RAND_ALLOC_COUNT];
+// Mixed sizes up to 64KiB, larger sizes bypass the thread caches and hit the freelist bins
+u32 mixed_sizes[RAND_ALLOC_COUNT];
 
 static u64 allocation_total = 0;
 static dynamic_allocator_t allocator;
+static slab_allocator_t small_allocator;
 
 SINLINE void freelist_benchmark();
 SINLINE void freelist_randalloc_benchmark();
 SINLINE void malloc_benchmark();
 SINLINE void malloc_randalloc_benchmark();
+SINLINE void freelist_mixed_benchmark();
+SINLINE void malloc_mixed_benchmark();
+SINLINE void threaded_benchmark();
 
 int sort_median_times(const void* a, const void* b) {
     f64 _a = *(f64*)a;
@@ -79,6 +92,10 @@ void init_random_vector() {
         rand_vector[i] = i;
     }
     
+    for (u32 i = 0; i < RAND_ALLOC_COUNT; i++) {
+        mixed_sizes[i] = random() % 4 == 0 ? random() % (64 * KB) + 1 : random() % 1024 + 1;
+    }
+
     // for (u32 i = 0; i < RAND_ALLOC_COUNT; i++) {
     //     int index = random() % RAND_ALLOC_COUNT;
     //
@@ -91,6 +108,7 @@ void init_random_vector() {
 s32 main(s32 argc, char** argv) {
     // Setup
     dynamic_allocator_create(512 * MB, &allocator);
+    slab_allocator_create(&small_allocator);
     init_random_vector();
 
     for (u32 i = 0; i < RAND_ALLOC_COUNT; i++) {
@@ -103,26 +121,32 @@ s32 main(s32 argc, char** argv) {
         SASSERT(found, "Failed to correctly initialize random vector. Could not find value %d", i);
     }
 
-#define BENCHMARK_FUNCTION_COUNT 4
+#define BENCHMARK_FUNCTION_COUNT 6
     u32 iteration_counts[BENCHMARK_FUNCTION_COUNT] = {
         50000,
         500,
+        200,
         50000,
         500,
+        200,
     };
 
     void (*benchmark_functoins[BENCHMARK_FUNCTION_COUNT])() = {
         freelist_benchmark,
         freelist_randalloc_benchmark,
+        freelist_mixed_benchmark,
         malloc_benchmark,
         malloc_randalloc_benchmark,
+        malloc_mixed_benchmark,
     };
 
     const char* benchmark_function_names[BENCHMARK_FUNCTION_COUNT] = {
         "Freelist       ",
         "Freelist Random",
+        "Freelist Mixed ",
         "Malloc         ",
         "Malloc   Random",
+        "Malloc   Mixed ",
     };
 
 
@@ -161,6 +185,8 @@ s32 main(s32 argc, char** argv) {
             SINFO("[%s] Med time: %fus", benchmark_function_names[i], iteration_times[i][test_count / 2] / iteration_counts[i]);
         }
     }
+
+    threaded_benchmark();
 }
 
 SINLINE void malloc_benchmark() {
@@ -192,3 +218,122 @@ SINLINE void freelist_randalloc_benchmark() {
         dynamic_allocator_free(&allocator, rand_alloc_ints[rand_vector[i]]);
     }
 }
+
+// Interleaves allocations and frees so the allocators have to deal with gaps of varying size
+SINLINE void malloc_mixed_benchmark() {
+    for (u32 i = 0; i < RAND_ALLOC_COUNT; i++) {
+        rand_alloc_ints[i] = malloc(mixed_sizes[i]);
+        if (i % 3 == 2) {
+            free(rand_alloc_ints[i - 1]);
+            rand_alloc_ints[i - 1] = NULL;
+        }
+    }
+    for (u32 i = 0; i < RAND_ALLOC_COUNT; i++) {
+        free(rand_alloc_ints[rand_vector[i]]);
+    }
+}
+
+SINLINE void freelist_mixed_benchmark() {
+    for (u32 i = 0; i < RAND_ALLOC_COUNT; i++) {
+        rand_alloc_ints[i] = dynamic_allocator_allocate(&allocator, mixed_sizes[i]);
+        if (i % 3 == 2) {
+            dynamic_allocator_free(&allocator, rand_alloc_ints[i - 1]);
+            rand_alloc_ints[i - 1] = NULL;
+        }
+    }
+    for (u32 i = 0; i < RAND_ALLOC_COUNT; i++) {
+        if (rand_alloc_ints[rand_vector[i]]) {
+            dynamic_allocator_free(&allocator, rand_alloc_ints[rand_vector[i]]);
+        }
+    }
+}
+
+// =========================
+// MULTITHREADED
+// =========================
+typedef struct {
+    b8 use_malloc;
+    // Sizes up to SLAB_ALLOCATOR_MAX_SIZE served by the slab allocator instead of the freelist
+    b8 small;
+    u32 seed;
+} threaded_benchmark_args_t;
+
+// Every thread keeps a window of live allocations of mixed small sizes and replaces one per iteration
+void* threaded_benchmark_thread(void* args) {
+    threaded_benchmark_args_t* benchmark_args = args;
+    void* live[THREADED_LIVE_ALLOCATIONS] = {};
+    u32 seed = benchmark_args->seed;
+
+    for (u32 i = 0; i < threaded_iteration_count; i++) {
+        for (u32 j = 0; j < THREADED_LIVE_ALLOCATIONS; j++) {
+            seed = seed * 1664525 + 1013904223;
+            const u32 size = benchmark_args->small ? 1 + (seed >> 8) % SLAB_ALLOCATOR_MAX_SIZE : 16 + (seed >> 8) % 1024;
+            const u32 slot = (seed >> 20) % THREADED_LIVE_ALLOCATIONS;
+
+            if (benchmark_args->use_malloc) {
+                free(live[slot]);
+                live[slot] = malloc(size);
+            } else if (benchmark_args->small) {
+                if (live[slot]) {
+                    slab_allocator_free(&small_allocator, live[slot]);
+                }
+                live[slot] = slab_allocator_allocate(&small_allocator, size);
+            } else {
+                if (live[slot]) {
+                    dynamic_allocator_free(&allocator, live[slot]);
+                }
+                live[slot] = dynamic_allocator_allocate(&allocator, size);
+            }
+        }
+    }
+
+    for (u32 i = 0; i < THREADED_LIVE_ALLOCATIONS; i++) {
+        if (benchmark_args->use_malloc) {
+            free(live[i]);
+        } else if (benchmark_args->small && live[i]) {
+            slab_allocator_free(&small_allocator, live[i]);
+        } else if (live[i]) {
+            dynamic_allocator_free(&allocator, live[i]);
+        }
+    }
+    if (benchmark_args->small && !benchmark_args->use_malloc) {
+        slab_allocator_flush_thread_cache(&small_allocator);
+    } else if (!benchmark_args->use_malloc) {
+        dynamic_allocator_flush_thread_cache(&allocator);
+    }
+    return NULL;
+}
+
+SINLINE f64 run_threaded_benchmark(u32 thread_count, b8 use_malloc, b8 small) {
+    thread_t threads[THREADED_MAX_THREADS];
+    threaded_benchmark_args_t args[THREADED_MAX_THREADS];
+
+    spark_clock_t clock;
+    clock_start(&clock);
+    for (u32 i = 0; i < thread_count; i++) {
+        args[i] = (threaded_benchmark_args_t) { .use_malloc = use_malloc, .small = small, .seed = i + 1 };
+        thread_create(threaded_benchmark_thread, &args[i], &threads[i]);
+    }
+    for (u32 i = 0; i < thread_count; i++) {
+        thread_join(threads[i]);
+    }
+    clock_update(&clock);
+    return clock.elapsed_time;
+}
+
+SINLINE void threaded_benchmark() {
+    const u64 operations_per_thread = (u64)threaded_iteration_count * THREADED_LIVE_ALLOCATIONS * 2;
+    for (u32 i = 0; i < sizeof(threaded_thread_counts) / sizeof(u32); i++) {
+        const u32 thread_count = threaded_thread_counts[i];
+        const f64 freelist_time = run_threaded_benchmark(thread_count, false, false);
+        const f64 malloc_time = run_threaded_benchmark(thread_count, true, false);
+        const f64 slab_time = run_threaded_benchmark(thread_count, false, true);
+        const f64 small_malloc_time = run_threaded_benchmark(thread_count, true, true);
+        const f64 operations = operations_per_thread * thread_count;
+
+        SINFO("[Threaded %d] Freelist    : %fms (%.2f Mops/s)", thread_count, freelist_time * 1000, operations / freelist_time / 1000000);
+        SINFO("[Threaded %d] Malloc      : %fms (%.2f Mops/s)", thread_count, malloc_time * 1000, operations / malloc_time / 1000000);
+        SINFO("[Threaded %d] Slab        : %fms (%.2f Mops/s)", thread_count, slab_time * 1000, operations / slab_time / 1000000);
+        SINFO("[Threaded %d] Small malloc: %fms (%.2f Mops/s)", thread_count, small_malloc_time * 1000, operations / small_malloc_time / 1000000);
+    }
+}
@@ -0,0 +1,152 @@
+#include "Spark/core/clock.h"
+#include "Spark/core/smemory.h"
+#include "Spark/core/sstring.h"
+#include "Spark/defines.h"
+#include "Spark/core/logging.h"
+
+#include "Spark/entry.h"
+#include "Spark/math/smath.h"
+#include "Spark/utils/hashing.h"
+#include <stdlib.h>
+
+// =========================
+// CONFIG
+// =========================
+#define KEY_COUNT (1 << 16)
+#define PATH_LENGTH 64
+const u32 repeat_count = 64;
+
+// =========================
+// STATE
+// =========================
+typedef enum {
+    KEY_SET_ENTITY_IDS,
+    KEY_SET_CHUNK_COORDS,
+    KEY_SET_ASSET_PATHS,
+    KEY_SET_MAX,
+} key_set_t;
+
+const char* key_set_names[] = {
+    "Entity ids  ",
+    "Chunk coords",
+    "Asset paths ",
+};
+
+static u64 entity_ids[KEY_COUNT];
+static vec3i chunk_coords[KEY_COUNT];
+static char asset_paths[KEY_COUNT][PATH_LENGTH];
+static hash_t hashes[KEY_COUNT];
+static u32 buckets[KEY_COUNT];
+
+b8 create_game(game_t *out_game) {
+    return true;
+}
+
+// Hashes the engine used before
+SINLINE hash_t legacy_string_hash(const char* string) {
+    u64 hash = 5381;
+    char c = *string;
+    while (c != 0) {
+        hash = ((hash << 5) + hash) + c;
+        c = *string++;
+    }
+    return hash;
+}
+
+SINLINE hash_t legacy_hash_vec3i(vec3i key) {
+    return (key.x + 501125321) ^ (key.y + 1136930381) ^ (key.z + 1720413743);
+}
+
+SINLINE hash_t hash_key(key_set_t key_set, b8 legacy, u32 index) {
+    switch (key_set) {
+        case KEY_SET_ENTITY_IDS:
+            return legacy ? entity_ids[index] : hash_u64(entity_ids[index]);
+        case KEY_SET_CHUNK_COORDS:
+            return legacy ? legacy_hash_vec3i(chunk_coords[index]) : hash_vec3i(chunk_coords[index]);
+        case KEY_SET_ASSET_PATHS:
+        default:
+            return legacy ? legacy_string_hash(asset_paths[index]) : string_hash(asset_paths[index]);
+    }
+}
+
+static void generate_keys() {
+    // Entity ids are dense, with a generation in the upper bits for some of them
+    for (u32 i = 0; i < KEY_COUNT; i++) {
+        entity_ids[i] = i | (u64)(i % 7 == 0) << 32;
+    }
+
+    // Chunks around the origin, 64 x 16 x 64
+    for (u32 i = 0; i < KEY_COUNT; i++) {
+        chunk_coords[i] = (vec3i) {
+            .x = (s32)(i % 64) - 32,
+            .y = (s32)(i / 64 % 16) - 8,
+            .z = (s32)(i / 1024) - 32,
+        };
+    }
+
+    const char* folders[] = { "models", "textures", "materials", "shaders" };
+    for (u32 i = 0; i < KEY_COUNT; i++) {
+        string_format(asset_paths[i], "assets/resources/%s/level_%u/object_%u", folders[i % 4], i / 512, i % 512);
+    }
+}
+
+static s32 compare_hashes(const void* a, const void* b) {
+    const hash_t hash_a = *(const hash_t*)a;
+    const hash_t hash_b = *(const hash_t*)b;
+    return (hash_a > hash_b) - (hash_a < hash_b);
+}
+
+// Keys that land in an already used bucket of a power of two table indexed by the low bits, and full hash collisions
+static void measure_collisions(u32* out_bucket_collisions, u32* out_max_bucket, u32* out_hash_collisions) {
+    szero_memory(buckets, sizeof(buckets));
+    u32 bucket_collisions = 0;
+    u32 max_bucket = 0;
+    for (u32 i = 0; i < KEY_COUNT; i++) {
+        u32* bucket = &buckets[hashes[i] & (KEY_COUNT - 1)];
+        bucket_collisions += *bucket > 0;
+        (*bucket)++;
+        max_bucket = smax(max_bucket, *bucket);
+    }
+
+    // Equal hashes of different keys, every key is distinct
+    static hash_t sorted[KEY_COUNT];
+    scopy_memory(sorted, hashes, sizeof(hashes));
+    qsort(sorted, KEY_COUNT, sizeof(hash_t), compare_hashes);
+    u32 hash_collisions = 0;
+    for (u32 i = 1; i < KEY_COUNT; i++) {
+        hash_collisions += sorted[i] == sorted[i - 1];
+    }
+
+    *out_bucket_collisions = bucket_collisions;
+    *out_max_bucket = max_bucket;
+    *out_hash_collisions = hash_collisions;
+}
+
+s32 main(s32 argc, char** argv) {
+    initialize_memory();
+    generate_keys();
+
+    // A uniform hash fills 1 - 1/e of the buckets when there are as many keys as buckets
+    SINFO("Expected bucket collisions for a uniform hash: %u", (u32)(KEY_COUNT / 2.718281828));
+    for (u32 key_set = 0; key_set < KEY_SET_MAX; key_set++) {
+        for (u32 legacy = 0; legacy < 2; legacy++) {
+            spark_clock_t clock;
+            clock_start(&clock);
+            hash_t checksum = 0;
+            for (u32 r = 0; r < repeat_count; r++) {
+                for (u32 i = 0; i < KEY_COUNT; i++) {
+                    hashes[i] = hash_key(key_set, legacy, i);
+                }
+                checksum ^= hashes[r];
+            }
+            clock_update(&clock);
+
+            u32 bucket_collisions, max_bucket, hash_collisions;
+            measure_collisions(&bucket_collisions, &max_bucket, &hash_collisions);
+            const f64 hash_count = (f64)KEY_COUNT * repeat_count;
+            SINFO("%s %s: %.2f Mhash/s, %u bucket collisions, largest bucket %u, %u hash collisions (%lx)",
+                    key_set_names[key_set], legacy ? "legacy" : "new   ",
+                    hash_count / clock.elapsed_time / 1000000, bucket_collisions, max_bucket, hash_collisions, checksum);
+        }
+    }
+}
@@ -0,0 +1,123 @@
+#include "Spark/core/clock.h"
+#include "Spark/core/smemory.h"
+#include "Spark/defines.h"
+#include "Spark/core/logging.h"
+
+#include "Spark/entry.h"
+#include "Spark/memory/pool_allocator.h"
+#include "Spark/threading/thread.h"
+#include <stdlib.h>
+
+// =========================
+// CONFIG
+// =========================
+#define MAX_THREADS 8
+#define LIVE_BLOCKS 64
+#define BLOCK_SIZE 64
+const u32 thread_counts[] = { 1, 2, 4, 8 };
+const u32 iteration_count = 20000;
+
+// =========================
+// STATE
+// =========================
+static pool_allocator_t allocator;
+
+typedef struct {
+    b8 use_malloc;
+    // Blocks freed by the previous thread
+    void** incoming;
+    void** outgoing;
+} benchmark_args_t;
+
+b8 create_game(game_t *out_game) {
+    return true;
+}
+
+SINLINE void* benchmark_allocate(b8 use_malloc) {
+    return use_malloc ? malloc(BLOCK_SIZE) : pool_allocator_allocate(&allocator);
+}
+
+SINLINE void benchmark_free(b8 use_malloc, void* block) {
+    if (use_malloc) {
+        free(block);
+    } else if (block) {
+        pool_allocator_free(&allocator, block);
+    }
+}
+
+// Every thread replaces a window of live blocks. Half of the new blocks are handed to the next thread and freed there.
+void* benchmark_thread(void* args) {
+    benchmark_args_t* benchmark_args = args;
+    const b8 use_malloc = benchmark_args->use_malloc;
+    void* live[LIVE_BLOCKS] = {};
+
+    for (u32 i = 0; i < iteration_count; i++) {
+        for (u32 j = 0; j < LIVE_BLOCKS; j++) {
+            if (j % 2) {
+                benchmark_free(use_malloc, live[j]);
+                live[j] = benchmark_allocate(use_malloc);
+            } else {
+                benchmark_free(use_malloc, __atomic_exchange_n(&benchmark_args->incoming[j], NULL, __ATOMIC_ACQUIRE));
+                // A block the next thread did not take yet is freed here
+                benchmark_free(use_malloc, __atomic_exchange_n(&benchmark_args->outgoing[j], benchmark_allocate(use_malloc), __ATOMIC_ACQ_REL));
+            }
+        }
+    }
+
+    for (u32 i = 0; i < LIVE_BLOCKS; i++) {
+        benchmark_free(use_malloc, live[i]);
+    }
+    if (!use_malloc) {
+        pool_allocator_flush_thread_cache(&allocator);
+    }
+    return NULL;
+}
+
+SINLINE f64 run_benchmark(u32 thread_count, b8 use_malloc) {
+    thread_t threads[MAX_THREADS];
+    benchmark_args_t args[MAX_THREADS];
+    static void* mailboxes[MAX_THREADS][LIVE_BLOCKS];
+
+    spark_clock_t clock;
+    clock_start(&clock);
+    for (u32 i = 0; i < thread_count; i++) {
+        args[i] = (benchmark_args_t) {
+            .use_malloc = use_malloc,
+            .incoming = mailboxes[(i + thread_count - 1) % thread_count],
+            .outgoing = mailboxes[i],
+        };
+        thread_create(benchmark_thread, &args[i], &threads[i]);
+    }
+    for (u32 i = 0; i < thread_count; i++) {
+        thread_join(threads[i]);
+    }
+    clock_update(&clock);
+
+    // Blocks still waiting in a mailbox
+    for (u32 i = 0; i < thread_count; i++) {
+        for (u32 j = 0; j < LIVE_BLOCKS; j++) {
+            benchmark_free(use_malloc, mailboxes[i][j]);
+            mailboxes[i][j] = NULL;
+        }
+    }
+    pool_allocator_flush_thread_cache(&allocator);
+    return clock.elapsed_time;
+}
+
+s32 main(s32 argc, char** argv) {
+    initialize_memory();
+    pool_allocator_create(BLOCK_SIZE, MAX_THREADS * LIVE_BLOCKS * 4, &allocator);
+
+    const u64 operations_per_thread = (u64)iteration_count * LIVE_BLOCKS * 2;
+    for (u32 i = 0; i < sizeof(thread_counts) / sizeof(u32); i++) {
+        const u32 thread_count = thread_counts[i];
+        const f64 pool_time = run_benchmark(thread_count, false);
+        const f64 malloc_time = run_benchmark(thread_count, true);
+        const f64 operations = operations_per_thread * thread_count;
+
+        SINFO("[Threaded %d] Pool  : %fms (%.2f Mops/s)", thread_count, pool_time * 1000, operations / pool_time / 1000000);
+        SINFO("[Threaded %d] Malloc: %fms (%.2f Mops/s)", thread_count, malloc_time * 1000, operations / malloc_time / 1000000);
+    }
+
+    pool_allocator_destroy(&allocator);
+}
@@ -0,0 +1,185 @@
+#include "Spark/core/clock.h"
+#include "Spark/core/smemory.h"
+#include "Spark/defines.h"
+#include "Spark/core/logging.h"
+
+#include "Spark/containers/ring_queue.h"
+#include "Spark/entry.h"
+#include "Spark/threading/mutex.h"
+#include "Spark/threading/thread.h"
+
+// =========================
+// CONFIG
+// =========================
+#define MAX_THREADS 8
+#define QUEUE_CAPACITY 1024
+#define BATCH_SIZE 32
+const u32 thread_pair_counts[] = { 1, 2, 4 };
+const u64 values_per_producer = 2000000;
+
+// =========================
+// STATE
+// =========================
+spsc_queue_header(u64, u64);
+spsc_queue_impl(u64, u64);
+mpmc_queue_header(u64, u64);
+mpmc_queue_impl(u64, u64);
+
+typedef enum {
+    QUEUE_KIND_SPSC,
+    QUEUE_KIND_MPMC,
+    // Ring buffer behind a mutex, for comparison
+    QUEUE_KIND_MUTEX,
+    QUEUE_KIND_MAX,
+} queue_kind_t;
+
+const char* queue_kind_names[] = {
+    "SPSC ",
+    "MPMC ",
+    "Mutex",
+};
+
+typedef struct mutex_queue {
+    spark_mutex_t mutex;
+    u64 values[QUEUE_CAPACITY];
+    u64 head;
+    u64 tail;
+} mutex_queue_t;
+
+static spsc_queue_u64_t spsc_queue;
+static mpmc_queue_u64_t mpmc_queue;
+static mutex_queue_t mutex_queue;
+static u64 consumed_count;
+static u64 total_count;
+
+typedef struct {
+    queue_kind_t kind;
+    u32 batch_size;
+} benchmark_args_t;
+
+b8 create_game(game_t *out_game) {
+    return true;
+}
+
+SINLINE u32 mutex_queue_push(const u64* values, u32 count) {
+    mutex_lock(mutex_queue.mutex);
+    count = smin(count, QUEUE_CAPACITY - (mutex_queue.tail - mutex_queue.head));
+    for (u32 i = 0; i < count; i++) {
+        mutex_queue.values[(mutex_queue.tail + i) % QUEUE_CAPACITY] = values[i];
+    }
+    mutex_queue.tail += count;
+    mutex_unlock(mutex_queue.mutex);
+    return count;
+}
+
+SINLINE u32 mutex_queue_pop(u64* values, u32 max_count) {
+    mutex_lock(mutex_queue.mutex);
+    const u32 count = smin(max_count, mutex_queue.tail - mutex_queue.head);
+    for (u32 i = 0; i < count; i++) {
+        values[i] = mutex_queue.values[(mutex_queue.head + i) % QUEUE_CAPACITY];
+    }
+    mutex_queue.head += count;
+    mutex_unlock(mutex_queue.mutex);
+    return count;
+}
+
+SINLINE u32 benchmark_push(queue_kind_t kind, const u64* values, u32 count) {
+    switch (kind) {
+        case QUEUE_KIND_SPSC:
+            return count == 1 ? spsc_queue_u64_push(&spsc_queue, values[0]) : spsc_queue_u64_push_batch(&spsc_queue, values, count);
+        case QUEUE_KIND_MPMC:
+            return count == 1 ? mpmc_queue_u64_push(&mpmc_queue, values[0]) : mpmc_queue_u64_push_batch(&mpmc_queue, values, count);
+        default:
+            return mutex_queue_push(values, count);
+    }
+}
+
+SINLINE u32 benchmark_pop(queue_kind_t kind, u64* values, u32 max_count) {
+    switch (kind) {
+        case QUEUE_KIND_SPSC:
+            return max_count == 1 ? spsc_queue_u64_pop(&spsc_queue, values) : spsc_queue_u64_pop_batch(&spsc_queue, values, max_count);
+        case QUEUE_KIND_MPMC:
+            return max_count == 1 ? mpmc_queue_u64_pop(&mpmc_queue, values) : mpmc_queue_u64_pop_batch(&mpmc_queue, values, max_count);
+        default:
+            return mutex_queue_pop(values, max_count);
+    }
+}
+
+void* producer_thread(void* args) {
+    const benchmark_args_t* benchmark_args = args;
+    u64 values[BATCH_SIZE];
+    u64 pushed = 0;
+    while (pushed < values_per_producer) {
+        const u32 count = smin(benchmark_args->batch_size, values_per_producer - pushed);
+        for (u32 i = 0; i < count; i++) {
+            values[i] = pushed + i;
+        }
+        pushed += benchmark_push(benchmark_args->kind, values, count);
+    }
+    return NULL;
+}
+
+void* consumer_thread(void* args) {
+    const benchmark_args_t* benchmark_args = args;
+    u64 values[BATCH_SIZE];
+    u64 checksum = 0;
+    while (__atomic_load_n(&consumed_count, __ATOMIC_RELAXED) < total_count) {
+        const u32 count = benchmark_pop(benchmark_args->kind, values, benchmark_args->batch_size);
+        for (u32 i = 0; i < count; i++) {
+            checksum += values[i];
+        }
+        if (count) {
+            __atomic_fetch_add(&consumed_count, count, __ATOMIC_RELAXED);
+        }
+    }
+    return (void*)checksum;
+}
+
+SINLINE f64 run_benchmark(queue_kind_t kind, u32 thread_pair_count, u32 batch_size) {
+    thread_t threads[MAX_THREADS];
+    benchmark_args_t args = {
+        .kind = kind,
+        .batch_size = batch_size,
+    };
+    consumed_count = 0;
+    total_count = values_per_producer * thread_pair_count;
+
+    spark_clock_t clock;
+    clock_start(&clock);
+    for (u32 i = 0; i < thread_pair_count; i++) {
+        thread_create(producer_thread, &args, &threads[i * 2]);
+        thread_create(consumer_thread, &args, &threads[i * 2 + 1]);
+    }
+    for (u32 i = 0; i < thread_pair_count * 2; i++) {
+        thread_join(threads[i]);
+    }
+    clock_update(&clock);
+    return clock.elapsed_time;
+}
+
+s32 main(s32 argc, char** argv) {
+    initialize_memory();
+    spsc_queue_u64_create(QUEUE_CAPACITY, &spsc_queue);
+    mpmc_queue_u64_create(QUEUE_CAPACITY, &mpmc_queue);
+    mutex_create(&mutex_queue.mutex);
+
+    for (u32 i = 0; i < sizeof(thread_pair_counts) / sizeof(u32); i++) {
+        const u32 thread_pair_count = thread_pair_counts[i];
+        for (u32 kind = 0; kind < QUEUE_KIND_MAX; kind++) {
+            // The SPSC queue only allows one producer and one consumer
+            if (kind == QUEUE_KIND_SPSC && thread_pair_count > 1) {
+                continue;
+            }
+            const f64 operations = (f64)values_per_producer * thread_pair_count;
+            const f64 single_time = run_benchmark(kind, thread_pair_count, 1);
+            const f64 batch_time = run_benchmark(kind, thread_pair_count, BATCH_SIZE);
+            SINFO("[%d producers, %d consumers] %s: single %.2f Mops/s, batch of %d %.2f Mops/s",
+                    thread_pair_count, thread_pair_count, queue_kind_names[kind],
+                    operations / single_time / 1000000, BATCH_SIZE, operations / batch_time / 1000000);
+        }
+    }
+
+    mutex_destroy(&mutex_queue.mutex);
+    mpmc_queue_u64_destroy(&mpmc_queue);
+    spsc_queue_u64_destroy(&spsc_queue);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Spark/defines.h"
+
+// Dense array of bits, for masks and sets of small ids such as component matches, visibility and dirty flags.
+//
+// Bits are stored in 64 bit words and the word count is padded to a multiple of BITSET_BLOCK_WORDS, so the bulk
+// operations work on whole 256 bit blocks (AVX2 when the CPU supports it) without a scalar tail. Bits at and past bit_count are
+// always zero, so counting and iterating never need to mask the last word.
+#define BITSET_WORD_BITS 64
+#define BITSET_BLOCK_WORDS 4
+
+typedef struct bitset {
+    u64* words;
+    u32 bit_count;
+    // Always a multiple of BITSET_BLOCK_WORDS
+    u32 word_count;
+} bitset_t;
+
+SAPI void bitset_create(u32 bit_count, bitset_t* out_bitset);
+SAPI void bitset_destroy(bitset_t* bitset);
+// Keeps the existing bits, new bits are cleared
+SAPI void bitset_resize(bitset_t* bitset, u32 bit_count);
+
+SINLINE void bitset_set(bitset_t* bitset, u32 bit) {
+    bitset->words[bit / BITSET_WORD_BITS] |= 1ull << (bit % BITSET_WORD_BITS);
+}
+
+SINLINE void bitset_clear(bitset_t* bitset, u32 bit) {
+    bitset->words[bit / BITSET_WORD_BITS] &= ~(1ull << (bit % BITSET_WORD_BITS));
+}
+
+SINLINE void bitset_assign(bitset_t* bitset, u32 bit, b8 value) {
+    u64* word = &bitset->words[bit / BITSET_WORD_BITS];
+    const u64 mask = 1ull << (bit % BITSET_WORD_BITS);
+    *word = (*word & ~mask) | (-(u64)(value != 0) & mask);
+}
+
+SINLINE b8 bitset_test(const bitset_t* bitset, u32 bit) {
+    return (bitset->words[bit / BITSET_WORD_BITS] >> (bit % BITSET_WORD_BITS)) & 1;
+}
+
+/**
+ * @brief Sets or clears count bits starting at first, whole words at a time.
+ */
+SAPI void bitset_set_range(bitset_t* bitset, u32 first, u32 count);
+SAPI void bitset_clear_range(bitset_t* bitset, u32 first, u32 count);
+SAPI void bitset_clear_all(bitset_t* bitset);
+
+/**
+ * @brief Combines a and b into dest. All three need the same bit count, dest may be a or b.
+ */
+SAPI void bitset_and(bitset_t* dest, const bitset_t* a, const bitset_t* b);
+SAPI void bitset_or(bitset_t* dest, const bitset_t* a, const bitset_t* b);
+// Bits of a that are not in b
+SAPI void bitset_andnot(bitset_t* dest, const bitset_t* a, const bitset_t* b);
+
+// Number of set bits
+SAPI u32 bitset_count(const bitset_t* bitset);
+SAPI b8 bitset_any(const bitset_t* bitset);
+
+// The bulk operations use AVX2 when the CPU supports it. Turning it off runs the scalar paths, for tests and benchmarks
+SAPI void bitset_set_avx2(b8 enabled);
+
+/**
+ * @brief First set bit at or after bit, INVALID_ID if there is none.
+ *
+ * Iterate all set bits with
+ *  for (u32 i = bitset_next(&bitset, 0); i != INVALID_ID; i = bitset_next(&bitset, i + 1))
+ */
+SAPI u32 bitset_next(const bitset_t* bitset, u32 bit);
+
+/**
+ * @brief Calls function with the index of every set bit in ascending order, one word at a time.
+ */
+SAPI void bitset_for_each(const bitset_t* bitset, void (*function)(u32 bit, void* user_data), void* user_data);
@@ -60,7 +60,7 @@
         type value = array->data[index];                                                                                                                \
         if (index < array->count) {                                                                                                                     \
             for (u32 i = index; i < array->count - 1; i++) {                                                                                            \
-                array->data[i] = array->data[i - 1];                                                                                                    \
+                array->data[i] = array->data[i + 1];                                                                                                    \
             }                                                                                                                                           \
         }                                                                                                                                               \
         array->count--;                                                                                                                                 \
@@ -80,10 +80,7 @@
         if (array->capacity >= size) {                                                                                                                  \
             return;                                                                                                                                     \
         }                                                                                                                                               \
-        type* temp = sallocate(sizeof(type) * size, MEMORY_TAG_DARRAY);                                                                                 \
-        scopy_memory(temp, array->data, array->count * sizeof(type));                                                                                   \
-        sfree(array->data, sizeof(type) * array->capacity, MEMORY_TAG_DARRAY);                                                                          \
-        array->data = temp;                                                                                                                             \
+        array->data = sreallocate(array->data, sizeof(type) * array->capacity, sizeof(type) * size, MEMORY_TAG_DARRAY);                                 \
         array->capacity = size;                                                                                                                         \
     }                                                                                                                                                   \
     void darray_##name##_clear(struct darray_##name* array) {                                                                                           \
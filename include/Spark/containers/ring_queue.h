@@ -0,0 +1,217 @@
+#pragma once
+
+#include "Spark/core/logging.h"
+#include "Spark/core/smemory.h"
+#include "Spark/defines.h"
+#include "Spark/math/smath.h"
+
+// Bounded lock-free ring buffer queues. Capacities are rounded up to a power of two.
+//
+// spsc_queue: one producer and one consumer thread. Both sides only write their own index, and keep a copy of the
+// other side's index that is refreshed when the queue looks full or empty, so most operations touch no shared cache
+// line. Every operation finishes in a bounded number of steps (wait-free).
+//
+// mpmc_queue: any number of producers and consumers (Vyukov's bounded queue). Every slot has a sequence number that
+// says whose turn it is, a producer or consumer claims a slot with one compare exchange on the shared position and
+// publishes it through the slot's sequence. Batches claim consecutive slots with a single compare exchange.
+//
+// The indices written by different threads live on separate cache lines.
+#define RING_QUEUE_CACHE_LINE 64
+
+SINLINE u32 ring_queue_capacity(u32 capacity) {
+    return capacity <= 2 ? 2 : 1u << (32 - __builtin_clz(capacity - 1));
+}
+
+// ================================
+// Single producer, single consumer
+// ================================
+#define spsc_queue_type(type, name)                                                                                   \
+    typedef struct spsc_queue_##name {                                                                                \
+        type* data;                                                                                                   \
+        u32 mask;                                                                                                     \
+        /* Consumer side */                                                                                           \
+        SALIGNED(RING_QUEUE_CACHE_LINE) u64 head;                                                                     \
+        u64 cached_tail;                                                                                              \
+        /* Producer side */                                                                                           \
+        SALIGNED(RING_QUEUE_CACHE_LINE) u64 tail;                                                                     \
+        u64 cached_head;                                                                                              \
+    } spsc_queue_##name##_t
+
+#define spsc_queue_header(type, name)                                                                                 \
+    spsc_queue_type(type, name);                                                                                      \
+    void spsc_queue_##name##_create(u32 capacity, spsc_queue_##name##_t* out_queue);                                  \
+    void spsc_queue_##name##_destroy(spsc_queue_##name##_t* queue);                                                   \
+    b8 spsc_queue_##name##_push(spsc_queue_##name##_t* queue, type value);                                            \
+    b8 spsc_queue_##name##_pop(spsc_queue_##name##_t* queue, type* out_value);                                        \
+    u32 spsc_queue_##name##_push_batch(spsc_queue_##name##_t* queue, const type* values, u32 count);                  \
+    u32 spsc_queue_##name##_pop_batch(spsc_queue_##name##_t* queue, type* out_values, u32 max_count);                 \
+    u32 spsc_queue_##name##_count(const spsc_queue_##name##_t* queue);
+
+#define spsc_queue_impl(type, name)                                                                                   \
+    void spsc_queue_##name##_create(u32 capacity, spsc_queue_##name##_t* out_queue) {                                 \
+        capacity = ring_queue_capacity(capacity);                                                                     \
+        *out_queue = (spsc_queue_##name##_t) {                                                                        \
+            .data = sallocate(sizeof(type) * capacity, MEMORY_TAG_ARRAY),                                             \
+            .mask = capacity - 1,                                                                                     \
+        };                                                                                                            \
+    }                                                                                                                 \
+    void spsc_queue_##name##_destroy(spsc_queue_##name##_t* queue) {                                                  \
+        sfree(queue->data, sizeof(type) * (queue->mask + 1), MEMORY_TAG_ARRAY);                                       \
+        queue->data = NULL;                                                                                           \
+    }                                                                                                                 \
+    /* Producer only. Space for up to count values, refreshing the consumer's index if needed */                      \
+    static u32 spsc_queue_##name##_free_space(spsc_queue_##name##_t* queue, u64 tail, u32 count) {                    \
+        const u64 capacity = (u64)queue->mask + 1;                                                                    \
+        if (tail - queue->cached_head + count > capacity) {                                                           \
+            queue->cached_head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);                                     \
+        }                                                                                                             \
+        return capacity - (tail - queue->cached_head);                                                                \
+    }                                                                                                                 \
+    /* Consumer only. Values available, refreshing the producer's index if needed */                                  \
+    static u32 spsc_queue_##name##_available(spsc_queue_##name##_t* queue, u64 head, u32 count) {                     \
+        if (queue->cached_tail - head < count) {                                                                      \
+            queue->cached_tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);                                     \
+        }                                                                                                             \
+        return queue->cached_tail - head;                                                                             \
+    }                                                                                                                 \
+    b8 spsc_queue_##name##_push(spsc_queue_##name##_t* queue, type value) {                                           \
+        const u64 tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);                                             \
+        if (!spsc_queue_##name##_free_space(queue, tail, 1)) {                                                        \
+            return false;                                                                                             \
+        }                                                                                                             \
+        queue->data[tail & queue->mask] = value;                                                                      \
+        __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);                                                   \
+        return true;                                                                                                  \
+    }                                                                                                                 \
+    b8 spsc_queue_##name##_pop(spsc_queue_##name##_t* queue, type* out_value) {                                       \
+        const u64 head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);                                             \
+        if (!spsc_queue_##name##_available(queue, head, 1)) {                                                         \
+            return false;                                                                                             \
+        }                                                                                                             \
+        *out_value = queue->data[head & queue->mask];                                                                 \
+        __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);                                                   \
+        return true;                                                                                                  \
+    }                                                                                                                 \
+    /* Pushes as many values as fit, returns how many */                                                              \
+    u32 spsc_queue_##name##_push_batch(spsc_queue_##name##_t* queue, const type* values, u32 count) {                 \
+        const u64 tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);                                             \
+        const u32 free_space = spsc_queue_##name##_free_space(queue, tail, count);                                    \
+        count = smin(count, free_space);                                                                              \
+        const u32 start = tail & queue->mask;                                                                         \
+        const u32 first_count = smin(count, queue->mask + 1 - start);                                                 \
+        scopy_memory(queue->data + start, values, sizeof(type) * first_count);                                        \
+        scopy_memory(queue->data, values + first_count, sizeof(type) * (count - first_count));                        \
+        __atomic_store_n(&queue->tail, tail + count, __ATOMIC_RELEASE);                                               \
+        return count;                                                                                                 \
+    }                                                                                                                 \
+    /* Pops up to max_count values, returns how many */                                                               \
+    u32 spsc_queue_##name##_pop_batch(spsc_queue_##name##_t* queue, type* out_values, u32 max_count) {                \
+        const u64 head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);                                             \
+        const u32 available = spsc_queue_##name##_available(queue, head, max_count);                                  \
+        const u32 count = smin(max_count, available);                                                                 \
+        const u32 start = head & queue->mask;                                                                         \
+        const u32 first_count = smin(count, queue->mask + 1 - start);                                                 \
+        scopy_memory(out_values, queue->data + start, sizeof(type) * first_count);                                    \
+        scopy_memory(out_values + first_count, queue->data, sizeof(type) * (count - first_count));                    \
+        __atomic_store_n(&queue->head, head + count, __ATOMIC_RELEASE);                                               \
+        return count;                                                                                                 \
+    }                                                                                                                 \
+    /* Exact only on the producer or consumer thread */                                                               \
+    u32 spsc_queue_##name##_count(const spsc_queue_##name##_t* queue) {                                               \
+        return __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);    \
+    }
+
+// ================================
+// Multiple producers, multiple consumers
+// ================================
+// A slot is free for position p when its sequence is p, and holds the value pushed at p when its sequence is p + 1
+#define mpmc_queue_type(type, name)                                                                                   \
+    typedef struct mpmc_queue_##name##_slot {                                                                         \
+        u64 sequence;                                                                                                 \
+        type value;                                                                                                   \
+    } mpmc_queue_##name##_slot_t;                                                                                     \
+    typedef struct mpmc_queue_##name {                                                                                \
+        mpmc_queue_##name##_slot_t* slots;                                                                            \
+        u32 mask;                                                                                                     \
+        SALIGNED(RING_QUEUE_CACHE_LINE) u64 push_position;                                                            \
+        SALIGNED(RING_QUEUE_CACHE_LINE) u64 pop_position;                                                             \
+    } mpmc_queue_##name##_t
+
+#define mpmc_queue_header(type, name)                                                                                 \
+    mpmc_queue_type(type, name);                                                                                      \
+    void mpmc_queue_##name##_create(u32 capacity, mpmc_queue_##name##_t* out_queue);                                  \
+    void mpmc_queue_##name##_destroy(mpmc_queue_##name##_t* queue);                                                   \
+    b8 mpmc_queue_##name##_push(mpmc_queue_##name##_t* queue, type value);                                            \
+    b8 mpmc_queue_##name##_pop(mpmc_queue_##name##_t* queue, type* out_value);                                        \
+    u32 mpmc_queue_##name##_push_batch(mpmc_queue_##name##_t* queue, const type* values, u32 count);                  \
+    u32 mpmc_queue_##name##_pop_batch(mpmc_queue_##name##_t* queue, type* out_values, u32 max_count);
+
+#define mpmc_queue_impl(type, name)                                                                                   \
+    void mpmc_queue_##name##_create(u32 capacity, mpmc_queue_##name##_t* out_queue) {                                 \
+        capacity = ring_queue_capacity(capacity);                                                                     \
+        *out_queue = (mpmc_queue_##name##_t) {                                                                        \
+            .slots = sallocate(sizeof(mpmc_queue_##name##_slot_t) * capacity, MEMORY_TAG_ARRAY),                      \
+            .mask = capacity - 1,                                                                                     \
+        };                                                                                                            \
+        for (u32 i = 0; i < capacity; i++) {                                                                          \
+            out_queue->slots[i].sequence = i;                                                                         \
+        }                                                                                                             \
+    }                                                                                                                 \
+    void mpmc_queue_##name##_destroy(mpmc_queue_##name##_t* queue) {                                                  \
+        sfree(queue->slots, sizeof(mpmc_queue_##name##_slot_t) * (queue->mask + 1), MEMORY_TAG_ARRAY);                \
+        queue->slots = NULL;                                                                                          \
+    }                                                                                                                 \
+    /* Claims up to max_count consecutive slots whose sequence is position + offset, returns how many */             \
+    static u32 mpmc_queue_##name##_claim(mpmc_queue_##name##_t* queue, u64* position_ptr, u64 offset, u32 max_count, u64* out_position) { \
+        u64 position = __atomic_load_n(position_ptr, __ATOMIC_RELAXED);                                               \
+        while (true) {                                                                                                \
+            u32 count = 0;                                                                                            \
+            while (count < max_count) {                                                                               \
+                const u64 sequence = __atomic_load_n(&queue->slots[(position + count) & queue->mask].sequence, __ATOMIC_ACQUIRE); \
+                if (sequence != position + count + offset) {                                                          \
+                    break;                                                                                            \
+                }                                                                                                     \
+                count++;                                                                                              \
+            }                                                                                                         \
+            if (count == 0) {                                                                                         \
+                /* Full or empty, unless another thread moved the position on since it was read */                   \
+                const u64 current = __atomic_load_n(position_ptr, __ATOMIC_RELAXED);                                  \
+                if (current == position) {                                                                            \
+                    return 0;                                                                                         \
+                }                                                                                                     \
+                position = current;                                                                                   \
+                continue;                                                                                             \
+            }                                                                                                         \
+            if (__atomic_compare_exchange_n(position_ptr, &position, position + count, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) { \
+                *out_position = position;                                                                             \
+                return count;                                                                                         \
+            }                                                                                                         \
+        }                                                                                                             \
+    }                                                                                                                 \
+    u32 mpmc_queue_##name##_push_batch(mpmc_queue_##name##_t* queue, const type* values, u32 count) {                 \
+        u64 position;                                                                                                 \
+        count = mpmc_queue_##name##_claim(queue, &queue->push_position, 0, count, &position);                        \
+        for (u32 i = 0; i < count; i++) {                                                                             \
+            mpmc_queue_##name##_slot_t* slot = &queue->slots[(position + i) & queue->mask];                           \
+            slot->value = values[i];                                                                                  \
+            __atomic_store_n(&slot->sequence, position + i + 1, __ATOMIC_RELEASE);                                    \
+        }                                                                                                             \
+        return count;                                                                                                 \
+    }                                                                                                                 \
+    u32 mpmc_queue_##name##_pop_batch(mpmc_queue_##name##_t* queue, type* out_values, u32 max_count) {                \
+        u64 position;                                                                                                 \
+        const u32 count = mpmc_queue_##name##_claim(queue, &queue->pop_position, 1, max_count, &position);           \
+        for (u32 i = 0; i < count; i++) {                                                                             \
+            mpmc_queue_##name##_slot_t* slot = &queue->slots[(position + i) & queue->mask];                           \
+            out_values[i] = slot->value;                                                                              \
+            /* Free for the push one lap later */                                                                     \
+            __atomic_store_n(&slot->sequence, position + i + queue->mask + 1, __ATOMIC_RELEASE);                      \
+        }                                                                                                             \
+        return count;                                                                                                 \
+    }                                                                                                                 \
+    b8 mpmc_queue_##name##_push(mpmc_queue_##name##_t* queue, type value) {                                           \
+        return mpmc_queue_##name##_push_batch(queue, &value, 1);                                                      \
+    }                                                                                                                 \
+    b8 mpmc_queue_##name##_pop(mpmc_queue_##name##_t* queue, type* out_value) {                                       \
+        return mpmc_queue_##name##_pop_batch(queue, out_value, 1);                                                    \
+    }
@@ -1,17 +1,67 @@
 #pragma once
 
+#include "Spark/containers/unordered_map.h"
 #include "Spark/core/smemory.h"
 #include "Spark/defines.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Set of integer values, each with the index it was inserted at.
+//
+// Up to SET_SMALL_CAPACITY values are kept sorted in the set itself and searched all at once. Larger sets move the
+// values to sorted arrays on the heap and look them up through a hashmap, so the size of a set only depends on its
+// count. Iterate with name##_values and name##_indices, which stay sorted by value in both cases.
+#define SET_SMALL_CAPACITY 16
+
+// Position of value in the first count of SET_SMALL_CAPACITY values, INVALID_ID if it is not there
+SINLINE u32 set_small_find_u32(const u32* values, u32 count, u32 value) {
+#ifdef __SSE2__
+    const __m128i needle = _mm_set1_epi32(value);
+    u32 matches = 0;
+    for (u32 i = 0; i < SET_SMALL_CAPACITY; i += 4) {
+        const __m128i equal = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(values + i)), needle);
+        matches |= (u32)_mm_movemask_ps(_mm_castsi128_ps(equal)) << i;
+    }
+    matches &= (1u << count) - 1;
+    return matches ? (u32)__builtin_ctz(matches) : INVALID_ID;
+#else
+    for (u32 i = 0; i < count; i++) {
+        if (values[i] == value) {
+            return i;
+        }
+    }
+    return INVALID_ID;
+#endif
+}
+
 #define set_type(type, name)                                                                 \
-    typedef struct pvt_##name##_container { \
-        type value; \
-        u32 index; \
-    } pvt_##name##_container_t; \
+    hashmap_type(pvt_##name##_map, type, u32);                                               \
     typedef struct name {                                                                    \
         u32 count;                                                                           \
+        /* Capacity of the heap arrays, 0 while the values fit in small */                   \
         u32 capacity;                                                                        \
-        pvt_##name##_container_t* data;                                                                          \
-    } name ##_t;
+        union {                                                                              \
+            struct {                                                                         \
+                type values[SET_SMALL_CAPACITY];                                             \
+                u32 indices[SET_SMALL_CAPACITY];                                             \
+            } small;                                                                         \
+            struct {                                                                         \
+                type* values;                                                                \
+                u32* indices;                                                                \
+                /* Value to its insertion index, which never changes when values shift */    \
+                pvt_##name##_map_t indices_by_value;                                         \
+            } large;                                                                         \
+        };                                                                                   \
+    } name ##_t;                                                                             \
+                                                                                             \
+    SINLINE const type* name##_values(const name##_t* set) {                                 \
+        return set->capacity ? set->large.values : set->small.values;                        \
+    }                                                                                        \
+    SINLINE const u32* name##_indices(const name##_t* set) {                                 \
+        return set->capacity ? set->large.indices : set->small.indices;                      \
+    }
 
 #define set_header(type, name)                                                               \
     set_type   (type, name);                                                                 \
@@ -22,60 +72,87 @@
     b8   name##_contains (name##_t* set, type value);
 
 #define set_impl(type, name)                                                                 \
-    void name##_resize(name##_t* set, u32 capacity) {                                        \
-        pvt_##name##_container_t* temp = sallocate(sizeof(pvt_##name##_container_t) * capacity, MEMORY_TAG_ARRAY);                   \
-        sset_memory(temp, 0xFFFFFFFF, capacity * sizeof(pvt_##name##_container_t)); \
-        for (u32 i = 0; i < set->capacity; i++) { \
-            u32 value = set->data[i].value; \
-            u32 index = value % capacity; \
-            if (value == INVALID_ID) { \
-                continue; \
-            } \
-            if (temp[index].value != INVALID_ID) { \
-                sfree(temp, sizeof(pvt_##name##_container_t) * capacity, MEMORY_TAG_ARRAY); \
-                SDEBUG("Failed to resize set: Value: %d, invalid_id: %d, Index: %d, New capacity %d", value, value == INVALID_ID, index, capacity); \
-                name##_resize(set, capacity * 2); \
-                return; \
-            } \
-            temp[index].value = value; \
-            temp[index].index = set->data[i].index; \
-        } \
-        sfree(set->data, sizeof(pvt_##name##_container_t) * set->capacity, MEMORY_TAG_ARRAY);                    \
-        set->data = temp;                                                                    \
+    hashmap_impl(pvt_##name##_map, type, u32, hash_passthrough, u64_compare, hash_passthrough); \
+                                                                                             \
+    /* Index value was inserted at, INVALID_ID if it is not in the set */                    \
+    static u32 name##_find(const name##_t* set, type value) {                                \
+        if (set->capacity) {                                                                 \
+            u32 index;                                                                       \
+            return pvt_##name##_map_try_get(&set->large.indices_by_value, value, &index) ? index : INVALID_ID; \
+        }                                                                                    \
+        u32 position = INVALID_ID;                                                           \
+        if (sizeof(type) == sizeof(u32)) {                                                   \
+            position = set_small_find_u32((const u32*)set->small.values, set->count, value); \
+        } else {                                                                             \
+            for (u32 i = 0; i < set->count && position == INVALID_ID; i++) {                 \
+                position = set->small.values[i] == value ? i : INVALID_ID;                   \
+            }                                                                                \
+        }                                                                                    \
+        return position == INVALID_ID ? INVALID_ID : set->small.indices[position];           \
+    }                                                                                        \
+                                                                                             \
+    static void name##_grow(name##_t* set, u32 capacity) {                                   \
+        type* values = sallocate(sizeof(type) * capacity, MEMORY_TAG_ARRAY);                 \
+        u32* indices = sallocate(sizeof(u32) * capacity, MEMORY_TAG_ARRAY);                  \
+        scopy_memory(values, name##_values(set), sizeof(type) * set->count);                 \
+        scopy_memory(indices, name##_indices(set), sizeof(u32) * set->count);                \
+        if (set->capacity) {                                                                 \
+            sfree(set->large.values, sizeof(type) * set->capacity, MEMORY_TAG_ARRAY);        \
+            sfree(set->large.indices, sizeof(u32) * set->capacity, MEMORY_TAG_ARRAY);        \
+        } else {                                                                             \
+            pvt_##name##_map_create(capacity, &set->large.indices_by_value);                 \
+            for (u32 i = 0; i < set->count; i++) {                                           \
+                pvt_##name##_map_insert(&set->large.indices_by_value, values[i], indices[i]); \
+            }                                                                                \
+        }                                                                                    \
+        set->large.values = values;                                                          \
+        set->large.indices = indices;                                                        \
         set->capacity = capacity;                                                            \
     }                                                                                        \
+                                                                                             \
     void name##_create(u32 capacity, name##_t* out_set) {                                    \
-        out_set->data = sallocate(sizeof(pvt_##name##_container_t) * capacity, MEMORY_TAG_ARRAY);                \
-        out_set->capacity = capacity;                                                        \
-        out_set->count = 0; \
-        for (u32 i = 0; i < capacity; i++) { \
-            out_set->data[i].value = INVALID_ID; \
-            out_set->data[i].index = INVALID_ID; \
-        } \
+        out_set->count = 0;                                                                  \
+        out_set->capacity = 0;                                                               \
+        sset_memory(out_set->small.values, 0xFF, sizeof(out_set->small.values));             \
+        if (capacity > SET_SMALL_CAPACITY) {                                                 \
+            name##_grow(out_set, capacity);                                                  \
+        }                                                                                    \
     }                                                                                        \
     void name##_destroy(name##_t* set) {                                                     \
-        sfree(set->data, sizeof(pvt_##name##_container_t) * set->capacity, MEMORY_TAG_ARRAY);                    \
-        set->data = NULL;                                                                    \
+        if (set->capacity) {                                                                 \
+            sfree(set->large.values, sizeof(type) * set->capacity, MEMORY_TAG_ARRAY);        \
+            sfree(set->large.indices, sizeof(u32) * set->capacity, MEMORY_TAG_ARRAY);        \
+            pvt_##name##_map_destroy(&set->large.indices_by_value);                          \
+        }                                                                                    \
+        set->count = 0;                                                                      \
+        set->capacity = 0;                                                                   \
     }                                                                                        \
     void name##_insert(name##_t* set, type value) {                                          \
-        u32 index = value % set->capacity; \
-        if (set->data[index].value != INVALID_ID || set->count >= set->capacity) { \
-            name##_resize(set, set->capacity * 2); \
-            name##_insert(set, value); \
-            return; \
-        } \
-        SASSERT(set->data[index].value == INVALID_ID, "Cannot insert value %d into set, index already in use (value: %d)", value, set->data[value % set->capacity]); \
-        set->data[index].value = value;                                                     \
-        set->data[index].index = set->count;                                                     \
-        set->count += 1; \
+        if (name##_find(set, value) != INVALID_ID) {                                         \
+            return;                                                                          \
+        }                                                                                    \
+        if (set->count == (set->capacity ? set->capacity : SET_SMALL_CAPACITY)) {            \
+            name##_grow(set, set->count * 2);                                                \
+        }                                                                                    \
+                                                                                             \
+        type* values = set->capacity ? set->large.values : set->small.values;                \
+        u32* indices = set->capacity ? set->large.indices : set->small.indices;              \
+        u32 position = set->count;                                                           \
+        while (position > 0 && values[position - 1] > value) {                               \
+            values[position] = values[position - 1];                                         \
+            indices[position] = indices[position - 1];                                       \
+            position--;                                                                      \
+        }                                                                                    \
+        values[position] = value;                                                            \
+        indices[position] = set->count;                                                      \
+        if (set->capacity) {                                                                 \
+            pvt_##name##_map_insert(&set->large.indices_by_value, value, set->count);        \
+        }                                                                                    \
+        set->count += 1;                                                                     \
     }                                                                                        \
     u32 name##_get_index(name##_t* set, type value) {                                        \
-        u32 index = value % set->capacity; \
-        if (set->data[index].value == value) { \
-            return set->data[index].index; \
-        } \
-        return INVALID_ID; \
+        return name##_find(set, value);                                                      \
     }                                                                                        \
     b8 name##_contains(name##_t* set, type value) {                                          \
-        return set->data[value % set->capacity].value == value; \
+        return name##_find(set, value) != INVALID_ID;                                        \
     }
@@ -2,10 +2,77 @@
 
 #include "Spark/core/logging.h"
 #include "Spark/core/smemory.h"
-#include "Spark/containers/darray.h"
 #include "Spark/utils/hashing.h"
 
-#define HASHMAP_MAX_LINKED_LIST_LENGTH 3
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Open addressing hash map with linear probing.
+//
+// Every slot has a control byte, HASHMAP_EMPTY or 7 bits of the key's hash. Lookups compare the control bytes of
+// HASHMAP_GROUP_WIDTH slots at once and only compare keys whose hash bits match. The first HASHMAP_GROUP_WIDTH - 1
+// control bytes are repeated after the last one, so a group can be loaded at any slot without wrapping.
+//
+// Keys never sit behind an empty slot on their probe sequence. Removing a key shifts the keys after it back to keep it
+// that way, so there are no tombstones and lookups stop at the first empty slot.
+#define HASHMAP_GROUP_WIDTH 16
+#define HASHMAP_EMPTY 0x80
+#define HASHMAP_MIN_CAPACITY 16
+// Grow once more than 7/8 of the slots are in use
+#define HASHMAP_MAX_LOAD(capacity) ((capacity) - (capacity) / 8)
+
+// Keys are often ids or addresses with few varying low bits, spread them over all bits before picking a slot
+SINLINE u64 hashmap_mix(hash_t hash) {
+    return hash * 0x9E3779B97F4A7C15ull;
+}
+
+SINLINE u32 hashmap_slot(u64 mixed, u32 shift) {
+    return mixed >> shift;
+}
+
+SINLINE u8 hashmap_control(u64 mixed) {
+    return (mixed >> 32) & 0x7F;
+}
+
+// Bit per slot of the group at control whose control byte equals value
+SINLINE u32 hashmap_group_match(const u8* control, u8 value) {
+#ifdef __SSE2__
+    const __m128i group = _mm_loadu_si128((const __m128i*)control);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(value)));
+#else
+    u32 mask = 0;
+    for (u32 i = 0; i < HASHMAP_GROUP_WIDTH; i++) {
+        mask |= (u32)(control[i] == value) << i;
+    }
+    return mask;
+#endif
+}
+
+// Bit per empty slot of the group at control. Only empty slots have the high bit set.
+SINLINE u32 hashmap_group_match_empty(const u8* control) {
+#ifdef __SSE2__
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)control));
+#else
+    return hashmap_group_match(control, HASHMAP_EMPTY);
+#endif
+}
+
+SINLINE void hashmap_set_control(u8* control, u32 capacity, u32 slot, u8 value) {
+    control[slot] = value;
+    if (slot < HASHMAP_GROUP_WIDTH - 1) {
+        control[capacity + slot] = value;
+    }
+}
+
+// Slots needed to hold count keys without growing
+SINLINE u32 hashmap_capacity_for(u32 count) {
+    u32 capacity = HASHMAP_MIN_CAPACITY;
+    while (HASHMAP_MAX_LOAD(capacity) < count) {
+        capacity *= 2;
+    }
+    return capacity;
+}
 
 #define hashmap_type(name, key_type, value_type)                                                     \
     typedef struct name##_pair {                                                                     \
@@ -13,101 +80,157 @@
         value_type value;                                                                            \
     } name##_pair_t;                                                                                 \
                                                                                                      \
-    darray_header(name##_pair_t, name##_pair);                                                       \
-                                                                                                     \
     typedef struct name {                                                                            \
+        name##_pair_t* pairs;                                                                        \
+        /* capacity + HASHMAP_GROUP_WIDTH - 1 bytes, in the same allocation as pairs */              \
+        u8* control;                                                                                 \
         u32 capacity;                                                                                \
-        darray_##name##_pair_t* pairs;                                                               \
+        u32 count;                                                                                   \
+        /* 64 - log2(capacity), turns a mixed hash into a slot */                                    \
+        u32 shift;                                                                                   \
     } name##_t;
 
 #define hashmap_header(name, key_type, value_type)                                                   \
     hashmap_type(name, key_type, value_type);                                                        \
     void name##_create(u32 capacity, name##_t* out_hashmap);                                         \
-    void name##_destroy(const name##_t* hashmap);                                                           \
-    void name##_insert(const name##_t* hashmap, key_type key, value_type value);                           \
-    b8 name##_contains(const name##_t* hashmap, key_type key);                                             \
-    b8 name##_try_get(const name##_t* hashmap, key_type key, value_type* out_value);                       \
-    value_type* name##_get(const name##_t* hashmap, key_type key);                                         
+    void name##_destroy(const name##_t* hashmap);                                                    \
+    void name##_insert(name##_t* hashmap, key_type key, value_type value);                           \
+    void name##_remove(name##_t* hashmap, key_type key);                                             \
+    b8 name##_contains(const name##_t* hashmap, key_type key);                                       \
+    b8 name##_try_get(const name##_t* hashmap, key_type key, value_type* out_value);                 \
+    value_type* name##_get(const name##_t* hashmap, key_type key);
 
-// Key copy is a function in the form of void (key_type* dest, key_type* src);
+// Key copy is a function in the form of key_type (key_type src);
 // If key_copy == NULL, the key wil take a simple copy (i.e.) dest = src;
-#define hashmap_impl(name, key_type, value_type, hash_function, key_compare_function, key_copy_function)                                      \
-    darray_impl(name##_pair_t, name##_pair);                                                         \
-    void name##_create(u32 capacity, name##_t* out_hashmap) {                                        \
-        out_hashmap->capacity = capacity;                                                            \
-        out_hashmap->pairs = sallocate(sizeof(darray_##name##_pair_t) * capacity, MEMORY_TAG_ARRAY); \
-        for (u32 i = 0; i < capacity; i++) {                                                         \
-            darray_##name##_pair_create(4, &out_hashmap->pairs[i]);                                  \
-        }                                                                                            \
-    }                                                                                                \
-    void name##_destroy(const name##_t* hashmap) {                                                         \
-        for (u32 i = 0; i < hashmap->capacity; i++) {                                                \
-            darray_##name##_pair_destroy(&hashmap->pairs[i]);                                        \
-        }                                                                                            \
-        sfree(hashmap->pairs, sizeof(darray_##name##_pair_t) * hashmap->capacity, MEMORY_TAG_ARRAY); \
-    }                                                                                                \
-    void name##_remove(const name##_t* hashmap, key_type key) {                                            \
-        hash_t hash = hash_function(key);                                                            \
-        u32 index = hash % hashmap->capacity;                                                        \
-                                                                                                     \
-        darray_##name##_pair_t* pairs = &hashmap->pairs[index];                                      \
-        for (u32 i = 0; i < pairs->count; i++) {                                                     \
-            if (key_compare_function(pairs->data[i].key, key)) {                                                         \
-                darray_##name##_pair_pop(pairs, i);                                                  \
-                return;                                                                              \
-            }                                                                                        \
-        }                                                                                            \
-                                                                                                     \
-        SERROR("Hashmap does not contain key.");                                                     \
-    }                                                                                                \
-                                                                                                     \
-    void name##_insert(const name##_t* hashmap, key_type key, value_type value) {                          \
-        hash_t hash = hash_function(key);                                                            \
-        u32 index = hash % hashmap->capacity;                                                        \
-                                                                                                     \
-        name##_pair_t pair = {                                                                       \
-            .value = value,                                                                          \
-            .key = key_copy_function(key), \
-        };                                                                                           \
-        darray_##name##_pair_push(&hashmap->pairs[index], pair);                                     \
-    }                                                                                                \
-    \
-    b8 name##_contains(const name##_t* hashmap, key_type key) {                                            \
-        hash_t hash = hash_function(key);                                                            \
-        u32 index = hash % hashmap->capacity;                                                        \
-        \
-        darray_##name##_pair_t* pairs = &hashmap->pairs[index];                                      \
-        for (u32 i = 0; i < pairs->count; i++) {                                                     \
-            if (key_compare_function(pairs->data[i].key, key)) {                                                         \
-                return true;                                                                         \
-            }                                                                                        \
-        }                                                                                            \
-        return false;                                                                                \
-    }                                                                                                \
-    \
-    b8 name##_try_get(const name##_t* hashmap, key_type key, value_type* out_value) {                      \
-        hash_t hash = hash_function(key);                                                            \
-        u32 index = hash % hashmap->capacity;                                                        \
-        \
-        darray_##name##_pair_t* pairs = &hashmap->pairs[index];                                      \
-        for (u32 i = 0; i < pairs->count; i++) {                                                     \
-            if (key_compare_function(pairs->data[i].key, key)) {                                                         \
-                *out_value = pairs->data[i].value;                                                   \
-                return true;                                                                         \
-            }                                                                                        \
-        }                                                                                            \
-        return false;                                                                                \
-    }                                                                                                \
-    \
-    value_type* name##_get(const name##_t* hashmap, key_type key) {                                        \
-        hash_t hash = hash_function(key);                                                            \
-        u32 index = hash % hashmap->capacity;                                                        \
-        \
-        darray_##name##_pair_t* pairs = &hashmap->pairs[index];                                      \
-        for (u32 i = 0; i < pairs->count; i++) {                                                     \
-            if (key_compare_function(pairs->data[i].key, key)) {                                                         \
-                return &pairs->data[i].value;                                                        \
-            }                                                                                        \
-        }                                                                                            \
-        return NULL;                                                                                 \
+// capacity is the number of keys the map holds before it grows.
+#define hashmap_impl(name, key_type, value_type, hash_function, key_compare_function, key_copy_function)   \
+    static void name##_allocate(u32 capacity, name##_t* out_hashmap) {                                \
+        const u64 pairs_size = sizeof(name##_pair_t) * capacity;                                      \
+        out_hashmap->pairs = sallocate(pairs_size + capacity + HASHMAP_GROUP_WIDTH - 1, MEMORY_TAG_ARRAY); \
+        out_hashmap->control = (u8*)out_hashmap->pairs + pairs_size;                                  \
+        sset_memory(out_hashmap->control, HASHMAP_EMPTY, capacity + HASHMAP_GROUP_WIDTH - 1);         \
+        out_hashmap->capacity = capacity;                                                             \
+        out_hashmap->count = 0;                                                                       \
+        out_hashmap->shift = 64 - __builtin_ctz(capacity);                                            \
+    }                                                                                                 \
+                                                                                                      \
+    void name##_create(u32 capacity, name##_t* out_hashmap) {                                         \
+        name##_allocate(hashmap_capacity_for(capacity), out_hashmap);                                 \
+    }                                                                                                 \
+                                                                                                      \
+    void name##_destroy(const name##_t* hashmap) {                                                    \
+        sfree(hashmap->pairs,                                                                         \
+                sizeof(name##_pair_t) * hashmap->capacity + hashmap->capacity + HASHMAP_GROUP_WIDTH - 1, \
+                MEMORY_TAG_ARRAY);                                                                    \
+    }                                                                                                 \
+                                                                                                      \
+    /* Slot holding key, INVALID_ID if there is none */                                               \
+    static u32 name##_find(const name##_t* hashmap, key_type key) {                                   \
+        const u64 mixed = hashmap_mix(hash_function(key));                                            \
+        const u8 control = hashmap_control(mixed);                                                    \
+        const u32 mask = hashmap->capacity - 1;                                                       \
+        u32 group = hashmap_slot(mixed, hashmap->shift);                                              \
+        while (true) {                                                                                \
+            u32 matches = hashmap_group_match(hashmap->control + group, control);                     \
+            const u32 empty = hashmap_group_match_empty(hashmap->control + group);                    \
+            if (empty) {                                                                              \
+                /* Keys can not be behind the first empty slot */                                     \
+                matches &= (empty & -empty) - 1;                                                      \
+            }                                                                                         \
+            while (matches) {                                                                         \
+                const u32 slot = (group + __builtin_ctz(matches)) & mask;                             \
+                if (key_compare_function(hashmap->pairs[slot].key, key)) {                            \
+                    return slot;                                                                      \
+                }                                                                                     \
+                matches &= matches - 1;                                                               \
+            }                                                                                         \
+            if (empty) {                                                                              \
+                return INVALID_ID;                                                                    \
+            }                                                                                         \
+            group = (group + HASHMAP_GROUP_WIDTH) & mask;                                             \
+        }                                                                                             \
+    }                                                                                                 \
+                                                                                                      \
+    /* Places a key that is not in the map yet in the first empty slot of its probe sequence */       \
+    static void name##_place(name##_t* hashmap, const name##_pair_t* pair) {                          \
+        const u64 mixed = hashmap_mix(hash_function(pair->key));                                      \
+        const u32 mask = hashmap->capacity - 1;                                                       \
+        u32 group = hashmap_slot(mixed, hashmap->shift);                                              \
+        u32 empty = hashmap_group_match_empty(hashmap->control + group);                              \
+        while (!empty) {                                                                              \
+            group = (group + HASHMAP_GROUP_WIDTH) & mask;                                             \
+            empty = hashmap_group_match_empty(hashmap->control + group);                              \
+        }                                                                                             \
+        const u32 slot = (group + __builtin_ctz(empty)) & mask;                                       \
+        hashmap->pairs[slot] = *pair;                                                                 \
+        hashmap_set_control(hashmap->control, hashmap->capacity, slot, hashmap_control(mixed));       \
+        hashmap->count++;                                                                             \
+    }                                                                                                 \
+                                                                                                      \
+    static void name##_grow(name##_t* hashmap) {                                                      \
+        const name##_t old = *hashmap;                                                                \
+        name##_allocate(old.capacity * 2, hashmap);                                                   \
+        for (u32 i = 0; i < old.capacity; i++) {                                                      \
+            if (old.control[i] != HASHMAP_EMPTY) {                                                    \
+                name##_place(hashmap, &old.pairs[i]);                                                 \
+            }                                                                                         \
+        }                                                                                             \
+        name##_destroy(&old);                                                                         \
+    }                                                                                                 \
+                                                                                                      \
+    void name##_remove(name##_t* hashmap, key_type key) {                                             \
+        u32 hole = name##_find(hashmap, key);                                                         \
+        if (hole == INVALID_ID) {                                                                     \
+            SERROR("Hashmap does not contain key.");                                                  \
+            return;                                                                                   \
+        }                                                                                             \
+                                                                                                      \
+        /* Move back every following key whose home slot does not lie between the hole and itself */  \
+        const u32 mask = hashmap->capacity - 1;                                                       \
+        for (u32 slot = (hole + 1) & mask; hashmap->control[slot] != HASHMAP_EMPTY; slot = (slot + 1) & mask) { \
+            const u32 home = hashmap_slot(hashmap_mix(hash_function(hashmap->pairs[slot].key)), hashmap->shift); \
+            if (((slot - home) & mask) >= ((slot - hole) & mask)) {                                   \
+                hashmap->pairs[hole] = hashmap->pairs[slot];                                          \
+                hashmap_set_control(hashmap->control, hashmap->capacity, hole, hashmap->control[slot]); \
+                hole = slot;                                                                          \
+            }                                                                                         \
+        }                                                                                             \
+        hashmap_set_control(hashmap->control, hashmap->capacity, hole, HASHMAP_EMPTY);                \
+        hashmap->count--;                                                                             \
+    }                                                                                                 \
+                                                                                                      \
+    /* Replaces the value if the key is already in the map */                                         \
+    void name##_insert(name##_t* hashmap, key_type key, value_type value) {                           \
+        const u32 slot = name##_find(hashmap, key);                                                   \
+        if (slot != INVALID_ID) {                                                                     \
+            hashmap->pairs[slot].value = value;                                                       \
+            return;                                                                                   \
+        }                                                                                             \
+                                                                                                      \
+        if (hashmap->count >= HASHMAP_MAX_LOAD(hashmap->capacity)) {                                  \
+            name##_grow(hashmap);                                                                     \
+        }                                                                                             \
+        name##_pair_t pair = {                                                                        \
+            .value = value,                                                                           \
+            .key = key_copy_function(key),                                                            \
+        };                                                                                            \
+        name##_place(hashmap, &pair);                                                                 \
+    }                                                                                                 \
+                                                                                                      \
+    b8 name##_contains(const name##_t* hashmap, key_type key) {                                       \
+        return name##_find(hashmap, key) != INVALID_ID;                                               \
+    }                                                                                                 \
+                                                                                                      \
+    b8 name##_try_get(const name##_t* hashmap, key_type key, value_type* out_value) {                 \
+        const u32 slot = name##_find(hashmap, key);                                                   \
+        if (slot == INVALID_ID) {                                                                     \
+            return false;                                                                             \
+        }                                                                                             \
+        *out_value = hashmap->pairs[slot].value;                                                      \
+        return true;                                                                                  \
+    }                                                                                                 \
+                                                                                                      \
+    value_type* name##_get(const name##_t* hashmap, key_type key) {                                   \
+        const u32 slot = name##_find(hashmap, key);                                                   \
+        return slot == INVALID_ID ? NULL : &hashmap->pairs[slot].value;                               \
     }
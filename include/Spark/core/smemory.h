@@ -30,28 +30,129 @@ typedef enum {
 void initialize_memory();
 void shutdown_memory();
 
+/**
+ * @brief Returns the memory the calling thread keeps cached to the heaps, slabs and pools and frees its per-thread
+ * slots for the next thread. Call last thing before a thread exits, thread_create does this for the threads it starts.
+ */
+SAPI void memory_thread_shutdown();
+
 SAPI void*  pvt_sallocate(u64 size, memory_tag_t tag);
 SAPI void   pvt_spark_free(const void* block, u64 size, memory_tag_t tag);
+SAPI void*  pvt_sreallocate(void* block, u64 old_size, u64 new_size, memory_tag_t tag);
 
 SAPI void* szero_memory(void* block, u64 size);
 SAPI void* sset_memory(void* block, s32 value, u64 size);
 SAPI void* scopy_memory(void* dest, const void* src, u64 size);
+SAPI b8    scompare_memory(const void* a, const void* b, u64 size);
 
 SAPI const char* get_memory_usage_string();
 SAPI u64 get_memory_alloc_count();
 
+// ================================
+// Memory tag statistics
+// ================================
+// Every thread counts its own allocations per tag without locks, queries sum the counters of all threads. Bytes in use
+// are an atomic counter per tag, which also raises the tag's peak on every allocation. Available in every build
+// configuration.
+#define MEMORY_STATS_MAX_THREADS 64
+#define MEMORY_STATS_DEFAULT_DUMP_INTERVAL 60
+
+typedef struct memory_tag_stats {
+    u64 current_bytes;
+    // Highest current_bytes since startup
+    u64 peak_bytes;
+    u64 allocation_count;
+    u64 free_count;
+    // Allocations and frees during the last completed frame
+    u64 frame_allocation_count;
+    u64 frame_free_count;
+} memory_tag_stats_t;
+
+typedef enum {
+    MEMORY_STATS_FORMAT_CSV,
+    // One JSON object per line and dump
+    MEMORY_STATS_FORMAT_JSON,
+} memory_stats_format_t;
+
+/**
+ * @brief Current statistics of tag. Reallocations count as a free and an allocation.
+ */
+SAPI void memory_get_tag_stats(memory_tag_t tag, memory_tag_stats_t* out_stats);
+SAPI u64 memory_get_total_allocated();
+
+/**
+ * @brief Completes the per-frame counts and writes a dump if one is due. Main thread only.
+ */
+SAPI void memory_stats_end_frame();
+
+/**
+ * @brief Writes the statistics of every tag to path every frame_interval frames, until memory_stats_stop_dump.
+ */
+SAPI b8 memory_stats_start_dump(const char* path, memory_stats_format_t format, u32 frame_interval);
+SAPI void memory_stats_stop_dump();
+
+// ================================
+// Memory heaps
+// ================================
+// Allocations larger than the slab allocator's blocks come from the heap of their tag, so subsystems do not fragment
+// each other's memory. A heap can be given a budget, going over it logs a warning and counts against the heap but the
+// allocation still succeeds.
+typedef enum {
+    MEMORY_HEAP_GENERAL,
+    MEMORY_HEAP_ECS,
+    MEMORY_HEAP_RENDERER,
+    MEMORY_HEAP_RESOURCES,
+    MEMORY_HEAP_STRING,
+
+    MEMORY_HEAP_MAX,
+} memory_heap_t;
+
+typedef struct memory_heap_stats {
+    // Bytes allocated with the heap's tags, including the ones served by the slab allocator and the platform
+    u64 used_bytes;
+    // 0 if the heap has no budget
+    u64 budget;
+    // Number of times the heap went over its budget
+    u64 over_budget_count;
+} memory_heap_stats_t;
+
+SAPI memory_heap_t memory_tag_heap(memory_tag_t tag);
+
+/**
+ * @brief Sets the budget of heap in bytes, 0 removes it.
+ */
+SAPI void memory_heap_set_budget(memory_heap_t heap, u64 budget);
+SAPI void memory_heap_get_stats(memory_heap_t heap, memory_heap_stats_t* out_stats);
+
 #if SPARK_DEBUG
 
+// Debug builds track every live allocation to report leaks and mismatched frees. Backtraces are expensive, so only
+// every n'th allocation records one.
+#define MEMORY_TRACKING_DEFAULT_BACKTRACE_SAMPLE_RATE 0
+
+/**
+ * @brief Records a backtrace for every sample_rate'th allocation, 0 records none.
+ */
+SAPI void memory_tracking_set_backtrace_sample_rate(u32 sample_rate);
+
+/**
+ * @brief Logs every live allocation with its backtrace, if it was sampled.
+ */
+SAPI void memory_tracking_report();
+
 void* create_tracked_allocation(u64 size, memory_tag_t tag, const char* file, u32 line);
-void  free_tracked_allocation(const void* block, u32 size, memory_tag_t tag);
+void  free_tracked_allocation(const void* block, u64 size, memory_tag_t tag);
+void* reallocate_tracked_allocation(void* block, u64 old_size, u64 new_size, memory_tag_t tag, const char* file, u32 line);
 
 #define sallocate(size, tag)    create_tracked_allocation(size, tag, __FILE__, __LINE__)
 #define sfree(block, size, tag) free_tracked_allocation((void*)block, size, tag)
+#define sreallocate(block, old_size, new_size, tag) reallocate_tracked_allocation((void*)block, old_size, new_size, tag, __FILE__, __LINE__)
 
 #else
 
 #define sfree(block, size, tag)     pvt_spark_free(block, size, tag);
 #define sallocate(size, tag)        pvt_sallocate(size, tag);
+#define sreallocate(block, old_size, new_size, tag) pvt_sreallocate((void*)block, old_size, new_size, tag)
 
 #endif
 
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Spark/core/smemory.h"
+#include "Spark/defines.h"
+#include "Spark/utils/hashing.h"
+
+// ================================
+// String interning
+// ================================
+// Every distinct string is stored once and named by a dense id, so strings that are looked up repeatedly (resource
+// paths, material and shader names) are compared and hashed as integers. Ids and the strings behind them stay valid
+// until string_intern_shutdown. Interning is thread safe, reading an interned string does not lock.
+typedef u32 string_id;
+
+#define STRING_ID_INVALID INVALID_ID
+// Strings are copied into blocks of this size, longer strings get an allocation of their own
+#define STRING_INTERN_BLOCK_SIZE (64 * KB)
+#define STRING_INTERN_ENTRIES_PER_PAGE 1024
+#define STRING_INTERN_MAX_PAGES 1024
+
+SAPI void string_intern_initialize();
+SAPI void string_intern_shutdown();
+
+/**
+ * @brief Id of string, adding a copy of it to the table if it was not interned yet.
+ */
+SAPI string_id string_intern(const char* string);
+SAPI string_id string_intern_n(const char* string, u32 length);
+
+/**
+ * @brief Id of string if it was interned before, STRING_ID_INVALID otherwise. Never adds the string.
+ */
+SAPI string_id string_intern_find(const char* string);
+
+/**
+ * @brief Null terminated string of id.
+ */
+SAPI const char* string_intern_get(string_id id);
+// Hash of the string's bytes, computed once when it was interned
+SAPI hash_t string_intern_hash(string_id id);
+// Length without the null terminator
+SAPI u32 string_intern_length(string_id id);
+SAPI u32 string_intern_count();
@@ -89,12 +89,65 @@ void entity_archetype_match_queryies(entity_archetype_t* archetyle, struct ecs_w
 darray_header(entity_archetype_t, entity_archetype);
 hashmap_header(component_singleton_map, ecs_component_id, entity_t);
 
+// ================================
+// ECS Component Index
+// ================================
+// Optional per-component index from a key to every entity whose component produces that key.
+// Keys come from key_function, or a hash of the component's bytes when it is NULL. Without a key_function every distinct
+// value gets its own bucket holding a copy of the value, and lookups compare the value so hash collisions never match.
+// Values are compared byte for byte including padding, so components indexed by value must be zero initialized.
+typedef u64 (*ecs_component_key_function)(const void* component);
+
+typedef struct ecs_index_slot {
+    u32 bucket;
+    u32 position;
+} ecs_index_slot_t;
+
+typedef struct ecs_index_bucket {
+    darray_entity_t entities;
+    u64 key;
+    // Next bucket with the same key but a different value, INVALID_ID at the end of the chain
+    u32 next;
+} ecs_index_bucket_t;
+
+darray_header(ecs_index_slot_t, ecs_index_slot);
+darray_header(ecs_index_bucket_t, ecs_index_bucket);
+hashmap_header(ecs_index_bucket_map, u64, u32);
+
+typedef struct ecs_component_index {
+    ecs_component_key_function key_function;
+    u32 stride;
+    // Key to the first bucket of its chain
+    ecs_index_bucket_map_t first_buckets;
+    darray_ecs_index_bucket_t buckets;
+    // stride bytes per bucket, the value of the bucket's entities. Only used without a key_function.
+    darray_u8_t values;
+    // Buckets that were emptied, their entity arrays are destroyed
+    darray_u32_t free_buckets;
+    // Bucket and position of every entity in the index, indexed by entity. Used for O(1) removal.
+    darray_ecs_index_slot_t slots;
+} ecs_component_index_t;
+
+#define ECS_COMPONENT_INDEX_BUCKET_MAP_CAPACITY 251
+
+void ecs_component_index_create(u32 stride, ecs_component_key_function key_function, ecs_component_index_t* out_index);
+void ecs_component_index_destroy(ecs_component_index_t* index);
+u64 ecs_component_index_key(const ecs_component_index_t* index, const void* component);
+void ecs_component_index_set(ecs_component_index_t* index, entity_t entity, const void* component);
+void ecs_component_index_remove(ecs_component_index_t* index, entity_t entity);
+// Entities of the first bucket with key, NULL if there are none
+const darray_entity_t* ecs_component_index_find(const ecs_component_index_t* index, u64 key);
+// Entities whose component equals component (or has the same key, with a key_function), NULL if there are none
+const darray_entity_t* ecs_component_index_find_value(const ecs_component_index_t* index, const void* component);
+
 // ================================
 // ECS Component
 // ================================
 typedef struct ecs_component {
     darray_entity_archetype_ptr_t archetypes;
     void (*destroy_callback)(void* component);
+    // NULL unless enabled with ecs_world_component_enable_index
+    ecs_component_index_t* index;
     u32 stride;
 #ifdef SPARK_DEBUG
     const char* name;
@@ -111,6 +164,8 @@ typedef struct ecs_iterator {
     entity_archetype_t* archetype;
     u32 component_count;
     u32 entity_count;
+    // Time step of the current system tick, see ecs_schedule_t
+    f32 delta_time;
 } ecs_iterator_t;
 
 #define ECS_ITERATOR_GET_COMPONENTS(iterator, index) (iterator->component_data[index]); SASSERT(index < iterator->component_count, "Cannot get component at index %d from query with %d components", index, iterator->component_count)
@@ -128,9 +183,13 @@ typedef struct ecs_query_create_info {
 
 typedef struct ecs_query {
     darray_u32_t archetype_indices;
+    // Column index of every query component in every matched archetype, resolved once when the archetype is matched.
+    // The columns of archetype_indices[i] start at column_indices[i * components.count].
+    darray_u32_t column_indices;
     darray_u32_t components;
     darray_u32_t without_components;
-    u32 hash;
+    // Of both component lists, queries are only shared if the lists are equal
+    hash_t hash;
     ecs_world_t* world;
 } ecs_query_t;
 
@@ -140,20 +199,57 @@ darray_header(ecs_query_t, ecs_query);
 ecs_query_t* ecs_query_create(struct ecs_world* world, const ecs_query_create_info_t* create_info);
 void ecs_query_destroy(ecs_query_t* query);
 b8 ecs_query_matches_archetype(ecs_query_t* query, entity_archetype_t* archetype);
+void ecs_query_add_archetype(ecs_query_t* query, entity_archetype_t* archetype);
 void ecs_query_create_iterator(ecs_query_t* query, ecs_iterator_t* out_iterator);
 void ecs_query_iterate(ecs_query_t* query, void (iterate_function)(ecs_iterator_t* iterator));
 
+/**
+ * @brief Iterates the query's archetypes starting at first_archetype until all are done or the time budget is used.
+ *
+ * @param time_budget Seconds to spend before returning, 0 for no limit. At least one archetype is always processed.
+ * @return Index of the next archetype to process, equal to archetype_indices.count when the query is complete.
+ */
+u32 ecs_query_iterate_range(ecs_query_t* query, void (iterate_function)(ecs_iterator_t* iterator), f32 delta_time, u32 first_archetype, f64 time_budget);
+// Entities matched by the query, summed from its archetypes without visiting the entities
+u32 ecs_query_entity_count(const ecs_query_t* query);
+
+// ================================
+// ECS schedule
+// ================================
+// When a system or phase runs. A zeroed schedule runs every frame with the frame's delta time and no budget.
+typedef struct ecs_schedule {
+    // Fixed ticks per second. Every tick gets a delta time of 1 / tick_rate, missed ticks are caught up on the next
+    // frames (up to ECS_SCHEDULE_MAX_CATCH_UP_TICKS). 0 runs once per frame.
+    f32 tick_rate;
+    // Run every n frames with the time accumulated since the last tick. Ignored if tick_rate is set.
+    u32 frame_interval;
+    // Seconds a system may spend per frame. Once over budget the remaining archetypes are resumed next frame. A phase
+    // budget is shared by the systems following the phase, see ecs_world_set_phase_schedule.
+    f64 time_budget;
+} ecs_schedule_t;
+
+#define ECS_SCHEDULE_MAX_CATCH_UP_TICKS 4
+// Smallest budget passed to a system so it processes at least one archetype per frame
+#define ECS_SCHEDULE_MIN_BUDGET 1e-9
+
 // ================================
 // ECS system
 // ================================
 typedef struct ecs_system {
     ecs_query_t* query;
     void (*callback)(ecs_iterator_t* iterator);
-#ifdef SPARK_DEBUG
     const char* name;
+    ecs_schedule_t schedule;
+
+    // Scheduling state
+    f64 accumulated_time;
+    f32 tick_delta;
+    u32 pending_ticks;
+    u32 archetype_cursor;
+
     f64 runtime;
-    u32 calls;
-#endif
+    f64 last_runtime;
+    u64 calls;
 } ecs_system_t;
 
 typedef struct ecs_system_create_info {
@@ -161,6 +257,8 @@ typedef struct ecs_system_create_info {
     ecs_phase_t phase;
     void (*callback)(ecs_iterator_t*);
     const char* name;
+    // Optional, systems without a schedule use the schedule of their phase
+    ecs_schedule_t schedule;
 } ecs_system_create_info_t;
 
 void ecs_system_create(struct ecs_world* world, const ecs_system_create_info_t* create_info);
@@ -176,3 +274,107 @@ darray_header(ecs_system_t, ecs_system);
 #define ECS_COMPONENT_ADD_DESTRUCTOR(world, component, destructor) world->components.data[ECS_COMPONENT_ID(component)].destroy_callback = destructor
 #define ECS_SYSTEM_CREATE(world, phase, components, callback) ecs_system_create(world, phase, sizeof(components) / sizeof(ecs_component_id), callback)
 
+// ================================
+// Typed queries
+// ================================
+// ECS_QUERY(name, component_types...) generates name##_query_t, a struct with one typed pointer per component named
+// after the component type, and helpers to create and walk the query without void** or per access asserts:
+//
+//     ECS_QUERY(transform, translation_t, rotation_t);
+//
+//     transform_query_t it;
+//     transform_query_iterator(transform_query_create(world), &it);
+//     while (transform_query_next(&it)) {
+//         for (u32 i = 0; i < it.entity_count; i++) {
+//             it.translation_t[i].value = ...;
+//         }
+//     }
+//
+// System callbacks can bind the same struct with name##_query_from_iterator if the system was created with the
+// components from name##_query_components.
+#define ECS_PVT_ARG_N(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, N, ...) N
+#define ECS_PVT_COUNT(...) ECS_PVT_ARG_N(__VA_ARGS__, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)
+#define ECS_PVT_FOR_EACH_1(m, a)       m(a)
+#define ECS_PVT_FOR_EACH_2(m, a, ...)  m(a) ECS_PVT_FOR_EACH_1(m, __VA_ARGS__)
+#define ECS_PVT_FOR_EACH_3(m, a, ...)  m(a) ECS_PVT_FOR_EACH_2(m, __VA_ARGS__)
+#define ECS_PVT_FOR_EACH_4(m, a, ...)  m(a) ECS_PVT_FOR_EACH_3(m, __VA_ARGS__)
+#define ECS_PVT_FOR_EACH_5(m, a, ...)  m(a) ECS_PVT_FOR_EACH_4(m, __VA_ARGS__)
+#define ECS_PVT_FOR_EACH_6(m, a, ...)  m(a) ECS_PVT_FOR_EACH_5(m, __VA_ARGS__)
+#define ECS_PVT_FOR_EACH_7(m, a, ...)  m(a) ECS_PVT_FOR_EACH_6(m, __VA_ARGS__)
+#define ECS_PVT_FOR_EACH_8(m, a, ...)  m(a) ECS_PVT_FOR_EACH_7(m, __VA_ARGS__)
+#define ECS_PVT_FOR_EACH_9(m, a, ...)  m(a) ECS_PVT_FOR_EACH_8(m, __VA_ARGS__)
+#define ECS_PVT_FOR_EACH_10(m, a, ...) m(a) ECS_PVT_FOR_EACH_9(m, __VA_ARGS__)
+#define ECS_PVT_FOR_EACH_11(m, a, ...) m(a) ECS_PVT_FOR_EACH_10(m, __VA_ARGS__)
+#define ECS_PVT_FOR_EACH_12(m, a, ...) m(a) ECS_PVT_FOR_EACH_11(m, __VA_ARGS__)
+#define ECS_PVT_CONCAT(a, b) a##b
+#define ECS_PVT_FOR_EACH_N(n, m, ...) ECS_PVT_CONCAT(ECS_PVT_FOR_EACH_, n)(m, __VA_ARGS__)
+#define ECS_PVT_FOR_EACH(m, ...) ECS_PVT_FOR_EACH_N(ECS_PVT_COUNT(__VA_ARGS__), m, __VA_ARGS__)
+
+#define ECS_PVT_QUERY_FIELD(type) type* type;
+#define ECS_PVT_QUERY_ID(type) ECS_COMPONENT_ID(type),
+#define ECS_PVT_QUERY_BIND_COLUMN(type) out_query->type = archetype->columns.data[columns[column++]].data;
+#define ECS_PVT_QUERY_BIND_ITERATOR(type) out_query->type = iterator->component_data[column++];
+
+#define ECS_QUERY(name, ...) \
+    typedef struct name##_query { \
+        ecs_query_t* query; \
+        ecs_world_t* world; \
+        entity_archetype_t* archetype; \
+        entity_t* entities; \
+        u32 entity_count; \
+        f32 delta_time; \
+        u32 pvt_archetype_cursor; \
+        ECS_PVT_FOR_EACH(ECS_PVT_QUERY_FIELD, __VA_ARGS__) \
+    } name##_query_t; \
+    enum { name##_query_component_count = ECS_PVT_COUNT(__VA_ARGS__) }; \
+    SINLINE void name##_query_components(ecs_component_id out_components[name##_query_component_count]) { \
+        const ecs_component_id components[] = { ECS_PVT_FOR_EACH(ECS_PVT_QUERY_ID, __VA_ARGS__) }; \
+        scopy_memory(out_components, components, sizeof(components)); \
+    } \
+    SINLINE ecs_query_t* name##_query_create(ecs_world_t* world) { \
+        ecs_component_id components[name##_query_component_count]; \
+        name##_query_components(components); \
+        const ecs_query_create_info_t create_info = { \
+            .component_count = name##_query_component_count, \
+            .components = components, \
+        }; \
+        return ecs_query_create(world, &create_info); \
+    } \
+    SINLINE void name##_query_iterator(ecs_query_t* query, name##_query_t* out_query) { \
+        /* Columns are bound by position, the query's components must be in the order of the fields */ \
+        ecs_component_id components[name##_query_component_count]; \
+        name##_query_components(components); \
+        SASSERT(query->components.count == name##_query_component_count && \
+                scompare_memory(query->components.data, components, sizeof(components)), "Query does not match typed query '" #name "'."); \
+        szero_memory(out_query, sizeof(name##_query_t)); \
+        out_query->query = query; \
+        out_query->world = query->world; \
+    } \
+    SINLINE b8 name##_query_next(name##_query_t* out_query) { \
+        ecs_query_t* query = out_query->query; \
+        while (out_query->pvt_archetype_cursor < query->archetype_indices.count) { \
+            const u32 index = out_query->pvt_archetype_cursor++; \
+            entity_archetype_t* archetype = &query->world->archetypes.data[query->archetype_indices.data[index]]; \
+            if (archetype->entities.count == 0) { \
+                continue; \
+            } \
+            const u32* columns = &query->column_indices.data[index * name##_query_component_count]; \
+            u32 column = 0; \
+            ECS_PVT_FOR_EACH(ECS_PVT_QUERY_BIND_COLUMN, __VA_ARGS__) \
+            out_query->archetype = archetype; \
+            out_query->entities = archetype->entities.data; \
+            out_query->entity_count = archetype->entities.count; \
+            return true; \
+        } \
+        return false; \
+    } \
+    SINLINE void name##_query_from_iterator(const ecs_iterator_t* iterator, name##_query_t* out_query) { \
+        SASSERT(iterator->component_count == name##_query_component_count, "Iterator does not match typed query '" #name "'."); \
+        u32 column = 0; \
+        ECS_PVT_FOR_EACH(ECS_PVT_QUERY_BIND_ITERATOR, __VA_ARGS__) \
+        out_query->world = iterator->world; \
+        out_query->archetype = iterator->archetype; \
+        out_query->entities = iterator->archetype->entities.data; \
+        out_query->entity_count = iterator->entity_count; \
+        out_query->delta_time = iterator->delta_time; \
+    }
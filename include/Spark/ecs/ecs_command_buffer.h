@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Spark/containers/darray.h"
+#include "Spark/containers/generic/darray_ints.h"
+#include "Spark/ecs/entity.h"
+
+// ================================
+// ECS command buffer
+// ================================
+// Records entity creation and component writes on any thread so they can be applied to the world later on the main
+// thread. Entity ids are reserved from the world up front, so staged entities can be referenced (e.g. as parents)
+// before they are committed.
+typedef enum ecs_command_type {
+    ECS_COMMAND_CREATE_ENTITY,
+    ECS_COMMAND_SET_COMPONENT,
+    ECS_COMMAND_ADD_CHILD,
+} ecs_command_type_t;
+
+typedef struct ecs_command {
+    ecs_command_type_t type;
+    ecs_component_id component;
+    entity_t entity;
+    // Parent of ECS_COMMAND_ADD_CHILD
+    entity_t parent;
+    u32 data_offset;
+    u32 data_size;
+} ecs_command_t;
+darray_header(ecs_command_t, ecs_command);
+
+typedef struct ecs_command_buffer {
+    darray_ecs_command_t commands;
+    // Component data of all ECS_COMMAND_SET_COMPONENT commands
+    darray_u8_t data;
+
+    // Entity ids reserved by this buffer that have not been handed out yet, [next_entity, end_entity)
+    entity_t next_entity;
+    entity_t end_entity;
+} ecs_command_buffer_t;
+
+// Number of entity ids a command buffer reserves from the world at once
+#define ECS_COMMAND_BUFFER_ENTITY_RESERVE_COUNT 64
+
+void ecs_command_buffer_create(u32 initial_command_count, ecs_command_buffer_t* out_buffer);
+void ecs_command_buffer_destroy(ecs_command_buffer_t* buffer);
+void ecs_command_buffer_clear(ecs_command_buffer_t* buffer);
+
+/**
+ * @brief Reserves an entity id and records its creation. Safe to call from any thread.
+ * The entity only exists in the world once the commands are committed.
+ */
+entity_t ecs_command_buffer_create_entity(ecs_command_buffer_t* buffer, struct ecs_world* world);
+void ecs_command_buffer_set_component(ecs_command_buffer_t* buffer, entity_t entity, ecs_component_id component, const void* data, u32 size);
+void ecs_command_buffer_add_child(ecs_command_buffer_t* buffer, entity_t parent, entity_t child);
+void ecs_command_buffer_add_transforms(ecs_command_buffer_t* buffer, entity_t entity, vec3 position, vec3 scale, quat rotation);
+
+/**
+ * @brief Moves the buffer's commands into the world's staging buffer. Safe to call from any thread.
+ * Staged commands are committed at the start of the next ecs_world_progress.
+ */
+void ecs_command_buffer_submit(ecs_command_buffer_t* buffer, struct ecs_world* world);
+
+/**
+ * @brief Applies all commands to the world in the order they were recorded and clears the buffer. Main thread only.
+ */
+void ecs_command_buffer_commit(ecs_command_buffer_t* buffer, struct ecs_world* world);
+
+#define ECS_COMMAND_SET_COMPONENT(buffer, entity, component, ...) \
+{ \
+    component __val__ = (component)__VA_ARGS__; \
+    ecs_command_buffer_set_component(buffer, entity, ECS_COMPONENT_ID(component), &__val__, sizeof(component)); \
+}
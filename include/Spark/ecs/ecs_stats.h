@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Spark/containers/darray.h"
+#include "Spark/ecs/ecs.h"
+
+// ================================
+// Column stats
+// ================================
+typedef struct ecs_column_stats {
+    ecs_component_id component;
+    u32 stride;
+    u64 count;
+    u64 capacity;
+    u64 bytes_used;
+    u64 bytes_wasted;
+#ifdef SPARK_DEBUG
+    const char* name;
+#endif
+} ecs_column_stats_t;
+darray_header(ecs_column_stats_t, ecs_column_stats);
+
+// ================================
+// Archetype stats
+// ================================
+typedef struct ecs_archetype_stats {
+    ecs_index archetype_id;
+    u32 entity_count;
+    u32 entity_capacity;
+    u32 column_count;
+    // Index of the first column of this archetype in ecs_world_stats_t::columns
+    u32 first_column;
+    u64 bytes_used;
+    u64 bytes_wasted;
+} ecs_archetype_stats_t;
+darray_header(ecs_archetype_stats_t, ecs_archetype_stats);
+
+// ================================
+// Query / System stats
+// ================================
+typedef struct ecs_query_stats {
+    u32 component_count;
+    u32 without_component_count;
+    u32 matched_archetype_count;
+    u64 matched_entity_count;
+} ecs_query_stats_t;
+darray_header(ecs_query_stats_t, ecs_query_stats);
+
+typedef struct ecs_system_stats {
+    const char* name;
+    ecs_phase_t phase;
+    // Index of the system's query in ecs_world_stats_t::queries
+    u32 query_index;
+    u64 calls;
+    f64 total_time;
+    f64 last_time;
+} ecs_system_stats_t;
+darray_header(ecs_system_stats_t, ecs_system_stats);
+
+// ================================
+// World stats
+// ================================
+typedef struct ecs_world_stats {
+    u64 entity_count;
+    u32 component_count;
+
+    // Totals of all component columns and entity arrays
+    u64 bytes_used;
+    u64 bytes_wasted;
+
+    darray_ecs_archetype_stats_t archetypes;
+    darray_ecs_column_stats_t columns;
+    darray_ecs_query_stats_t queries;
+    darray_ecs_system_stats_t systems;
+} ecs_world_stats_t;
+
+/**
+ * @brief Takes a snapshot of the world's memory use, query matches and system timings.
+ *
+ * @param world World to inspect
+ * @param out_stats Snapshot output. Must be destroyed with ecs_world_stats_destroy.
+ */
+void ecs_world_stats_create(struct ecs_world* world, ecs_world_stats_t* out_stats);
+void ecs_world_stats_destroy(ecs_world_stats_t* stats);
+
+/**
+ * @brief Writes the snapshot as JSON into buffer.
+ *
+ * @return Number of characters the full document requires (excluding the null terminator).
+ * If this is >= buffer_size, the output was truncated.
+ */
+u64 ecs_world_stats_to_json(const ecs_world_stats_t* stats, char* buffer, u64 buffer_size);
+b8 ecs_world_stats_write_json(const ecs_world_stats_t* stats, const char* path);
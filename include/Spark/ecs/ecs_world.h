@@ -2,32 +2,87 @@
 
 #include "Spark/containers/unordered_map.h"
 #include "Spark/ecs/ecs.h"
+#include "Spark/ecs/ecs_command_buffer.h"
 #include "Spark/ecs/entity.h"
 #include "Spark/memory/linear_allocator.h"
+#include "Spark/threading/mutex.h"
 
 typedef struct ecs_world {
+    // Next free entity id. Incremented atomically so worker threads can reserve ids.
     entity_t entity_count;
     darray_entity_record_t records;
     darray_ecs_component_t components;
     darray_entity_archetype_t archetypes;
     darray_ecs_query_t queries;
     darray_ecs_system_t systems[ECS_PHASE_ENUM_MAX];
+    ecs_schedule_t phase_schedules[ECS_PHASE_ENUM_MAX];
+    // First system of each phase that did not finish within the phase's time budget, resumed on the next frame
+    u32 phase_cursors[ECS_PHASE_ENUM_MAX];
     component_singleton_map_t singletons;
+    u64 frame_index;
+
+    // Commands submitted from other threads, committed at the start of ecs_world_progress
+    spark_mutex_t staging_mutex;
+    ecs_command_buffer_t staged_commands;
 } ecs_world_t;
 
 void ecs_world_initialize(linear_allocator_t* allocator);
 struct ecs_world* ecs_world_get();
 void ecs_world_shutdown();
-void ecs_world_progress();
+void ecs_world_progress(f64 delta_time);
+
+/**
+ * @brief Reserves a contiguous range of entity ids without creating the entities. Safe to call from any thread.
+ * Reserved entities are created on the main thread with entity_create_reserved (usually through an ecs_command_buffer_t).
+ *
+ * @return First entity id of the range
+ */
+entity_t ecs_world_reserve_entities(ecs_world_t* world, u32 count);
+
+/**
+ * @brief Commits all command buffers submitted to the world. Main thread only.
+ */
+void ecs_world_commit_staged(ecs_world_t* world);
+
+/**
+ * @brief Sets the schedule used by all systems in a phase that do not have their own schedule. The phase's time budget
+ * is shared by all of its systems, a phase over budget resumes from its first unfinished system next frame.
+ */
+void ecs_world_set_phase_schedule(ecs_world_t* world, ecs_phase_t phase, const ecs_schedule_t* schedule);
 
 ecs_component_id ecs_world_component_define(ecs_world_t* world, const char* name, u32 stride);
 
+/**
+ * @brief Maintains an index from component value (or key_function's key) to entities for a component.
+ * Existing entities are indexed immediately, later changes are tracked through entity_set_component.
+ * Components modified in place through a pointer must be set again to be re-indexed.
+ *
+ * @param key_function Extracts the key from a component, NULL to key on the component's bytes. Components keyed on
+ * their bytes are compared including padding, zero initialize them (e.g. with = {0} or szero_memory) before setting.
+ */
+void ecs_world_component_enable_index(ecs_world_t* world, ecs_component_id component, ecs_component_key_function key_function);
+
+/**
+ * @brief Gets all entities whose component has the given key. Returns NULL if there are none.
+ * The returned array is owned by the index and is only valid until the next change to the component.
+ * Components indexed on their bytes can have colliding keys, only the first value with the key is returned.
+ */
+const darray_entity_t* ecs_world_find_entities_by_key(ecs_world_t* world, ecs_component_id component, u64 key);
+
+/**
+ * @brief Gets all entities whose component equals value, or has value's key with a key_function. NULL if there are none.
+ */
+const darray_entity_t* ecs_world_find_entities(ecs_world_t* world, ecs_component_id component, const void* value);
+
 void ecs_world_set_singleton(ecs_world_t* world, ecs_component_id component, entity_t singleton);
 void* ecs_world_get_singleton(ecs_world_t* world, ecs_component_id component);
 
 #define ECS_SET_SINGLETON(world, component, entity) ecs_world_set_singleton(world, ECS_COMPONENT_ID(component), entity)
 #define ECS_GET_SINGLETON(world, component) (component*)ecs_world_get_singleton(world, ECS_COMPONENT_ID(component))
 
+#define ECS_COMPONENT_ENABLE_INDEX(world, component, key_function) ecs_world_component_enable_index(world, ECS_COMPONENT_ID(component), key_function)
+#define ECS_FIND_ENTITIES(world, component, ...) ecs_world_find_entities(world, ECS_COMPONENT_ID(component), &(component)__VA_ARGS__)
+
 #ifdef SPARK_DEBUG
 #define ECS_COMPONENT_DEFINE(world, component) ECS_COMPONENT_ID(component) = ecs_world_component_define(world, #component, sizeof(component))
 #else
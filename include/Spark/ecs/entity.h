@@ -29,6 +29,10 @@ struct ecs_world;
 typedef struct ecs_world ecs_world_t;
 
 entity_t entity_create(struct ecs_world* world);
+/**
+ * @brief Creates an entity with an id previously reserved with ecs_world_reserve_entities.
+ */
+void entity_create_reserved(struct ecs_world* world, entity_t entity);
 b8 entity_has_component(struct ecs_world* world, entity_t entity, ecs_index component);
 b8 entity_try_get_component(struct ecs_world* world, entity_t entity, ecs_index component, void** out_value);
 void* entity_get_component(struct ecs_world* world, entity_t entity, ecs_index component);
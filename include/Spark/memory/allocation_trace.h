@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Spark/core/smemory.h"
+
+// ================================
+// Allocation trace
+// ================================
+// Records every sallocate, sfree and sreallocate to a binary file, so allocators can be benchmarked against a real
+// workload with benchmarks/allocation_replay.c. Threads buffer records locally and append them to the file in batches.
+// With a size limit the file is a ring that keeps the most recent records.
+#define ALLOCATION_TRACE_MAGIC 0x52544C41
+#define ALLOCATION_TRACE_VERSION 1
+#define ALLOCATION_TRACE_THREAD_BUFFER_SIZE 4096
+// Size limit of traces started by the application, see SPARK_ALLOCATION_TRACE
+#define ALLOCATION_TRACE_DEFAULT_MAX_SIZE (1024ull * MB)
+
+typedef enum : u8 {
+    ALLOCATION_TRACE_ALLOCATE,
+    ALLOCATION_TRACE_FREE,
+    // Old block of a reallocation, directly followed by ALLOCATION_TRACE_REALLOCATE_TO with the new block
+    ALLOCATION_TRACE_REALLOCATE_FROM,
+    ALLOCATION_TRACE_REALLOCATE_TO,
+} allocation_trace_op_t;
+
+typedef struct allocation_trace_record {
+    // Since the trace was started
+    u64 time_ns;
+    // Address of the block, identifies the allocation in later records
+    u64 block;
+    u32 size;
+    u16 thread;
+    // memory_tag_t
+    u8 tag;
+    allocation_trace_op_t op;
+} allocation_trace_record_t;
+
+// Followed by record_count records. Records are in file order per thread, sort them by time to get the global order.
+typedef struct allocation_trace_header {
+    u32 magic;
+    u32 version;
+    u64 record_count;
+    // Index of the oldest record, not 0 once a size limited trace wrapped around
+    u64 first_record;
+} allocation_trace_header_t;
+
+// Checked by smemory.c before recording
+extern b8 allocation_trace_active;
+
+/**
+ * @brief Starts recording to path.
+ *
+ * @param max_size Limit of the file size in bytes, 0 for no limit
+ */
+SAPI b8 allocation_trace_start(const char* path, u64 max_size);
+
+/**
+ * @brief Writes the records buffered by all threads and closes the trace. Other threads must not allocate meanwhile.
+ */
+SAPI void allocation_trace_stop();
+
+void allocation_trace_record(allocation_trace_op_t op, const void* block, u64 size, memory_tag_t tag);
+void allocation_trace_record_reallocate(const void* old_block, u64 old_size, const void* new_block, u64 new_size, memory_tag_t tag);
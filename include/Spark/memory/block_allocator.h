@@ -1,34 +1,85 @@
 #pragma once
 
-#define BLOCK_ALLOCATOR_MAGIC 0xAEFF9025
+#include "Spark/defines.h"
+
+// Fixed size block allocator. Blocks live in pages of page_block_count blocks that are added when all blocks are in
+// use, so block addresses never change. Blocks are also addressed by a stable index, see block_allocator_get.
+// Pages are placed at a fixed stride in an address range reserved per allocator, so the page of a block is found by
+// dividing its offset into the range. Pages are committed as they are added.
+#define BLOCK_ALLOCATOR_RESERVE_SIZE (1ull << 32)
+// Page strides are rounded to OS pages so pages can be committed and decommitted on their own
+#define BLOCK_ALLOCATOR_PAGE_ALIGNMENT 4096
 typedef struct block_allocator_block {
-    u32 magic;
     struct block_allocator_block* next;
 } block_allocator_block_t;
 
-typedef struct block_allocator {
-    void* buffer;
+typedef struct block_allocator_page {
+    // Neighbours in the allocator's list of pages with free blocks
+    struct block_allocator_page* next;
+    struct block_allocator_page* previous;
+
+    void* blocks;
+    // Intrusive list of free blocks in this page
     block_allocator_block_t* first_block;
-    u32 block_count;
+    // Bit per block, set if the block is allocated
+    u64* allocated;
+    u32 index;
+    u32 used_count;
+    b8 partial;
+} block_allocator_page_t;
+
+typedef struct block_allocator {
+    // Reserved range holding the pages, page i starts at memory + i * page_stride
+    void* memory;
+    u64 page_stride;
+    // Indexed by page index, NULL for released pages
+    block_allocator_page_t** pages;
+    // Pages with at least one free block
+    block_allocator_page_t* partial_pages;
+    u32 page_count;
+    u32 page_block_count;
     u32 block_size;
+    // Distance between blocks, block_size rounded up to keep blocks 16 byte aligned
+    u32 block_stride;
+    // Give pages back once all of their blocks are free. Off by default, set after creating the allocator.
+    b8 release_empty_pages;
 } block_allocator_t;
 
-void block_allocator_create(u32 block_count, u32 block_size, block_allocator_t* out_allocator);
+void block_allocator_create(u32 page_block_count, u32 block_size, block_allocator_t* out_allocator);
 void block_allocator_destroy(block_allocator_t* allocator);
 
+/**
+ * @brief Allocates a block, NULL once all pages of the reservation are in use.
+ */
 void* block_allocator_allocate(block_allocator_t* allocator);
 void block_allocator_free(block_allocator_t* allocator, void* block);
-void block_allocator_zero_unused_blocks(block_allocator_t* allocator);
 
+/**
+ * @brief Stable index of an allocated block.
+ */
+u32 block_allocator_index_of(const block_allocator_t* allocator, const void* block);
+
+/**
+ * @brief Block at index, as returned by block_allocator_index_of.
+ */
+SINLINE void* block_allocator_get(const block_allocator_t* allocator, u32 index) {
+    const block_allocator_page_t* page = allocator->pages[index / allocator->page_block_count];
+    return page->blocks + (u64)(index % allocator->page_block_count) * allocator->block_stride;
+}
+
+// Runs function for every allocated block, with the block bound to arg_name
 #define block_allocator_iterate(allocator, arg_name, function) \
 { \
-    block_allocator_block_t* block = (allocator)->buffer; \
-    const u32 step_size = smax((allocator)->block_size, sizeof(block_allocator_block_t)); \
-    for (u32 i = 0; i < (allocator)->block_count; i++) { \
-        void* arg_name = block; \
-        if (block->magic == BLOCK_ALLOCATOR_MAGIC) { \
-            function \
+    for (u32 pvt_page_index = 0; pvt_page_index < (allocator)->page_count; pvt_page_index++) { \
+        block_allocator_page_t* pvt_page = (allocator)->pages[pvt_page_index]; \
+        if (!pvt_page) { \
+            continue; \
+        } \
+        for (u32 pvt_block = 0; pvt_block < (allocator)->page_block_count; pvt_block++) { \
+            if (pvt_page->allocated[pvt_block / 64] & (1ull << (pvt_block % 64))) { \
+                void* arg_name = pvt_page->blocks + (u64)pvt_block * (allocator)->block_stride; \
+                function \
+            } \
         } \
-        block += step_size; \
     } \
 }
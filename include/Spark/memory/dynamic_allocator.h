@@ -1,14 +1,90 @@
 #pragma once
 
 #include "Spark/memory/freelist.h"
+#include "Spark/threading/thread_slots.h"
+
+// Per-thread caches of small blocks sitting in front of the freelists, so small allocations do not have to
+// take the freelist mutex. Blocks move between a cache and the freelists in batches.
+#define DYNAMIC_ALLOCATOR_MAX_THREADS THREAD_SLOTS_MAX
+#define DYNAMIC_ALLOCATOR_CACHE_MIN_SIZE 32
+#define DYNAMIC_ALLOCATOR_CACHE_MAX_SIZE 2048
+// Size classes are powers of two from DYNAMIC_ALLOCATOR_CACHE_MIN_SIZE to DYNAMIC_ALLOCATOR_CACHE_MAX_SIZE
+#define DYNAMIC_ALLOCATOR_CACHE_CLASS_COUNT 7
+// Number of blocks moved between a cache and the freelist at once
+#define DYNAMIC_ALLOCATOR_CACHE_BATCH_SIZE 32
+// Blocks a single size class can hold before half of them are flushed back to the freelist
+#define DYNAMIC_ALLOCATOR_CACHE_MAX_BLOCKS (DYNAMIC_ALLOCATOR_CACHE_BATCH_SIZE * 4)
+
+// Address space reserved per region. Memory is committed in steps of the size passed to dynamic_allocator_create as
+// it is needed, a new region is only added once a reservation is fully committed. Block sizes are u32, so a region
+// must stay below 4GiB.
+// Regions are aligned to their size, so the region owning an address is found by shifting it into the region map.
+#define DYNAMIC_ALLOCATOR_RESERVE_SIZE_LOG2 31
+#define DYNAMIC_ALLOCATOR_RESERVE_SIZE (1ull << DYNAMIC_ALLOCATOR_RESERVE_SIZE_LOG2)
+// Bits of user space addresses, the region map has an entry for every region sized slot below that
+#define DYNAMIC_ALLOCATOR_ADDRESS_BITS 48
+#define DYNAMIC_ALLOCATOR_REGION_MAP_SIZE (1ull << (DYNAMIC_ALLOCATOR_ADDRESS_BITS - DYNAMIC_ALLOCATOR_RESERVE_SIZE_LOG2))
+// Back regions with huge pages to reduce TLB misses
+#define DYNAMIC_ALLOCATOR_HUGE_PAGES 1
+// Whole pages of this size inside free blocks are given back to the OS, a huge page so decommitting never splits one
+#define DYNAMIC_ALLOCATOR_DECOMMIT_SIZE (2 * MB)
+
+typedef struct dynamic_allocator_cache_bin {
+    // Intrusive stack, the first pointer of each cached block points to the next one
+    void* first_block;
+    u32 count;
+} dynamic_allocator_cache_bin_t;
+
+typedef struct dynamic_allocator_cache {
+    dynamic_allocator_cache_bin_t bins[DYNAMIC_ALLOCATOR_CACHE_CLASS_COUNT];
+} SALIGNED(64) dynamic_allocator_cache_t;
+
 typedef struct dynamic_allocator {
     struct dynamic_allocator* next_allocator;
+    // First allocator of the chain this region belongs to
+    struct dynamic_allocator* root;
     freelist_t freelist;
+    // Size committed at once
     u64 memory_size;
+    u64 committed_size;
+    u64 reserved_size;
+    // Held while a thread commits more of the reservation. committed_size only grows under it.
+    b8 committing;
+    // One cache per thread slot. Only the first allocator of a chain owns caches.
+    dynamic_allocator_cache_t* caches;
 } dynamic_allocator_t;
 
 void dynamic_allocator_create(u64 memory_size, dynamic_allocator_t* out_allocator);
 void dynamic_allocator_destroy(dynamic_allocator_t* allocator);
 
+/**
+ * @brief Allocates size bytes. Blocks are 16 byte aligned.
+ *
+ * @return NULL if size can never fit into a region of this allocator, or if called while this thread is creating
+ * a new region (e.g. the region's mutex being allocated through sallocate).
+ */
 void* dynamic_allocator_allocate(dynamic_allocator_t* allocator, u64 size);
 void dynamic_allocator_free(dynamic_allocator_t* allocator, void* data);
+
+/**
+ * @brief Resizes data, in place if the neighbouring memory is free. Contents up to the smaller of both sizes are kept.
+ *
+ * @return The new address of data, NULL under the same conditions as dynamic_allocator_allocate.
+ */
+void* dynamic_allocator_reallocate(dynamic_allocator_t* allocator, void* data, u64 size);
+
+/**
+ * @brief Returns true if data was allocated from any region of this allocator.
+ */
+b8 dynamic_allocator_owns(dynamic_allocator_t* allocator, const void* data);
+
+/**
+ * @brief Returns all blocks cached by the calling thread to the freelists. Call before a thread exits.
+ */
+void dynamic_allocator_flush_thread_cache(dynamic_allocator_t* allocator);
+
+/**
+ * @brief Hands the calling thread's cache slot to the next thread that allocates. Flush the thread's cache of every
+ * allocator first, otherwise its blocks stay cached until another thread takes the slot over.
+ */
+void dynamic_allocator_release_thread_slot();
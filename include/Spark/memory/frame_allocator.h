@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Spark/core/smemory.h"
+#include "Spark/memory/linear_allocator.h"
+
+// ================================
+// Frame allocator
+// ================================
+// Transient memory that lives for the current frame and the one after it. This is not tied to the renderer's frames
+// in flight, data the GPU reads later has to be copied into a GPU buffer before the frame is submitted. Allocating is
+// a pointer bump and the whole frame is released in O(1) by frame_allocator_end_frame. Memory is not zeroed. Main
+// thread only.
+#define FRAME_ALLOCATOR_FRAME_COUNT 2
+#define FRAME_ALLOCATOR_DEFAULT_SIZE (8 * MB)
+#define FRAME_ALLOCATOR_ALIGNMENT 16
+
+struct frame_allocator_overflow;
+
+// Usage of one frame. Overflow is what did not fit and went to the general allocator, raise the frame size when it
+// is not zero.
+typedef struct frame_allocator_stats {
+    u64 used_bytes;
+    u64 overflow_bytes;
+    u32 overflow_count;
+} frame_allocator_stats_t;
+
+typedef struct frame_allocator {
+    linear_allocator_t frames[FRAME_ALLOCATOR_FRAME_COUNT];
+    // Blocks allocated once a frame ran out of space, freed when that frame is reset
+    struct frame_allocator_overflow* overflow[FRAME_ALLOCATOR_FRAME_COUNT];
+    u64 overflow_bytes;
+    u32 overflow_count;
+    frame_allocator_stats_t last_frame_stats;
+    u32 current_frame;
+} frame_allocator_t;
+
+SAPI void frame_allocator_initialize(u64 frame_size);
+SAPI void frame_allocator_shutdown();
+
+/**
+ * @brief Allocates size bytes that stay valid until the end of the next frame. Aligned to FRAME_ALLOCATOR_ALIGNMENT.
+ */
+SAPI void* frame_alloc(u64 size);
+
+/**
+ * @brief Moves on to the next frame and releases everything that was allocated the frame before the current one.
+ * Warns once if the frame that ended overflowed.
+ */
+SAPI void frame_allocator_end_frame();
+
+// Usage of the last completed frame
+SAPI void frame_allocator_get_stats(frame_allocator_stats_t* out_stats);
+
+#define FRAME_ALLOC(type, count) ((type*)frame_alloc(sizeof(type) * (count)))
@@ -13,15 +13,30 @@ typedef struct freelist_block {
     u32 allocated;
 } freelist_block_t;
 
+// Free blocks are kept in two-level segregated bins (TLSF). The first level splits sizes by power of two, the second
+// level splits each power of two range into FREELIST_SL_INDEX_COUNT linear steps. Sizes below
+// 1 << FREELIST_FL_INDEX_SHIFT all share the first first-level bin in 16 byte steps.
+#define FREELIST_ALIGNMENT_LOG2 4
+#define FREELIST_SL_INDEX_COUNT_LOG2 4
+#define FREELIST_SL_INDEX_COUNT (1 << FREELIST_SL_INDEX_COUNT_LOG2)
+#define FREELIST_FL_INDEX_SHIFT (FREELIST_SL_INDEX_COUNT_LOG2 + FREELIST_ALIGNMENT_LOG2)
+// Block sizes are u32
+#define FREELIST_FL_INDEX_COUNT (32 - FREELIST_FL_INDEX_SHIFT + 1)
+
 struct freelist_explicit;
 
 typedef struct freelist {
     void* memory;
-    struct freelist_explicit* first_free_block;
+    // Bit per first-level bin containing any free block
+    u32 fl_bitmap;
+    // Bit per second-level bin containing a free block
+    u32 sl_bitmap[FREELIST_FL_INDEX_COUNT];
+    struct freelist_explicit* free_blocks[FREELIST_FL_INDEX_COUNT][FREELIST_SL_INDEX_COUNT];
     spark_mutex_t mutex;
-#ifdef SPARK_DEBUG
     u64 capacity;
-#endif
+    // Power of two. Whole pages of this size inside free blocks are given back to the OS with
+    // platform_decommit_memory, 0 keeps free memory resident. Only for memory from platform_reserve_memory.
+    u64 decommit_size;
 // #if SPARK_DEBUG
 //     struct freelist_block* first_block;
 // #endif
@@ -30,9 +45,46 @@ typedef struct freelist {
 void freelist_create(void* memory, u64 memory_size, freelist_t* out_allocator);
 void freelist_destroy(freelist_t* allocator);
 
+/**
+ * @brief Grows the freelist to manage memory_size bytes from its start. The memory past the current capacity has to be
+ * usable. Does nothing if memory_size is not larger than the current capacity.
+ */
+void freelist_extend(freelist_t* allocator, u64 memory_size);
+
 void* freelist_allocate(freelist_t* allocator, u64 size);
 void freelist_free(freelist_t* allocator, void* address);
 
+/**
+ * @brief Same as freelist_allocate, but returns NULL instead of failing when there is no space left.
+ */
+void* freelist_try_allocate(freelist_t* allocator, u64 size);
+
+/**
+ * @brief Allocates up to count blocks of size bytes while only taking the lock once.
+ *
+ * @return Number of blocks written to out_blocks, less than count if the freelist ran out of space.
+ */
+u32 freelist_allocate_batch(freelist_t* allocator, u64 size, u32 count, void** out_blocks);
+void freelist_free_batch(freelist_t* allocator, u32 count, void** blocks);
+
+/**
+ * @brief Resizes the block at address. Grows in place when the next block is free and only moves the block when it
+ * has to. Shrinking always happens in place.
+ *
+ * @return The block's new address, NULL if there is no space left. The original block stays valid in that case.
+ */
+void* freelist_reallocate(freelist_t* allocator, void* address, u64 size);
+
+/**
+ * @brief Usable size of an allocated block, this can be larger than the size that was requested.
+ */
+u64 freelist_block_size(const void* address);
+
+/**
+ * @brief Size of the largest free block, 0 if the freelist is full.
+ */
+u64 freelist_largest_free_block(freelist_t* allocator);
+
 #ifdef SPARK_DEBUG
 void freelist_check_health(freelist_t* allocator);
 #endif
@@ -14,3 +14,5 @@ SAPI void linear_allocator_destroy(linear_allocator_t* allocator);
 
 SAPI void* linear_allocator_allocate(linear_allocator_t* allocator, u64 size);
 SAPI void linear_allocator_free_all(linear_allocator_t* allocator);
+// Same as linear_allocator_free_all without zeroing the memory
+SAPI void linear_allocator_reset(linear_allocator_t* allocator);
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Spark/defines.h"
+#include "Spark/threading/thread_slots.h"
+
+// Lock-free pool of fixed size blocks for memory allocated on one thread and freed on another.
+//
+// Free blocks form an intrusive stack like in block_allocator.c, linked by block index. The head packs the index of
+// the first block with a tag that changes on every update, so a compare exchange can not succeed on a head that was
+// popped and pushed back in the meantime (ABA).
+//
+// Threads keep a cache of free blocks in front of the shared stack. A block freed by a thread other than the one that
+// allocated it goes to the allocating thread's remote free queue, which that thread drains once its cache is empty.
+// A thread's slot is returned when it exits, after its cache of every pool was flushed.
+#define POOL_ALLOCATOR_MAX_THREADS THREAD_SLOTS_MAX
+#define POOL_ALLOCATOR_CACHE_SIZE 64
+// Number of blocks moved between a cache and the shared stack at once
+#define POOL_ALLOCATOR_CACHE_BATCH_SIZE (POOL_ALLOCATOR_CACHE_SIZE / 2)
+
+typedef struct pool_allocator_cache {
+    u32 blocks[POOL_ALLOCATOR_CACHE_SIZE];
+    u32 count;
+    // Stack of blocks freed by other threads, pushed with compare exchange and taken all at once by exchange
+    u32 remote_head;
+} SALIGNED(64) pool_allocator_cache_t;
+
+typedef struct pool_allocator {
+    // Backs the caches, blocks and owners
+    void* allocation;
+    pool_allocator_cache_t* caches;
+    void* memory;
+    // Thread slot that allocated each block, decides where a freed block goes
+    u8* owners;
+    // Tag in the upper, index of the first free block in the lower 32 bits
+    SALIGNED(64) u64 head;
+    u32 block_size;
+    u32 block_count;
+    // Next live pool, every pool is flushed when a thread releases its slot
+    struct pool_allocator* next_pool;
+} pool_allocator_t;
+
+void pool_allocator_create(u32 block_size, u32 block_count, pool_allocator_t* out_allocator);
+void pool_allocator_destroy(pool_allocator_t* allocator);
+
+/**
+ * @brief Allocates a block of block_size bytes, 16 byte aligned. The block is not zeroed.
+ *
+ * @return NULL if all blocks are in use.
+ */
+void* pool_allocator_allocate(pool_allocator_t* allocator);
+
+/**
+ * @brief Frees a block, can be called from any thread.
+ */
+void pool_allocator_free(pool_allocator_t* allocator, void* block);
+
+/**
+ * @brief Returns the calling thread's cached and remotely freed blocks to the shared stack.
+ */
+void pool_allocator_flush_thread_cache(pool_allocator_t* allocator);
+
+/**
+ * @brief Flushes the calling thread's cache of every pool and frees its slot for the next thread. Called by
+ * memory_thread_shutdown when a thread exits.
+ */
+void pool_allocator_release_thread_slot();
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "Spark/core/smemory.h"
+#include "Spark/threading/mutex.h"
+#include "Spark/threading/thread_slots.h"
+
+// Segregated size-class allocator for small allocations. Blocks live in 64KiB pages that only hold one size class,
+// so blocks need no header: the page a block belongs to is found by masking its address.
+#define SLAB_ALLOCATOR_PAGE_SIZE (64 * KB)
+#define SLAB_ALLOCATOR_MAX_SIZE 256
+#define SLAB_ALLOCATOR_CLASS_COUNT 8
+// All pages come from one range reserved up front, so ownership is a single range check. The range is committed in
+// steps of SLAB_ALLOCATOR_COMMIT_SIZE as pages are needed.
+#define SLAB_ALLOCATOR_RESERVE_SIZE (4096ull * MB)
+#define SLAB_ALLOCATOR_COMMIT_SIZE (16 * MB)
+#define SLAB_ALLOCATOR_PAGE_COUNT (SLAB_ALLOCATOR_RESERVE_SIZE / SLAB_ALLOCATOR_PAGE_SIZE)
+
+// Per-thread caches of blocks sitting in front of the size classes, so most allocations do not take a class mutex.
+// Blocks move between a cache and the pages in batches.
+#define SLAB_ALLOCATOR_MAX_THREADS THREAD_SLOTS_MAX
+// Number of blocks moved between a cache and the pages at once
+#define SLAB_ALLOCATOR_CACHE_BATCH_SIZE 32
+// Blocks a single size class can hold before half of them are flushed back to the pages
+#define SLAB_ALLOCATOR_CACHE_MAX_BLOCKS (SLAB_ALLOCATOR_CACHE_BATCH_SIZE * 4)
+
+typedef struct slab_page {
+    // Neighbours in the size class' list of pages with free blocks
+    struct slab_page* next;
+    struct slab_page* previous;
+
+    // Intrusive list of freed blocks
+    void* free_block;
+    // Offset of the first block that has never been handed out
+    u32 bump_offset;
+    u32 used_count;
+    u32 block_size;
+    u32 block_capacity;
+    u8 size_class;
+    b8 partial;
+} slab_page_t;
+
+typedef struct slab_class {
+    // Pages of this class with at least one free block
+    slab_page_t* partial_pages;
+    spark_mutex_t mutex;
+} slab_class_t;
+
+typedef struct slab_cache_bin {
+    // Intrusive stack, the first pointer of each cached block points to the next one
+    void* first_block;
+    u32 count;
+} slab_cache_bin_t;
+
+typedef struct slab_cache {
+    slab_cache_bin_t bins[SLAB_ALLOCATOR_CLASS_COUNT];
+} SALIGNED(64) slab_cache_t;
+
+typedef struct slab_allocator {
+    slab_class_t classes[SLAB_ALLOCATOR_CLASS_COUNT];
+
+    // Page aligned reservation, set once in slab_allocator_create
+    void* memory;
+    u64 committed_size;
+    // Pages carved out of memory so far
+    u32 used_page_count;
+    // Empty pages that can be given to any size class
+    slab_page_t* free_pages;
+    spark_mutex_t page_mutex;
+
+    // One cache per thread slot
+    slab_cache_t* caches;
+} slab_allocator_t;
+
+void slab_allocator_create(slab_allocator_t* out_allocator);
+void slab_allocator_destroy(slab_allocator_t* allocator);
+
+/**
+ * @brief Allocates size bytes from the smallest size class that fits. Blocks are 16 byte aligned.
+ *
+ * @param size Must be less than or equal to SLAB_ALLOCATOR_MAX_SIZE
+ */
+void* slab_allocator_allocate(slab_allocator_t* allocator, u64 size);
+void slab_allocator_free(slab_allocator_t* allocator, void* block);
+
+/**
+ * @brief Returns true if block lies in the reservation of this allocator.
+ */
+b8 slab_allocator_owns(slab_allocator_t* allocator, const void* block);
+
+/**
+ * @brief Usable size of a block, this can be larger than the size that was requested.
+ */
+u32 slab_allocator_block_size(const void* block);
+
+/**
+ * @brief Returns the blocks cached by the calling thread to their pages. Call before a thread exits.
+ */
+void slab_allocator_flush_thread_cache(slab_allocator_t* allocator);
+
+/**
+ * @brief Gives the calling thread's cache slot back so a new thread can use it. Flush every allocator first.
+ */
+void slab_allocator_release_thread_slot();
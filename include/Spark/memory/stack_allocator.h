@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Spark/defines.h"
+
+// ================================
+// Stack allocator
+// ================================
+// Scratch memory for nested work. Take a mark, allocate, and rewind to the mark to release everything allocated after
+// it in O(1). Address space is reserved up front and committed as the stack grows, so a large reserve costs nothing
+// until it is used. Memory is not zeroed, debug builds fill rewound memory with STACK_ALLOCATOR_POISON.
+#define STACK_ALLOCATOR_ALIGNMENT 16
+#define STACK_ALLOCATOR_COMMIT_SIZE (64 * 1024)
+#define STACK_ALLOCATOR_POISON 0xDD
+
+typedef struct stack_allocator {
+    void* memory;
+    u64 allocated;
+    u64 committed_size;
+    u64 reserved_size;
+} stack_allocator_t;
+
+// Position of the stack, returned by stack_allocator_mark
+typedef u64 stack_allocator_mark_t;
+
+SAPI void stack_allocator_create(u64 reserve_size, stack_allocator_t* out_allocator);
+SAPI void stack_allocator_destroy(stack_allocator_t* allocator);
+
+/**
+ * @brief Allocates size bytes aligned to STACK_ALLOCATOR_ALIGNMENT. The memory is not zeroed.
+ *
+ * @return NULL if the reserve is exhausted.
+ */
+SAPI void* stack_allocator_allocate(stack_allocator_t* allocator, u64 size);
+
+SAPI stack_allocator_mark_t stack_allocator_mark(const stack_allocator_t* allocator);
+
+/**
+ * @brief Releases everything allocated since mark was taken. Marks taken after it become invalid.
+ */
+SAPI void stack_allocator_rewind_to(stack_allocator_t* allocator, stack_allocator_mark_t mark);
+
+#define STACK_ALLOC(allocator, type, count) ((type*)stack_allocator_allocate(allocator, sizeof(type) * (count)))
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "Spark/ecs/ecs.h"
+
+// Fixed rate the physics phase is stepped at, in ticks per second
+#define PHYSICS_TICK_RATE 60
 typedef enum physics_broadphase_layer {
     PHYSICS_BROADPHASE_LAYER_NON_MOVING = 0,
     PHYSICS_BROADPHASE_LAYER_MOVING = 1,
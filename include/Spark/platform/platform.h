@@ -22,6 +22,18 @@ void*   platform_zero_memory(void* block, u64 size);
 void*   platform_copy_memory(void* dest, const void* source, u64 size);
 void*   platform_set_memory(void* dest, s32 value, u64 size);
 
+// Virtual memory. Reserved address space is not backed by memory until it is committed, and committed pages only
+// count towards the resident size once they are touched.
+// alignment has to be a power of two and is at least PLATFORM_HUGE_PAGE_SIZE. huge_pages asks for transparent huge
+// pages. Release with the same size the block was reserved with.
+#define PLATFORM_HUGE_PAGE_SIZE (2ull * 1024 * 1024)
+void*   platform_reserve_memory(u64 size, u64 alignment, b8 huge_pages);
+b8      platform_commit_memory(void* block, u64 size);
+void    platform_release_memory(void* block, u64 size);
+// Gives the physical pages of a committed block back to the OS. The block stays committed, its contents are undefined
+// until it is written again.
+void    platform_decommit_memory(void* block, u64 size);
+
 void platform_console_write(const char* message, u8 color);
 void platform_console_write_error(const char* message, u8 color);
 
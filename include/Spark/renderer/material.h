@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Spark/core/string_intern.h"
 #include "Spark/ecs/ecs.h"
 #include "Spark/renderer/shader.h"
 #include "Spark/renderer/texture.h"
@@ -14,17 +15,17 @@ typedef struct material_resource {
 #define MATERIAL_MAX_RESOURCE_COUNT 8
 #define MATERIAL_CONFIG_MAX_NAME_LENGTH 48
 typedef struct material {
-#ifdef SPARK_DEBUG
-    char name[MATERIAL_CONFIG_MAX_NAME_LENGTH];
-#endif 
+    string_id name;
     void* internal_data;
     shader_t* shader;
 } material_t;
 extern ECS_COMPONENT_DECLARE(material_t);
 
+// Names are interned by the loader once, so creating many materials does not hash the same strings again
 typedef struct material_config {
-    char name[MATERIAL_CONFIG_MAX_NAME_LENGTH];
-    char shader_path[MATERIAL_CONFIG_MAX_NAME_LENGTH];
+    string_id name;
+    // STRING_ID_INVALID uses the default shader
+    string_id shader_path;
     u8 resource_count;
     material_resource_t resources[MATERIAL_MAX_RESOURCE_COUNT];
 } material_config_t;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Spark/core/string_intern.h"
 #include "Spark/renderer/renderpasses.h"
 #include "Spark/resources/resource_types.h"
 #include "Spark/types/s3d.h"
@@ -43,9 +44,7 @@ typedef struct shader {
     builtin_renderpass_t renderpass;
     u8 resource_count;
     u8 attribute_count;
-#ifdef SPARK_DEBUG
-    char name[64];
-#endif
+    string_id name;
 } shader_t;
 
 darray_header(shader_t, shader);
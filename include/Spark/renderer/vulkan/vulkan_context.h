@@ -74,7 +74,9 @@ typedef struct vulkan_context {
     VkFence in_flight_fences[SWAPCHAIN_MAX_IMAGE_COUNT];
 
     vulkan_renderpass_t renderpasses[BUILTIN_RENDERPASS_ENUM_MAX];
-    darray_mat4_t local_instance_buffer;
+    // Instance transforms of the current frame, allocated from the frame allocator
+    mat4* local_instance_buffer;
+    u32 local_instance_count;
 
     // Descriptor pools
     VkDescriptorPool descriptor_pool;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Spark/ecs/ecs_command_buffer.h"
 #include "Spark/memory/linear_allocator.h"
 #include "Spark/renderer/material.h"
 #include "Spark/renderer/model.h"
@@ -13,3 +14,8 @@ resource_t pvt_model_loader_load_text_resource(const char* text, u32 length, b8
 resource_t pvt_model_loader_load_binary_resource(void* binary_data, u32 size, b8 auto_delete);
 model_t* model_loader_get_model(u32 index);
 entity_t model_loader_instance_model(u32 index, u32 material_override_count, material_t* material_overrides[static material_override_count]);
+/**
+ * @brief Records the creation of a model instance into a command buffer instead of the world, so models can be
+ * instanced from loader threads. The entities exist once the buffer is submitted and committed.
+ */
+entity_t model_loader_stage_model(ecs_command_buffer_t* buffer, u32 index, u32 material_override_count, material_t* material_overrides[static material_override_count]);
@@ -1,5 +1,6 @@
 #pragma once 
 
+#include "Spark/core/string_intern.h"
 #include "Spark/memory/linear_allocator.h"
 #include "Spark/resources/resource_types.h"
 
@@ -7,5 +8,9 @@ void resource_loader_initialize(linear_allocator_t* allocator);
 void resource_loader_shutdown();
 
 resource_t resource_loader_get_resource(const char* path, b8 auto_delete);
+/**
+ * @brief Same as resource_loader_get_resource for an interned path, the path is not hashed again.
+ */
+resource_t resource_loader_get_resource_by_id(string_id path_id, b8 auto_delete);
 void resource_loader_destroy_resource(resource_t* resource);
 
@@ -49,3 +49,5 @@ struct texture*  resource_get_texture(resource_t* resource);
 struct shader*   resource_get_shader(resource_t* resource);
 struct material* resource_get_material(resource_t* resource);
 entity_t    resource_instance_model(resource_t* resource, u32 material_count, struct material** materials);
+struct ecs_command_buffer;
+entity_t    resource_stage_model_instance(struct ecs_command_buffer* buffer, resource_t* resource, u32 material_count, struct material** materials);
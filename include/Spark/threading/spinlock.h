@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Spark/defines.h"
+
+// Busy waiting for locks and flags that are only held for a few instructions. Waiters pause between checks and back
+// off exponentially, so they neither starve the owner's hyperthread nor keep its cache line bouncing.
+#define SPIN_MAX_BACKOFF 64
+
+SINLINE void spin_pause() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ volatile("yield");
+#endif
+}
+
+// Pauses backoff times, returns the backoff for the next wait
+SINLINE u32 spin_backoff(u32 backoff) {
+    for (u32 i = 0; i < backoff; i++) {
+        spin_pause();
+    }
+    return backoff < SPIN_MAX_BACKOFF ? backoff * 2 : backoff;
+}
+
+// Waits until flag is cleared by another thread
+SINLINE void spin_wait_clear(const b8* flag) {
+    u32 backoff = 1;
+    while (__atomic_load_n(flag, __ATOMIC_ACQUIRE)) {
+        backoff = spin_backoff(backoff);
+    }
+}
+
+SINLINE void spin_lock(b8* lock) {
+    // Only retry the exchange once the lock looks free, plain loads keep the cache line shared
+    while (__atomic_test_and_set(lock, __ATOMIC_ACQUIRE)) {
+        spin_wait_clear(lock);
+    }
+}
+
+SINLINE void spin_unlock(b8* lock) {
+    __atomic_clear(lock, __ATOMIC_RELEASE);
+}
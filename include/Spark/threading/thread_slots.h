@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Spark/defines.h"
+
+// Small dense indices for threads, so per-thread data can live in fixed size arrays. A slot is returned when its
+// thread shuts down and handed to the next thread that asks, so short lived threads do not use the array up.
+// A set bit marks a slot in use, acquiring claims the lowest clear bit with compare exchange.
+#define THREAD_SLOTS_MAX 64
+
+typedef struct thread_slots {
+    u64 used;
+    // Highest slot ever acquired + 1, the slots to visit when summing over all threads
+    u32 high_water;
+} thread_slots_t;
+
+/**
+ * @brief Claims a free slot, INVALID_ID if all THREAD_SLOTS_MAX slots are in use.
+ */
+SINLINE u32 thread_slots_acquire(thread_slots_t* slots) {
+    u64 used = __atomic_load_n(&slots->used, __ATOMIC_RELAXED);
+    while (~used) {
+        const u32 slot = __builtin_ctzll(~used);
+        if (__atomic_compare_exchange_n(&slots->used, &used, used | (1ull << slot), true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            u32 high_water = __atomic_load_n(&slots->high_water, __ATOMIC_RELAXED);
+            while (slot >= high_water && !__atomic_compare_exchange_n(&slots->high_water, &high_water, slot + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+            return slot;
+        }
+    }
+    return INVALID_ID;
+}
+
+SINLINE void thread_slots_release(thread_slots_t* slots, u32 slot) {
+    __atomic_fetch_and(&slots->used, ~(1ull << slot), __ATOMIC_RELEASE);
+}
+
+SINLINE u32 thread_slots_high_water(const thread_slots_t* slots) {
+    return __atomic_load_n(&slots->high_water, __ATOMIC_RELAXED);
+}
@@ -6,80 +6,141 @@
 
 typedef u64 hash_t;
 
-#define X_PRIME 501125321
-#define Y_PRIME 1136930381
-#define Z_PRIME 1720413743
-#define W_PRIME 1066037191
+// Byte hashing follows wyhash: 16 byte blocks are folded with a 64x64 -> 128 bit multiply, which mixes every input
+// bit into the result at a few cycles per block.
+#define HASH_SECRET_0 0x2d358dccaa6c78a5ull
+#define HASH_SECRET_1 0x8bb84b93962eacc9ull
+#define HASH_SECRET_2 0x4b33a62ed433d4a3ull
+#define HASH_SECRET_3 0x4d5a2da51de1aa47ull
 
-SINLINE hash_t string_hash(const char* string) {
-    u64 hash = 5381;
-    char c = *string;
+// Multiplies a and b, returning the low and high half of the product in a and b
+SINLINE void hash_multiply(u64* a, u64* b) {
+    const __uint128_t product = (__uint128_t)*a * *b;
+    *a = (u64)product;
+    *b = (u64)(product >> 64);
+}
+
+SINLINE u64 hash_fold(u64 a, u64 b) {
+    hash_multiply(&a, &b);
+    return a ^ b;
+}
+
+SINLINE u64 hash_read_u64(const u8* bytes) {
+    u64 value;
+    __builtin_memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+SINLINE u64 hash_read_u32(const u8* bytes) {
+    u32 value;
+    __builtin_memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+// 1 to 3 bytes, reads the first, middle and last byte
+SINLINE u64 hash_read_small(const u8* bytes, u64 size) {
+    return ((u64)bytes[0] << 16) | ((u64)bytes[size >> 1] << 8) | bytes[size - 1];
+}
+
+SINLINE hash_t hash_bytes_seeded(const void* data, u64 size, u64 seed) {
+    const u8* bytes = data;
+    seed ^= hash_fold(seed ^ HASH_SECRET_0, HASH_SECRET_1);
 
-    while (c != 0) {
-        hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
-        c = *string++;
+    u64 a = 0;
+    u64 b = 0;
+    if (size <= 16) {
+        if (size >= 4) {
+            // Two overlapping pairs of 4 byte reads cover 4 to 16 bytes
+            const u64 offset = (size >> 3) << 2;
+            a = (hash_read_u32(bytes) << 32) | hash_read_u32(bytes + offset);
+            b = (hash_read_u32(bytes + size - 4) << 32) | hash_read_u32(bytes + size - 4 - offset);
+        } else if (size > 0) {
+            a = hash_read_small(bytes, size);
+        }
+    } else {
+        u64 remaining = size;
+        if (remaining > 48) {
+            // Three independent lanes keep the multipliers busy
+            u64 seed_1 = seed;
+            u64 seed_2 = seed;
+            do {
+                seed = hash_fold(hash_read_u64(bytes) ^ HASH_SECRET_1, hash_read_u64(bytes + 8) ^ seed);
+                seed_1 = hash_fold(hash_read_u64(bytes + 16) ^ HASH_SECRET_2, hash_read_u64(bytes + 24) ^ seed_1);
+                seed_2 = hash_fold(hash_read_u64(bytes + 32) ^ HASH_SECRET_3, hash_read_u64(bytes + 40) ^ seed_2);
+                bytes += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            seed ^= seed_1 ^ seed_2;
+        }
+        while (remaining > 16) {
+            seed = hash_fold(hash_read_u64(bytes) ^ HASH_SECRET_1, hash_read_u64(bytes + 8) ^ seed);
+            bytes += 16;
+            remaining -= 16;
+        }
+        // The last 16 bytes, overlapping the previous block if size is not a multiple of 16
+        a = hash_read_u64(bytes + remaining - 16);
+        b = hash_read_u64(bytes + remaining - 8);
     }
 
-    return hash;
+    a ^= HASH_SECRET_1;
+    b ^= seed;
+    hash_multiply(&a, &b);
+    return hash_fold(a ^ HASH_SECRET_0 ^ size, b ^ HASH_SECRET_1);
+}
+
+SINLINE hash_t hash_bytes(const void* data, u64 size) {
+    return hash_bytes_seeded(data, size, 0);
+}
+
+SINLINE hash_t string_hash(const char* string) {
+    return hash_bytes(string, string_length(string));
 }
 
 SINLINE b8 u64_compare(u64 a, u64 b) {
     return a == b;
 }
+// For keys that are hashed again by the container, like the hashmap does
 SINLINE hash_t hash_passthrough(u64 key) {
     return key;
 }
 
-// Stolen from stackoverflow. Performance may not be ideal
+// Invertible finalizer of splitmix64, every input bit affects every output bit
 SINLINE hash_t hash_u64(u64 key) {
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ull;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebull;
+    key ^= key >> 31;
     return key;
 }
 
+SINLINE hash_t hash_u32(u32 key) {
+    return hash_u64(key);
+}
+
+// Order dependent combination of a hash with another value
+SINLINE hash_t hash_combine(hash_t hash, u64 value) {
+    return hash_fold(hash ^ HASH_SECRET_0, value ^ HASH_SECRET_1);
+}
+
+// Spatial hashes pack the coordinates into 64 bit words, so neighbouring cells differ in the bits that get mixed most
 SINLINE b8 vec2i_compare(vec2i a, vec2i b) {
     return a.x == b.x && a.y == b.y;
 }
 SINLINE hash_t hash_vec2i(vec2i key) {
-    return (key.x + X_PRIME) ^
-           (key.y + Y_PRIME);
+    return hash_u64(((u64)(u32)key.x << 32) | (u32)key.y);
 }
 
 SINLINE b8 vec3i_compare(vec3i a, vec3i b) {
     return a.x == b.x && a.y == b.y && a.z == b.z;
 }
 SINLINE hash_t hash_vec3i(vec3i key) {
-    return (key.x + X_PRIME) ^
-           (key.y + Y_PRIME) ^
-           (key.z + Z_PRIME);
+    return hash_fold(((u64)(u32)key.x << 32 | (u32)key.y) ^ HASH_SECRET_0, (u32)key.z ^ HASH_SECRET_1);
 }
 
 SINLINE b8 vec4i_compare(vec4i a, vec4i b) {
     return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
 }
 SINLINE hash_t hash_vec4i(vec4i key) {
-    return (key.x + X_PRIME) ^
-           (key.y + Y_PRIME) ^
-           (key.z + Z_PRIME) ^
-           (key.w + W_PRIME);
-}
-
-SINLINE b8 string_compare(const char* a, const char* b) {
-    SDEBUG("String compare: %p - %p", a, b);
-    SDEBUG("String compare: %s - %s", a, b);
-    return string_equal(a, b);
-    if (!a || !b) {
-        return false;
-    }
-    char ca = a[0];
-    char cb = b[0];
-    while (ca != 0 && cb != 0) {
-        if (ca != cb) {
-            return false;
-        }
-        a++;
-        b++;
-        ca = *a;
-        cb = *b;
-    }
-
-    return true;
+    return hash_fold(((u64)(u32)key.x << 32 | (u32)key.y) ^ HASH_SECRET_0, ((u64)(u32)key.z << 32 | (u32)key.w) ^ HASH_SECRET_1);
 }
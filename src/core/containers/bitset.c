@@ -0,0 +1,245 @@
+#include "Spark/containers/bitset.h"
+#include "Spark/core/logging.h"
+#include "Spark/core/smemory.h"
+#include "Spark/math/smath.h"
+
+// The AVX2 paths are compiled for every x86 build and picked at runtime, so the engine does not have to be built
+// with -mavx2 to use them and still runs on CPUs without AVX2
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BITSET_AVX2
+#define BITSET_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+static b8 bitset_avx2_enabled = true;
+
+SINLINE b8 bitset_use_avx2() {
+#ifdef BITSET_AVX2
+    return bitset_avx2_enabled && __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+// Words for bit_count bits, rounded up to whole blocks and never empty so words is always valid
+static u32 bitset_word_count(u32 bit_count) {
+    constexpr u32 block_bits = BITSET_WORD_BITS * BITSET_BLOCK_WORDS;
+    const u32 block_count = smax((bit_count + block_bits - 1) / block_bits, 1u);
+    return block_count * BITSET_BLOCK_WORDS;
+}
+
+void bitset_create(u32 bit_count, bitset_t* out_bitset) {
+    out_bitset->bit_count = bit_count;
+    out_bitset->word_count = bitset_word_count(bit_count);
+    out_bitset->words = sallocate(sizeof(u64) * out_bitset->word_count, MEMORY_TAG_ARRAY);
+}
+
+void bitset_destroy(bitset_t* bitset) {
+    sfree(bitset->words, sizeof(u64) * bitset->word_count, MEMORY_TAG_ARRAY);
+    bitset->words = NULL;
+    bitset->bit_count = 0;
+    bitset->word_count = 0;
+}
+
+void bitset_resize(bitset_t* bitset, u32 bit_count) {
+    const u32 word_count = bitset_word_count(bit_count);
+    if (word_count != bitset->word_count) {
+        u64* words = sallocate(sizeof(u64) * word_count, MEMORY_TAG_ARRAY);
+        scopy_memory(words, bitset->words, sizeof(u64) * smin(word_count, bitset->word_count));
+        sfree(bitset->words, sizeof(u64) * bitset->word_count, MEMORY_TAG_ARRAY);
+        bitset->words = words;
+        bitset->word_count = word_count;
+    }
+
+    // Bits past the new count have to be zero when shrinking
+    if (bit_count < bitset->bit_count) {
+        bitset_clear_range(bitset, bit_count, word_count * BITSET_WORD_BITS - bit_count);
+    }
+    bitset->bit_count = bit_count;
+}
+
+static void bitset_fill_range(bitset_t* bitset, u32 first, u32 count, b8 value) {
+    if (count == 0) {
+        return;
+    }
+    SASSERT((u64)first + count <= (u64)bitset->word_count * BITSET_WORD_BITS, "Bit range %u + %u is outside of the bitset.", first, count);
+
+    const u32 last = first + count - 1;
+    const u32 first_word = first / BITSET_WORD_BITS;
+    const u32 last_word = last / BITSET_WORD_BITS;
+    const u64 first_mask = ~0ull << (first % BITSET_WORD_BITS);
+    const u64 last_mask = ~0ull >> (BITSET_WORD_BITS - 1 - last % BITSET_WORD_BITS);
+
+    if (first_word == last_word) {
+        const u64 mask = first_mask & last_mask;
+        bitset->words[first_word] = value ? bitset->words[first_word] | mask : bitset->words[first_word] & ~mask;
+        return;
+    }
+
+    bitset->words[first_word] = value ? bitset->words[first_word] | first_mask : bitset->words[first_word] & ~first_mask;
+    sset_memory(bitset->words + first_word + 1, value ? 0xFF : 0, sizeof(u64) * (last_word - first_word - 1));
+    bitset->words[last_word] = value ? bitset->words[last_word] | last_mask : bitset->words[last_word] & ~last_mask;
+}
+
+void bitset_set_range(bitset_t* bitset, u32 first, u32 count) {
+    SASSERT((u64)first + count <= bitset->bit_count, "Can not set bits past the end of the bitset.");
+    bitset_fill_range(bitset, first, count, true);
+}
+
+void bitset_clear_range(bitset_t* bitset, u32 first, u32 count) {
+    bitset_fill_range(bitset, first, count, false);
+}
+
+void bitset_clear_all(bitset_t* bitset) {
+    szero_memory(bitset->words, sizeof(u64) * bitset->word_count);
+}
+
+void bitset_set_avx2(b8 enabled) {
+    bitset_avx2_enabled = enabled;
+}
+
+#ifdef BITSET_AVX2
+BITSET_AVX2_TARGET static void bitset_and_avx2(u64* dest, const u64* a, const u64* b, u32 word_count) {
+    for (u32 i = 0; i < word_count; i += BITSET_BLOCK_WORDS) {
+        const __m256i block_a = _mm256_loadu_si256((const __m256i*)(a + i));
+        const __m256i block_b = _mm256_loadu_si256((const __m256i*)(b + i));
+        _mm256_storeu_si256((__m256i*)(dest + i), _mm256_and_si256(block_a, block_b));
+    }
+}
+
+BITSET_AVX2_TARGET static void bitset_or_avx2(u64* dest, const u64* a, const u64* b, u32 word_count) {
+    for (u32 i = 0; i < word_count; i += BITSET_BLOCK_WORDS) {
+        const __m256i block_a = _mm256_loadu_si256((const __m256i*)(a + i));
+        const __m256i block_b = _mm256_loadu_si256((const __m256i*)(b + i));
+        _mm256_storeu_si256((__m256i*)(dest + i), _mm256_or_si256(block_a, block_b));
+    }
+}
+
+BITSET_AVX2_TARGET static void bitset_andnot_avx2(u64* dest, const u64* a, const u64* b, u32 word_count) {
+    for (u32 i = 0; i < word_count; i += BITSET_BLOCK_WORDS) {
+        const __m256i block_a = _mm256_loadu_si256((const __m256i*)(a + i));
+        const __m256i block_b = _mm256_loadu_si256((const __m256i*)(b + i));
+        _mm256_storeu_si256((__m256i*)(dest + i), _mm256_andnot_si256(block_b, block_a));
+    }
+}
+
+BITSET_AVX2_TARGET static u32 bitset_count_avx2(const u64* words, u32 word_count) {
+    // Looks up the bit count of every nibble and sums the bytes of each 64 bit lane
+    const __m256i lookup = _mm256_setr_epi8(
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_nibbles = _mm256_set1_epi8(0x0F);
+    __m256i total = _mm256_setzero_si256();
+    for (u32 i = 0; i < word_count; i += BITSET_BLOCK_WORDS) {
+        const __m256i block = _mm256_loadu_si256((const __m256i*)(words + i));
+        const __m256i low = _mm256_shuffle_epi8(lookup, _mm256_and_si256(block, low_nibbles));
+        const __m256i high = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(block, 4), low_nibbles));
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256()));
+    }
+    return _mm256_extract_epi64(total, 0) + _mm256_extract_epi64(total, 1) +
+        _mm256_extract_epi64(total, 2) + _mm256_extract_epi64(total, 3);
+}
+
+BITSET_AVX2_TARGET static b8 bitset_any_avx2(const u64* words, u32 word_count) {
+    for (u32 i = 0; i < word_count; i += BITSET_BLOCK_WORDS) {
+        const __m256i block = _mm256_loadu_si256((const __m256i*)(words + i));
+        if (!_mm256_testz_si256(block, block)) {
+            return true;
+        }
+    }
+    return false;
+}
+#endif
+
+void bitset_and(bitset_t* dest, const bitset_t* a, const bitset_t* b) {
+    SASSERT(dest->word_count == a->word_count && a->word_count == b->word_count, "Bitsets are of different sizes.");
+#ifdef BITSET_AVX2
+    if (bitset_use_avx2()) {
+        bitset_and_avx2(dest->words, a->words, b->words, dest->word_count);
+        return;
+    }
+#endif
+    for (u32 i = 0; i < dest->word_count; i++) {
+        dest->words[i] = a->words[i] & b->words[i];
+    }
+}
+
+void bitset_or(bitset_t* dest, const bitset_t* a, const bitset_t* b) {
+    SASSERT(dest->word_count == a->word_count && a->word_count == b->word_count, "Bitsets are of different sizes.");
+#ifdef BITSET_AVX2
+    if (bitset_use_avx2()) {
+        bitset_or_avx2(dest->words, a->words, b->words, dest->word_count);
+        return;
+    }
+#endif
+    for (u32 i = 0; i < dest->word_count; i++) {
+        dest->words[i] = a->words[i] | b->words[i];
+    }
+}
+
+void bitset_andnot(bitset_t* dest, const bitset_t* a, const bitset_t* b) {
+    SASSERT(dest->word_count == a->word_count && a->word_count == b->word_count, "Bitsets are of different sizes.");
+#ifdef BITSET_AVX2
+    if (bitset_use_avx2()) {
+        bitset_andnot_avx2(dest->words, a->words, b->words, dest->word_count);
+        return;
+    }
+#endif
+    for (u32 i = 0; i < dest->word_count; i++) {
+        dest->words[i] = a->words[i] & ~b->words[i];
+    }
+}
+
+u32 bitset_count(const bitset_t* bitset) {
+#ifdef BITSET_AVX2
+    if (bitset_use_avx2()) {
+        return bitset_count_avx2(bitset->words, bitset->word_count);
+    }
+#endif
+    u32 count = 0;
+    for (u32 i = 0; i < bitset->word_count; i++) {
+        count += __builtin_popcountll(bitset->words[i]);
+    }
+    return count;
+}
+
+b8 bitset_any(const bitset_t* bitset) {
+#ifdef BITSET_AVX2
+    if (bitset_use_avx2()) {
+        return bitset_any_avx2(bitset->words, bitset->word_count);
+    }
+#endif
+    for (u32 i = 0; i < bitset->word_count; i += BITSET_BLOCK_WORDS) {
+        if (bitset->words[i] | bitset->words[i + 1] | bitset->words[i + 2] | bitset->words[i + 3]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+u32 bitset_next(const bitset_t* bitset, u32 bit) {
+    if (bit >= bitset->bit_count) {
+        return INVALID_ID;
+    }
+
+    u32 word_index = bit / BITSET_WORD_BITS;
+    u64 word = bitset->words[word_index] & (~0ull << (bit % BITSET_WORD_BITS));
+    while (!word) {
+        if (++word_index == bitset->word_count) {
+            return INVALID_ID;
+        }
+        word = bitset->words[word_index];
+    }
+    return word_index * BITSET_WORD_BITS + __builtin_ctzll(word);
+}
+
+void bitset_for_each(const bitset_t* bitset, void (*function)(u32 bit, void* user_data), void* user_data) {
+    for (u32 i = 0; i < bitset->word_count; i++) {
+        u64 word = bitset->words[i];
+        while (word) {
+            function(i * BITSET_WORD_BITS + __builtin_ctzll(word), user_data);
+            // Clear the lowest set bit
+            word &= word - 1;
+        }
+    }
+}
@@ -2,8 +2,11 @@
 #include "Spark/core/event.h"
 #include "Spark/core/input.h"
 #include "Spark/core/sstring.h"
+#include "Spark/core/string_intern.h"
 #include "Spark/ecs/ecs_world.h"
 #include "Spark/game_types.h"
+#include "Spark/memory/allocation_trace.h"
+#include "Spark/memory/frame_allocator.h"
 #include "Spark/memory/linear_allocator.h"
 #include "Spark/physics/physics_backend.h"
 #include "Spark/platform/platform.h"
@@ -16,6 +19,7 @@
 #include "Spark/systems/core_systems.h"
 #include "Spark/types/ecs_declarations.h"
 #include "Spark/ui/ui_systems.h"
+#include <stdlib.h>
 
 typedef enum : u8 {
     APPLICATION_STATE_OFF       = 0,
@@ -79,6 +83,21 @@ application_create(game_t* game_inst) {
 
     // Memory
     initialize_memory();
+    frame_allocator_initialize(FRAME_ALLOCATOR_DEFAULT_SIZE);
+
+    // Lets CI track memory use per frame, a path ending in .json is written as JSON and anything else as CSV
+    const char* memory_stats_path = getenv("SPARK_MEMORY_STATS");
+    if (memory_stats_path) {
+        const u32 length = string_length(memory_stats_path);
+        const memory_stats_format_t format = length >= 5 && string_equal(memory_stats_path + length - 5, ".json") ? MEMORY_STATS_FORMAT_JSON : MEMORY_STATS_FORMAT_CSV;
+        memory_stats_start_dump(memory_stats_path, format, MEMORY_STATS_DEFAULT_DUMP_INTERVAL);
+    }
+
+    // Records the session's allocations for benchmarks/allocation_replay.c
+    const char* allocation_trace_path = getenv("SPARK_ALLOCATION_TRACE");
+    if (allocation_trace_path) {
+        allocation_trace_start(allocation_trace_path, ALLOCATION_TRACE_DEFAULT_MAX_SIZE);
+    }
 
     // Application
     game_inst->application_state = sallocate(sizeof(application_state_t), MEMORY_TAG_GAME);
@@ -102,6 +121,7 @@ application_create(game_t* game_inst) {
     }
     
     // Resources
+    string_intern_initialize();
     resource_loader_initialize(&app_state->systems_allocator);
 
     // ECS
@@ -203,7 +223,7 @@ application_run() {
         const f32 delta_time = delta;
 
         // Update
-        ecs_world_progress();
+        ecs_world_progress(delta_time);
         b8 update_success = app_state->game_inst->update(app_state->game_inst, delta_time );
         if (!update_success) {
             SASSERT(update_success, "Game failed to update");
@@ -254,6 +274,9 @@ application_run() {
 
         input_update(delta_time);
         platform_set_cursor_position(&app_state->platform, 256, 256);
+
+        frame_allocator_end_frame();
+        memory_stats_end_frame();
     }
 
     STRACE("App shutting down");
@@ -271,6 +294,10 @@ application_run() {
     input_shutdown();
     ecs_world_shutdown();
     physics_backend_shutdown();
+    string_intern_shutdown();
+    frame_allocator_shutdown();
+    memory_stats_stop_dump();
+    allocation_trace_stop();
 
     linear_allocator_destroy(&app_state->systems_allocator);
 
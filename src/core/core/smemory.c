@@ -7,44 +7,95 @@
 #include "Spark/containers/generic/darray_ints.h"
 #include "Spark/core/logging.h"
 #include "Spark/core/sstring.h"
+#include "Spark/math/smath.h"
+#include "Spark/memory/allocation_trace.h"
 #include "Spark/memory/dynamic_allocator.h"
 #include "Spark/memory/freelist.h"
+#include "Spark/memory/pool_allocator.h"
+#include "Spark/memory/slab_allocator.h"
+#include "Spark/platform/filesystem.h"
 #include "Spark/platform/platform.h"
+#include "Spark/threading/spinlock.h"
+#include "Spark/threading/thread_slots.h"
 #include <execinfo.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/stat.h>
 
 // Used for allocation tracking
 #ifdef SPARK_DEBUG
-#include <unistd.h>
-#include <sys/wait.h>
+#define ALLOCATION_TRACKING_INITIAL_CAPACITY (1u << 14)
+#define ALLOCATION_TRACKING_BACKTRACE_DEPTH 16
 
-#define ALLOCATION_INFO_BACKTRACE_STRING_SIZE 512
 typedef struct allocation_info {
-    char backtrace[ALLOCATION_INFO_BACKTRACE_STRING_SIZE];
+    // NULL for empty slots
+    const void* block;
     const char* file;
-    u32 line;
+    // Raw return addresses, only symbolized when reporting. NULL unless the allocation was sampled.
+    void** backtrace;
     u64 size;
+    u32 line;
+    u32 backtrace_count;
     memory_tag_t tag;
-    u32 allocation_index;
 } allocation_info_t;
 
-const u32 padding_size = 0x100;
-const u32 alloc_info_padding = padding_size - (sizeof(allocation_info_t) % padding_size);
-
-u32 allocation_count = 0;
-u32 allocation_capacity = 0;
-allocation_info_t** tracked_allocations = NULL;
-
-void addr2line(const char *ptr, const char *elf_name, char* output, u32 output_buffer_size);
+// Open addressing table of live allocations keyed by block address. The entries are allocated from the platform so
+// tracking never recurses into itself.
+typedef struct allocation_tracking {
+    allocation_info_t* entries;
+    u32 capacity;
+    u32 count;
+    // Every backtrace_sample_rate'th allocation records a backtrace, 0 disables backtraces
+    u32 backtrace_sample_rate;
+    u32 sample_counter;
+    b8 lock;
+} allocation_tracking_t;
+
+static allocation_tracking_t tracking = {
+    .backtrace_sample_rate = MEMORY_TRACKING_DEFAULT_BACKTRACE_SAMPLE_RATE,
+};
 #endif
 
-typedef struct {
-    u64 total_allocated;
-    u64 tagged_allocations[MEMORY_TAG_MAX];
+// Counters of one thread slot. Only the owning thread writes them, so updates are plain stores that other threads may
+// read at any time. A slot keeps its counts when its thread exits and the next thread continues them, only the sum
+// over all slots is meaningful.
+typedef struct memory_thread_stats {
+    u64 allocation_count[MEMORY_TAG_MAX];
+    u64 free_count[MEMORY_TAG_MAX];
+} SALIGNED(64) memory_thread_stats_t;
+
+// Bytes in use are counted with atomics instead of per thread, so the peak can be raised on every allocation. Each
+// tag has its own cache line so threads allocating different tags do not contend.
+typedef struct memory_tag_bytes {
+    u64 current;
+    u64 peak;
+} SALIGNED(64) memory_tag_bytes_t;
+
+typedef struct memory_stats {
+    memory_thread_stats_t threads[MEMORY_STATS_MAX_THREADS];
+    // Shared by the threads that find every slot in use, updated with atomic adds
+    memory_thread_stats_t shared;
+    thread_slots_t thread_slots;
+
+    memory_tag_bytes_t bytes[MEMORY_TAG_MAX];
+    // Totals at the start of the current frame and the counts of the last completed frame
+    u64 frame_start_allocation_count[MEMORY_TAG_MAX];
+    u64 frame_start_free_count[MEMORY_TAG_MAX];
+    u64 frame_allocation_count[MEMORY_TAG_MAX];
+    u64 frame_free_count[MEMORY_TAG_MAX];
+    u64 frame_index;
+
+    file_handle_t dump_file;
+    memory_stats_format_t dump_format;
+    u32 dump_interval;
 } memory_stats_t;
 
+STATIC_ASSERT(MEMORY_STATS_MAX_THREADS == THREAD_SLOTS_MAX, "Memory stats need a slot per thread slot.");
+
+static memory_stats_t stats;
+static thread_local memory_thread_stats_t* thread_stats = NULL;
+
 const char* memory_tag_strings[] = {
     "UNDEFINED          ",
     "ENTITY             ",
@@ -65,28 +116,79 @@ const char* memory_tag_strings[] = {
     "THREAD             ",
 };
 
-typedef struct memory_system_state {
-    memory_stats_t stats;
-    u64 alloc_count;
+// Tag names are padded for get_memory_usage_string
+SINLINE s32 memory_tag_name_length(memory_tag_t tag) {
+    return strcspn(memory_tag_strings[tag], " ");
+}
+
+static const char* memory_heap_names[] = {
+    "GENERAL",
+    "ECS",
+    "RENDERER",
+    "RESOURCES",
+    "STRING",
+};
+
+// Tags that are not listed go to MEMORY_HEAP_GENERAL
+static const memory_heap_t memory_tag_heaps[MEMORY_TAG_MAX] = {
+    [MEMORY_TAG_ENTITY]            = MEMORY_HEAP_ECS,
+    [MEMORY_TAG_ECS]               = MEMORY_HEAP_ECS,
+    [MEMORY_TAG_SYSTEM]            = MEMORY_HEAP_ECS,
+    [MEMORY_TAG_STRING]            = MEMORY_HEAP_STRING,
+    [MEMORY_TAG_TEXTURE]           = MEMORY_HEAP_RESOURCES,
+    [MEMORY_TAG_MATERIAL]          = MEMORY_HEAP_RESOURCES,
+    [MEMORY_TAG_SHADER]            = MEMORY_HEAP_RESOURCES,
+    [MEMORY_TAG_MESH]              = MEMORY_HEAP_RESOURCES,
+    [MEMORY_TAG_RENDERER]          = MEMORY_HEAP_RENDERER,
+    [MEMORY_TAG_MATERIAL_INSTANCE] = MEMORY_HEAP_RENDERER,
+};
+
+// Size committed at once by each heap's dynamic allocator
+static const u64 memory_heap_commit_sizes[MEMORY_HEAP_MAX] = {
+    [MEMORY_HEAP_GENERAL]   = 128 * MB,
+    [MEMORY_HEAP_ECS]       = 32 * MB,
+    [MEMORY_HEAP_RENDERER]  = 32 * MB,
+    [MEMORY_HEAP_RESOURCES] = 32 * MB,
+    [MEMORY_HEAP_STRING]    = 8 * MB,
+};
+
+typedef struct memory_heap_state {
     dynamic_allocator_t allocator;
+    // 0 for no budget. used_bytes is only counted while there is a budget, see memory_heap_set_budget.
+    u64 budget;
+    u64 used_bytes;
+    u64 over_budget_count;
+} SALIGNED(64) memory_heap_state_t;
+
+typedef struct memory_system_state {
+    // Serve allocations larger than SLAB_ALLOCATOR_MAX_SIZE, picked by tag
+    memory_heap_state_t heaps[MEMORY_HEAP_MAX];
+    // Serves allocations of SLAB_ALLOCATOR_MAX_SIZE bytes or less
+    slab_allocator_t small_allocator;
+    // Allocations go to the platform until the allocators exist, this includes the allocators' own mutexes
+    b8 allocator_initialized;
 } memory_system_state_t;
 
+// Allocations larger than this go straight to the platform instead of fragmenting the allocator's regions
+#define MEMORY_PLATFORM_ALLOCATION_THRESHOLD (8 * MB)
+
 static memory_system_state_t state_ptr;
 
 static char* memory_usage_string;
 static int memory_usage_string_size = 0x8000;
 
 void initialize_memory() {
-    state_ptr.alloc_count = 0;
-
-    dynamic_allocator_create(128 * MB, &state_ptr.allocator);
-    memory_usage_string = dynamic_allocator_allocate(&state_ptr.allocator, memory_usage_string_size);
+    // Creating the allocators again would route their own mutexes into the half created allocators
+    if (state_ptr.allocator_initialized) {
+        return;
+    }
 
-#ifdef SPARK_DEBUG 
-    allocation_count = 0;
-    allocation_capacity = 8192;
-    tracked_allocations = platform_allocate(sizeof(allocation_info_t) * allocation_capacity, true);
-#endif
+    for (u32 i = 0; i < MEMORY_HEAP_MAX; i++) {
+        dynamic_allocator_create(memory_heap_commit_sizes[i], &state_ptr.heaps[i].allocator);
+    }
+    slab_allocator_create(&state_ptr.small_allocator);
+    state_ptr.allocator_initialized = true;
+    memory_usage_string = dynamic_allocator_allocate(&state_ptr.heaps[MEMORY_HEAP_GENERAL].allocator, memory_usage_string_size);
 }
 
 /**
@@ -95,43 +197,148 @@ void initialize_memory() {
 void 
 shutdown_memory() {
 #ifdef SPARK_DEBUG
-    // Ensure all allocations are removed
-    for (u32 i = 0; i < allocation_count; i++) {
-        SWARN("File: %s:%d", tracked_allocations[i]->file, tracked_allocations[i]->line);
+    memory_tracking_report();
+#endif
 
-        const char* backtrace = tracked_allocations[i]->backtrace;
+    SDEBUG("Memory after shutdown: %s", get_memory_usage_string());
+    memory_stats_stop_dump();
+    state_ptr.allocator_initialized = false;
+    slab_allocator_destroy(&state_ptr.small_allocator);
+    for (u32 i = 0; i < MEMORY_HEAP_MAX; i++) {
+        dynamic_allocator_destroy(&state_ptr.heaps[i].allocator);
+    }
+}
 
-        while (backtrace) {
-            char* addr_text = string_start(backtrace, "(");
-            if (!addr_text) {
-                break;
-            }
-            char address[128] = {};
-            *addr_text = ' ';
-            char* addr_text_end = string_start(backtrace, ")");
-            if (!addr_text_end) {
-                break;
-            }
-            *addr_text_end = 0;
+void memory_thread_shutdown() {
+    if (state_ptr.allocator_initialized) {
+        for (u32 i = 0; i < MEMORY_HEAP_MAX; i++) {
+            dynamic_allocator_flush_thread_cache(&state_ptr.heaps[i].allocator);
+        }
+        slab_allocator_flush_thread_cache(&state_ptr.small_allocator);
+    }
+    dynamic_allocator_release_thread_slot();
+    slab_allocator_release_thread_slot();
+    pool_allocator_release_thread_slot();
 
-            // NOTE: Hardcoding binary name.
-            addr2line(addr_text, "cube", address, sizeof(address));
+    if (thread_stats && thread_stats != &stats.shared) {
+        thread_slots_release(&stats.thread_slots, thread_stats - stats.threads);
+    }
+    thread_stats = NULL;
+}
 
-            backtrace = addr_text_end + 1;
+// Picks the allocator for size and tag, without tracking or zeroing
+static void* memory_allocate_block(u64 size, memory_tag_t tag) {
+    void* block = NULL;
+    if (state_ptr.allocator_initialized) {
+        if (size <= SLAB_ALLOCATOR_MAX_SIZE) {
+            block = slab_allocator_allocate(&state_ptr.small_allocator, size);
+        } else if (size <= MEMORY_PLATFORM_ALLOCATION_THRESHOLD) {
+            block = dynamic_allocator_allocate(&state_ptr.heaps[memory_tag_heaps[tag]].allocator, size);
+        }
+    }
+    if (!block) {
+        block = platform_allocate(size, true);
+    }
+    return block;
+}
 
-            SWARN("Backtrace:\n%.*s", ALLOCATION_INFO_BACKTRACE_STRING_SIZE - 1, address);
+// Heap allocator that owns block, NULL if it is not from a heap. Checks the heap of tag first.
+static dynamic_allocator_t* memory_heap_owner(const void* block, memory_tag_t tag) {
+    if (!state_ptr.allocator_initialized) {
+        return NULL;
+    }
+    dynamic_allocator_t* allocator = &state_ptr.heaps[memory_tag_heaps[tag]].allocator;
+    if (dynamic_allocator_owns(allocator, block)) {
+        return allocator;
+    }
+    for (u32 i = 0; i < MEMORY_HEAP_MAX; i++) {
+        if (dynamic_allocator_owns(&state_ptr.heaps[i].allocator, block)) {
+            return &state_ptr.heaps[i].allocator;
         }
     }
+    return NULL;
+}
 
-    if (allocation_count > 0) {
-        SWARN("FAILED TO FREE ALL ALLOCATIONS: %d REMAINING.", allocation_count);
+// Returns block to the allocator that owns it
+static void memory_free_block(void* block, memory_tag_t tag) {
+    dynamic_allocator_t* heap = NULL;
+    if (state_ptr.allocator_initialized && slab_allocator_owns(&state_ptr.small_allocator, block)) {
+        slab_allocator_free(&state_ptr.small_allocator, block);
+    } else if ((heap = memory_heap_owner(block, tag))) {
+        dynamic_allocator_free(heap, block);
+    } else {
+        platform_free(block, true);
     }
-#endif
+}
 
-    SDEBUG("Memory after shutdown: %s", get_memory_usage_string());
-    dynamic_allocator_destroy(&state_ptr.allocator);
+// Counts size against the budget of tag's heap, and reports when the heap goes over it
+SINLINE void memory_heap_track(memory_tag_t tag, u64 size, b8 allocated) {
+    memory_heap_state_t* heap = &state_ptr.heaps[memory_tag_heaps[tag]];
+    const u64 budget = __atomic_load_n(&heap->budget, __ATOMIC_RELAXED);
+    if (!budget) {
+        return;
+    }
+
+    if (!allocated) {
+        __atomic_fetch_sub(&heap->used_bytes, size, __ATOMIC_RELAXED);
+        return;
+    }
+    const u64 used_bytes = __atomic_add_fetch(&heap->used_bytes, size, __ATOMIC_RELAXED);
+    if (used_bytes > budget && used_bytes - size <= budget) {
+        __atomic_fetch_add(&heap->over_budget_count, 1, __ATOMIC_RELAXED);
+        SWARN("Memory heap %s went over its budget of %lu bytes, %lu bytes used after allocating %lu bytes of %.*s.",
+                memory_heap_names[memory_tag_heaps[tag]], budget, used_bytes, size, memory_tag_name_length(tag), memory_tag_strings[tag]);
+    }
+}
+
+SINLINE memory_thread_stats_t* memory_thread_stats() {
+    if (!thread_stats) {
+        const u32 slot = thread_slots_acquire(&stats.thread_slots);
+        thread_stats = slot != INVALID_ID ? &stats.threads[slot] : &stats.shared;
+    }
+    return thread_stats;
+}
+
+SINLINE void memory_stats_add(memory_thread_stats_t* thread, u64* counter, u64 value) {
+    if (thread == &stats.shared) {
+        __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+    } else {
+        __atomic_store_n(counter, *counter + value, __ATOMIC_RELAXED);
+    }
+}
+
+SINLINE void memory_track_allocation(u64 size, memory_tag_t tag) {
+    memory_thread_stats_t* thread = memory_thread_stats();
+    memory_stats_add(thread, &thread->allocation_count[tag], 1);
+
+    memory_tag_bytes_t* bytes = &stats.bytes[tag];
+    const u64 current = __atomic_add_fetch(&bytes->current, size, __ATOMIC_RELAXED);
+    u64 peak = __atomic_load_n(&bytes->peak, __ATOMIC_RELAXED);
+    while (current > peak && !__atomic_compare_exchange_n(&bytes->peak, &peak, current, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+SINLINE void memory_track_free(u64 size, memory_tag_t tag) {
+    memory_thread_stats_t* thread = memory_thread_stats();
+    memory_stats_add(thread, &thread->free_count[tag], 1);
+    __atomic_fetch_sub(&stats.bytes[tag].current, size, __ATOMIC_RELAXED);
+}
+
+SINLINE u64 memory_tag_current_bytes(memory_tag_t tag) {
+    return __atomic_load_n(&stats.bytes[tag].current, __ATOMIC_RELAXED);
+}
+
+// Sums counter over all threads
+static u64 memory_stats_sum(u64 offset) {
+    const u32 thread_count = thread_slots_high_water(&stats.thread_slots);
+    u64 sum = __atomic_load_n((u64*)((void*)&stats.shared + offset), __ATOMIC_RELAXED);
+    for (u32 i = 0; i < thread_count; i++) {
+        sum += __atomic_load_n((u64*)((void*)&stats.threads[i] + offset), __ATOMIC_RELAXED);
+    }
+    return sum;
 }
 
+#define MEMORY_STATS_SUM(field, tag) memory_stats_sum(offsetof(memory_thread_stats_t, field) + sizeof(u64) * (tag))
+
 /**
  * @brief Allocates [size] bytes of memory to type [tag] and tracks the number of bytes used.
  *
@@ -149,12 +356,14 @@ pvt_sallocate(u64 size, memory_tag_t tag) {
         SWARN("Allocating %lu bytes to undefined memory tag.", size);
     }
 
-    state_ptr.stats.total_allocated += size;
-    state_ptr.stats.tagged_allocations[tag] += size;
+    memory_track_allocation(size, tag);
+    memory_heap_track(tag, size, true);
 
-    void* block = platform_allocate(size, true);
+    void* block = memory_allocate_block(size, tag);
     platform_zero_memory(block, size);
-    // void* block = dynamic_allocator_allocate(&state_ptr.allocator, size);
+    if (allocation_trace_active) {
+        allocation_trace_record(ALLOCATION_TRACE_ALLOCATE, block, size, tag);
+    }
     return block;
 }
 
@@ -171,15 +380,68 @@ pvt_spark_free(const void* block, u64 size, memory_tag_t tag) {
         SWARN("De-allocating %lu bytes to undefined memory tag.", size);
     }
 
-    if (state_ptr.stats.tagged_allocations[tag] - size > state_ptr.stats.tagged_allocations[tag]) {
-        SCRITICAL("Underflowed a memory allocation tag by freeing %lu bytes. Before %lu, After %lu - Failed to free the correct type of memory '%s'", size, state_ptr.stats.tagged_allocations[tag], state_ptr.stats.tagged_allocations[tag] - size, memory_tag_strings[tag]);
-    } 
+#ifdef SPARK_DEBUG
+    const u64 tag_bytes = memory_tag_current_bytes(tag);
+    if (tag_bytes - size > tag_bytes) {
+        SCRITICAL("Underflowed a memory allocation tag by freeing %lu bytes. Before %lu, After %lu - Failed to free the correct type of memory '%s'", size, tag_bytes, tag_bytes - size, memory_tag_strings[tag]);
+    }
+#endif
+
+    memory_track_free(size, tag);
+    memory_heap_track(tag, size, false);
+    if (allocation_trace_active) {
+        allocation_trace_record(ALLOCATION_TRACE_FREE, block, size, tag);
+    }
+
+    memory_free_block((void*)block, tag);
+}
+
+/**
+ * @brief Resizes [block] from old_size to new_size bytes, keeping its contents. Bytes past old_size are zeroed.
+ * The block is grown in place when the memory after it is free, otherwise it is moved.
+ *
+ * @param block Block to resize, NULL allocates a new block
+ * @param old_size Number of bytes that [block] contains. This is used for memory tracking
+ * @param new_size Number of bytes the block should contain
+ * @param tag Type of memory of the block
+ */
+void*
+pvt_sreallocate(void* block, u64 old_size, u64 new_size, memory_tag_t tag) {
+    if (!block) {
+        return pvt_sallocate(new_size, tag);
+    }
+
+    memory_track_free(old_size, tag);
+    memory_track_allocation(new_size, tag);
+    memory_heap_track(tag, old_size, false);
+    memory_heap_track(tag, new_size, true);
+
+    void* new_block = NULL;
+    dynamic_allocator_t* heap = NULL;
+    if (state_ptr.allocator_initialized && slab_allocator_owns(&state_ptr.small_allocator, block)) {
+        // Slab blocks have a fixed size, they can only be kept if the new size still fits
+        if (new_size <= slab_allocator_block_size(block)) {
+            new_block = block;
+        }
+    } else if ((heap = memory_heap_owner(block, tag))) {
+        if (new_size > SLAB_ALLOCATOR_MAX_SIZE && new_size <= MEMORY_PLATFORM_ALLOCATION_THRESHOLD) {
+            new_block = dynamic_allocator_reallocate(heap, block, new_size);
+        }
+    }
 
-    state_ptr.stats.total_allocated -= size;
-    state_ptr.stats.tagged_allocations[tag] -= size;
+    if (!new_block) {
+        new_block = memory_allocate_block(new_size, tag);
+        platform_copy_memory(new_block, block, smin(old_size, new_size));
+        memory_free_block(block, tag);
+    }
 
-    // dynamic_allocator_free(&state_ptr.allocator, (void*)block);
-    platform_free((void*)block, true);
+    if (new_size > old_size) {
+        platform_zero_memory(new_block + old_size, new_size - old_size);
+    }
+    if (allocation_trace_active) {
+        allocation_trace_record_reallocate(block, old_size, new_block, new_size, tag);
+    }
+    return new_block;
 }
 
 /**
@@ -217,6 +479,16 @@ scopy_memory(void* dest, const void* src, u64 size) {
     return platform_copy_memory(dest, src, size);
 }
 
+/**
+ * @brief Compares size bytes of a and b
+ *
+ * @return true if all bytes are equal
+ */
+b8 
+scompare_memory(const void* a, const void* b, u64 size) {
+    return memcmp(a, b, size) == 0;
+}
+
 void copy_memory_usage_string(const char* buffer, const char* tag_string, u64 size, u64* offset) {
     const u64 kib = 1024;
     const u64 mib = 1024 * 1024;
@@ -258,10 +530,10 @@ char* get_memory_usage_string() {
 
     strcpy(memory_usage_string, "System memory use (tagged):\n");
     u64 offset = strlen(memory_usage_string);
-    copy_memory_usage_string(memory_usage_string, "TOTAL              ", state_ptr.stats.total_allocated, &offset);
+    copy_memory_usage_string(memory_usage_string, "TOTAL              ", memory_get_total_allocated(), &offset);
 
     for (int i = 0; i < MEMORY_TAG_MAX; i++) {
-        u64 size = state_ptr.stats.tagged_allocations[i];
+        u64 size = memory_tag_current_bytes(i);
         copy_memory_usage_string(memory_usage_string, memory_tag_strings[i], size, &offset);
     }
 
@@ -271,87 +543,335 @@ char* get_memory_usage_string() {
 }
 
 u64 get_memory_alloc_count() {
-    return state_ptr.alloc_count;
+    u64 count = 0;
+    for (u32 i = 0; i < MEMORY_TAG_MAX; i++) {
+        count += MEMORY_STATS_SUM(allocation_count, i);
+    }
+    return count;
+}
+
+void memory_get_tag_stats(memory_tag_t tag, memory_tag_stats_t* out_stats) {
+    out_stats->current_bytes = memory_tag_current_bytes(tag);
+    out_stats->peak_bytes = __atomic_load_n(&stats.bytes[tag].peak, __ATOMIC_RELAXED);
+    out_stats->allocation_count = MEMORY_STATS_SUM(allocation_count, tag);
+    out_stats->free_count = MEMORY_STATS_SUM(free_count, tag);
+    out_stats->frame_allocation_count = stats.frame_allocation_count[tag];
+    out_stats->frame_free_count = stats.frame_free_count[tag];
+}
+
+u64 memory_get_total_allocated() {
+    u64 total = 0;
+    for (u32 i = 0; i < MEMORY_TAG_MAX; i++) {
+        total += memory_tag_current_bytes(i);
+    }
+    return total;
+}
+
+static void memory_stats_write_dump() {
+    char line[512];
+    u64 written = 0;
+    if (stats.dump_format == MEMORY_STATS_FORMAT_JSON) {
+        snprintf(line, sizeof(line), "{\"frame\": %lu, \"tags\": {", stats.frame_index);
+        filesystem_write(&stats.dump_file, strlen(line), line, &written);
+    }
+
+    for (u32 i = 0; i < MEMORY_TAG_MAX; i++) {
+        memory_tag_stats_t tag_stats;
+        memory_get_tag_stats(i, &tag_stats);
+
+        if (stats.dump_format == MEMORY_STATS_FORMAT_JSON) {
+            snprintf(line, sizeof(line),
+                    "%s\"%.*s\": {\"current_bytes\": %lu, \"peak_bytes\": %lu, \"frame_allocations\": %lu, \"frame_frees\": %lu, \"allocations\": %lu, \"frees\": %lu}",
+                    i == 0 ? "" : ", ", memory_tag_name_length(i), memory_tag_strings[i],
+                    tag_stats.current_bytes, tag_stats.peak_bytes, tag_stats.frame_allocation_count, tag_stats.frame_free_count,
+                    tag_stats.allocation_count, tag_stats.free_count);
+            filesystem_write(&stats.dump_file, strlen(line), line, &written);
+        } else {
+            snprintf(line, sizeof(line), "%lu,%.*s,%lu,%lu,%lu,%lu,%lu,%lu",
+                    stats.frame_index, memory_tag_name_length(i), memory_tag_strings[i],
+                    tag_stats.current_bytes, tag_stats.peak_bytes, tag_stats.frame_allocation_count, tag_stats.frame_free_count,
+                    tag_stats.allocation_count, tag_stats.free_count);
+            filesystem_write_line(&stats.dump_file, line);
+        }
+    }
+
+    if (stats.dump_format == MEMORY_STATS_FORMAT_JSON) {
+        filesystem_write_line(&stats.dump_file, "}}");
+    }
+}
+
+void memory_stats_end_frame() {
+    for (u32 i = 0; i < MEMORY_TAG_MAX; i++) {
+        const u64 allocation_count = MEMORY_STATS_SUM(allocation_count, i);
+        const u64 free_count = MEMORY_STATS_SUM(free_count, i);
+        stats.frame_allocation_count[i] = allocation_count - stats.frame_start_allocation_count[i];
+        stats.frame_free_count[i] = free_count - stats.frame_start_free_count[i];
+        stats.frame_start_allocation_count[i] = allocation_count;
+        stats.frame_start_free_count[i] = free_count;
+    }
+
+    if (stats.dump_file.is_valid && stats.frame_index % stats.dump_interval == 0) {
+        memory_stats_write_dump();
+    }
+    stats.frame_index++;
+}
+
+b8 memory_stats_start_dump(const char* path, memory_stats_format_t format, u32 frame_interval) {
+    memory_stats_stop_dump();
+    if (!filesystem_open(path, FILE_MODE_WRITE, false, &stats.dump_file)) {
+        SERROR("Failed to open memory stats dump '%s'.", path);
+        return false;
+    }
+
+    stats.dump_format = format;
+    stats.dump_interval = smax(frame_interval, 1);
+    if (format == MEMORY_STATS_FORMAT_CSV) {
+        filesystem_write_line(&stats.dump_file, "frame,tag,current_bytes,peak_bytes,frame_allocations,frame_frees,allocations,frees");
+    }
+    return true;
+}
+
+void memory_stats_stop_dump() {
+    if (stats.dump_file.is_valid) {
+        filesystem_close(&stats.dump_file);
+    }
+}
+
+memory_heap_t memory_tag_heap(memory_tag_t tag) {
+    return memory_tag_heaps[tag];
+}
+
+SINLINE u64 memory_heap_sum_bytes(memory_heap_t heap) {
+    u64 used_bytes = 0;
+    for (u32 i = 0; i < MEMORY_TAG_MAX; i++) {
+        if (memory_tag_heaps[i] == heap) {
+            used_bytes += memory_tag_current_bytes(i);
+        }
+    }
+    return used_bytes;
+}
+
+void memory_heap_set_budget(memory_heap_t heap, u64 budget) {
+    memory_heap_state_t* state = &state_ptr.heaps[heap];
+    // Allocations are not counted without a budget, start from the tag statistics
+    __atomic_store_n(&state->used_bytes, memory_heap_sum_bytes(heap), __ATOMIC_RELAXED);
+    __atomic_store_n(&state->budget, budget, __ATOMIC_RELAXED);
+}
+
+void memory_heap_get_stats(memory_heap_t heap, memory_heap_stats_t* out_stats) {
+    out_stats->used_bytes = memory_heap_sum_bytes(heap);
+    out_stats->budget = __atomic_load_n(&state_ptr.heaps[heap].budget, __ATOMIC_RELAXED);
+    out_stats->over_budget_count = __atomic_load_n(&state_ptr.heaps[heap].over_budget_count, __ATOMIC_RELAXED);
 }
 
 #ifdef SPARK_DEBUG 
 
-void addr2line(const char *ptr, const char *elf_name, char* output, u32 output_buffer_size) {
-#if _POSIX_C_SOURCE >= 2
-    static char addr2line_str[1024] = {0};
-    sprintf(addr2line_str, "addr2line %s -e %s", ptr, elf_name);
-    FILE* handle = popen(addr2line_str, "r");
+SINLINE void allocation_tracking_lock() {
+    spin_lock(&tracking.lock);
+}
 
-    fgets(output, output_buffer_size, handle);
-#else
-    string_ncopy(output, ptr, output_buffer_size);
-#endif
+SINLINE void allocation_tracking_unlock() {
+    spin_unlock(&tracking.lock);
 }
 
-void* 
-create_tracked_allocation(u64 size, memory_tag_t tag, const char* file, u32 line) {
-    void* block = pvt_sallocate(size + sizeof(allocation_info_t) + alloc_info_padding, tag);
-    allocation_info_t* info = block;
-
-    const b8 track_callstack = false;
-    if (track_callstack) {
-        // Get backtrace string
-        const u32 buffer_size = 100;
-        void* buffer[100];
-        char** backtrace_strings;
-        u32 backtrace_count = backtrace(buffer, buffer_size);
-        backtrace_strings = backtrace_symbols(buffer, backtrace_count);
-        if (backtrace_strings == NULL) {
-            SERROR("backtrace_symbols failed to get symbols");
+SINLINE u32 allocation_tracking_slot(const void* block, u32 capacity) {
+    return (((u64)block >> 4) * 0x9E3779B97F4A7C15ull) >> 32 & (capacity - 1);
+}
+
+static void allocation_tracking_insert(const allocation_info_t* info);
+
+static void allocation_tracking_grow() {
+    allocation_info_t* old_entries = tracking.entries;
+    const u32 old_capacity = tracking.capacity;
+
+    tracking.capacity = old_capacity ? old_capacity * 2 : ALLOCATION_TRACKING_INITIAL_CAPACITY;
+    tracking.entries = platform_allocate(sizeof(allocation_info_t) * tracking.capacity, false);
+    platform_zero_memory(tracking.entries, sizeof(allocation_info_t) * tracking.capacity);
+    tracking.count = 0;
+
+    for (u32 i = 0; i < old_capacity; i++) {
+        if (old_entries[i].block) {
+            allocation_tracking_insert(&old_entries[i]);
         }
+    }
+    if (old_entries) {
+        platform_free(old_entries, false);
+    }
+}
+
+static void allocation_tracking_insert(const allocation_info_t* info) {
+    // Keep the load under one half so probe sequences stay short
+    if ((tracking.count + 1) * 2 > tracking.capacity) {
+        allocation_tracking_grow();
+    }
+
+    u32 slot = allocation_tracking_slot(info->block, tracking.capacity);
+    while (tracking.entries[slot].block) {
+        slot = (slot + 1) & (tracking.capacity - 1);
+    }
+    tracking.entries[slot] = *info;
+    tracking.count++;
+}
+
+static allocation_info_t* allocation_tracking_find(const void* block) {
+    if (!tracking.entries) {
+        return NULL;
+    }
 
-        szero_memory(info->backtrace, ALLOCATION_INFO_BACKTRACE_STRING_SIZE);
-        for (u32 i = 0; i < backtrace_count; i++) {
-            string_nconcat(info->backtrace, backtrace_strings[i], ALLOCATION_INFO_BACKTRACE_STRING_SIZE - 1);
-            string_nconcat(info->backtrace, "\n", ALLOCATION_INFO_BACKTRACE_STRING_SIZE - 1);
+    u32 slot = allocation_tracking_slot(block, tracking.capacity);
+    while (tracking.entries[slot].block) {
+        if (tracking.entries[slot].block == block) {
+            return &tracking.entries[slot];
         }
-        free(backtrace_strings);
+        slot = (slot + 1) & (tracking.capacity - 1);
     }
+    return NULL;
+}
 
-    info->file = file;
-    info->line = line;
-    info->tag = tag;
-    info->size = size;
-    info->allocation_index = allocation_count;
+// Empties the slot of info and moves later entries of its probe sequence back, so lookups never need tombstones
+static void allocation_tracking_remove(allocation_info_t* info) {
+    const u32 mask = tracking.capacity - 1;
+    u32 hole = info - tracking.entries;
+    u32 slot = hole;
+    for (;;) {
+        slot = (slot + 1) & mask;
+        if (!tracking.entries[slot].block) {
+            break;
+        }
+        // The entry can fill the hole if its home slot is not between the hole and its current slot
+        const u32 home = allocation_tracking_slot(tracking.entries[slot].block, tracking.capacity);
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            tracking.entries[hole] = tracking.entries[slot];
+            hole = slot;
+        }
+    }
+    tracking.entries[hole].block = NULL;
+    tracking.count--;
+}
 
-    if (tracked_allocations) {
-        // Ensure that the darray doesnt try to allocate itself in an infinite loop by managing it here
-        if (allocation_count >= allocation_capacity) {
-            allocation_info_t** old_allocations = tracked_allocations;
-            tracked_allocations = platform_allocate(allocation_capacity * 2 * sizeof(allocation_info_t), true);
+void memory_tracking_set_backtrace_sample_rate(u32 sample_rate) {
+    __atomic_store_n(&tracking.backtrace_sample_rate, sample_rate, __ATOMIC_RELAXED);
+}
 
-            scopy_memory(tracked_allocations, old_allocations, allocation_count * sizeof(allocation_info_t));
-            platform_free(old_allocations, true);
-            allocation_capacity *= 2;
+void memory_tracking_report() {
+    allocation_tracking_lock();
+    for (u32 i = 0; i < tracking.capacity; i++) {
+        const allocation_info_t* info = &tracking.entries[i];
+        if (!info->block) {
+            continue;
         }
 
-        tracked_allocations[allocation_count++] = info;
+        SWARN("Leaked %lu bytes of %.*s at %s:%d", info->size, memory_tag_name_length(info->tag), memory_tag_strings[info->tag], info->file, info->line);
+        if (info->backtrace) {
+            char** symbols = backtrace_symbols(info->backtrace, info->backtrace_count);
+            for (u32 frame = 0; symbols && frame < info->backtrace_count; frame++) {
+                SWARN("\t%s", symbols[frame]);
+            }
+            free(symbols);
+        }
     }
 
+    if (tracking.count > 0) {
+        SWARN("FAILED TO FREE ALL ALLOCATIONS: %d REMAINING.", tracking.count);
+    }
+    allocation_tracking_unlock();
+}
 
-    return block + sizeof(allocation_info_t) + alloc_info_padding;
+void* 
+create_tracked_allocation(u64 size, memory_tag_t tag, const char* file, u32 line) {
+    void* block = pvt_sallocate(size, tag);
+    allocation_info_t info = {
+        .block = block,
+        .file = file,
+        .line = line,
+        .size = size,
+        .tag = tag,
+    };
+
+    const u32 sample_rate = __atomic_load_n(&tracking.backtrace_sample_rate, __ATOMIC_RELAXED);
+    if (sample_rate && __atomic_fetch_add(&tracking.sample_counter, 1, __ATOMIC_RELAXED) % sample_rate == 0) {
+        // Skip this function's own frame
+        void* frames[ALLOCATION_TRACKING_BACKTRACE_DEPTH + 1];
+        const s32 frame_count = backtrace(frames, ALLOCATION_TRACKING_BACKTRACE_DEPTH + 1) - 1;
+        if (frame_count > 0) {
+            info.backtrace = platform_allocate(sizeof(void*) * frame_count, false);
+            platform_copy_memory(info.backtrace, frames + 1, sizeof(void*) * frame_count);
+            info.backtrace_count = frame_count;
+        }
+    }
+
+    allocation_tracking_lock();
+    allocation_tracking_insert(&info);
+    allocation_tracking_unlock();
+    return block;
+}
+
+void*
+reallocate_tracked_allocation(void* block, u64 old_size, u64 new_size, memory_tag_t tag, const char* file, u32 line) {
+    if (!block) {
+        return create_tracked_allocation(new_size, tag, file, line);
+    }
+
+    // The record is taken out before the block is handed over. Once the block is freed another thread may allocate
+    // the same address and insert its own record, which must not be mistaken for this one.
+    allocation_tracking_lock();
+    allocation_info_t* info = allocation_tracking_find(block);
+    allocation_info_t moved = {};
+    const b8 tracked = info != NULL;
+    if (tracked) {
+        moved = *info;
+        allocation_tracking_remove(info);
+    }
+    allocation_tracking_unlock();
+
+    // Handing a block that was freed or never allocated to the allocators would corrupt them, leave it alone
+    if (!tracked) {
+        SERROR("Reallocating untracked block %p at %s:%d, it was already freed or not allocated with sallocate.", block, file, line);
+        return NULL;
+    }
+
+    void* new_block = pvt_sreallocate(block, old_size, new_size, tag);
+
+    // A failed reallocation keeps the original block, and with it the original record
+    if (new_block) {
+        moved.block = new_block;
+        moved.size = new_size;
+    }
+    allocation_tracking_lock();
+    allocation_tracking_insert(&moved);
+    allocation_tracking_unlock();
+    return new_block;
 }
 
 void 
-free_tracked_allocation(const void* block, u32 size, memory_tag_t tag) {
+free_tracked_allocation(const void* block, u64 size, memory_tag_t tag) {
     if (!block) {
         return;
     }
-    // Find the allocation by its block
-    block -= sizeof(allocation_info_t) + alloc_info_padding;
-    allocation_info_t* info = (void*)block;
 
-    for (u32 i = info->allocation_index; i < allocation_count - 1; i++) {
-        tracked_allocations[i] = tracked_allocations[i + 1];
-        tracked_allocations[i]->allocation_index--;
+    allocation_tracking_lock();
+    allocation_info_t* info = allocation_tracking_find(block);
+    void** backtrace = NULL;
+    if (info) {
+        if (info->size != size || info->tag != tag) {
+            SERROR("Freeing %p with %lu bytes of %.*s, allocated with %lu bytes of %.*s at %s:%d.",
+                    block, size, memory_tag_name_length(tag), memory_tag_strings[tag],
+                    info->size, memory_tag_name_length(info->tag), memory_tag_strings[info->tag], info->file, info->line);
+        }
+        backtrace = info->backtrace;
+        allocation_tracking_remove(info);
     }
-    allocation_count--;
+    allocation_tracking_unlock();
 
+    // A double free would corrupt the allocator's free lists, report it and keep the memory as it is
+    if (!info) {
+        SERROR("Freeing untracked block %p, it was already freed or not allocated with sallocate.", block);
+        return;
+    }
+
+    if (backtrace) {
+        platform_free(backtrace, false);
+    }
     pvt_spark_free(block, size, tag);
 }
 #endif
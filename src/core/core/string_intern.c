@@ -0,0 +1,180 @@
+#include "Spark/core/string_intern.h"
+#include "Spark/containers/unordered_map.h"
+#include "Spark/core/logging.h"
+#include "Spark/core/smemory.h"
+#include "Spark/core/sstring.h"
+#include "Spark/math/smath.h"
+#include <string.h>
+
+typedef struct string_intern_entry {
+    const char* string;
+    hash_t hash;
+    u32 length;
+} string_intern_entry_t;
+
+// The map owns no strings, its keys point at the entries' copies
+SINLINE hash_t string_intern_entry_hash(string_intern_entry_t entry) {
+    return entry.hash;
+}
+
+SINLINE b8 string_intern_entry_compare(string_intern_entry_t a, string_intern_entry_t b) {
+    return a.hash == b.hash && a.length == b.length && memcmp(a.string, b.string, a.length) == 0;
+}
+
+SINLINE string_intern_entry_t string_intern_entry_copy(string_intern_entry_t entry) {
+    return entry;
+}
+
+hashmap_type(string_intern_map, string_intern_entry_t, string_id);
+hashmap_impl(string_intern_map, string_intern_entry_t, string_id, string_intern_entry_hash, string_intern_entry_compare, string_intern_entry_copy);
+
+typedef struct string_intern_block {
+    struct string_intern_block* next;
+    u64 size;
+    u64 used;
+} string_intern_block_t;
+
+typedef struct string_intern_state {
+    string_intern_map_t ids;
+    // Entries are never moved once written, so readers can index them without the lock
+    string_intern_entry_t* pages[STRING_INTERN_MAX_PAGES];
+    // Most recent block first, strings are copied into the first one
+    string_intern_block_t* blocks;
+    u32 count;
+    b8 lock;
+    b8 initialized;
+} string_intern_state_t;
+
+static string_intern_state_t state;
+
+SINLINE void string_intern_lock() {
+    while (__atomic_test_and_set(&state.lock, __ATOMIC_ACQUIRE)) {
+    }
+}
+
+SINLINE void string_intern_unlock() {
+    __atomic_clear(&state.lock, __ATOMIC_RELEASE);
+}
+
+SINLINE const string_intern_entry_t* string_intern_entry(string_id id) {
+    SASSERT(id < __atomic_load_n(&state.count, __ATOMIC_ACQUIRE), "Invalid string id %u.", id);
+    return &state.pages[id / STRING_INTERN_ENTRIES_PER_PAGE][id % STRING_INTERN_ENTRIES_PER_PAGE];
+}
+
+void string_intern_initialize() {
+    if (state.initialized) {
+        return;
+    }
+    string_intern_map_create(1024, &state.ids);
+    state.initialized = true;
+}
+
+void string_intern_shutdown() {
+    if (!state.initialized) {
+        return;
+    }
+    string_intern_map_destroy(&state.ids);
+    for (u32 i = 0; i < STRING_INTERN_MAX_PAGES && state.pages[i]; i++) {
+        sfree(state.pages[i], sizeof(string_intern_entry_t) * STRING_INTERN_ENTRIES_PER_PAGE, MEMORY_TAG_STRING);
+    }
+    string_intern_block_t* block = state.blocks;
+    while (block) {
+        string_intern_block_t* next = block->next;
+        sfree(block, block->size, MEMORY_TAG_STRING);
+        block = next;
+    }
+    state = (string_intern_state_t) {};
+}
+
+// Copies length bytes of string and a null terminator into the intern blocks
+static const char* string_intern_store(const char* string, u32 length) {
+    const u64 size = length + 1;
+    string_intern_block_t* block = state.blocks;
+    if (!block || block->used + size > block->size) {
+        const u64 block_size = smax(STRING_INTERN_BLOCK_SIZE, sizeof(string_intern_block_t) + size);
+        string_intern_block_t* new_block = sallocate(block_size, MEMORY_TAG_STRING);
+        new_block->size = block_size;
+        new_block->used = sizeof(string_intern_block_t);
+        // Keep filling the current block if the new one only holds this string
+        if (block && block_size > STRING_INTERN_BLOCK_SIZE) {
+            new_block->next = block->next;
+            block->next = new_block;
+        } else {
+            new_block->next = block;
+            state.blocks = new_block;
+        }
+        block = new_block;
+    }
+
+    char* copy = (char*)block + block->used;
+    scopy_memory(copy, string, length);
+    copy[length] = 0;
+    block->used += size;
+    return copy;
+}
+
+string_id string_intern_n(const char* string, u32 length) {
+    SASSERT(state.initialized, "String intern table is not initialized.");
+    const string_intern_entry_t key = {
+        .string = string,
+        .hash = hash_bytes(string, length),
+        .length = length,
+    };
+
+    string_intern_lock();
+    string_id id = STRING_ID_INVALID;
+    if (string_intern_map_try_get(&state.ids, key, &id)) {
+        string_intern_unlock();
+        return id;
+    }
+
+    id = state.count;
+    const u32 page = id / STRING_INTERN_ENTRIES_PER_PAGE;
+    SASSERT(page < STRING_INTERN_MAX_PAGES, "String intern table is full, %u strings are interned.", id);
+    if (!state.pages[page]) {
+        state.pages[page] = sallocate(sizeof(string_intern_entry_t) * STRING_INTERN_ENTRIES_PER_PAGE, MEMORY_TAG_STRING);
+    }
+
+    string_intern_entry_t* entry = &state.pages[page][id % STRING_INTERN_ENTRIES_PER_PAGE];
+    *entry = key;
+    entry->string = string_intern_store(string, length);
+    string_intern_map_insert(&state.ids, *entry, id);
+    __atomic_store_n(&state.count, id + 1, __ATOMIC_RELEASE);
+    string_intern_unlock();
+    return id;
+}
+
+string_id string_intern(const char* string) {
+    return string_intern_n(string, string_length(string));
+}
+
+string_id string_intern_find(const char* string) {
+    const u32 length = string_length(string);
+    const string_intern_entry_t key = {
+        .string = string,
+        .hash = hash_bytes(string, length),
+        .length = length,
+    };
+
+    string_intern_lock();
+    string_id id = STRING_ID_INVALID;
+    string_intern_map_try_get(&state.ids, key, &id);
+    string_intern_unlock();
+    return id;
+}
+
+const char* string_intern_get(string_id id) {
+    return string_intern_entry(id)->string;
+}
+
+hash_t string_intern_hash(string_id id) {
+    return string_intern_entry(id)->hash;
+}
+
+u32 string_intern_length(string_id id) {
+    return string_intern_entry(id)->length;
+}
+
+u32 string_intern_count() {
+    return __atomic_load_n(&state.count, __ATOMIC_ACQUIRE);
+}
@@ -29,16 +29,10 @@ void ecs_component_column_resize(ecs_column_t* column, u32 size) {
     if (size > column->capacity) {
         SASSERT(column->component_stride > 0, "Resizing component column with component size of 0 is not allowed.");
         SASSERT(column->count >= 0 && column->count != INVALID_ID_U64, "Cannot resize column with negative number of elements: %d", column->count);
-        void* temp = sallocate(column->component_stride * size, MEMORY_TAG_ECS);
+        column->data = sreallocate(column->data, column->capacity * column->component_stride, column->component_stride * size, MEMORY_TAG_ECS);
 
-        // Zero out new memory
-        sset_memory(temp + column->count * column->component_stride, 0, (size - column->count) * column->component_stride);
-
-        // Copy old memory
-        scopy_memory(temp, column->data, column->count * column->component_stride);
-        sfree(column->data, column->capacity * column->component_stride, MEMORY_TAG_ECS);
-
-        column->data = temp;
+        // Zero out unused rows, memory past the old capacity is already zeroed
+        sset_memory(column->data + column->count * column->component_stride, 0, (column->capacity - column->count) * column->component_stride);
         column->capacity = size;
     }
 }
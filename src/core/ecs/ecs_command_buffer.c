@@ -0,0 +1,125 @@
+#include "Spark/ecs/ecs_command_buffer.h"
+#include "Spark/core/smemory.h"
+#include "Spark/ecs/ecs.h"
+#include "Spark/ecs/ecs_world.h"
+#include "Spark/math/mat4.h"
+#include "Spark/math/smath.h"
+#include "Spark/threading/mutex.h"
+#include "Spark/types/transforms.h"
+
+#define ECS_COMMAND_BUFFER_INITIAL_DATA_SIZE 1024
+
+darray_impl(ecs_command_t, ecs_command);
+
+void ecs_command_buffer_create(u32 initial_command_count, ecs_command_buffer_t* out_buffer) {
+    darray_ecs_command_create(smax(initial_command_count, 1), &out_buffer->commands);
+    darray_u8_create(ECS_COMMAND_BUFFER_INITIAL_DATA_SIZE, &out_buffer->data);
+    out_buffer->next_entity = 0;
+    out_buffer->end_entity = 0;
+}
+
+void ecs_command_buffer_destroy(ecs_command_buffer_t* buffer) {
+    if (buffer->commands.count > 0) {
+        SWARN("Destroying ecs command buffer with %d uncommitted commands.", buffer->commands.count);
+    }
+    darray_ecs_command_destroy(&buffer->commands);
+    darray_u8_destroy(&buffer->data);
+}
+
+void ecs_command_buffer_clear(ecs_command_buffer_t* buffer) {
+    darray_ecs_command_clear(&buffer->commands);
+    darray_u8_clear(&buffer->data);
+}
+
+entity_t ecs_command_buffer_create_entity(ecs_command_buffer_t* buffer, struct ecs_world* world) {
+    // Reserve ids in batches so worker threads rarely touch the shared counter
+    if (buffer->next_entity >= buffer->end_entity) {
+        buffer->next_entity = ecs_world_reserve_entities(world, ECS_COMMAND_BUFFER_ENTITY_RESERVE_COUNT);
+        buffer->end_entity = buffer->next_entity + ECS_COMMAND_BUFFER_ENTITY_RESERVE_COUNT;
+    }
+
+    entity_t entity = buffer->next_entity++;
+    ecs_command_t command = {
+        .type = ECS_COMMAND_CREATE_ENTITY,
+        .entity = entity,
+    };
+    darray_ecs_command_push(&buffer->commands, command);
+    return entity;
+}
+
+void ecs_command_buffer_set_component(ecs_command_buffer_t* buffer, entity_t entity, ecs_component_id component, const void* data, u32 size) {
+    ecs_command_t command = {
+        .type = ECS_COMMAND_SET_COMPONENT,
+        .entity = entity,
+        .component = component,
+        .data_offset = buffer->data.count,
+        .data_size = size,
+    };
+
+    // Grow geometrically, push_range does not resize
+    if (buffer->data.count + size > buffer->data.capacity) {
+        darray_u8_reserve(&buffer->data, smax(buffer->data.capacity * 2, buffer->data.count + size));
+    }
+    darray_u8_push_range(&buffer->data, size, data);
+    darray_ecs_command_push(&buffer->commands, command);
+}
+
+void ecs_command_buffer_add_child(ecs_command_buffer_t* buffer, entity_t parent, entity_t child) {
+    ecs_command_t command = {
+        .type = ECS_COMMAND_ADD_CHILD,
+        .entity = child,
+        .parent = parent,
+    };
+    darray_ecs_command_push(&buffer->commands, command);
+}
+
+void ecs_command_buffer_add_transforms(ecs_command_buffer_t* buffer, entity_t entity, vec3 position, vec3 scale, quat rotation) {
+    ECS_COMMAND_SET_COMPONENT(buffer, entity, translation_t, { .value = position });
+    ECS_COMMAND_SET_COMPONENT(buffer, entity, scale_t, { .value = scale });
+    ECS_COMMAND_SET_COMPONENT(buffer, entity, rotation_t, { .value = rotation });
+    ECS_COMMAND_SET_COMPONENT(buffer, entity, local_to_world_t, { mat4_translation(position) });
+    ECS_COMMAND_SET_COMPONENT(buffer, entity, dirty_transform_t, { true });
+}
+
+void ecs_command_buffer_submit(ecs_command_buffer_t* buffer, struct ecs_world* world) {
+    if (buffer->commands.count == 0) {
+        return;
+    }
+
+    mutex_lock(world->staging_mutex);
+    ecs_command_buffer_t* staged = &world->staged_commands;
+
+    darray_ecs_command_reserve(&staged->commands, smax(staged->commands.capacity, staged->commands.count + buffer->commands.count));
+    darray_u8_reserve(&staged->data, smax(staged->data.capacity, staged->data.count + buffer->data.count));
+
+    // Data offsets are relative to the owning buffer
+    const u32 data_offset = staged->data.count;
+    for (u32 i = 0; i < buffer->commands.count; i++) {
+        ecs_command_t command = buffer->commands.data[i];
+        command.data_offset += data_offset;
+        darray_ecs_command_push(&staged->commands, command);
+    }
+    darray_u8_push_range(&staged->data, buffer->data.count, buffer->data.data);
+    mutex_unlock(world->staging_mutex);
+
+    ecs_command_buffer_clear(buffer);
+}
+
+void ecs_command_buffer_commit(ecs_command_buffer_t* buffer, struct ecs_world* world) {
+    for (u32 i = 0; i < buffer->commands.count; i++) {
+        const ecs_command_t* command = &buffer->commands.data[i];
+        switch (command->type) {
+            case ECS_COMMAND_CREATE_ENTITY:
+                entity_create_reserved(world, command->entity);
+                break;
+            case ECS_COMMAND_SET_COMPONENT:
+                entity_set_component(world, command->entity, command->component, buffer->data.data + command->data_offset, command->data_size);
+                break;
+            case ECS_COMMAND_ADD_CHILD:
+                entity_add_child(world, command->parent, command->entity);
+                break;
+        }
+    }
+
+    ecs_command_buffer_clear(buffer);
+}
@@ -0,0 +1,173 @@
+#include "Spark/core/smemory.h"
+#include "Spark/ecs/ecs.h"
+#include "Spark/math/smath.h"
+#include "Spark/utils/hashing.h"
+
+#define ECS_COMPONENT_INDEX_INITIAL_BUCKET_COUNT 16
+#define ECS_COMPONENT_INDEX_INITIAL_BUCKET_SIZE 4
+#define ECS_COMPONENT_INDEX_INITIAL_SLOT_COUNT 128
+
+darray_impl(ecs_index_slot_t, ecs_index_slot);
+darray_impl(ecs_index_bucket_t, ecs_index_bucket);
+hashmap_impl(ecs_index_bucket_map, u64, u32, hash_passthrough, u64_compare, hash_passthrough);
+
+void ecs_component_index_create(u32 stride, ecs_component_key_function key_function, ecs_component_index_t* out_index) {
+    out_index->key_function = key_function;
+    out_index->stride = stride;
+    ecs_index_bucket_map_create(ECS_COMPONENT_INDEX_BUCKET_MAP_CAPACITY, &out_index->first_buckets);
+    darray_ecs_index_bucket_create(ECS_COMPONENT_INDEX_INITIAL_BUCKET_COUNT, &out_index->buckets);
+    darray_u8_create(key_function ? 1 : ECS_COMPONENT_INDEX_INITIAL_BUCKET_COUNT * stride, &out_index->values);
+    darray_u32_create(ECS_COMPONENT_INDEX_INITIAL_BUCKET_COUNT, &out_index->free_buckets);
+    darray_ecs_index_slot_create(ECS_COMPONENT_INDEX_INITIAL_SLOT_COUNT, &out_index->slots);
+}
+
+void ecs_component_index_destroy(ecs_component_index_t* index) {
+    for (u32 i = 0; i < index->buckets.count; i++) {
+        // Freed buckets already destroyed their entities
+        if (index->buckets.data[i].entities.data) {
+            darray_entity_destroy(&index->buckets.data[i].entities);
+        }
+    }
+    darray_ecs_index_bucket_destroy(&index->buckets);
+    darray_u8_destroy(&index->values);
+    darray_u32_destroy(&index->free_buckets);
+    darray_ecs_index_slot_destroy(&index->slots);
+    ecs_index_bucket_map_destroy(&index->first_buckets);
+}
+
+u64 ecs_component_index_key(const ecs_component_index_t* index, const void* component) {
+    if (index->key_function) {
+        return index->key_function(component);
+    }
+    return hash_bytes(component, index->stride);
+}
+
+// Bucket of the component's value, INVALID_ID if there is none
+static u32 ecs_component_index_find_bucket(const ecs_component_index_t* index, u64 key, const void* component) {
+    u32 bucket = INVALID_ID;
+    if (!ecs_index_bucket_map_try_get(&index->first_buckets, key, &bucket) || index->key_function) {
+        return bucket;
+    }
+
+    // Values whose hashes collide share a key, only the bucket with the same bytes matches
+    while (bucket != INVALID_ID && !scompare_memory(index->values.data + (u64)bucket * index->stride, component, index->stride)) {
+        bucket = index->buckets.data[bucket].next;
+    }
+    return bucket;
+}
+
+// Adds an empty bucket for the component's value to the front of the key's chain
+static u32 ecs_component_index_add_bucket(ecs_component_index_t* index, u64 key, const void* component) {
+    u32 first = INVALID_ID;
+    ecs_index_bucket_map_try_get(&index->first_buckets, key, &first);
+
+    ecs_index_bucket_t new_bucket = {
+        .key = key,
+        .next = first,
+    };
+    darray_entity_create(ECS_COMPONENT_INDEX_INITIAL_BUCKET_SIZE, &new_bucket.entities);
+
+    u32 bucket;
+    if (index->free_buckets.count > 0) {
+        bucket = index->free_buckets.data[--index->free_buckets.count];
+        index->buckets.data[bucket] = new_bucket;
+    } else {
+        bucket = index->buckets.count;
+        darray_ecs_index_bucket_push(&index->buckets, new_bucket);
+        if (!index->key_function) {
+            const u32 values_size = index->buckets.count * index->stride;
+            darray_u8_reserve(&index->values, smax(values_size, index->values.capacity * 2));
+            index->values.count = values_size;
+        }
+    }
+    if (!index->key_function) {
+        scopy_memory(index->values.data + (u64)bucket * index->stride, component, index->stride);
+    }
+
+    ecs_index_bucket_map_insert(&index->first_buckets, key, bucket);
+    return bucket;
+}
+
+// Unlinks an empty bucket from its chain and keeps it for reuse
+static void ecs_component_index_free_bucket(ecs_component_index_t* index, u32 bucket) {
+    ecs_index_bucket_t* freed = &index->buckets.data[bucket];
+    u32 first = INVALID_ID;
+    ecs_index_bucket_map_try_get(&index->first_buckets, freed->key, &first);
+    if (first == bucket) {
+        if (freed->next == INVALID_ID) {
+            ecs_index_bucket_map_remove(&index->first_buckets, freed->key);
+        } else {
+            ecs_index_bucket_map_insert(&index->first_buckets, freed->key, freed->next);
+        }
+    } else {
+        u32 previous = first;
+        while (index->buckets.data[previous].next != bucket) {
+            previous = index->buckets.data[previous].next;
+        }
+        index->buckets.data[previous].next = freed->next;
+    }
+
+    darray_entity_destroy(&freed->entities);
+    freed->next = INVALID_ID;
+    darray_u32_push(&index->free_buckets, bucket);
+}
+
+void ecs_component_index_set(ecs_component_index_t* index, entity_t entity, const void* component) {
+    const u64 key = ecs_component_index_key(index, component);
+
+    // Grow slots to cover the entity
+    while (index->slots.count <= entity) {
+        darray_ecs_index_slot_push(&index->slots, (ecs_index_slot_t) { .bucket = INVALID_ID, .position = INVALID_ID });
+    }
+
+    u32 bucket = ecs_component_index_find_bucket(index, key, component);
+    ecs_index_slot_t* slot = &index->slots.data[entity];
+    if (bucket != INVALID_ID && slot->bucket == bucket) {
+        return;
+    }
+    if (slot->bucket != INVALID_ID) {
+        ecs_component_index_remove(index, entity);
+    }
+    // Created after the removal, which may free a bucket this can reuse
+    if (bucket == INVALID_ID) {
+        bucket = ecs_component_index_add_bucket(index, key, component);
+    }
+
+    darray_entity_t* entities = &index->buckets.data[bucket].entities;
+    slot->bucket = bucket;
+    slot->position = entities->count;
+    darray_entity_push(entities, entity);
+}
+
+void ecs_component_index_remove(ecs_component_index_t* index, entity_t entity) {
+    if (entity >= index->slots.count || index->slots.data[entity].bucket == INVALID_ID) {
+        return;
+    }
+
+    // Swap the last entity of the bucket into the removed entity's position
+    ecs_index_slot_t* slot = &index->slots.data[entity];
+    darray_entity_t* entities = &index->buckets.data[slot->bucket].entities;
+    entity_t last = entities->data[entities->count - 1];
+    entities->data[slot->position] = last;
+    index->slots.data[last].position = slot->position;
+    entities->count--;
+
+    if (entities->count == 0) {
+        ecs_component_index_free_bucket(index, slot->bucket);
+    }
+    slot->bucket = INVALID_ID;
+    slot->position = INVALID_ID;
+}
+
+const darray_entity_t* ecs_component_index_find(const ecs_component_index_t* index, u64 key) {
+    u32 bucket = INVALID_ID;
+    if (!ecs_index_bucket_map_try_get(&index->first_buckets, key, &bucket)) {
+        return NULL;
+    }
+    return &index->buckets.data[bucket].entities;
+}
+
+const darray_entity_t* ecs_component_index_find_value(const ecs_component_index_t* index, const void* component) {
+    const u32 bucket = ecs_component_index_find_bucket(index, ecs_component_index_key(index, component), component);
+    return bucket == INVALID_ID ? NULL : &index->buckets.data[bucket].entities;
+}
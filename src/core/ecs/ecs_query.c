@@ -1,37 +1,45 @@
 #include "Spark/containers/generic/darray_ints.h"
+#include "Spark/core/clock.h"
 #include "Spark/core/smemory.h"
 #include "Spark/ecs/ecs.h"
 #include "Spark/ecs/ecs_world.h"
 #include "Spark/ecs/entity.h"
+#include "Spark/math/smath.h"
+#include "Spark/utils/hashing.h"
 
 #define ECS_QUERY_INITIAL_CAPACITY 5
 darray_impl(ecs_query_t, ecs_query);
 
-// u32 __builtin_stdc_trailing_zeros(ecs_component_id component);
-s32 sort_components(void* a, void* b) {
-    return *(ecs_component_id*)a < *(ecs_component_id*)b;
+// Hash of both component lists. Components are hashed in order, the count keeps with and without components apart.
+static hash_t ecs_query_hash(const ecs_query_create_info_t* create_info) {
+    hash_t hash = hash_combine(hash_u32(create_info->component_count), create_info->without_component_count);
+    for (u32 i = 0; i < create_info->component_count; i++) {
+        hash = hash_combine(hash, create_info->components[i]);
+    }
+    for (u32 i = 0; i < create_info->without_component_count; i++) {
+        hash = hash_combine(hash, create_info->without_components[i]);
+    }
+    return hash;
+}
+
+// Typed queries bind columns by position, so only a query with the same components in the same order can be shared
+static b8 ecs_query_equals(const ecs_query_t* query, const ecs_query_create_info_t* create_info) {
+    // Empty lists have no data to compare
+    return query->components.count == create_info->component_count &&
+        query->without_components.count == create_info->without_component_count &&
+        (create_info->component_count == 0 ||
+            scompare_memory(query->components.data, create_info->components, sizeof(ecs_component_id) * create_info->component_count)) &&
+        (create_info->without_component_count == 0 ||
+            scompare_memory(query->without_components.data, create_info->without_components, sizeof(ecs_component_id) * create_info->without_component_count));
 }
 
 ecs_query_t* ecs_query_create(struct ecs_world* world, const ecs_query_create_info_t* create_info) {
     // Check if query already exists
-    const u32 max_component_count = 128;
-    u32 total_component_count = create_info->component_count + create_info->without_component_count;
-    u32 all_components[max_component_count];
-
-    scopy_memory(all_components, create_info->components, sizeof(ecs_component_id) * create_info->component_count);
-    scopy_memory(all_components + create_info->component_count, create_info->without_components, sizeof(ecs_component_id) * create_info->without_component_count);
-
-    u64 query_hash = 0x45d9f3bu;
-    for (u32 i = 0; i < total_component_count; i++) {
-        query_hash ^= all_components[i];
-        u32 trailing_zeros = __builtin_stdc_trailing_zeros(query_hash);
-        query_hash >>= trailing_zeros;
-        trailing_zeros ^= 0x45d9f3bu;
-    }
+    const hash_t query_hash = ecs_query_hash(create_info);
 
     // TODO: This is O(n) and slow
     for (u32 i = 0; i < world->queries.count; i++) {
-        if (query_hash == world->queries.data[i].hash) {
+        if (query_hash == world->queries.data[i].hash && ecs_query_equals(&world->queries.data[i], create_info)) {
             return &world->queries.data[i];
         }
     }
@@ -53,10 +61,11 @@ ecs_query_t* ecs_query_create(struct ecs_world* world, const ecs_query_create_in
 
     // Find matching archetypes
     darray_u32_create(ECS_QUERY_INITIAL_CAPACITY, &query.archetype_indices);
+    darray_u32_create(ECS_QUERY_INITIAL_CAPACITY * smax(create_info->component_count, 1), &query.column_indices);
     for (u32 i = 0; i < world->archetypes.count; i++) {
         entity_archetype_t* archetype = &world->archetypes.data[i];
         if (ecs_query_matches_archetype(&query, archetype)) {
-            darray_u32_push(&query.archetype_indices, archetype->archetype_id);
+            ecs_query_add_archetype(&query, archetype);
         }
     }
 
@@ -68,6 +77,7 @@ ecs_query_t* ecs_query_create(struct ecs_world* world, const ecs_query_create_in
 
 void ecs_query_destroy(ecs_query_t* query) {
     darray_u32_destroy(&query->archetype_indices);
+    darray_u32_destroy(&query->column_indices);
     if (query->components.count > 0) {
         darray_u32_destroy(&query->components);
     }
@@ -105,11 +115,28 @@ b8 ecs_query_matches_archetype(ecs_query_t* query, entity_archetype_t* archetype
     return true;
 }
 
+void ecs_query_add_archetype(ecs_query_t* query, entity_archetype_t* archetype) {
+    darray_u32_push(&query->archetype_indices, archetype->archetype_id);
+
+    // Resolve the component columns once here so iterating does not have to look them up every frame
+    for (u32 i = 0; i < query->components.count; i++) {
+        ecs_component_id component = query->components.data[i];
+        u32 column_index = ecs_component_set_get_index(&archetype->component_set, component);
+        SASSERT(column_index != INVALID_ID, "Archetype matched by query is missing component %d.", component);
+        SASSERT(archetype->columns.data[column_index].component_stride == query->world->components.data[component].stride, "Failed to get correct component from query.");
+        darray_u32_push(&query->column_indices, column_index);
+    }
+}
+
 void ecs_query_create_iterator(ecs_query_t* query, ecs_iterator_t* out_iterator) {
 
 }
 
 void ecs_query_iterate(ecs_query_t* query, void (iterate_function)(ecs_iterator_t* iterator)) {
+    ecs_query_iterate_range(query, iterate_function, 0, 0, 0);
+}
+
+u32 ecs_query_iterate_range(ecs_query_t* query, void (iterate_function)(ecs_iterator_t* iterator), f32 delta_time, u32 first_archetype, f64 time_budget) {
     // Create iterator
     void* component_arrays[MAX_QUERY_COMPONENT_COUNT];
 
@@ -117,9 +144,14 @@ void ecs_query_iterate(ecs_query_t* query, void (iterate_function)(ecs_iterator_
         .component_data = component_arrays,
         .component_count = query->components.count,
         .world = query->world,
+        .delta_time = delta_time,
     };
 
-    for (u32 i = 0; i < query->archetype_indices.count; i++) {
+    spark_clock_t clock;
+    clock_start(&clock);
+
+    SASSERT(query->components.count < MAX_QUERY_COMPONENT_COUNT, "QUERY HAS TOO MANY COMPONENTS");
+    for (u32 i = first_archetype; i < query->archetype_indices.count; i++) {
         entity_archetype_t* archetype = &query->world->archetypes.data[query->archetype_indices.data[i]];
         iterator.archetype = archetype;
         if (archetype->entities.count <= 0) {
@@ -127,22 +159,32 @@ void ecs_query_iterate(ecs_query_t* query, void (iterate_function)(ecs_iterator_
         }
 
         // Set component arrays
-        SASSERT(query->components.count < MAX_QUERY_COMPONENT_COUNT, "QUERY HAS TOO MANY COMPONENTS");
+        const u32* columns = &query->column_indices.data[i * query->components.count];
         for (u32 j = 0; j < query->components.count; j++) {
-            ecs_component_id component = query->components.data[j];
-
-            u32 component_index = ecs_component_set_get_index(&archetype->component_set, component);
-            if (component_index == INVALID_ID) {
-                SERROR("Should not get invalid ID from archetype that matches query.");
-                continue;
-            }
-            component_arrays[j] = archetype->columns.data[component_index].data;
-            SASSERT(archetype->columns.data[component_index].component_stride == query->world->components.data[component].stride, "Failed to get correct component from query.");
+            component_arrays[j] = archetype->columns.data[columns[j]].data;
         }
 
         iterator.entity_count = archetype->entities.count;
 
         // Call function
         iterate_function(&iterator);
+
+        // Stop between archetypes once over budget, the caller resumes from the returned index
+        if (time_budget > 0) {
+            clock_update(&clock);
+            if (clock.elapsed_time >= time_budget) {
+                return i + 1;
+            }
+        }
+    }
+
+    return query->archetype_indices.count;
+}
+
+u32 ecs_query_entity_count(const ecs_query_t* query) {
+    u32 entity_count = 0;
+    for (u32 i = 0; i < query->archetype_indices.count; i++) {
+        entity_count += query->world->archetypes.data[query->archetype_indices.data[i]].entities.count;
     }
+    return entity_count;
 }
@@ -0,0 +1,188 @@
+#include "Spark/ecs/ecs_stats.h"
+#include "Spark/core/logging.h"
+#include "Spark/core/smemory.h"
+#include "Spark/ecs/ecs.h"
+#include "Spark/ecs/ecs_world.h"
+#include "Spark/math/smath.h"
+#include "Spark/platform/filesystem.h"
+#include <stdio.h>
+
+darray_impl(ecs_column_stats_t, ecs_column_stats);
+darray_impl(ecs_archetype_stats_t, ecs_archetype_stats);
+darray_impl(ecs_query_stats_t, ecs_query_stats);
+darray_impl(ecs_system_stats_t, ecs_system_stats);
+
+void ecs_world_stats_create(struct ecs_world* world, ecs_world_stats_t* out_stats) {
+    szero_memory(out_stats, sizeof(ecs_world_stats_t));
+    out_stats->component_count = world->components.count;
+
+    darray_ecs_archetype_stats_create(world->archetypes.count, &out_stats->archetypes);
+    darray_ecs_column_stats_create(world->components.count, &out_stats->columns);
+    darray_ecs_query_stats_create(smax(world->queries.count, 1), &out_stats->queries);
+    darray_ecs_system_stats_create(16, &out_stats->systems);
+
+    // Archetypes and their columns
+    for (u32 i = 0; i < world->archetypes.count; i++) {
+        entity_archetype_t* archetype = &world->archetypes.data[i];
+        ecs_archetype_stats_t archetype_stats = {
+            .archetype_id    = archetype->archetype_id,
+            .entity_count    = archetype->entities.count,
+            .entity_capacity = archetype->entities.capacity,
+            .first_column    = out_stats->columns.count,
+            .bytes_used      = archetype->entities.count * sizeof(entity_t),
+            .bytes_wasted    = (archetype->entities.capacity - archetype->entities.count) * sizeof(entity_t),
+        };
+
+        const ecs_component_id* components = ecs_component_set_values(&archetype->component_set);
+        const u32* column_indices = ecs_component_set_indices(&archetype->component_set);
+        for (u32 c = 0; c < archetype->component_set.count; c++) {
+            ecs_component_id component = components[c];
+            ecs_column_t* column = &archetype->columns.data[column_indices[c]];
+            ecs_column_stats_t column_stats = {
+                .component    = component,
+                .stride       = column->component_stride,
+                .count        = column->count,
+                .capacity     = column->capacity,
+                .bytes_used   = column->count * column->component_stride,
+                .bytes_wasted = (column->capacity - column->count) * column->component_stride,
+#ifdef SPARK_DEBUG
+                .name         = world->components.data[component].name,
+#endif
+            };
+            darray_ecs_column_stats_push(&out_stats->columns, column_stats);
+
+            archetype_stats.column_count++;
+            archetype_stats.bytes_used += column_stats.bytes_used;
+            archetype_stats.bytes_wasted += column_stats.bytes_wasted;
+        }
+
+        out_stats->entity_count += archetype_stats.entity_count;
+        out_stats->bytes_used += archetype_stats.bytes_used;
+        out_stats->bytes_wasted += archetype_stats.bytes_wasted;
+        darray_ecs_archetype_stats_push(&out_stats->archetypes, archetype_stats);
+    }
+
+    // Queries
+    for (u32 i = 0; i < world->queries.count; i++) {
+        ecs_query_t* query = &world->queries.data[i];
+        ecs_query_stats_t query_stats = {
+            .component_count         = query->components.count,
+            .without_component_count = query->without_components.count,
+            .matched_archetype_count = query->archetype_indices.count,
+        };
+
+        for (u32 a = 0; a < query->archetype_indices.count; a++) {
+            query_stats.matched_entity_count += world->archetypes.data[query->archetype_indices.data[a]].entities.count;
+        }
+        darray_ecs_query_stats_push(&out_stats->queries, query_stats);
+    }
+
+    // Systems
+    for (u32 phase = 0; phase < ECS_PHASE_ENUM_MAX; phase++) {
+        for (u32 i = 0; i < world->systems[phase].count; i++) {
+            ecs_system_t* system = &world->systems[phase].data[i];
+            ecs_system_stats_t system_stats = {
+                .name        = system->name,
+                .phase       = phase,
+                .query_index = system->query - world->queries.data,
+                .calls       = system->calls,
+                .total_time  = system->runtime,
+                .last_time   = system->last_runtime,
+            };
+            darray_ecs_system_stats_push(&out_stats->systems, system_stats);
+        }
+    }
+}
+
+void ecs_world_stats_destroy(ecs_world_stats_t* stats) {
+    darray_ecs_archetype_stats_destroy(&stats->archetypes);
+    darray_ecs_column_stats_destroy(&stats->columns);
+    darray_ecs_query_stats_destroy(&stats->queries);
+    darray_ecs_system_stats_destroy(&stats->systems);
+}
+
+// Appends to buffer while still counting the characters that did not fit, the same way snprintf does.
+#define json_append(...) \
+    offset += snprintf(buffer + smin(offset, buffer_size), offset < buffer_size ? buffer_size - offset : 0, __VA_ARGS__)
+
+// Appends string as a quoted JSON string, escaping quotes and backslashes
+static u64 json_append_string(char* buffer, u64 buffer_size, u64 offset, const char* string) {
+    json_append("\"");
+    for (const char* c = string; *c; c++) {
+        json_append(*c == '"' || *c == '\\' ? "\\%c" : "%c", *c);
+    }
+    json_append("\"");
+    return offset;
+}
+
+u64 ecs_world_stats_to_json(const ecs_world_stats_t* stats, char* buffer, u64 buffer_size) {
+    u64 offset = 0;
+    if (buffer_size > 0) {
+        buffer[0] = 0;
+    }
+
+    json_append("{\n\t\"entity_count\": %lu,\n\t\"component_count\": %u,\n\t\"bytes_used\": %lu,\n\t\"bytes_wasted\": %lu,\n",
+            stats->entity_count, stats->component_count, stats->bytes_used, stats->bytes_wasted);
+
+    json_append("\t\"archetypes\": [");
+    for (u32 i = 0; i < stats->archetypes.count; i++) {
+        const ecs_archetype_stats_t* archetype = &stats->archetypes.data[i];
+        json_append("%s\n\t\t{ \"id\": %lu, \"entity_count\": %u, \"entity_capacity\": %u, \"bytes_used\": %lu, \"bytes_wasted\": %lu, \"columns\": [",
+                i == 0 ? "" : ",", archetype->archetype_id, archetype->entity_count, archetype->entity_capacity, archetype->bytes_used, archetype->bytes_wasted);
+
+        for (u32 c = 0; c < archetype->column_count; c++) {
+            const ecs_column_stats_t* column = &stats->columns.data[archetype->first_column + c];
+            json_append("%s\n\t\t\t{ \"component\": %u, ", c == 0 ? "" : ",", column->component);
+#ifdef SPARK_DEBUG
+            json_append("\"name\": ");
+            offset = json_append_string(buffer, buffer_size, offset, column->name);
+            json_append(", ");
+#endif
+            json_append("\"stride\": %u, \"count\": %lu, \"capacity\": %lu, \"bytes_used\": %lu, \"bytes_wasted\": %lu }",
+                    column->stride, column->count, column->capacity, column->bytes_used, column->bytes_wasted);
+        }
+        json_append("%s] }", archetype->column_count > 0 ? "\n\t\t" : "");
+    }
+    json_append("\n\t],\n");
+
+    json_append("\t\"queries\": [");
+    for (u32 i = 0; i < stats->queries.count; i++) {
+        const ecs_query_stats_t* query = &stats->queries.data[i];
+        json_append("%s\n\t\t{ \"index\": %u, \"component_count\": %u, \"without_component_count\": %u, \"matched_archetypes\": %u, \"matched_entities\": %lu }",
+                i == 0 ? "" : ",", i, query->component_count, query->without_component_count, query->matched_archetype_count, query->matched_entity_count);
+    }
+    json_append("\n\t],\n");
+
+    json_append("\t\"systems\": [");
+    for (u32 i = 0; i < stats->systems.count; i++) {
+        const ecs_system_stats_t* system = &stats->systems.data[i];
+        const f64 average_time = system->calls > 0 ? system->total_time / system->calls : 0;
+        json_append("%s\n\t\t{ \"name\": ", i == 0 ? "" : ",");
+        offset = json_append_string(buffer, buffer_size, offset, system->name ? system->name : "");
+        json_append(", \"phase\": %u, \"query\": %u, \"calls\": %lu, \"total_ms\": %f, \"last_ms\": %f, \"average_ms\": %f }",
+                system->phase, system->query_index, system->calls,
+                system->total_time * 1000, system->last_time * 1000, average_time * 1000);
+    }
+    json_append("\n\t]\n}\n");
+
+    return offset;
+}
+
+b8 ecs_world_stats_write_json(const ecs_world_stats_t* stats, const char* path) {
+    u64 length = ecs_world_stats_to_json(stats, NULL, 0);
+    char* buffer = sallocate(length + 1, MEMORY_TAG_STRING);
+    ecs_world_stats_to_json(stats, buffer, length + 1);
+
+    file_handle_t handle;
+    b8 success = filesystem_open(path, FILE_MODE_WRITE, false, &handle);
+    if (success) {
+        u64 written = 0;
+        success = filesystem_write(&handle, length, buffer, &written);
+        filesystem_close(&handle);
+    } else {
+        SERROR("Failed to open '%s' to write ecs world stats.", path);
+    }
+
+    sfree(buffer, length + 1, MEMORY_TAG_STRING);
+    return success;
+}
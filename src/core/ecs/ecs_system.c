@@ -13,13 +13,11 @@ void ecs_system_create(struct ecs_world* world, const ecs_system_create_info_t*
 
     ecs_system_t system = {
         .query = ecs_query_create(world, &create_info->query),
-        .callback = create_info->callback 
+        .callback = create_info->callback,
+        .name = create_info->name,
+        .schedule = create_info->schedule,
     };
 
-#if SPARK_DEBUG
-    system.name = create_info->name;
-#endif
-
     darray_ecs_system_push(&world->systems[create_info->phase], system);
 }
 
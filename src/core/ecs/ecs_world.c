@@ -3,6 +3,7 @@
 #include "Spark/core/sstring.h"
 #include "Spark/ecs/ecs.h"
 #include "Spark/ecs/entity.h"
+#include "Spark/math/smath.h"
 #include "Spark/memory/linear_allocator.h"
 
 ecs_world_t* pvt_ecs_world;
@@ -16,7 +17,13 @@ void ecs_world_initialize(linear_allocator_t* allocator) {
     darray_ecs_query_create(100, &pvt_ecs_world->queries);
     for (u32 i = 0; i < ECS_PHASE_ENUM_MAX; i++) {
         darray_ecs_system_create(20, &pvt_ecs_world->systems[i]);
+        pvt_ecs_world->phase_schedules[i] = (ecs_schedule_t) { };
+        pvt_ecs_world->phase_cursors[i] = 0;
     }
+    pvt_ecs_world->frame_index = 0;
+
+    mutex_create(&pvt_ecs_world->staging_mutex);
+    ecs_command_buffer_create(256, &pvt_ecs_world->staged_commands);
 
     // Create default (empty) archetype
     entity_archetype_create(pvt_ecs_world, 0, NULL, &pvt_ecs_world->archetypes.data[0]);
@@ -52,7 +59,12 @@ void ecs_world_shutdown() {
         entity_archetype_destroy(&pvt_ecs_world->archetypes.data[i]);
     }
     for (u32 i = 0; i < pvt_ecs_world->components.count; i++) {
-        darray_entity_archetype_ptr_destroy(&pvt_ecs_world->components.data[i].archetypes);
+        ecs_component_t* component = &pvt_ecs_world->components.data[i];
+        darray_entity_archetype_ptr_destroy(&component->archetypes);
+        if (component->index) {
+            ecs_component_index_destroy(component->index);
+            sfree(component->index, sizeof(ecs_component_index_t), MEMORY_TAG_ECS);
+        }
     }
     for (u32 i = 0; i < pvt_ecs_world->queries.count; i++) {
         ecs_query_destroy(&pvt_ecs_world->queries.data[i]);
@@ -68,6 +80,8 @@ void ecs_world_shutdown() {
         darray_ecs_system_destroy(&pvt_ecs_world->systems[i]);
     }
     darray_ecs_query_destroy(&pvt_ecs_world->queries);
+    ecs_command_buffer_destroy(&pvt_ecs_world->staged_commands);
+    mutex_destroy(&pvt_ecs_world->staging_mutex);
     darray_entity_record_destroy(&pvt_ecs_world->records);
     darray_ecs_component_destroy(&pvt_ecs_world->components);
     darray_entity_archetype_destroy(&pvt_ecs_world->archetypes);
@@ -87,28 +101,179 @@ ecs_component_id ecs_world_component_define(ecs_world_t* world, const char* name
     return component_id;
 }
 
-void ecs_world_progress() {
+void ecs_world_component_enable_index(ecs_world_t* world, ecs_component_id component_id, ecs_component_key_function key_function) {
+    ecs_component_t* component = &world->components.data[component_id];
+    if (component->index) {
+        SWARN("Component %d is already indexed.", component_id);
+        return;
+    }
+
+    component->index = sallocate(sizeof(ecs_component_index_t), MEMORY_TAG_ECS);
+    ecs_component_index_create(component->stride, key_function, component->index);
+
+    // Index entities that already have the component
+    for (u32 a = 0; a < component->archetypes.count; a++) {
+        entity_archetype_t* archetype = component->archetypes.data[a];
+        for (u32 e = 0; e < archetype->entities.count; e++) {
+            entity_t entity = archetype->entities.data[e];
+            ecs_component_index_set(component->index, entity, entity_get_component(world, entity, component_id));
+        }
+    }
+}
+
+const darray_entity_t* ecs_world_find_entities_by_key(ecs_world_t* world, ecs_component_id component, u64 key) {
+    ecs_component_index_t* index = world->components.data[component].index;
+    SASSERT(index, "Cannot find entities by value for component %d, the component is not indexed.", component);
+    return ecs_component_index_find(index, key);
+}
+
+const darray_entity_t* ecs_world_find_entities(ecs_world_t* world, ecs_component_id component, const void* value) {
+    ecs_component_index_t* index = world->components.data[component].index;
+    SASSERT(index, "Cannot find entities by value for component %d, the component is not indexed.", component);
+    return ecs_component_index_find_value(index, value);
+}
+
+void ecs_world_set_phase_schedule(ecs_world_t* world, ecs_phase_t phase, const ecs_schedule_t* schedule) {
+    SASSERT(phase < ECS_PHASE_ENUM_MAX, "Invalid ecs phase %d.", phase);
+    world->phase_schedules[phase] = *schedule;
+}
+
+// Systems without their own schedule follow their phase
+SINLINE const ecs_schedule_t* ecs_system_schedule(const ecs_system_t* system, const ecs_schedule_t* phase_schedule) {
+    const ecs_schedule_t* schedule = &system->schedule;
+    if (schedule->tick_rate <= 0 && schedule->frame_interval == 0 && schedule->time_budget <= 0) {
+        return phase_schedule;
+    }
+    return schedule;
+}
+
+// Adds the ticks that became due this frame to the system's pending ticks
+static void ecs_system_schedule_ticks(ecs_system_t* system, const ecs_schedule_t* schedule, u64 frame_index, f64 delta_time) {
+    system->accumulated_time += delta_time;
+
+    if (schedule->tick_rate > 0) {
+        const f64 step = 1.0 / schedule->tick_rate;
+        u32 ticks = system->accumulated_time / step;
+        system->accumulated_time -= ticks * step;
+        system->tick_delta = step;
+
+        // Drop time that cannot be caught up so a slow frame does not spiral
+        system->pending_ticks += ticks;
+        if (system->pending_ticks > ECS_SCHEDULE_MAX_CATCH_UP_TICKS) {
+            system->pending_ticks = ECS_SCHEDULE_MAX_CATCH_UP_TICKS;
+        }
+        return;
+    }
+
+    // Variable rate ticks only start once the previous one has finished, time keeps accumulating until then
+    const u32 interval = smax(schedule->frame_interval, 1);
+    if (system->pending_ticks == 0 && frame_index % interval == 0) {
+        system->pending_ticks = 1;
+        system->tick_delta = system->accumulated_time;
+        system->accumulated_time = 0;
+    }
+}
+
+// Runs pending ticks until they are done or the budget runs out, returns the time spent
+static f64 ecs_system_run(ecs_system_t* system, const ecs_schedule_t* schedule) {
+    spark_clock_t clock;
+    clock_start(&clock);
+
+    b8 progressed = false;
+    while (system->pending_ticks > 0) {
+        f64 remaining_budget = 0;
+        if (schedule->time_budget > 0) {
+            clock_update(&clock);
+            remaining_budget = schedule->time_budget - clock.elapsed_time;
+            if (remaining_budget <= 0) {
+                // Always make some progress so a tight budget cannot stall the system
+                if (progressed) {
+                    break;
+                }
+                remaining_budget = ECS_SCHEDULE_MIN_BUDGET;
+            }
+        }
+        progressed = true;
+
+        system->archetype_cursor = ecs_query_iterate_range(system->query, system->callback, system->tick_delta, system->archetype_cursor, remaining_budget);
+        if (system->archetype_cursor < system->query->archetype_indices.count) {
+            break;
+        }
+
+        system->archetype_cursor = 0;
+        system->pending_ticks--;
+        system->calls++;
+    }
+
+    clock_update(&clock);
+    return clock.elapsed_time;
+}
+
+entity_t ecs_world_reserve_entities(ecs_world_t* world, u32 count) {
+    return __atomic_fetch_add(&world->entity_count, count, __ATOMIC_RELAXED);
+}
+
+void ecs_world_commit_staged(ecs_world_t* world) {
+    mutex_lock(world->staging_mutex);
+    ecs_command_buffer_commit(&world->staged_commands, world);
+    mutex_unlock(world->staging_mutex);
+}
+
+void ecs_world_progress(f64 delta_time) {
 #ifdef SPARK_DEBUG
     static char system_debug_buffer[8192] = {};
     u32 debug_buffer_offset = 0;
 #endif
+    ecs_world_commit_staged(pvt_ecs_world);
+
     for (u32 phase = 0; phase < ECS_PHASE_ENUM_MAX; phase++) {
-        for (u32 i = 0; i < pvt_ecs_world->systems[phase].count; i++) {
-            ecs_system_t* system = &pvt_ecs_world->systems[phase].data[i];
-#ifdef SPARK_DEBUG
-            spark_clock_t clock;
-            clock_start(&clock);
-#endif
-            ecs_query_iterate(system->query, system->callback);
+        darray_ecs_system_t* systems = &pvt_ecs_world->systems[phase];
+        const ecs_schedule_t* phase_schedule = &pvt_ecs_world->phase_schedules[phase];
+
+        // Time keeps accumulating for every system, also for those the phase does not get to this frame
+        for (u32 i = 0; i < systems->count; i++) {
+            ecs_system_t* system = &systems->data[i];
+            system->last_runtime = 0;
+            ecs_system_schedule_ticks(system, ecs_system_schedule(system, phase_schedule), pvt_ecs_world->frame_index, delta_time);
+        }
+
+        // The phase budget is shared by all of its systems. Once it is used up the phase resumes from the first
+        // unfinished system next frame.
+        f64 remaining_budget = phase_schedule->time_budget;
+        u32 i = pvt_ecs_world->phase_cursors[phase];
+        pvt_ecs_world->phase_cursors[phase] = 0;
+        for (; i < systems->count; i++) {
+            ecs_system_t* system = &systems->data[i];
+            if (system->pending_ticks == 0) {
+                continue;
+            }
+
+            // Systems following the phase get what is left of the phase budget
+            const ecs_schedule_t* system_schedule = ecs_system_schedule(system, phase_schedule);
+            ecs_schedule_t schedule = *system_schedule;
+            if (system_schedule == phase_schedule && phase_schedule->time_budget > 0) {
+                schedule.time_budget = remaining_budget;
+            }
+
+            f64 elapsed_time = ecs_system_run(system, &schedule);
+            system->last_runtime = elapsed_time;
+            system->runtime += elapsed_time;
 #ifdef SPARK_DEBUG
-            clock_update(&clock);
-            system->runtime += clock.elapsed_time;
-            system->calls++;
-            debug_buffer_offset += string_format(system_debug_buffer + debug_buffer_offset, "%s: %.2fms (%f\%)\n", system->name, clock.elapsed_time * 1000, clock.elapsed_time / (1.0f / 60) * 100);
+            debug_buffer_offset += string_format(system_debug_buffer + debug_buffer_offset, "%s: %.2fms (%f\%)\n", system->name, elapsed_time * 1000, elapsed_time / (1.0f / 60) * 100);
             // SDEBUG(system_debug_buffer);
 #endif
+
+            if (phase_schedule->time_budget > 0) {
+                remaining_budget -= elapsed_time;
+                if (remaining_budget <= 0) {
+                    const u32 next_system = system->pending_ticks > 0 ? i : i + 1;
+                    pvt_ecs_world->phase_cursors[phase] = next_system < systems->count ? next_system : 0;
+                    break;
+                }
+            }
         }
     }
+    pvt_ecs_world->frame_index++;
 }
 
 void ecs_world_set_singleton(ecs_world_t* world, ecs_component_id component, entity_t singleton) {
@@ -16,15 +16,28 @@ void entity_transition_archetype(struct ecs_world* world,
         entity_archetype_t* dest_archetype);
 
 entity_t entity_create(struct ecs_world* world) {
-    entity_t entity = world->entity_count++;
+    entity_t entity = ecs_world_reserve_entities(world, 1);
+    entity_create_reserved(world, entity);
+    return entity;
+}
+
+void entity_create_reserved(struct ecs_world* world, entity_t entity) {
+    // Ids reserved by other threads may be committed later, keep their records invalid until then
+    while (world->records.count < entity) {
+        darray_entity_record_push(&world->records, (entity_record_t) { .index = INVALID_ID_U64, .archetype_index = INVALID_ID });
+    }
+
     entity_record_t record = {
         .archetype_index = 0,
-        .index = world->archetypes.data[0].columns.count,
+        .index = world->archetypes.data[0].entities.count,
     };
     darray_entity_push(&world->archetypes.data[0].entities, entity);
-    darray_entity_record_push(&world->records, record);
-
-    return entity;
+    if (entity < world->records.count) {
+        SASSERT(world->records.data[entity].archetype_index == INVALID_ID, "Entity %d was already created.", entity);
+        world->records.data[entity] = record;
+    } else {
+        darray_entity_record_push(&world->records, record);
+    }
 }
 
 b8 entity_has_component(struct ecs_world* world, entity_t entity, ecs_index component) {
@@ -119,12 +132,9 @@ void entity_add_component(struct ecs_world* world, entity_t entity, ecs_componen
 
         // Type check
         b8 is_existing_archetype = true;
-        for (u32 j = 0; j < current_archetype->component_set.capacity; j++) {
-            ecs_component_id component = current_archetype->component_set.data[j].value;
-            if (component == INVALID_ID) {
-                continue;
-            }
-            if (!ecs_component_set_contains(&archetype->component_set, component)) {
+        const ecs_component_id* components = ecs_component_set_values(&current_archetype->component_set);
+        for (u32 j = 0; j < current_archetype->component_set.count; j++) {
+            if (!ecs_component_set_contains(&archetype->component_set, components[j])) {
                 is_existing_archetype = false;
                 break;
             }
@@ -175,12 +185,11 @@ void entity_transition_archetype(struct ecs_world* world,
     darray_entity_push(&dest_archetype->entities, entity);
 
     // Append each component from source to dest
-    for (u32 i = 0; i < source_archetype->component_set.capacity; i++) {
-        ecs_component_id component = source_archetype->component_set.data[i].value;
-        if (component == INVALID_ID) {
-            continue;
-        }
-        u32 source_column_index = ecs_component_set_get_index(&source_archetype->component_set, component);
+    const ecs_component_id* components = ecs_component_set_values(&source_archetype->component_set);
+    const u32* source_column_indices = ecs_component_set_indices(&source_archetype->component_set);
+    for (u32 i = 0; i < source_archetype->component_set.count; i++) {
+        ecs_component_id component = components[i];
+        u32 source_column_index = source_column_indices[i];
         u32 dest_column_index = ecs_component_set_get_index(&dest_archetype->component_set, component);
 
         ecs_column_t* source_column = &source_archetype->columns.data[source_column_index];
@@ -205,6 +214,11 @@ void entity_set_component(struct ecs_world* world, entity_t entity, ecs_componen
     u32 column_index = ecs_component_set_get_index(&world->archetypes.data[record.archetype_index].component_set, component);
     SASSERT(column_index != INVALID_ID, "Cannot set component %s to entity %d when entity does not have component.", world->components.data[component].name, entity);
     scopy_memory(world->archetypes.data[record.archetype_index].columns.data[column_index].data + record.index * stride, data, stride);
+
+    ecs_component_index_t* index = world->components.data[component].index;
+    if (index) {
+        ecs_component_index_set(index, entity, data);
+    }
 }
 
 void entity_add_transforms(ecs_world_t* world, entity_t entity, vec3 position, vec3 scale, quat rotation) {
@@ -6,7 +6,7 @@
 #include "Spark/ecs/entity.h"
 #include "Spark/math/smath.h"
 
-#define EDGE_MAP_DEFAULT_CAPACITY 30
+#define EDGE_MAP_DEFAULT_CAPACITY 8
 
 void entity_archetype_create(struct ecs_world* world, u32 component_count, ecs_component_id* components, entity_archetype_t* out_archetype) {
     out_archetype->archetype_id = world->archetypes.count;
@@ -57,12 +57,9 @@ entity_archetype_t* entity_archetype_create_from_base(struct ecs_world* world, e
     entity_archetype_ptr_map_create(EDGE_MAP_DEFAULT_CAPACITY, &out_archetype->edges.remove_edges);
 
     // Manually set component_set data
-    for (u32 i = 0; i < base_archetype->component_set.capacity; i++) {
-        ecs_component_id component = base_archetype->component_set.data[i].value;
-        if (component == INVALID_ID) {
-            continue;
-        }
-        ecs_component_set_insert(&out_archetype->component_set, component);
+    const ecs_component_id* base_components = ecs_component_set_values(&base_archetype->component_set);
+    for (u32 i = 0; i < base_archetype->component_set.count; i++) {
+        ecs_component_set_insert(&out_archetype->component_set, base_components[i]);
     }
 
     for (u32 i = 0; i < component_count; i++) {
@@ -70,13 +67,11 @@ entity_archetype_t* entity_archetype_create_from_base(struct ecs_world* world, e
     }
 
     // Initialize columns from base
-    for (u32 i = 0; i < out_archetype->component_set.capacity; i++) {
-         u32 value = out_archetype->component_set.data[i].value;
-         u32 index = out_archetype->component_set.data[i].index;
-
-         if (value == INVALID_ID) {
-             continue;
-         }
+    const ecs_component_id* out_components = ecs_component_set_values(&out_archetype->component_set);
+    const u32* column_indices = ecs_component_set_indices(&out_archetype->component_set);
+    for (u32 i = 0; i < out_archetype->component_set.count; i++) {
+         u32 value = out_components[i];
+         u32 index = column_indices[i];
 
          ecs_component_t* component = &world->components.data[value];
          ecs_component_column_create(1, component->stride, &out_archetype->columns.data[index]);
@@ -108,7 +103,7 @@ void entity_archetype_print_debug(entity_archetype_t* archetype) {
 
     SDEBUG("ARCHETYPE: %d", archetype->archetype_id);
     for (u32 i = 0; i < archetype->columns.count; i++) {
-        u32 component_index = archetype->component_set.data[i].value;
+        u32 component_index = ecs_component_set_values(&archetype->component_set)[i];
         SDEBUG("Component %d: %s (Index: %d)", i, world->components.data[component_index].name, component_index);
     }
 #endif
@@ -119,7 +114,7 @@ void entity_archetype_match_queryies(entity_archetype_t *archetype, struct ecs_w
     // Check if archetype matches any existing queries
     for (u32 i = 0; i < world->queries.count; i++) {
         if (ecs_query_matches_archetype(&world->queries.data[i], archetype)) {
-            darray_u32_push(&world->queries.data[i].archetype_indices, archetype->archetype_id);
+            ecs_query_add_archetype(&world->queries.data[i], archetype);
         }
     }
 }
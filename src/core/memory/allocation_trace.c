@@ -0,0 +1,171 @@
+#include "Spark/memory/allocation_trace.h"
+#include "Spark/core/logging.h"
+#include "Spark/math/smath.h"
+#include "Spark/platform/platform.h"
+#include "Spark/threading/mutex.h"
+#include <stdio.h>
+
+#define ALLOCATION_TRACE_MAX_THREADS 256
+
+typedef struct allocation_trace_buffer {
+    allocation_trace_record_t records[ALLOCATION_TRACE_THREAD_BUFFER_SIZE];
+    u32 count;
+    u16 thread;
+} allocation_trace_buffer_t;
+
+typedef struct allocation_trace_state {
+    FILE* file;
+    f64 start_time;
+    // Records that fit in the file, ~0 without a size limit
+    u64 capacity;
+    u64 written_count;
+
+    // Buffers of all threads that recorded, flushed when the trace stops
+    allocation_trace_buffer_t* buffers[ALLOCATION_TRACE_MAX_THREADS];
+    u32 buffer_count;
+    // Held across file writes, created by the first allocation_trace_start and kept so late flushes can still lock it
+    spark_mutex_t mutex;
+} allocation_trace_state_t;
+
+b8 allocation_trace_active = false;
+static allocation_trace_state_t trace;
+static thread_local allocation_trace_buffer_t* thread_buffer = NULL;
+
+// Appends the buffered records to the file, wrapping around to the first record once the file is full
+static void allocation_trace_flush(allocation_trace_buffer_t* buffer) {
+    mutex_lock(trace.mutex);
+    u32 flushed = 0;
+    while (trace.file && flushed < buffer->count) {
+        const u64 index = trace.written_count % trace.capacity;
+        const u32 count = smin(buffer->count - flushed, trace.capacity - index);
+        fseek(trace.file, sizeof(allocation_trace_header_t) + sizeof(allocation_trace_record_t) * index, SEEK_SET);
+        fwrite(buffer->records + flushed, sizeof(allocation_trace_record_t), count, trace.file);
+        trace.written_count += count;
+        flushed += count;
+    }
+    buffer->count = 0;
+    mutex_unlock(trace.mutex);
+}
+
+static allocation_trace_buffer_t* allocation_trace_thread_buffer() {
+    if (!thread_buffer) {
+        // Allocated from the platform, allocating through sallocate would record itself
+        thread_buffer = platform_allocate(sizeof(allocation_trace_buffer_t), false);
+        thread_buffer->count = 0;
+
+        mutex_lock(trace.mutex);
+        thread_buffer->thread = trace.buffer_count;
+        if (trace.buffer_count < ALLOCATION_TRACE_MAX_THREADS) {
+            trace.buffers[trace.buffer_count] = thread_buffer;
+        }
+        trace.buffer_count++;
+        mutex_unlock(trace.mutex);
+    }
+    return thread_buffer;
+}
+
+SINLINE allocation_trace_record_t* allocation_trace_push(allocation_trace_buffer_t* buffer, u32 count) {
+    if (buffer->count + count > ALLOCATION_TRACE_THREAD_BUFFER_SIZE) {
+        allocation_trace_flush(buffer);
+    }
+    allocation_trace_record_t* records = &buffer->records[buffer->count];
+    buffer->count += count;
+    return records;
+}
+
+SINLINE u64 allocation_trace_time() {
+    return (platform_get_absolute_time() - trace.start_time) * 1000000000.0;
+}
+
+void allocation_trace_record(allocation_trace_op_t op, const void* block, u64 size, memory_tag_t tag) {
+    allocation_trace_buffer_t* buffer = allocation_trace_thread_buffer();
+    allocation_trace_record_t* record = allocation_trace_push(buffer, 1);
+    *record = (allocation_trace_record_t) {
+        .time_ns = allocation_trace_time(),
+        .block = (u64)block,
+        .size = size,
+        .thread = buffer->thread,
+        .tag = tag,
+        .op = op,
+    };
+}
+
+void allocation_trace_record_reallocate(const void* old_block, u64 old_size, const void* new_block, u64 new_size, memory_tag_t tag) {
+    allocation_trace_buffer_t* buffer = allocation_trace_thread_buffer();
+    allocation_trace_record_t* records = allocation_trace_push(buffer, 2);
+    const u64 time_ns = allocation_trace_time();
+    records[0] = (allocation_trace_record_t) {
+        .time_ns = time_ns,
+        .block = (u64)old_block,
+        .size = old_size,
+        .thread = buffer->thread,
+        .tag = tag,
+        .op = ALLOCATION_TRACE_REALLOCATE_FROM,
+    };
+    records[1] = (allocation_trace_record_t) {
+        .time_ns = time_ns,
+        .block = (u64)new_block,
+        .size = new_size,
+        .thread = buffer->thread,
+        .tag = tag,
+        .op = ALLOCATION_TRACE_REALLOCATE_TO,
+    };
+}
+
+b8 allocation_trace_start(const char* path, u64 max_size) {
+    allocation_trace_stop();
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        SERROR("Failed to open allocation trace '%s'.", path);
+        return false;
+    }
+
+    // Created while tracing is off, so the mutex' own allocation is not recorded
+    if (!trace.mutex.internal_data) {
+        mutex_create(&trace.mutex);
+    }
+    mutex_lock(trace.mutex);
+    trace.file = file;
+    trace.start_time = platform_get_absolute_time();
+    trace.written_count = 0;
+    trace.capacity = max_size ? (max_size - sizeof(allocation_trace_header_t)) / sizeof(allocation_trace_record_t) : ~0ull;
+    SASSERT(trace.capacity > 0, "Allocation trace size limit of %lu bytes does not fit a single record.", max_size);
+    // Records buffered before this trace started belong to the previous one
+    for (u32 i = 0; i < smin(trace.buffer_count, ALLOCATION_TRACE_MAX_THREADS); i++) {
+        trace.buffers[i]->count = 0;
+    }
+    mutex_unlock(trace.mutex);
+
+    __atomic_store_n(&allocation_trace_active, true, __ATOMIC_RELEASE);
+    return true;
+}
+
+void allocation_trace_stop() {
+    if (!trace.file) {
+        return;
+    }
+    __atomic_store_n(&allocation_trace_active, false, __ATOMIC_RELEASE);
+
+    for (u32 i = 0; i < smin(trace.buffer_count, ALLOCATION_TRACE_MAX_THREADS); i++) {
+        allocation_trace_flush(trace.buffers[i]);
+    }
+    if (trace.buffer_count > ALLOCATION_TRACE_MAX_THREADS) {
+        SWARN("Allocation trace lost the last records of %u threads.", trace.buffer_count - ALLOCATION_TRACE_MAX_THREADS);
+    }
+
+    mutex_lock(trace.mutex);
+    const allocation_trace_header_t header = {
+        .magic = ALLOCATION_TRACE_MAGIC,
+        .version = ALLOCATION_TRACE_VERSION,
+        .record_count = smin(trace.written_count, trace.capacity),
+        .first_record = trace.written_count > trace.capacity ? trace.written_count % trace.capacity : 0,
+    };
+    fseek(trace.file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, trace.file);
+    fclose(trace.file);
+    trace.file = NULL;
+    mutex_unlock(trace.mutex);
+
+    SINFO("Allocation trace recorded %lu records.", header.record_count);
+}
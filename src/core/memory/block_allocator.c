@@ -1,58 +1,175 @@
-
 #include "Spark/memory/block_allocator.h"
+#include "Spark/core/logging.h"
 #include "Spark/core/smemory.h"
 #include "Spark/math/smath.h"
+#include "Spark/platform/platform.h"
 
-void block_allocator_create(u32 block_count, u32 block_size, block_allocator_t* out_allocator) {
-    const u32 total_block_size = smax(block_size, sizeof(block_allocator_block_t));
-    out_allocator->buffer = sallocate(total_block_size * block_count, MEMORY_TAG_ALLOCATOR);
-    out_allocator->first_block = out_allocator->buffer;
-    out_allocator->block_count = block_count;
-    out_allocator->block_size = block_size;
+SINLINE u64 block_allocator_bitmap_size(const block_allocator_t* allocator) {
+    return sizeof(u64) * ((allocator->page_block_count + 63) / 64);
+}
+
+// Page header, allocation bitmap and blocks share one allocation
+SINLINE u64 block_allocator_page_size(const block_allocator_t* allocator) {
+    const u64 header_size = (sizeof(block_allocator_page_t) + block_allocator_bitmap_size(allocator) + 15) & ~15ull;
+    return header_size + (u64)allocator->page_block_count * allocator->block_stride;
+}
 
-    for (u32 i = 0; i < block_count - 1; i++) {
-        u32 offset = i * total_block_size;
-        block_allocator_block_t* block = (block_allocator_block_t*)(out_allocator->buffer + offset);
-        block->next = out_allocator->buffer + (i + 1) * total_block_size;
+SINLINE void block_allocator_remove_page(block_allocator_t* allocator, block_allocator_page_t* page) {
+    if (page->previous) {
+        page->previous->next = page->next;
+    } else {
+        allocator->partial_pages = page->next;
     }
+    if (page->next) {
+        page->next->previous = page->previous;
+    }
+    page->next = NULL;
+    page->previous = NULL;
+    page->partial = false;
+}
+
+SINLINE void block_allocator_push_page(block_allocator_t* allocator, block_allocator_page_t* page) {
+    page->previous = NULL;
+    page->next = allocator->partial_pages;
+    if (page->next) {
+        page->next->previous = page;
+    }
+    allocator->partial_pages = page;
+    page->partial = true;
+}
+
+void block_allocator_create(u32 page_block_count, u32 block_size, block_allocator_t* out_allocator) {
+    SASSERT(page_block_count > 0, "Block allocator pages need at least one block.");
+    out_allocator->pages = NULL;
+    out_allocator->partial_pages = NULL;
+    out_allocator->page_count = 0;
+    out_allocator->page_block_count = page_block_count;
+    out_allocator->block_size = block_size;
+    out_allocator->block_stride = (smax(block_size, sizeof(block_allocator_block_t)) + 15) & ~15u;
+    out_allocator->release_empty_pages = false;
+
+    const u64 page_size = block_allocator_page_size(out_allocator);
+    out_allocator->page_stride = (page_size + BLOCK_ALLOCATOR_PAGE_ALIGNMENT - 1) & ~((u64)BLOCK_ALLOCATOR_PAGE_ALIGNMENT - 1);
+    SASSERT(out_allocator->page_stride <= BLOCK_ALLOCATOR_RESERVE_SIZE, "Block allocator pages of 0x%lx bytes do not fit the reservation.", page_size);
+    out_allocator->memory = platform_reserve_memory(BLOCK_ALLOCATOR_RESERVE_SIZE, 0, false);
+    SASSERT(out_allocator->memory, "Failed to reserve 0x%lx bytes for the block allocator.", BLOCK_ALLOCATOR_RESERVE_SIZE);
 }
 
 void block_allocator_destroy(block_allocator_t* allocator) {
-    sfree(allocator->buffer, allocator->block_count * allocator->block_size, MEMORY_TAG_ALLOCATOR);
+    if (allocator->memory) {
+        platform_release_memory(allocator->memory, BLOCK_ALLOCATOR_RESERVE_SIZE);
+        allocator->memory = NULL;
+    }
+    if (allocator->pages) {
+        sfree(allocator->pages, sizeof(block_allocator_page_t*) * allocator->page_count, MEMORY_TAG_ALLOCATOR);
+    }
+    allocator->pages = NULL;
+    allocator->partial_pages = NULL;
+    allocator->page_count = 0;
 }
 
-void* block_allocator_allocate(block_allocator_t* allocator) {
-    if (allocator->first_block == NULL) {
-        SCRITICAL("Cannot allocate, no blocks remaining.");
+// Adds a page with all blocks free, reusing the index of a released page if there is one. NULL if the reservation is
+// used up.
+static block_allocator_page_t* block_allocator_add_page(block_allocator_t* allocator) {
+    u32 index = 0;
+    while (index < allocator->page_count && allocator->pages[index]) {
+        index++;
+    }
+    if (index == allocator->page_count) {
+        const u32 page_count = smax(allocator->page_count * 2, 4);
+        allocator->pages = sreallocate(allocator->pages,
+                sizeof(block_allocator_page_t*) * allocator->page_count,
+                sizeof(block_allocator_page_t*) * page_count,
+                MEMORY_TAG_ALLOCATOR);
+        allocator->page_count = page_count;
+    }
+
+    block_allocator_page_t* page = allocator->memory + index * allocator->page_stride;
+    if ((index + 1) * allocator->page_stride > BLOCK_ALLOCATOR_RESERVE_SIZE || !platform_commit_memory(page, allocator->page_stride)) {
+        SERROR("block_allocator_add_page - Failed to commit page %d.", index);
         return NULL;
     }
+    const u64 bitmap_size = block_allocator_bitmap_size(allocator);
+    const u64 page_size = block_allocator_page_size(allocator);
+    page->allocated = (void*)page + sizeof(block_allocator_page_t);
+    page->blocks = (void*)page + page_size - (u64)allocator->page_block_count * allocator->block_stride;
+    page->index = index;
+    page->used_count = 0;
+    szero_memory(page->allocated, bitmap_size);
 
-    block_allocator_block_t* block = allocator->first_block;
-    block->magic = 0;
-    allocator->first_block = block->next;
-    // szero_memory(block, sizeof(block_allocator_block_t));
+    // Link the blocks in address order
+    page->first_block = page->blocks;
+    for (u32 i = 0; i < allocator->page_block_count; i++) {
+        block_allocator_block_t* block = page->blocks + (u64)i * allocator->block_stride;
+        block->next = i + 1 < allocator->page_block_count ? (void*)block + allocator->block_stride : NULL;
+    }
+
+    allocator->pages[index] = page;
+    block_allocator_push_page(allocator, page);
+    return page;
+}
+
+void* block_allocator_allocate(block_allocator_t* allocator) {
+    block_allocator_page_t* page = allocator->partial_pages;
+    if (!page) {
+        page = block_allocator_add_page(allocator);
+        if (!page) {
+            return NULL;
+        }
+    }
+
+    block_allocator_block_t* block = page->first_block;
+    page->first_block = block->next;
+    page->used_count++;
+    if (page->used_count == allocator->page_block_count) {
+        block_allocator_remove_page(allocator, page);
+    }
 
+    const u32 block_index = ((void*)block - page->blocks) / allocator->block_stride;
+    page->allocated[block_index / 64] |= 1ull << (block_index % 64);
     return block;
 }
 
+// Page owning block, found from the block's offset into the reservation. NULL if block is not from this allocator.
+SINLINE block_allocator_page_t* block_allocator_page_of(const block_allocator_t* allocator, const void* block) {
+    const u64 index = (u64)(block - allocator->memory) / allocator->page_stride;
+    if (block < allocator->memory || index >= allocator->page_count) {
+        return NULL;
+    }
+    block_allocator_page_t* page = allocator->pages[index];
+    const u64 blocks_size = (u64)allocator->page_block_count * allocator->block_stride;
+    if (!page || block < page->blocks || block >= page->blocks + blocks_size) {
+        return NULL;
+    }
+    return page;
+}
+
 void block_allocator_free(block_allocator_t* allocator, void* block) {
-    SASSERT(block >= allocator->buffer && block < allocator->buffer + allocator->block_count * allocator->block_size, 
-            "Cannot free block %p: Outsize of memory range (%p - %p)", 
-            block, 
-            allocator->buffer, 
-            allocator->buffer + allocator->block_size * allocator->block_count);
+    block_allocator_page_t* page = block_allocator_page_of(allocator, block);
+    SASSERT(page, "Cannot free block %p: Not allocated from this block allocator.", block);
+
+    const u32 block_index = (block - page->blocks) / allocator->block_stride;
+    SASSERT(page->allocated[block_index / 64] & (1ull << (block_index % 64)), "Block allocator double free of block %p.", block);
+    page->allocated[block_index / 64] &= ~(1ull << (block_index % 64));
 
     block_allocator_block_t* _block = block;
-    _block->magic = BLOCK_ALLOCATOR_MAGIC;
-    _block->next = allocator->first_block;
-    allocator->first_block = _block;
-}
+    _block->next = page->first_block;
+    page->first_block = _block;
+    page->used_count--;
 
-void block_allocator_zero_unused_blocks(block_allocator_t* allocator) {
-    block_allocator_block_t* block = allocator->first_block;
-    while (block) {
-        block_allocator_block_t* next_block = block->next;
-        szero_memory(block, allocator->block_size);
-        block = next_block;
+    if (!page->partial) {
+        block_allocator_push_page(allocator, page);
+    }
+    if (page->used_count == 0 && allocator->release_empty_pages) {
+        block_allocator_remove_page(allocator, page);
+        allocator->pages[page->index] = NULL;
+        // The page stays committed, its index is reused by the next page that is added
+        platform_decommit_memory(page, allocator->page_stride);
     }
 }
+
+u32 block_allocator_index_of(const block_allocator_t* allocator, const void* block) {
+    const block_allocator_page_t* page = block_allocator_page_of(allocator, block);
+    SASSERT(page, "Block %p was not allocated from this block allocator.", block);
+    return page->index * allocator->page_block_count + (block - page->blocks) / allocator->block_stride;
+}
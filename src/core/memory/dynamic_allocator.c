@@ -1,41 +1,349 @@
 #include "Spark/memory/dynamic_allocator.h"
+#include "Spark/core/logging.h"
+#include "Spark/math/smath.h"
 #include "Spark/memory/freelist.h"
 #include "Spark/platform/platform.h"
+#include "Spark/threading/spinlock.h"
+#include "Spark/threading/thread_slots.h"
+
+// Space of a region that can not be handed out, see freelist_create
+#define DYNAMIC_ALLOCATOR_REGION_OVERHEAD (sizeof(freelist_block_t) * 4 + 16)
+
+// Thread slots index into dynamic_allocator_t::caches. Threads that find every slot taken run uncached until one is
+// released by dynamic_allocator_release_thread_slot.
+static thread_slots_t thread_cache_slots;
+static thread_local u32 thread_cache_slot = INVALID_ID;
+
+// Set while this thread creates a region, the region's mutex must not be allocated from the allocator itself
+static thread_local b8 creating_region = false;
+
+// Region owning each DYNAMIC_ALLOCATOR_RESERVE_SIZE aligned slot of the address space, shared by all allocators.
+// Reserved once and committed lazily by the OS, only the touched pages of the map take up memory.
+static dynamic_allocator_t** region_map = NULL;
+
+SINLINE dynamic_allocator_t* dynamic_allocator_next(dynamic_allocator_t* allocator) {
+    return __atomic_load_n(&allocator->next_allocator, __ATOMIC_ACQUIRE);
+}
+
+SINLINE b8 dynamic_allocator_region_contains(const dynamic_allocator_t* region, const void* data) {
+    return data >= region->freelist.memory && data < region->freelist.memory + region->reserved_size;
+}
+
+SINLINE dynamic_allocator_cache_t* dynamic_allocator_thread_cache(dynamic_allocator_t* allocator) {
+    if (thread_cache_slot == INVALID_ID) {
+        thread_cache_slot = thread_slots_acquire(&thread_cache_slots);
+    }
+    if (!allocator->caches || thread_cache_slot == INVALID_ID) {
+        return NULL;
+    }
+    return &allocator->caches[thread_cache_slot];
+}
+
+// Smallest class that can hold size. size must be <= DYNAMIC_ALLOCATOR_CACHE_MAX_SIZE
+SINLINE u32 dynamic_allocator_size_class(u64 size) {
+    if (size <= DYNAMIC_ALLOCATOR_CACHE_MIN_SIZE) {
+        return 0;
+    }
+    return 64 - __builtin_clzll(size - 1) - 5;
+}
+
+// Largest class a block of size bytes can serve. size must be >= DYNAMIC_ALLOCATOR_CACHE_MIN_SIZE
+SINLINE u32 dynamic_allocator_block_class(u64 size) {
+    return 63 - __builtin_clzll(size) - 5;
+}
+
+SINLINE u64 dynamic_allocator_class_size(u32 size_class) {
+    return DYNAMIC_ALLOCATOR_CACHE_MIN_SIZE << size_class;
+}
+
+SINLINE u64 dynamic_allocator_region_index(const void* data) {
+    return (u64)data >> DYNAMIC_ALLOCATOR_RESERVE_SIZE_LOG2;
+}
+
+static void dynamic_allocator_create_region(u64 memory_size, dynamic_allocator_t* root, dynamic_allocator_t* out_allocator) {
+    SASSERT(memory_size <= DYNAMIC_ALLOCATOR_RESERVE_SIZE, "Dynamic allocator regions cannot be larger than 0x%lx bytes.", DYNAMIC_ALLOCATOR_RESERVE_SIZE);
+    void* memory = platform_reserve_memory(DYNAMIC_ALLOCATOR_RESERVE_SIZE, DYNAMIC_ALLOCATOR_RESERVE_SIZE, DYNAMIC_ALLOCATOR_HUGE_PAGES);
+    SASSERT(memory, "Failed to reserve 0x%lx bytes for the dynamic allocator.", DYNAMIC_ALLOCATOR_RESERVE_SIZE);
+    SASSERT(dynamic_allocator_region_index(memory) < DYNAMIC_ALLOCATOR_REGION_MAP_SIZE, "Dynamic allocator region %p is outside of the region map.", memory);
+    platform_commit_memory(memory, memory_size);
 
-void dynamic_allocator_create(u64 memory_size, dynamic_allocator_t* out_allocator) {
-    void* memory = platform_allocate(memory_size, true);
     freelist_create(memory, memory_size, &out_allocator->freelist);
+    out_allocator->freelist.decommit_size = DYNAMIC_ALLOCATOR_DECOMMIT_SIZE;
     out_allocator->memory_size = memory_size;
+    out_allocator->committed_size = memory_size;
+    out_allocator->reserved_size = DYNAMIC_ALLOCATOR_RESERVE_SIZE;
+    out_allocator->committing = false;
     out_allocator->next_allocator = NULL;
+    out_allocator->root = root;
+    out_allocator->caches = NULL;
+
+    __atomic_store_n(&region_map[dynamic_allocator_region_index(memory)], out_allocator, __ATOMIC_RELEASE);
 }
+
+void dynamic_allocator_create(u64 memory_size, dynamic_allocator_t* out_allocator) {
+    if (!__atomic_load_n(&region_map, __ATOMIC_ACQUIRE)) {
+        const u64 map_size = sizeof(dynamic_allocator_t*) * DYNAMIC_ALLOCATOR_REGION_MAP_SIZE;
+        dynamic_allocator_t** map = platform_reserve_memory(map_size, 0, false);
+        platform_commit_memory(map, map_size);
+
+        dynamic_allocator_t** expected = NULL;
+        if (!__atomic_compare_exchange_n(&region_map, &expected, map, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            platform_release_memory(map, map_size);
+        }
+    }
+
+    dynamic_allocator_create_region(memory_size, out_allocator, out_allocator);
+
+    const u64 caches_size = sizeof(dynamic_allocator_cache_t) * DYNAMIC_ALLOCATOR_MAX_THREADS;
+    out_allocator->caches = platform_allocate(caches_size, true);
+    platform_zero_memory(out_allocator->caches, caches_size);
+}
+
 void dynamic_allocator_destroy(dynamic_allocator_t* allocator) {
-    freelist_destroy(&allocator->freelist);
-    if (allocator->next_allocator) {
-        dynamic_allocator_destroy(allocator->next_allocator);
+    if (allocator->caches) {
+        platform_free(allocator->caches, true);
+        allocator->caches = NULL;
+    }
+
+    dynamic_allocator_t* region = allocator;
+    while (region) {
+        dynamic_allocator_t* next = region->next_allocator;
+        freelist_destroy(&region->freelist);
+        __atomic_store_n(&region_map[dynamic_allocator_region_index(region->freelist.memory)], NULL, __ATOMIC_RELEASE);
+        platform_release_memory(region->freelist.memory, region->reserved_size);
+        if (region != allocator) {
+            platform_free(region, true);
+        }
+        region = next;
+    }
+    allocator->next_allocator = NULL;
+}
+
+// Appends a new region to the chain. Threads racing to grow each append their own region.
+static dynamic_allocator_t* dynamic_allocator_grow(dynamic_allocator_t* allocator) {
+    creating_region = true;
+    dynamic_allocator_t* region = platform_allocate(sizeof(dynamic_allocator_t), true);
+    dynamic_allocator_create_region(allocator->memory_size, allocator->root, region);
+    creating_region = false;
+
+    dynamic_allocator_t* expected = NULL;
+    while (!__atomic_compare_exchange_n(&allocator->next_allocator, &expected, region, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        allocator = expected;
+        expected = NULL;
+    }
+    return region;
+}
+
+static dynamic_allocator_t* dynamic_allocator_owner(dynamic_allocator_t* allocator, const void* data) {
+    const u64 index = dynamic_allocator_region_index(data);
+    if (index >= DYNAMIC_ALLOCATOR_REGION_MAP_SIZE) {
+        return NULL;
+    }
+    dynamic_allocator_t* region = __atomic_load_n(&region_map[index], __ATOMIC_ACQUIRE);
+    return region && region->root == allocator->root ? region : NULL;
+}
+
+// Commits more of the region's reservation, enough for a block of size bytes.
+// Returns false if the reservation is used up or the memory could not be committed.
+static b8 dynamic_allocator_commit(dynamic_allocator_t* region, u64 size) {
+    const u64 seen_committed_size = __atomic_load_n(&region->committed_size, __ATOMIC_ACQUIRE);
+    spin_lock(&region->committing);
+
+    // Another thread committed while this one waited, retry the allocation with its memory.
+    // If that thread failed the size did not change and this thread tries again itself.
+    const u64 committed_size = region->committed_size;
+    if (committed_size != seen_committed_size) {
+        spin_unlock(&region->committing);
+        return true;
+    }
+
+    const u64 commit_size = (size + DYNAMIC_ALLOCATOR_REGION_OVERHEAD + region->memory_size - 1) / region->memory_size * region->memory_size;
+    const u64 new_committed_size = smin(committed_size + commit_size, region->reserved_size);
+    const b8 committed = new_committed_size > committed_size &&
+        platform_commit_memory(region->freelist.memory + committed_size, new_committed_size - committed_size);
+    if (committed) {
+        freelist_extend(&region->freelist, new_committed_size);
+        __atomic_store_n(&region->committed_size, new_committed_size, __ATOMIC_RELEASE);
+    }
+
+    spin_unlock(&region->committing);
+    return committed;
+}
+
+// Allocates from the region, committing more of its reservation if needed
+static void* dynamic_allocator_region_allocate(dynamic_allocator_t* region, u64 size) {
+    void* data = freelist_try_allocate(&region->freelist, size);
+    while (!data && dynamic_allocator_commit(region, size)) {
+        data = freelist_try_allocate(&region->freelist, size);
+    }
+    return data;
+}
+
+// Tries every region, then grows the regions' committed memory and only then adds a region
+static void* dynamic_allocator_allocate_uncached(dynamic_allocator_t* allocator, u64 size) {
+    for (dynamic_allocator_t* region = allocator; region; region = dynamic_allocator_next(region)) {
+        void* data = freelist_try_allocate(&region->freelist, size);
+        if (data) {
+            return data;
+        }
+    }
+
+    for (dynamic_allocator_t* region = allocator; region; region = dynamic_allocator_next(region)) {
+        void* data = dynamic_allocator_region_allocate(region, size);
+        if (data) {
+            return data;
+        }
+    }
+
+    // No region has space left, try creating one.
+    return dynamic_allocator_region_allocate(dynamic_allocator_grow(allocator), size);
+}
+
+static void dynamic_allocator_refill_bin(dynamic_allocator_t* allocator, dynamic_allocator_cache_bin_t* bin, u64 class_size) {
+    void* blocks[DYNAMIC_ALLOCATOR_CACHE_BATCH_SIZE];
+    u32 count = 0;
+    for (dynamic_allocator_t* region = allocator; region && count == 0; region = dynamic_allocator_next(region)) {
+        count = freelist_allocate_batch(&region->freelist, class_size, DYNAMIC_ALLOCATOR_CACHE_BATCH_SIZE, blocks);
+    }
+    for (dynamic_allocator_t* region = allocator; region && count == 0; region = dynamic_allocator_next(region)) {
+        while (count == 0 && dynamic_allocator_commit(region, class_size)) {
+            count = freelist_allocate_batch(&region->freelist, class_size, DYNAMIC_ALLOCATOR_CACHE_BATCH_SIZE, blocks);
+        }
+    }
+    if (count == 0) {
+        count = freelist_allocate_batch(&dynamic_allocator_grow(allocator)->freelist, class_size, DYNAMIC_ALLOCATOR_CACHE_BATCH_SIZE, blocks);
+    }
+
+    for (u32 i = 0; i < count; i++) {
+        *(void**)blocks[i] = bin->first_block;
+        bin->first_block = blocks[i];
+    }
+    bin->count += count;
+}
+
+// Returns count blocks of the bin to their freelists, taking each region's lock once
+static void dynamic_allocator_flush_bin(dynamic_allocator_t* allocator, dynamic_allocator_cache_bin_t* bin, u32 count) {
+    void* blocks[DYNAMIC_ALLOCATOR_CACHE_MAX_BLOCKS];
+    count = smin(count, bin->count);
+    for (u32 i = 0; i < count; i++) {
+        blocks[i] = bin->first_block;
+        bin->first_block = *(void**)bin->first_block;
+    }
+    bin->count -= count;
+
+    void** remaining = blocks;
+    while (count > 0) {
+        dynamic_allocator_t* region = dynamic_allocator_owner(allocator, remaining[0]);
+
+        // Move all blocks of this region to the front
+        u32 region_count = 0;
+        for (u32 i = 0; i < count; i++) {
+            if (dynamic_allocator_region_contains(region, remaining[i])) {
+                void* block = remaining[i];
+                remaining[i] = remaining[region_count];
+                remaining[region_count++] = block;
+            }
+        }
+
+        freelist_free_batch(&region->freelist, region_count, remaining);
+        remaining += region_count;
+        count -= region_count;
     }
 }
 
 void* dynamic_allocator_allocate(dynamic_allocator_t* allocator, u64 size) {
-    void* data = freelist_allocate(&allocator->freelist, size);
-    if (data) {
-        return data;
+    if (creating_region || size > allocator->reserved_size - DYNAMIC_ALLOCATOR_REGION_OVERHEAD) {
+        return NULL;
+    }
+
+    dynamic_allocator_cache_t* cache = dynamic_allocator_thread_cache(allocator);
+    if (!cache || size > DYNAMIC_ALLOCATOR_CACHE_MAX_SIZE) {
+        return dynamic_allocator_allocate_uncached(allocator, size);
     }
 
-    // Failed to allocate data, try next allocator
-    if (allocator->next_allocator) {
-        return dynamic_allocator_allocate(allocator->next_allocator, size);
+    const u32 size_class = dynamic_allocator_size_class(size);
+    dynamic_allocator_cache_bin_t* bin = &cache->bins[size_class];
+    if (!bin->first_block) {
+        dynamic_allocator_refill_bin(allocator, bin, dynamic_allocator_class_size(size_class));
+        if (!bin->first_block) {
+            return NULL;
+        }
     }
 
-    // No existing allocator, try creating one.
-    allocator->next_allocator = platform_allocate(sizeof(dynamic_allocator_t), true);
-    dynamic_allocator_create(allocator->memory_size, allocator->next_allocator);
-    return dynamic_allocator_allocate(allocator->next_allocator, size);
+    void* data = bin->first_block;
+    bin->first_block = *(void**)data;
+    bin->count--;
+    return data;
 }
 
 void dynamic_allocator_free(dynamic_allocator_t* allocator, void* data) {
-    while (data < allocator->freelist.memory || data > allocator->freelist.memory + allocator->memory_size) {
-        allocator = allocator->next_allocator;
+    dynamic_allocator_cache_t* cache = dynamic_allocator_thread_cache(allocator);
+    const u64 block_size = freelist_block_size(data);
+
+    // Cache blocks by the largest class they can serve, larger blocks would waste too much space
+    if (cache && block_size >= DYNAMIC_ALLOCATOR_CACHE_MIN_SIZE && block_size < DYNAMIC_ALLOCATOR_CACHE_MAX_SIZE * 2) {
+        dynamic_allocator_cache_bin_t* bin = &cache->bins[dynamic_allocator_block_class(block_size)];
+        *(void**)data = bin->first_block;
+        bin->first_block = data;
+        bin->count++;
+
+        if (bin->count > DYNAMIC_ALLOCATOR_CACHE_MAX_BLOCKS) {
+            dynamic_allocator_flush_bin(allocator, bin, DYNAMIC_ALLOCATOR_CACHE_MAX_BLOCKS / 2);
+        }
+        return;
+    }
+
+    dynamic_allocator_t* region = dynamic_allocator_owner(allocator, data);
+    SASSERT(region, "Freeing %p, which is not owned by the dynamic allocator.", data);
+    freelist_free(&region->freelist, data);
+}
+
+void* dynamic_allocator_reallocate(dynamic_allocator_t* allocator, void* data, u64 size) {
+    if (!data) {
+        return dynamic_allocator_allocate(allocator, size);
+    }
+    if (creating_region || size > allocator->reserved_size - DYNAMIC_ALLOCATOR_REGION_OVERHEAD) {
+        return NULL;
+    }
+
+    dynamic_allocator_t* region = dynamic_allocator_owner(allocator, data);
+    SASSERT(region, "Reallocating %p, which is not owned by the dynamic allocator.", data);
+    void* new_data = freelist_reallocate(&region->freelist, data, size);
+    if (new_data) {
+        return new_data;
     }
 
-    freelist_free(&allocator->freelist, data);
+    // The owning region is full, move to another one
+    new_data = dynamic_allocator_allocate_uncached(allocator, size);
+    if (new_data) {
+        scopy_memory(new_data, data, smin(freelist_block_size(data), size));
+        freelist_free(&region->freelist, data);
+    }
+    return new_data;
+}
+
+b8 dynamic_allocator_owns(dynamic_allocator_t* allocator, const void* data) {
+    return dynamic_allocator_owner(allocator, data) != NULL;
+}
+
+void dynamic_allocator_flush_thread_cache(dynamic_allocator_t* allocator) {
+    // A thread without a slot has nothing cached, do not claim one just to flush it
+    if (thread_cache_slot == INVALID_ID || !allocator->caches) {
+        return;
+    }
+    dynamic_allocator_cache_t* cache = &allocator->caches[thread_cache_slot];
+
+    for (u32 i = 0; i < DYNAMIC_ALLOCATOR_CACHE_CLASS_COUNT; i++) {
+        dynamic_allocator_cache_bin_t* bin = &cache->bins[i];
+        while (bin->count > 0) {
+            dynamic_allocator_flush_bin(allocator, bin, DYNAMIC_ALLOCATOR_CACHE_MAX_BLOCKS);
+        }
+    }
+}
+
+void dynamic_allocator_release_thread_slot() {
+    if (thread_cache_slot != INVALID_ID) {
+        thread_slots_release(&thread_cache_slots, thread_cache_slot);
+        thread_cache_slot = INVALID_ID;
+    }
 }
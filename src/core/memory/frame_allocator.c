@@ -0,0 +1,81 @@
+#include "Spark/memory/frame_allocator.h"
+#include "Spark/core/logging.h"
+
+typedef struct frame_allocator_overflow {
+    struct frame_allocator_overflow* next;
+    u64 size;
+} SALIGNED(FRAME_ALLOCATOR_ALIGNMENT) frame_allocator_overflow_t;
+
+static frame_allocator_t frame_allocator;
+
+void frame_allocator_initialize(u64 frame_size) {
+    for (u32 i = 0; i < FRAME_ALLOCATOR_FRAME_COUNT; i++) {
+        linear_allocator_create(frame_size, NULL, &frame_allocator.frames[i]);
+        frame_allocator.overflow[i] = NULL;
+    }
+    frame_allocator.overflow_bytes = 0;
+    frame_allocator.overflow_count = 0;
+    frame_allocator.last_frame_stats = (frame_allocator_stats_t) {};
+    frame_allocator.current_frame = 0;
+}
+
+static void frame_allocator_free_overflow(u32 frame) {
+    frame_allocator_overflow_t* overflow = frame_allocator.overflow[frame];
+    while (overflow) {
+        frame_allocator_overflow_t* next = overflow->next;
+        sfree(overflow, overflow->size, MEMORY_TAG_ALLOCATOR);
+        overflow = next;
+    }
+    frame_allocator.overflow[frame] = NULL;
+}
+
+void frame_allocator_shutdown() {
+    for (u32 i = 0; i < FRAME_ALLOCATOR_FRAME_COUNT; i++) {
+        frame_allocator_free_overflow(i);
+        linear_allocator_destroy(&frame_allocator.frames[i]);
+    }
+}
+
+void* frame_alloc(u64 size) {
+    linear_allocator_t* frame = &frame_allocator.frames[frame_allocator.current_frame];
+    size = (size + FRAME_ALLOCATOR_ALIGNMENT - 1) & ~((u64)FRAME_ALLOCATOR_ALIGNMENT - 1);
+
+    if (frame->allocated + size <= frame->total_size) {
+        void* block = frame->memory + frame->allocated;
+        frame->allocated += size;
+        return block;
+    }
+
+    // Out of space, fall back to the general allocator for the rest of the frame. Reported once at the end of the frame
+    frame_allocator.overflow_bytes += size;
+    frame_allocator.overflow_count++;
+    const u64 overflow_size = sizeof(frame_allocator_overflow_t) + size;
+    frame_allocator_overflow_t* overflow = sallocate(overflow_size, MEMORY_TAG_ALLOCATOR);
+    overflow->size = overflow_size;
+    overflow->next = frame_allocator.overflow[frame_allocator.current_frame];
+    frame_allocator.overflow[frame_allocator.current_frame] = overflow;
+    return (void*)overflow + sizeof(frame_allocator_overflow_t);
+}
+
+void frame_allocator_end_frame() {
+    frame_allocator_stats_t* stats = &frame_allocator.last_frame_stats;
+    stats->used_bytes = frame_allocator.frames[frame_allocator.current_frame].allocated + frame_allocator.overflow_bytes;
+    stats->overflow_bytes = frame_allocator.overflow_bytes;
+    stats->overflow_count = frame_allocator.overflow_count;
+    if (stats->overflow_count > 0) {
+        SWARN("Frame allocator ran out of space, %u allocations of %lu bytes past the %lu byte frame went to the general allocator.",
+                stats->overflow_count, stats->overflow_bytes, frame_allocator.frames[frame_allocator.current_frame].total_size);
+    }
+    frame_allocator.overflow_bytes = 0;
+    frame_allocator.overflow_count = 0;
+
+    frame_allocator.current_frame = (frame_allocator.current_frame + 1) % FRAME_ALLOCATOR_FRAME_COUNT;
+
+    // The frame being reused was last written FRAME_ALLOCATOR_FRAME_COUNT frames ago
+    linear_allocator_reset(&frame_allocator.frames[frame_allocator.current_frame]);
+    frame_allocator_free_overflow(frame_allocator.current_frame);
+}
+
+void frame_allocator_get_stats(frame_allocator_stats_t* out_stats) {
+    *out_stats = frame_allocator.last_frame_stats;
+}
@@ -21,37 +21,126 @@ typedef struct freelist_explicit {
     struct freelist_explicit* previous;
 } freelist_explicit_t;
 
-void freelist_create(void* memory, u64 memory_size, freelist_t* out_allocator) {
-    _SASSERT(memory_size >= FREELIST_MINIMUM_MEMORY_SIZE, "Cannot create freelist with memory size less than %d", FREELIST_MINIMUM_MEMORY_SIZE);
-    out_allocator->memory = memory;
+// Smallest block that can be split off, it has to hold the explicit list pointers
+#define FREELIST_MINIMUM_BLOCK_SIZE 32
 
-    u32 usable_size = memory_size - sizeof(freelist_block_t) * 4;
+#define freelist_block_of(explicit) ((freelist_block_t*)((void*)(explicit) - sizeof(freelist_block_t)))
+#define freelist_block_footer(block) ((freelist_block_t*)((void*)(block) + sizeof(freelist_block_t) + (block)->size))
 
-    // Create first block
-    freelist_block_t* block = out_allocator->memory + sizeof(freelist_block_t);
-    block->size             = usable_size;
-    block->allocated        = FREELIST_FREE_MAGIC;
+SINLINE u32 freelist_msb(u64 value) {
+    return 63 - __builtin_clzll(value);
+}
 
-    freelist_block_t* block_end = out_allocator->memory + sizeof(freelist_block_t) * 2 + usable_size;
-    block_end->size             = usable_size;
-    block_end->allocated        = FREELIST_FREE_MAGIC;
+// Bin a block of exactly size bytes belongs to
+SINLINE void freelist_mapping_insert(u64 size, u32* out_fl, u32* out_sl) {
+    if (size < (1 << FREELIST_FL_INDEX_SHIFT)) {
+        *out_fl = 0;
+        *out_sl = size >> FREELIST_ALIGNMENT_LOG2;
+        return;
+    }
+
+    const u32 msb = freelist_msb(size);
+    *out_sl = (size >> (msb - FREELIST_SL_INDEX_COUNT_LOG2)) ^ FREELIST_SL_INDEX_COUNT;
+    *out_fl = msb - FREELIST_FL_INDEX_SHIFT + 1;
+}
+
+// First bin whose blocks are all at least size bytes, so any block found there fits without searching the list
+SINLINE void freelist_mapping_search(u64 size, u32* out_fl, u32* out_sl) {
+    if (size >= (1 << FREELIST_FL_INDEX_SHIFT)) {
+        size += (1ull << (freelist_msb(size) - FREELIST_SL_INDEX_COUNT_LOG2)) - 1;
+    }
+    freelist_mapping_insert(size, out_fl, out_sl);
+}
+
+static void freelist_insert_block(freelist_t* allocator, freelist_block_t* block) {
+    u32 fl, sl;
+    freelist_mapping_insert(block->size, &fl, &sl);
 
     freelist_explicit_t* explicit = (void*)block + sizeof(freelist_block_t);
-    explicit->next     = NULL;
     explicit->previous = NULL;
-    out_allocator->first_free_block  = explicit;
+    explicit->next = allocator->free_blocks[fl][sl];
+    if (explicit->next) {
+        explicit->next->previous = explicit;
+    }
+    allocator->free_blocks[fl][sl] = explicit;
+
+    allocator->fl_bitmap |= 1u << fl;
+    allocator->sl_bitmap[fl] |= 1u << sl;
+}
+
+static void freelist_remove_block(freelist_t* allocator, freelist_block_t* block) {
+    u32 fl, sl;
+    freelist_mapping_insert(block->size, &fl, &sl);
+
+    freelist_explicit_t* explicit = (void*)block + sizeof(freelist_block_t);
+    if (explicit->next) {
+        explicit->next->previous = explicit->previous;
+    }
+    if (explicit->previous) {
+        explicit->previous->next = explicit->next;
+    } else {
+        allocator->free_blocks[fl][sl] = explicit->next;
+        if (!explicit->next) {
+            allocator->sl_bitmap[fl] &= ~(1u << sl);
+            if (!allocator->sl_bitmap[fl]) {
+                allocator->fl_bitmap &= ~(1u << fl);
+            }
+        }
+    }
+}
+
+// Finds a bin at or above (fl, sl) that has a free block
+static freelist_block_t* freelist_find_block(freelist_t* allocator, u32 fl, u32 sl) {
+    if (fl >= FREELIST_FL_INDEX_COUNT) {
+        return NULL;
+    }
+
+    u32 sl_map = allocator->sl_bitmap[fl] & (~0u << sl);
+    if (!sl_map) {
+        const u32 fl_map = fl + 1 < 32 ? allocator->fl_bitmap & (~0u << (fl + 1)) : 0;
+        if (!fl_map) {
+            return NULL;
+        }
+        fl = __builtin_ctz(fl_map);
+        sl_map = allocator->sl_bitmap[fl];
+    }
+    sl = __builtin_ctz(sl_map);
+    return freelist_block_of(allocator->free_blocks[fl][sl]);
+}
+
+SINLINE void freelist_set_block(freelist_block_t* block, u32 size, u32 magic) {
+    block->size = size;
+    block->allocated = magic;
+    freelist_block_t* footer = freelist_block_footer(block);
+    footer->size = size;
+    footer->allocated = magic;
+}
 
-    // Set end of memory block
+void freelist_create(void* memory, u64 memory_size, freelist_t* out_allocator) {
+    _SASSERT(memory_size >= FREELIST_MINIMUM_MEMORY_SIZE, "Cannot create freelist with memory size less than %d", FREELIST_MINIMUM_MEMORY_SIZE);
+    out_allocator->memory = memory;
+    out_allocator->fl_bitmap = 0;
+    szero_memory(out_allocator->sl_bitmap, sizeof(out_allocator->sl_bitmap));
+    szero_memory(out_allocator->free_blocks, sizeof(out_allocator->free_blocks));
+
+    // Keep data 16 byte aligned
+    u32 usable_size = (memory_size - sizeof(freelist_block_t) * 4) & ~((1u << FREELIST_ALIGNMENT_LOG2) - 1);
+
+    // Set end of memory block, these are never free so blocks do not coalesce past them
     freelist_block_t* leading_block = out_allocator->memory;
     leading_block->size = 0;
     leading_block->allocated = FREELIST_ALLOCATED_MAGIC;
 
-    freelist_block_t* trailing_block = out_allocator->memory + memory_size - sizeof(freelist_block_t);
+    // Create first block
+    freelist_block_t* block = out_allocator->memory + sizeof(freelist_block_t);
+    freelist_set_block(block, usable_size, FREELIST_FREE_MAGIC);
+    freelist_insert_block(out_allocator, block);
+
+    freelist_block_t* trailing_block = (void*)freelist_block_footer(block) + sizeof(freelist_block_t);
     trailing_block->size = 0;
     trailing_block->allocated = FREELIST_ALLOCATED_MAGIC;
-#ifdef SPARK_DEBUG
     out_allocator->capacity = memory_size;
-#endif
+    out_allocator->decommit_size = 0;
 
     mutex_create(&out_allocator->mutex);
 }
@@ -60,266 +149,273 @@ void freelist_destroy(freelist_t* allocator) {
     mutex_destroy(&allocator->mutex);
 }
 
-void* freelist_allocate(freelist_t* allocator, u64 size) {
-    mutex_lock(allocator->mutex);
-    _SASSERT(allocator->memory, "Freelist has not been initialized or was not assigned memory.");
-    size = smax(size, 32);
+// Trailing sentinel of a freelist managing memory_size bytes, see freelist_create
+SINLINE freelist_block_t* freelist_trailing_block(void* memory, u64 memory_size) {
+    const u64 usable_size = (memory_size - sizeof(freelist_block_t) * 4) & ~((1ull << FREELIST_ALIGNMENT_LOG2) - 1);
+    return memory + usable_size + sizeof(freelist_block_t) * 3;
+}
 
-    u32 padding = 16 - (size % 16);
-    if (padding) {
-        size += padding;
+void freelist_extend(freelist_t* allocator, u64 memory_size) {
+    mutex_lock(allocator->mutex);
+    freelist_block_t* trailing_block = freelist_trailing_block(allocator->memory, allocator->capacity);
+    freelist_block_t* new_trailing_block = freelist_trailing_block(allocator->memory, memory_size);
+    const u64 added_size = (void*)new_trailing_block - (void*)trailing_block;
+    if (memory_size <= allocator->capacity || added_size < FREELIST_MINIMUM_BLOCK_SIZE + sizeof(freelist_block_t) * 2) {
+        mutex_unlock(allocator->mutex);
+        return;
     }
 
-    freelist_explicit_t* explicit = allocator->first_free_block;
-    while (explicit) {
-        freelist_block_t* block = (void*)explicit - sizeof(freelist_block_t);
-
-        // Check if block can contain allocation
-        if (size > block->size) {
-            explicit = explicit->next;
-            continue;
-        }
-
-        // It can
-        // Split the block into the allocation and a new block
-        const u32 remaining_size = block->size - size;
-
-        freelist_block_t* block_end = ((void*)block) + sizeof(freelist_block_t) + block->size;
-        _SASSERT(block->allocated == FREELIST_FREE_MAGIC, "Allocating already allocated block.");
-        _SASSERT(block_end->allocated == FREELIST_FREE_MAGIC, "Allocating already allocated block.");
-
-        const b8 split_block = sizeof(freelist_block_t) * 2 < remaining_size;
-        if (split_block) {
-            freelist_block_t* new_block = ((void*)block) + sizeof(freelist_block_t) * 2 + size;
-            freelist_explicit_t* new_explicit = (void*)new_block + sizeof(freelist_block_t);
-            new_block->size = remaining_size - sizeof(freelist_block_t) * 2;
-            new_block->allocated = FREELIST_FREE_MAGIC;
-
-            block_end->size = new_block->size;
-            block_end->allocated = FREELIST_FREE_MAGIC;
-            block_end = ((void*)block) + sizeof(freelist_block_t) + size;
-
-
-            new_explicit->next = explicit->next;
-            new_explicit->previous = explicit->previous;
-
-            _SASSERT((void*)new_explicit >= allocator->memory && (void*)new_explicit < allocator->memory + allocator->capacity, "Creating new explicit pointer at invalid address.");
-            _SASSERT(((void*)new_explicit->next >= allocator->memory && (void*)new_explicit->next < allocator->memory + allocator->capacity) || new_explicit->next == 0, "Setting new explicit pointer to invalid address.");
-            _SASSERT(((void*)new_explicit->previous >= allocator->memory && (void*)new_explicit->previous < allocator->memory + allocator->capacity) || new_explicit->previous == 0, "Setting new explicit pointer to invalid address.");
+    // The added memory starts where the old trailing sentinel was, merge it with the last block if that one is free
+    freelist_block_t* block = trailing_block;
+    u64 size = added_size - sizeof(freelist_block_t) * 2;
+    freelist_block_t* previous_footer = (void*)trailing_block - sizeof(freelist_block_t);
+    if (previous_footer->allocated == FREELIST_FREE_MAGIC) {
+        block = (void*)previous_footer - previous_footer->size - sizeof(freelist_block_t);
+        freelist_remove_block(allocator, block);
+        size += block->size + sizeof(freelist_block_t) * 2;
+    }
+    SASSERT(size <= 0xFFFFFFFFull, "Freelist cannot manage blocks of 0x%lx bytes.", size);
 
-            if (explicit->next) {
-                explicit->next->previous = new_explicit;
-            }
-            if (explicit->previous) {
-                explicit->previous->next = new_explicit;
-            }
+    freelist_set_block(block, size, FREELIST_FREE_MAGIC);
+    freelist_insert_block(allocator, block);
 
-            // NOTE: Following block is equivalent and is marginally faster
-            if (explicit == allocator->first_free_block) {
-                allocator->first_free_block = new_explicit;
-            }
+    new_trailing_block->size = 0;
+    new_trailing_block->allocated = FREELIST_ALLOCATED_MAGIC;
+    allocator->capacity = memory_size;
+    mutex_unlock(allocator->mutex);
+}
 
-            _SASSERT(allocator->first_free_block->previous == NULL, "Allocation: First explicit cannot have previous.");
-            // const u8 replace_first_block = explicit == allocator->first_free_block;
-            // allocator->first_free_block = (void*)((size_t)allocator->first_free_block * (!replace_first_block)
-            //     + (size_t)new_explicit * replace_first_block);
-        } else {
-            if (explicit->next) {
-                explicit->next->previous = explicit->previous;
-            }
-            if (explicit->previous) {
-                explicit->previous->next = explicit->next;
-            } else {
-                allocator->first_free_block = explicit->next;
-            }
+// Allocates without locking, returns NULL if no block is large enough
+static void* pvt_freelist_allocate(freelist_t* allocator, u64 size) {
+    _SASSERT(allocator->memory, "Freelist has not been initialized or was not assigned memory.");
+    size = smax(size, FREELIST_MINIMUM_BLOCK_SIZE);
+    size = (size + (1 << FREELIST_ALIGNMENT_LOG2) - 1) & ~((1ull << FREELIST_ALIGNMENT_LOG2) - 1);
+    if (size > 0xFFFFFFFFull - (1 << FREELIST_FL_INDEX_SHIFT)) {
+        return NULL;
+    }
 
-            size = block->size;
-            block_end = (void*)block + block->size + sizeof(freelist_block_t);
-            _SASSERT(allocator->first_free_block->previous == NULL, "Allocation else: First explicit cannot have previous.");
-            // block_end = (void*)block + sizeof(freelist_block_t) + block->size;
+    u32 fl, sl;
+    freelist_mapping_search(size, &fl, &sl);
+    freelist_block_t* block = freelist_find_block(allocator, fl, sl);
+    if (!block) {
+        // Blocks in the bin the size maps to might still fit, only happens when close to running out of space
+        freelist_mapping_insert(size, &fl, &sl);
+        freelist_explicit_t* explicit = allocator->free_blocks[fl][sl];
+        while (explicit && freelist_block_of(explicit)->size < size) {
+            explicit = explicit->next;
         }
+        if (!explicit) {
+            return NULL;
+        }
+        block = freelist_block_of(explicit);
+    }
+    _SASSERT(block->allocated == FREELIST_FREE_MAGIC, "Allocating already allocated block.");
+    _SASSERT(block->size >= size, "Freelist bin contains block that is too small.");
+    freelist_remove_block(allocator, block);
+
+    // Split the block into the allocation and a new free block if the remainder is usable
+    const u32 remaining_size = block->size - size;
+    if (remaining_size >= FREELIST_MINIMUM_BLOCK_SIZE + sizeof(freelist_block_t) * 2) {
+        freelist_set_block(block, size, FREELIST_ALLOCATED_MAGIC);
+
+        freelist_block_t* new_block = (void*)freelist_block_footer(block) + sizeof(freelist_block_t);
+        freelist_set_block(new_block, remaining_size - sizeof(freelist_block_t) * 2, FREELIST_FREE_MAGIC);
+        freelist_insert_block(allocator, new_block);
+    } else {
+        freelist_set_block(block, block->size, FREELIST_ALLOCATED_MAGIC);
+    }
 
-        // Create a new allocation
-        block_end->size      = size;
-        block_end->allocated = FREELIST_ALLOCATED_MAGIC;
-
-        block->size          = size;
-        block->allocated     = FREELIST_ALLOCATED_MAGIC;
+    return ((void*)block) + sizeof(freelist_block_t);
+}
 
-        mutex_unlock(allocator->mutex);
-        return ((void*)block) + sizeof(freelist_block_t);
+void* freelist_allocate(freelist_t* allocator, u64 size) {
+    mutex_lock(allocator->mutex);
+    void* block = pvt_freelist_allocate(allocator, size);
+    mutex_unlock(allocator->mutex);
+    if (block) {
+        return block;
     }
 
-    mutex_unlock(allocator->mutex);
 #ifdef SPARK_DEBUG
-    explicit = allocator->first_free_block;
-    SERROR("Freelist failed to allocate 0x%x bytes.", size);
-    while (explicit) {
-        freelist_block_t* block = (void*)explicit - sizeof(freelist_block_t);
-        SERROR("\tBlock Size: 0x%x", block->size);
-        explicit = explicit->next;
-    }
+    SERROR("Freelist failed to allocate 0x%x bytes. Largest free block: 0x%x", size, freelist_largest_free_block(allocator));
 #endif
     SCRITICAL("Freelist failed to allocate block.");
     return NULL;
 }
 
-void freelist_free(freelist_t* allocator, void* address) {
+void* freelist_try_allocate(freelist_t* allocator, u64 size) {
     mutex_lock(allocator->mutex);
+    void* block = pvt_freelist_allocate(allocator, size);
+    mutex_unlock(allocator->mutex);
+    return block;
+}
+
+u32 freelist_allocate_batch(freelist_t* allocator, u64 size, u32 count, void** out_blocks) {
+    mutex_lock(allocator->mutex);
+    u32 allocated = 0;
+    while (allocated < count) {
+        void* block = pvt_freelist_allocate(allocator, size);
+        if (!block) {
+            break;
+        }
+        out_blocks[allocated++] = block;
+    }
+    mutex_unlock(allocator->mutex);
+    return allocated;
+}
+
+// Start of the first whole decommit page inside a free block, past its header and list pointers
+SINLINE void* freelist_pages_start(const freelist_t* allocator, const freelist_block_t* block) {
+    const u64 page_mask = allocator->decommit_size - 1;
+    return (void*)(((u64)block + sizeof(freelist_block_t) + sizeof(freelist_explicit_t) + page_mask) & ~page_mask);
+}
+
+// End of the last whole decommit page inside a free block, before its footer
+SINLINE void* freelist_pages_end(const freelist_t* allocator, const freelist_block_t* block) {
+    return (void*)((u64)freelist_block_footer(block) & ~(allocator->decommit_size - 1));
+}
+
+// Frees without locking, coalescing with free neighbours
+static void pvt_freelist_free(freelist_t* allocator, void* address) {
     _SASSERT(address != NULL, "Freelist cannot free null address.");
     _SASSERT(address >= allocator->memory && address <= allocator->memory + allocator->capacity, "Cannot free address not owned by freelist. %p <= %p <= %p", allocator->memory, address, allocator->memory + allocator->capacity);
 
-    // get allocation
     freelist_block_t* block = address - sizeof(freelist_block_t);
-    freelist_block_t* block_header = address + block->size;
-
-    _SASSERT(block_header->size > 0 && block_header->size != INVALID_ID, "Invalid block header size. 0x%x", block->size);
     _SASSERT(block->size > 0 && block->size != INVALID_ID, "Invalid block size. 0x%x", block->size);
     _SASSERT(block->allocated == FREELIST_ALLOCATED_MAGIC, "Freelist double-free detected. Cannot free unallocated block.");
-
-    // Convert allocation to block
-    enum coalesce_state {
-        coalesce_state_default = 0,
-        coalesce_state_previous = 1,
-        coalesce_state_next = 2,
-        coalesce_state_all = 3,
-    };
-
-    freelist_explicit_t* new_explicit = address;
-    new_explicit->next = NULL;
-    new_explicit->previous = NULL;
-
-    freelist_block_t* previous_block = address - sizeof(freelist_block_t) * 2;
-    freelist_block_t* next_block = address + block->size + sizeof(freelist_block_t);
-
-    freelist_explicit_t* previous_explicit = (void*)previous_block - previous_block->size;
-    freelist_explicit_t* next_explicit = (void*)next_block + sizeof(freelist_block_t);
-
-    enum coalesce_state state = 0;
-    if (previous_block->allocated == FREELIST_FREE_MAGIC) {
-        state += coalesce_state_previous;
+    _SASSERT(freelist_block_footer(block)->allocated == FREELIST_ALLOCATED_MAGIC, "Invalid block footer.");
+
+    const u32 block_size = block->size;
+    u32 size = block_size;
+    // Pages inside free neighbours were given back when those were freed, only the pages between them are new
+    void* decommit_start = NULL;
+    void* decommit_end = (void*)~0ull;
+
+    // Previous block's footer sits right before this block's header
+    freelist_block_t* previous_footer = (void*)block - sizeof(freelist_block_t);
+    if (previous_footer->allocated == FREELIST_FREE_MAGIC) {
+        freelist_block_t* previous_block = (void*)previous_footer - previous_footer->size - sizeof(freelist_block_t);
+        freelist_remove_block(allocator, previous_block);
+        size += previous_block->size + sizeof(freelist_block_t) * 2;
+        block = previous_block;
+        if (allocator->decommit_size) {
+            decommit_start = freelist_pages_end(allocator, previous_block);
+        }
     }
+
+    freelist_block_t* next_block = address + block_size + sizeof(freelist_block_t);
     if (next_block->allocated == FREELIST_FREE_MAGIC) {
-        state += coalesce_state_next;
+        freelist_remove_block(allocator, next_block);
+        size += next_block->size + sizeof(freelist_block_t) * 2;
+        if (allocator->decommit_size) {
+            decommit_end = freelist_pages_start(allocator, next_block);
+        }
     }
 
-    _SASSERT((void*)next_explicit >= allocator->memory && (void*)next_explicit < allocator->memory + allocator->capacity, "Creating new explicit pointer at invalid address.");
-    _SASSERT(((void*)next_explicit->next >= allocator->memory && (void*)next_explicit->next < allocator->memory + allocator->capacity) || next_explicit->next == 0 || next_block->allocated, "Setting new explicit pointer to invalid address.");
-    _SASSERT(((void*)next_explicit->previous >= allocator->memory && (void*)next_explicit->previous < allocator->memory + allocator->capacity) || next_explicit->previous == 0 || next_block->allocated, "Setting new explicit pointer to invalid address.");
-
-    _SASSERT((void*)previous_explicit >= allocator->memory && (void*)previous_explicit < allocator->memory + allocator->capacity, "Creating new explicit pointer at invalid address.");
-    _SASSERT(((void*)previous_explicit->next >= allocator->memory && (void*)previous_explicit->next < allocator->memory + allocator->capacity) || previous_explicit->next == 0 || previous_block->allocated, "Setting new explicit pointer to invalid address.");
-    _SASSERT(((void*)previous_explicit->previous >= allocator->memory && (void*)previous_explicit->previous < allocator->memory + allocator->capacity) || previous_explicit->previous == 0 || previous_block->allocated, "Setting new explicit pointer to invalid address.");
-
-    switch (state) {
-        case coalesce_state_default:
-            block->allocated = FREELIST_FREE_MAGIC;
-            block_header->allocated = FREELIST_FREE_MAGIC;
-
-            new_explicit->next = allocator->first_free_block;
-            new_explicit->previous = NULL;
-            if (new_explicit->next) {
-                new_explicit->next->previous = new_explicit;
-            }
-            allocator->first_free_block = new_explicit;
-            mutex_unlock(allocator->mutex);
-            return;
-        case coalesce_state_previous:
-            previous_block = (void*)previous_block - previous_block->size - sizeof(freelist_block_t);
-            previous_block->size += block->size + sizeof(freelist_block_t) * 2;
-
-            block = previous_block;
-
-            block_header->size = block->size;
-            block_header->allocated = FREELIST_FREE_MAGIC;
-
-            mutex_unlock(allocator->mutex);
-            return;
-        case coalesce_state_next:
-            block->allocated = FREELIST_FREE_MAGIC;
-            block->size += next_block->size + sizeof(freelist_block_t) * 2;
-            block_header = (void*)block_header + next_block->size + sizeof(freelist_block_t) * 2;
-            block_header->size = block->size;
-
-            if (next_explicit->previous) {
-                next_explicit->previous->next = new_explicit;
-            } else {
-                allocator->first_free_block = new_explicit;
-            }
-            if (next_explicit->next) {
-                next_explicit->next->previous = new_explicit;
-            }
-            new_explicit->next = next_explicit->next;
-            new_explicit->previous = next_explicit->previous;
+    freelist_set_block(block, size, FREELIST_FREE_MAGIC);
+    freelist_insert_block(allocator, block);
 
-            mutex_unlock(allocator->mutex);
-            return;
-        case coalesce_state_all:
-            // NOTE: DO NOT TOUCH THIS. IT IS JANKY AND HELD TOGETHER WITH PRAYER AND DUCT TAPE
-            previous_block = (void*)previous_block - previous_block->size - sizeof(freelist_block_t);
-            previous_block->size += block->size + next_block->size + sizeof(freelist_block_t) * 4;
+    if (allocator->decommit_size && size >= allocator->decommit_size) {
+        decommit_start = smax(decommit_start, freelist_pages_start(allocator, block));
+        decommit_end = smin(decommit_end, freelist_pages_end(allocator, block));
+        if (decommit_start < decommit_end) {
+            platform_decommit_memory(decommit_start, decommit_end - decommit_start);
+        }
+    }
+}
 
-            block = previous_block;
+void freelist_free(freelist_t* allocator, void* address) {
+    mutex_lock(allocator->mutex);
+    pvt_freelist_free(allocator, address);
+    mutex_unlock(allocator->mutex);
+}
 
-            block_header = (void*)block + block->size + sizeof(freelist_block_t);
-            block_header->size = block->size;
+void freelist_free_batch(freelist_t* allocator, u32 count, void** blocks) {
+    mutex_lock(allocator->mutex);
+    for (u32 i = 0; i < count; i++) {
+        pvt_freelist_free(allocator, blocks[i]);
+    }
+    mutex_unlock(allocator->mutex);
+}
 
-            if (previous_explicit->next) {
-                previous_explicit->next->previous = previous_explicit->previous;
-            }
-            if (previous_explicit->previous) {
-                previous_explicit->previous->next = previous_explicit->next;
-            } 
+// Resizes the block at address without moving it, returns false if the next block does not have enough free space
+static b8 pvt_freelist_resize_in_place(freelist_t* allocator, void* address, u64 size) {
+    freelist_block_t* block = address - sizeof(freelist_block_t);
+    _SASSERT(block->allocated == FREELIST_ALLOCATED_MAGIC, "Cannot reallocate unallocated block.");
+
+    u32 available = block->size;
+    freelist_block_t* next_block = (void*)freelist_block_footer(block) + sizeof(freelist_block_t);
+    const b8 next_free = next_block->allocated == FREELIST_FREE_MAGIC;
+    if (size > available) {
+        if (!next_free || size > available + next_block->size + sizeof(freelist_block_t) * 2) {
+            return false;
+        }
+        // Absorb the next block
+        freelist_remove_block(allocator, next_block);
+        available += next_block->size + sizeof(freelist_block_t) * 2;
+    } else if (next_free) {
+        // Shrinking, the freed tail is merged with the next free block
+        freelist_remove_block(allocator, next_block);
+        available += next_block->size + sizeof(freelist_block_t) * 2;
+    }
 
-            if (next_explicit->next) {
-                next_explicit->next->previous = next_explicit->previous;
-            }
-            if (next_explicit->previous) {
-                next_explicit->previous->next = next_explicit->next;
-            } 
-
-            new_explicit = previous_explicit;
-            new_explicit->previous = NULL;
-
-            if (next_explicit != allocator->first_free_block && previous_explicit != allocator->first_free_block) {
-                new_explicit->next = allocator->first_free_block;
-            } else if (previous_explicit->next != next_explicit) {
-                new_explicit->next = allocator->first_free_block->next;
-            } else if (next_explicit->next != previous_explicit) {
-                new_explicit->next = next_explicit->next;
-            } else {
-                new_explicit->next = NULL;
-            }
-            allocator->first_free_block = new_explicit;
-            if (new_explicit->next) {
-                new_explicit->next->previous = new_explicit;
-            }
+    // Give back whatever is not needed
+    const u32 remaining_size = available - size;
+    if (remaining_size >= FREELIST_MINIMUM_BLOCK_SIZE + sizeof(freelist_block_t) * 2) {
+        freelist_set_block(block, size, FREELIST_ALLOCATED_MAGIC);
 
-            mutex_unlock(allocator->mutex);
-            return;
+        freelist_block_t* new_block = (void*)freelist_block_footer(block) + sizeof(freelist_block_t);
+        freelist_set_block(new_block, remaining_size - sizeof(freelist_block_t) * 2, FREELIST_FREE_MAGIC);
+        freelist_insert_block(allocator, new_block);
+    } else {
+        freelist_set_block(block, available, FREELIST_ALLOCATED_MAGIC);
     }
+    return true;
+}
 
+void* freelist_reallocate(freelist_t* allocator, void* address, u64 size) {
+    if (!address) {
+        return freelist_try_allocate(allocator, size);
+    }
 
-    _SASSERT((void*)new_explicit >= allocator->memory && (void*)new_explicit < allocator->memory + allocator->capacity, "Creating new explicit pointer at invalid address.");
-    _SASSERT(((void*)new_explicit->next >= allocator->memory && (void*)new_explicit->next < allocator->memory + allocator->capacity) || new_explicit->next == 0, "Setting new explicit pointer to invalid address.");
-    _SASSERT(((void*)new_explicit->previous >= allocator->memory && (void*)new_explicit->previous < allocator->memory + allocator->capacity) || new_explicit->previous == 0, "Setting new explicit pointer to invalid address.");
+    size = smax(size, FREELIST_MINIMUM_BLOCK_SIZE);
+    size = (size + (1 << FREELIST_ALIGNMENT_LOG2) - 1) & ~((1ull << FREELIST_ALIGNMENT_LOG2) - 1);
 
-    _SASSERT((void*)next_explicit >= allocator->memory && (void*)next_explicit < allocator->memory + allocator->capacity, "Creating new explicit pointer at invalid address.");
-    _SASSERT(((void*)next_explicit->next >= allocator->memory && (void*)next_explicit->next < allocator->memory + allocator->capacity) || next_explicit->next == 0 || next_block->allocated, "Setting new explicit pointer to invalid address.");
-    _SASSERT(((void*)next_explicit->previous >= allocator->memory && (void*)next_explicit->previous < allocator->memory + allocator->capacity) || next_explicit->previous == 0 || next_block->allocated, "Setting new explicit pointer to invalid address.");
+    mutex_lock(allocator->mutex);
+    if (pvt_freelist_resize_in_place(allocator, address, size)) {
+        mutex_unlock(allocator->mutex);
+        return address;
+    }
 
-    _SASSERT((void*)previous_explicit >= allocator->memory && (void*)previous_explicit < allocator->memory + allocator->capacity, "Creating new explicit pointer at invalid address.");
-    _SASSERT(((void*)previous_explicit->next >= allocator->memory && (void*)previous_explicit->next < allocator->memory + allocator->capacity) || previous_explicit->next == 0 || previous_block->allocated, "Setting new explicit pointer to invalid address.");
-    _SASSERT(((void*)previous_explicit->previous >= allocator->memory && (void*)previous_explicit->previous < allocator->memory + allocator->capacity) || previous_explicit->previous == 0 || previous_block->allocated, "Setting new explicit pointer to invalid address.");
+    // The neighbour is in use, move the block
+    void* data = pvt_freelist_allocate(allocator, size);
+    if (data) {
+        const freelist_block_t* block = address - sizeof(freelist_block_t);
+        scopy_memory(data, address, smin(block->size, size));
+        pvt_freelist_free(allocator, address);
+    }
+    mutex_unlock(allocator->mutex);
+    return data;
+}
 
+u64 freelist_block_size(const void* address) {
+    const freelist_block_t* block = address - sizeof(freelist_block_t);
+    return block->size;
+}
 
-    new_explicit->previous                = NULL;
-    new_explicit->next                    = allocator->first_free_block;
-    if (allocator->first_free_block) {
-        allocator->first_free_block->previous = new_explicit;
+u64 freelist_largest_free_block(freelist_t* allocator) {
+    mutex_lock(allocator->mutex);
+    u64 largest = 0;
+    if (allocator->fl_bitmap) {
+        // Sizes within a bin vary, so the highest bin has to be searched
+        const u32 fl = freelist_msb(allocator->fl_bitmap);
+        const u32 sl = freelist_msb(allocator->sl_bitmap[fl]);
+        for (freelist_explicit_t* explicit = allocator->free_blocks[fl][sl]; explicit; explicit = explicit->next) {
+            largest = smax(largest, freelist_block_of(explicit)->size);
+        }
     }
-    allocator->first_free_block           = new_explicit;
     mutex_unlock(allocator->mutex);
+    return largest;
 }
 
 #ifdef SPARK_DEBUG
@@ -333,76 +429,55 @@ void freelist_check_health(freelist_t* allocator) {
     u64 allocated_block_count = 0;
     u64 free_block_count = 0;
 
+    // Walk the blocks in memory order
     freelist_block_t* block = allocator->memory + sizeof(freelist_block_t);
-    static char block_buffer[8192] = {};
-    u32 block_buffer_len = 0;
-    while (block) {
-        freelist_block_t* block_end = (void*)block + sizeof(freelist_block_t) + block->size;
+    b8 previous_free = false;
+    while (block->size > 0) {
+        freelist_block_t* block_end = freelist_block_footer(block);
 
         SASSERT(block_end->allocated == block->allocated, "Block header / footer allocated do not match. 0x%x != 0x%x", block->allocated, block_end->allocated);
         SASSERT(block_end->size == block->size, "Block header / footer size do not match. 0x%x != 0x%x", block->size, block_end->size);
 
-        u32 offset = (void*)block - allocator->memory + sizeof(freelist_block_t);
         if (block->allocated == FREELIST_ALLOCATED_MAGIC) {
             allocated += block->size;
             allocated_block_count++;
-            block_buffer_len += sprintf(block_buffer + block_buffer_len, "| A (0x%x) 0x%x ", offset, block->size);
-
-        } else { 
+            previous_free = false;
+        } else {
+            SASSERT(!previous_free, "Adjacent free blocks were not coalesced.");
             free_all += block->size;
             free_block_count++;
-            block_buffer_len += sprintf(block_buffer + block_buffer_len, "| F (0x%x) 0x%x ", offset, block->size);
-
-            s32 explicit_index = 0;
-            b8 found_explicit = false;
-            freelist_explicit_t* explicit = allocator->first_free_block;
-            while (explicit) {
-                if (explicit == (void*)block + 8) {
-                    found_explicit = true;
-                    break;
-                }
-                explicit_index++;
-
-                explicit = explicit->next;
-            }
-
-            if (!found_explicit) {
-                explicit_index = -1;
-            }
-
-            block_buffer_len += sprintf(block_buffer + block_buffer_len, "%d", explicit_index);
+            previous_free = true;
         }
 
-        block = (void*)block + block->size + sizeof(freelist_block_t) * 2;
+        block = (void*)block_end + sizeof(freelist_block_t);
         total_block_count++;
-        if (block->size <= 0) {
-            break;
-        }
-
     }
 
-
-    freelist_explicit_t* explicit = allocator->first_free_block;
+    // Walk the bins
     u32 explicit_block_count = 0;
-    int i = 0;
-    while (explicit) {
-        explicit_block_count++;
-        SASSERT((void*)explicit >= allocator->memory && (void*)explicit < allocator->memory + allocator->capacity, "Creating new explicit pointer at invalid address.");
-        SASSERT(((void*)explicit->next >= allocator->memory && (void*)explicit->next < allocator->memory + allocator->capacity) || explicit->next == 0, "Setting new explicit pointer to invalid address.");
-        SASSERT(((void*)explicit->previous >= allocator->memory && (void*)explicit->previous < allocator->memory + allocator->capacity) || explicit->previous == 0, "Setting new explicit pointer to invalid address.");
-
-        SASSERT(explicit->next != (void*)INVALID_ID_U64, "Explicit freelist corrupted.");
-        SASSERT(explicit->previous != (void*)INVALID_ID_U64, "Explicit freelist corrupted.");
-
-
-        freelist_block_t* block = (void*)explicit - sizeof(freelist_block_t);
-        SASSERT(block->allocated == FREELIST_FREE_MAGIC, "Explicit freelist block is not free."); 
-        free_explicit += block->size;
-        explicit = explicit->next;
-        i++;
-        if (i > 100000000) {
-            SERROR("Recursive freelist detective.");
-            break;
+    for (u32 fl = 0; fl < FREELIST_FL_INDEX_COUNT; fl++) {
+        SASSERT(((allocator->fl_bitmap >> fl) & 1) == (allocator->sl_bitmap[fl] != 0), "Freelist first level bitmap out of sync for bin %d.", fl);
+        for (u32 sl = 0; sl < FREELIST_SL_INDEX_COUNT; sl++) {
+            freelist_explicit_t* explicit = allocator->free_blocks[fl][sl];
+            SASSERT(((allocator->sl_bitmap[fl] >> sl) & 1) == (explicit != NULL), "Freelist second level bitmap out of sync for bin %d, %d.", fl, sl);
+
+            freelist_explicit_t* previous_explicit = NULL;
+            while (explicit) {
+                SASSERT((void*)explicit >= allocator->memory && (void*)explicit < allocator->memory + allocator->capacity, "Explicit pointer at invalid address.");
+                SASSERT(previous_explicit == explicit->previous, "Failed to properly create explicit linked list. %p != %p", explicit->previous, previous_explicit);
+
+                freelist_block_t* block = freelist_block_of(explicit);
+                SASSERT(block->allocated == FREELIST_FREE_MAGIC, "Explicit freelist block is not free.");
+
+                u32 block_fl, block_sl;
+                freelist_mapping_insert(block->size, &block_fl, &block_sl);
+                SASSERT(block_fl == fl && block_sl == sl, "Free block of size 0x%x is in the wrong bin.", block->size);
+
+                free_explicit += block->size;
+                explicit_block_count++;
+                previous_explicit = explicit;
+                explicit = explicit->next;
+            }
         }
     }
 
@@ -417,21 +492,6 @@ void freelist_check_health(freelist_t* allocator) {
             "Allocated Block Count: %d", free_all, free_explicit, allocated, capacity, total_block_count, explicit_block_count, free_block_count, allocated_block_count);
     SASSERT(free_block_count == explicit_block_count, "Free block count and explicit block count do not match: %d != %d", free_block_count, explicit_block_count);
     SASSERT(free_all == free_explicit, "Freelist: All free block size not equal to explicit free size: 0x%x != 0x%x", free_all, free_explicit);
-    SASSERT(allocator->first_free_block->previous == NULL, "First explicit cannot have previous.");
-
-    // Validate explicit list 
-    explicit = allocator->first_free_block;
-    freelist_explicit_t* previous_explicit = NULL;
-    while (explicit) {
-        SASSERT(previous_explicit == explicit->previous, "Failed to properly create explicit linked list. %p != %p", explicit->previous, previous_explicit);
-        previous_explicit = explicit;
-        explicit = explicit->next;
-        i++;
-        if (i > 100000000) {
-            SERROR("Recursive freelist detective.");
-            break;
-        }
-    }
     mutex_unlock(allocator->mutex);
 }
 #endif
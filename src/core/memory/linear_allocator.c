@@ -50,3 +50,9 @@ void linear_allocator_free_all(linear_allocator_t* allocator) {
         szero_memory(allocator->memory, allocator->total_size);
     }
 }
+
+void linear_allocator_reset(linear_allocator_t* allocator) {
+    if (allocator) {
+        allocator->allocated = 0;
+    }
+}
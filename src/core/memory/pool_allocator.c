@@ -0,0 +1,238 @@
+#include "Spark/memory/pool_allocator.h"
+#include "Spark/core/logging.h"
+#include "Spark/core/smemory.h"
+#include "Spark/math/smath.h"
+#include "Spark/threading/spinlock.h"
+
+// Owner of blocks allocated by threads without a cache, these are always freed to the shared stack
+#define POOL_ALLOCATOR_NO_OWNER 0xFF
+
+// Thread slots index into pool_allocator_t::caches. Threads that find every slot taken run uncached until one is
+// released by pool_allocator_release_thread_slot.
+static thread_slots_t thread_slots;
+static thread_local u32 thread_slot = INVALID_ID;
+
+// Live pools, guarded by pools_lock
+static pool_allocator_t* pools = NULL;
+static b8 pools_lock = false;
+
+SINLINE u32 pool_allocator_thread_slot() {
+    if (thread_slot == INVALID_ID) {
+        thread_slot = thread_slots_acquire(&thread_slots);
+    }
+    return thread_slot;
+}
+
+SINLINE u64 pool_allocator_allocation_size(const pool_allocator_t* allocator) {
+    return sizeof(pool_allocator_cache_t) * POOL_ALLOCATOR_MAX_THREADS + (u64)allocator->block_size * allocator->block_count + allocator->block_count + 64;
+}
+
+SINLINE void* pool_allocator_block(const pool_allocator_t* allocator, u32 index) {
+    return allocator->memory + (u64)index * allocator->block_size;
+}
+
+// Free blocks store the index of the next free block in their first bytes
+SINLINE u32* pool_allocator_next(const pool_allocator_t* allocator, u32 index) {
+    return pool_allocator_block(allocator, index);
+}
+
+SINLINE u64 pool_allocator_make_head(u64 previous_head, u32 index) {
+    return (((previous_head >> 32) + 1) << 32) | index;
+}
+
+void pool_allocator_create(u32 block_size, u32 block_count, pool_allocator_t* out_allocator) {
+    SASSERT(block_count > 0 && block_count < INVALID_ID, "Invalid pool allocator block count %u.", block_count);
+    out_allocator->block_size = (smax(block_size, sizeof(u32)) + 15) & ~15u;
+    out_allocator->block_count = block_count;
+
+    out_allocator->allocation = sallocate(pool_allocator_allocation_size(out_allocator), MEMORY_TAG_ALLOCATOR);
+    out_allocator->caches = (void*)(((u64)out_allocator->allocation + 63) & ~63ull);
+    out_allocator->memory = (void*)out_allocator->caches + sizeof(pool_allocator_cache_t) * POOL_ALLOCATOR_MAX_THREADS;
+    out_allocator->owners = out_allocator->memory + (u64)out_allocator->block_size * block_count;
+
+    for (u32 i = 0; i < POOL_ALLOCATOR_MAX_THREADS; i++) {
+        out_allocator->caches[i].count = 0;
+        out_allocator->caches[i].remote_head = INVALID_ID;
+    }
+    for (u32 i = 0; i < block_count; i++) {
+        *pool_allocator_next(out_allocator, i) = i + 1 < block_count ? i + 1 : INVALID_ID;
+    }
+    out_allocator->head = 0;
+
+    spin_lock(&pools_lock);
+    out_allocator->next_pool = pools;
+    pools = out_allocator;
+    spin_unlock(&pools_lock);
+}
+
+void pool_allocator_destroy(pool_allocator_t* allocator) {
+    spin_lock(&pools_lock);
+    pool_allocator_t** link = &pools;
+    while (*link != allocator) {
+        link = &(*link)->next_pool;
+    }
+    *link = allocator->next_pool;
+    spin_unlock(&pools_lock);
+
+    sfree(allocator->allocation, pool_allocator_allocation_size(allocator), MEMORY_TAG_ALLOCATOR);
+    allocator->allocation = NULL;
+}
+
+// Pushes the chain of blocks from first to last onto the shared stack
+static void pool_allocator_push(pool_allocator_t* allocator, u32 first, u32 last) {
+    u64 head = __atomic_load_n(&allocator->head, __ATOMIC_RELAXED);
+    do {
+        __atomic_store_n(pool_allocator_next(allocator, last), (u32)head, __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(&allocator->head, &head, pool_allocator_make_head(head, first), true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+// Pops up to count blocks off the shared stack
+static u32 pool_allocator_pop(pool_allocator_t* allocator, u32 count, u32* out_blocks) {
+    u64 head = __atomic_load_n(&allocator->head, __ATOMIC_ACQUIRE);
+    u32 popped;
+    u32 index;
+    do {
+        // The links may be changed by other threads while walking them. The tag makes the exchange fail in that case,
+        // so garbage read here is never used.
+        popped = 0;
+        index = (u32)head;
+        while (index < allocator->block_count && popped < count) {
+            out_blocks[popped++] = index;
+            index = __atomic_load_n(pool_allocator_next(allocator, index), __ATOMIC_RELAXED);
+        }
+        if (index >= allocator->block_count) {
+            index = INVALID_ID;
+        }
+    } while (!__atomic_compare_exchange_n(&allocator->head, &head, pool_allocator_make_head(head, index), true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+    return popped;
+}
+
+// Links count cached blocks into a chain and pushes them onto the shared stack
+static void pool_allocator_push_cached(pool_allocator_t* allocator, const u32* blocks, u32 count) {
+    if (count == 0) {
+        return;
+    }
+    for (u32 i = 0; i + 1 < count; i++) {
+        *pool_allocator_next(allocator, blocks[i]) = blocks[i + 1];
+    }
+    pool_allocator_push(allocator, blocks[0], blocks[count - 1]);
+}
+
+// Moves a remote free queue into the cache, blocks that do not fit go to the shared stack
+static void pool_allocator_take_remote(pool_allocator_t* allocator, pool_allocator_cache_t* cache, u32* remote_head) {
+    u32 index = __atomic_exchange_n(remote_head, INVALID_ID, __ATOMIC_ACQUIRE);
+    while (index != INVALID_ID && cache->count < POOL_ALLOCATOR_CACHE_SIZE) {
+        cache->blocks[cache->count++] = index;
+        index = *pool_allocator_next(allocator, index);
+    }
+
+    if (index != INVALID_ID) {
+        u32 last = index;
+        while (*pool_allocator_next(allocator, last) != INVALID_ID) {
+            last = *pool_allocator_next(allocator, last);
+        }
+        pool_allocator_push(allocator, index, last);
+    }
+}
+
+static void pool_allocator_refill(pool_allocator_t* allocator, u32 slot) {
+    pool_allocator_cache_t* cache = &allocator->caches[slot];
+    pool_allocator_take_remote(allocator, cache, &cache->remote_head);
+    if (cache->count > 0) {
+        return;
+    }
+
+    cache->count = pool_allocator_pop(allocator, POOL_ALLOCATOR_CACHE_BATCH_SIZE, cache->blocks);
+    if (cache->count > 0) {
+        return;
+    }
+
+    // Blocks freed to threads that stopped allocating would otherwise never come back
+    for (u32 i = 0; i < POOL_ALLOCATOR_MAX_THREADS && cache->count == 0; i++) {
+        if (__atomic_load_n(&allocator->caches[i].remote_head, __ATOMIC_RELAXED) != INVALID_ID) {
+            pool_allocator_take_remote(allocator, cache, &allocator->caches[i].remote_head);
+        }
+    }
+}
+
+void* pool_allocator_allocate(pool_allocator_t* allocator) {
+    const u32 slot = pool_allocator_thread_slot();
+    u32 index;
+    if (slot >= POOL_ALLOCATOR_MAX_THREADS) {
+        if (pool_allocator_pop(allocator, 1, &index) == 0) {
+            return NULL;
+        }
+        allocator->owners[index] = POOL_ALLOCATOR_NO_OWNER;
+        return pool_allocator_block(allocator, index);
+    }
+
+    pool_allocator_cache_t* cache = &allocator->caches[slot];
+    if (cache->count == 0) {
+        pool_allocator_refill(allocator, slot);
+        if (cache->count == 0) {
+            return NULL;
+        }
+    }
+
+    index = cache->blocks[--cache->count];
+    allocator->owners[index] = slot;
+    return pool_allocator_block(allocator, index);
+}
+
+void pool_allocator_free(pool_allocator_t* allocator, void* block) {
+    SASSERT(block >= allocator->memory && block < allocator->memory + (u64)allocator->block_size * allocator->block_count,
+            "Freeing %p, which is not owned by the pool allocator.", block);
+    const u32 index = (block - allocator->memory) / allocator->block_size;
+    const u32 owner = allocator->owners[index];
+    const u32 slot = pool_allocator_thread_slot();
+
+    if (owner == POOL_ALLOCATOR_NO_OWNER) {
+        pool_allocator_push(allocator, index, index);
+    } else if (owner == slot) {
+        pool_allocator_cache_t* cache = &allocator->caches[slot];
+        if (cache->count == POOL_ALLOCATOR_CACHE_SIZE) {
+            cache->count -= POOL_ALLOCATOR_CACHE_BATCH_SIZE;
+            pool_allocator_push_cached(allocator, &cache->blocks[cache->count], POOL_ALLOCATOR_CACHE_BATCH_SIZE);
+        }
+        cache->blocks[cache->count++] = index;
+    } else {
+        // Hand the block back to the thread that allocated it
+        u32* remote_head = &allocator->caches[owner].remote_head;
+        u32 head = __atomic_load_n(remote_head, __ATOMIC_RELAXED);
+        do {
+            *pool_allocator_next(allocator, index) = head;
+        } while (!__atomic_compare_exchange_n(remote_head, &head, index, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+}
+
+void pool_allocator_flush_thread_cache(pool_allocator_t* allocator) {
+    // A thread without a slot has nothing cached, do not claim one just to flush it
+    const u32 slot = thread_slot;
+    if (slot >= POOL_ALLOCATOR_MAX_THREADS) {
+        return;
+    }
+
+    pool_allocator_cache_t* cache = &allocator->caches[slot];
+    pool_allocator_push_cached(allocator, cache->blocks, cache->count);
+    cache->count = 0;
+
+    // Whatever is left after filling the cache goes to the shared stack, then flush the cache again
+    pool_allocator_take_remote(allocator, cache, &cache->remote_head);
+    pool_allocator_push_cached(allocator, cache->blocks, cache->count);
+    cache->count = 0;
+}
+
+void pool_allocator_release_thread_slot() {
+    if (thread_slot == INVALID_ID) {
+        return;
+    }
+
+    spin_lock(&pools_lock);
+    for (pool_allocator_t* pool = pools; pool; pool = pool->next_pool) {
+        pool_allocator_flush_thread_cache(pool);
+    }
+    spin_unlock(&pools_lock);
+
+    thread_slots_release(&thread_slots, thread_slot);
+    thread_slot = INVALID_ID;
+}
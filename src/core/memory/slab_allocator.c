@@ -0,0 +1,301 @@
+#include "Spark/memory/slab_allocator.h"
+#include "Spark/core/logging.h"
+#include "Spark/math/smath.h"
+#include "Spark/platform/platform.h"
+
+// Space reserved for slab_page_t at the start of each page, keeps blocks 16 byte aligned
+#define SLAB_PAGE_HEADER_SIZE 64
+
+static const u32 slab_class_sizes[SLAB_ALLOCATOR_CLASS_COUNT] = { 16, 32, 48, 64, 96, 128, 192, 256 };
+
+// Size class of every 16 byte step, indexed by (size - 1) / 16
+static const u8 slab_class_lookup[SLAB_ALLOCATOR_MAX_SIZE / 16] = {
+    0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7,
+};
+
+// Thread slots index into slab_allocator_t::caches. Threads that find every slot taken run uncached until one is
+// released by slab_allocator_release_thread_slot.
+static thread_slots_t thread_cache_slots;
+static thread_local u32 thread_cache_slot = INVALID_ID;
+
+SINLINE slab_cache_t* slab_allocator_thread_cache(slab_allocator_t* allocator) {
+    if (thread_cache_slot == INVALID_ID) {
+        thread_cache_slot = thread_slots_acquire(&thread_cache_slots);
+    }
+    if (!allocator->caches || thread_cache_slot == INVALID_ID) {
+        return NULL;
+    }
+    return &allocator->caches[thread_cache_slot];
+}
+
+SINLINE slab_page_t* slab_page_of(const void* block) {
+    return (slab_page_t*)((size_t)block & ~((size_t)SLAB_ALLOCATOR_PAGE_SIZE - 1));
+}
+
+SINLINE void slab_class_remove_page(slab_class_t* slab_class, slab_page_t* page) {
+    if (page->previous) {
+        page->previous->next = page->next;
+    } else {
+        slab_class->partial_pages = page->next;
+    }
+    if (page->next) {
+        page->next->previous = page->previous;
+    }
+    page->next = NULL;
+    page->previous = NULL;
+    page->partial = false;
+}
+
+SINLINE void slab_class_push_page(slab_class_t* slab_class, slab_page_t* page) {
+    page->previous = NULL;
+    page->next = slab_class->partial_pages;
+    if (page->next) {
+        page->next->previous = page;
+    }
+    slab_class->partial_pages = page;
+    page->partial = true;
+}
+
+void slab_allocator_create(slab_allocator_t* out_allocator) {
+    szero_memory(out_allocator, sizeof(slab_allocator_t));
+    for (u32 i = 0; i < SLAB_ALLOCATOR_CLASS_COUNT; i++) {
+        mutex_create(&out_allocator->classes[i].mutex);
+    }
+    mutex_create(&out_allocator->page_mutex);
+
+    out_allocator->memory = platform_reserve_memory(SLAB_ALLOCATOR_RESERVE_SIZE, SLAB_ALLOCATOR_PAGE_SIZE, false);
+    SASSERT(out_allocator->memory, "Failed to reserve 0x%lx bytes for the slab allocator.", SLAB_ALLOCATOR_RESERVE_SIZE);
+
+    const u64 caches_size = sizeof(slab_cache_t) * SLAB_ALLOCATOR_MAX_THREADS;
+    out_allocator->caches = platform_allocate(caches_size, true);
+    platform_zero_memory(out_allocator->caches, caches_size);
+}
+
+void slab_allocator_destroy(slab_allocator_t* allocator) {
+    if (allocator->caches) {
+        platform_free(allocator->caches, true);
+        allocator->caches = NULL;
+    }
+    if (allocator->memory) {
+        platform_release_memory(allocator->memory, SLAB_ALLOCATOR_RESERVE_SIZE);
+        allocator->memory = NULL;
+    }
+    allocator->committed_size = 0;
+    allocator->used_page_count = 0;
+    allocator->free_pages = NULL;
+
+    for (u32 i = 0; i < SLAB_ALLOCATOR_CLASS_COUNT; i++) {
+        mutex_destroy(&allocator->classes[i].mutex);
+    }
+    mutex_destroy(&allocator->page_mutex);
+}
+
+// Takes an empty page for size_class, committing more of the reservation if there is none left
+static slab_page_t* slab_allocator_acquire_page(slab_allocator_t* allocator, u8 size_class) {
+    mutex_lock(allocator->page_mutex);
+    slab_page_t* page = allocator->free_pages;
+    if (page) {
+        allocator->free_pages = page->next;
+    } else {
+        const u64 page_offset = (u64)allocator->used_page_count * SLAB_ALLOCATOR_PAGE_SIZE;
+        if (allocator->used_page_count == SLAB_ALLOCATOR_PAGE_COUNT ||
+            (page_offset == allocator->committed_size &&
+             !platform_commit_memory(allocator->memory + page_offset, SLAB_ALLOCATOR_COMMIT_SIZE))) {
+            mutex_unlock(allocator->page_mutex);
+            return NULL;
+        }
+        if (page_offset == allocator->committed_size) {
+            allocator->committed_size += SLAB_ALLOCATOR_COMMIT_SIZE;
+        }
+
+        page = allocator->memory + page_offset;
+        allocator->used_page_count++;
+    }
+    mutex_unlock(allocator->page_mutex);
+
+    page->next = NULL;
+    page->previous = NULL;
+    page->free_block = NULL;
+    page->bump_offset = SLAB_PAGE_HEADER_SIZE;
+    page->used_count = 0;
+    page->size_class = size_class;
+    page->block_size = slab_class_sizes[size_class];
+    page->block_capacity = (SLAB_ALLOCATOR_PAGE_SIZE - SLAB_PAGE_HEADER_SIZE) / page->block_size;
+    page->partial = false;
+    return page;
+}
+
+static void slab_allocator_release_page(slab_allocator_t* allocator, slab_page_t* page) {
+    mutex_lock(allocator->page_mutex);
+    page->next = allocator->free_pages;
+    allocator->free_pages = page;
+    mutex_unlock(allocator->page_mutex);
+}
+
+// Takes a block of size_class, the class mutex must be held
+static void* slab_class_pop_block(slab_allocator_t* allocator, slab_class_t* slab_class, u8 size_class) {
+    slab_page_t* page = slab_class->partial_pages;
+    if (!page) {
+        page = slab_allocator_acquire_page(allocator, size_class);
+        if (!page) {
+            return NULL;
+        }
+        slab_class_push_page(slab_class, page);
+    }
+
+    // Reuse freed blocks first, then carve new ones off the end of the page
+    void* block = page->free_block;
+    if (block) {
+        page->free_block = *(void**)block;
+    } else {
+        block = (void*)page + page->bump_offset;
+        page->bump_offset += page->block_size;
+    }
+
+    page->used_count++;
+    if (page->used_count == page->block_capacity) {
+        slab_class_remove_page(slab_class, page);
+    }
+    return block;
+}
+
+// Returns block to its page, the class mutex must be held. Returns the page if it became empty and has to be released.
+static slab_page_t* slab_class_push_block(slab_class_t* slab_class, void* block) {
+    slab_page_t* page = slab_page_of(block);
+    *(void**)block = page->free_block;
+    page->free_block = block;
+    page->used_count--;
+
+    if (!page->partial) {
+        slab_class_push_page(slab_class, page);
+    } else if (page->used_count == 0 && (page->previous || page->next)) {
+        // Keep one empty page per class around so alternating alloc / free does not bounce pages
+        slab_class_remove_page(slab_class, page);
+        return page;
+    }
+    return NULL;
+}
+
+static void slab_allocator_refill_bin(slab_allocator_t* allocator, slab_cache_bin_t* bin, u8 size_class) {
+    slab_class_t* slab_class = &allocator->classes[size_class];
+    mutex_lock(slab_class->mutex);
+    for (u32 i = 0; i < SLAB_ALLOCATOR_CACHE_BATCH_SIZE; i++) {
+        void* block = slab_class_pop_block(allocator, slab_class, size_class);
+        if (!block) {
+            break;
+        }
+        *(void**)block = bin->first_block;
+        bin->first_block = block;
+        bin->count++;
+    }
+    mutex_unlock(slab_class->mutex);
+}
+
+// Returns count blocks of the bin to their pages, taking the class mutex once
+static void slab_allocator_flush_bin(slab_allocator_t* allocator, slab_cache_bin_t* bin, u8 size_class, u32 count) {
+    slab_class_t* slab_class = &allocator->classes[size_class];
+    // Pages that became empty, released once the class mutex is dropped
+    slab_page_t* empty_pages = NULL;
+
+    count = smin(count, bin->count);
+    mutex_lock(slab_class->mutex);
+    for (u32 i = 0; i < count; i++) {
+        void* block = bin->first_block;
+        bin->first_block = *(void**)block;
+        slab_page_t* page = slab_class_push_block(slab_class, block);
+        if (page) {
+            page->next = empty_pages;
+            empty_pages = page;
+        }
+    }
+    bin->count -= count;
+    mutex_unlock(slab_class->mutex);
+
+    while (empty_pages) {
+        slab_page_t* next = empty_pages->next;
+        slab_allocator_release_page(allocator, empty_pages);
+        empty_pages = next;
+    }
+}
+
+void* slab_allocator_allocate(slab_allocator_t* allocator, u64 size) {
+    SASSERT(size > 0 && size <= SLAB_ALLOCATOR_MAX_SIZE, "Slab allocator cannot allocate %lu bytes.", size);
+    const u8 size_class = slab_class_lookup[(size - 1) >> 4];
+
+    slab_cache_t* cache = slab_allocator_thread_cache(allocator);
+    if (!cache) {
+        slab_class_t* slab_class = &allocator->classes[size_class];
+        mutex_lock(slab_class->mutex);
+        void* block = slab_class_pop_block(allocator, slab_class, size_class);
+        mutex_unlock(slab_class->mutex);
+        return block;
+    }
+
+    slab_cache_bin_t* bin = &cache->bins[size_class];
+    if (!bin->first_block) {
+        slab_allocator_refill_bin(allocator, bin, size_class);
+        if (!bin->first_block) {
+            return NULL;
+        }
+    }
+
+    void* block = bin->first_block;
+    bin->first_block = *(void**)block;
+    bin->count--;
+    return block;
+}
+
+void slab_allocator_free(slab_allocator_t* allocator, void* block) {
+    const u8 size_class = slab_page_of(block)->size_class;
+
+    slab_cache_t* cache = slab_allocator_thread_cache(allocator);
+    if (cache) {
+        slab_cache_bin_t* bin = &cache->bins[size_class];
+        *(void**)block = bin->first_block;
+        bin->first_block = block;
+        bin->count++;
+
+        if (bin->count > SLAB_ALLOCATOR_CACHE_MAX_BLOCKS) {
+            slab_allocator_flush_bin(allocator, bin, size_class, SLAB_ALLOCATOR_CACHE_MAX_BLOCKS / 2);
+        }
+        return;
+    }
+
+    slab_class_t* slab_class = &allocator->classes[size_class];
+    mutex_lock(slab_class->mutex);
+    slab_page_t* empty_page = slab_class_push_block(slab_class, block);
+    mutex_unlock(slab_class->mutex);
+    if (empty_page) {
+        slab_allocator_release_page(allocator, empty_page);
+    }
+}
+
+b8 slab_allocator_owns(slab_allocator_t* allocator, const void* block) {
+    // Addresses below the reservation wrap around and fail the same compare
+    return (size_t)block - (size_t)allocator->memory < SLAB_ALLOCATOR_RESERVE_SIZE;
+}
+
+u32 slab_allocator_block_size(const void* block) {
+    return slab_page_of(block)->block_size;
+}
+
+void slab_allocator_flush_thread_cache(slab_allocator_t* allocator) {
+    // A thread without a slot has nothing cached, do not claim one just to flush it
+    if (thread_cache_slot == INVALID_ID || !allocator->caches) {
+        return;
+    }
+    slab_cache_t* cache = &allocator->caches[thread_cache_slot];
+
+    for (u8 i = 0; i < SLAB_ALLOCATOR_CLASS_COUNT; i++) {
+        if (cache->bins[i].count > 0) {
+            slab_allocator_flush_bin(allocator, &cache->bins[i], i, cache->bins[i].count);
+        }
+    }
+}
+
+void slab_allocator_release_thread_slot() {
+    if (thread_cache_slot != INVALID_ID) {
+        thread_slots_release(&thread_cache_slots, thread_cache_slot);
+        thread_cache_slot = INVALID_ID;
+    }
+}
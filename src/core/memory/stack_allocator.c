@@ -0,0 +1,55 @@
+#include "Spark/memory/stack_allocator.h"
+#include "Spark/core/logging.h"
+#include "Spark/core/smemory.h"
+#include "Spark/platform/platform.h"
+
+void stack_allocator_create(u64 reserve_size, stack_allocator_t* out_allocator) {
+    reserve_size = (reserve_size + STACK_ALLOCATOR_COMMIT_SIZE - 1) & ~((u64)STACK_ALLOCATOR_COMMIT_SIZE - 1);
+    out_allocator->memory = platform_reserve_memory(reserve_size, 0, false);
+    SASSERT(out_allocator->memory, "Failed to reserve 0x%lx bytes for the stack allocator.", reserve_size);
+    out_allocator->allocated = 0;
+    out_allocator->committed_size = 0;
+    out_allocator->reserved_size = reserve_size;
+}
+
+void stack_allocator_destroy(stack_allocator_t* allocator) {
+    platform_release_memory(allocator->memory, allocator->reserved_size);
+    allocator->memory = NULL;
+    allocator->allocated = 0;
+    allocator->committed_size = 0;
+    allocator->reserved_size = 0;
+}
+
+void* stack_allocator_allocate(stack_allocator_t* allocator, u64 size) {
+    size = (size + STACK_ALLOCATOR_ALIGNMENT - 1) & ~((u64)STACK_ALLOCATOR_ALIGNMENT - 1);
+    const u64 allocated = allocator->allocated + size;
+    if (allocated > allocator->reserved_size) {
+        SERROR("stack_allocator_allocate - Tried to allocate %luB, only %luB remaining.", size, allocator->reserved_size - allocator->allocated);
+        return NULL;
+    }
+
+    if (allocated > allocator->committed_size) {
+        const u64 committed_size = (allocated + STACK_ALLOCATOR_COMMIT_SIZE - 1) & ~((u64)STACK_ALLOCATOR_COMMIT_SIZE - 1);
+        if (!platform_commit_memory(allocator->memory + allocator->committed_size, committed_size - allocator->committed_size)) {
+            SERROR("stack_allocator_allocate - Failed to commit memory for %luB.", size);
+            return NULL;
+        }
+        allocator->committed_size = committed_size;
+    }
+
+    void* block = allocator->memory + allocator->allocated;
+    allocator->allocated = allocated;
+    return block;
+}
+
+stack_allocator_mark_t stack_allocator_mark(const stack_allocator_t* allocator) {
+    return allocator->allocated;
+}
+
+void stack_allocator_rewind_to(stack_allocator_t* allocator, stack_allocator_mark_t mark) {
+    SASSERT(mark <= allocator->allocated, "Stack allocator rewind to %lu past the top of the stack at %lu.", mark, allocator->allocated);
+#ifdef SPARK_DEBUG
+    sset_memory(allocator->memory + mark, STACK_ALLOCATOR_POISON, allocator->allocated - mark);
+#endif
+    allocator->allocated = mark;
+}
@@ -114,6 +114,12 @@ void physics_backend_initialize(linear_allocator_t* allocator) {
     };
     ecs_system_create(world, &phsyics_step_create);
 
+    // Step physics at a fixed rate regardless of frame rate
+    const ecs_schedule_t physics_schedule = {
+        .tick_rate = PHYSICS_TICK_RATE,
+    };
+    ecs_world_set_phase_schedule(world, ECS_PHASE_PHYSICS, &physics_schedule);
+
 #ifdef SPARK_DEBUG
     // Debug renderer
     state->debug_renderer = JPH_DebugRenderer_Create(state);
@@ -261,7 +267,7 @@ void physics_step_system(ecs_iterator_t* iterator) {
     // If you take larger steps than 1 / 60th of a second you need to do multiple collision steps in order to keep the simulation stable. Do 1 collision step per 1 / 60th of a second (round up).
     const int cCollisionSteps = 1;
     // Step the world
-    JPH_PhysicsSystem_Update(state->system, 1.0f / 60.0f, cCollisionSteps, state->job_system);
+    JPH_PhysicsSystem_Update(state->system, iterator->delta_time, cCollisionSteps, state->job_system);
 
     for (u32 i = 0; i < iterator->entity_count; i++) {
         // Output current position and velocity of the sphere
@@ -8,6 +8,7 @@
 
 #include <bits/time.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <time.h>
 
 #if _POSIX_C_SOURCE >= 199309L
@@ -107,6 +108,39 @@ platform_set_memory(void* dest, s32 value, u64 size) {
     return memset(dest, value, size);
 }
 
+void* platform_reserve_memory(u64 size, u64 alignment, b8 huge_pages) {
+    alignment = alignment < PLATFORM_HUGE_PAGE_SIZE ? PLATFORM_HUGE_PAGE_SIZE : alignment;
+    // Over reserve so the block can be aligned, at least to a huge page so transparent huge pages can be used
+    const u64 reserve_size = size + alignment;
+    void* reserved = mmap(NULL, reserve_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (reserved == MAP_FAILED) {
+        return NULL;
+    }
+    void* block = (void*)(((u64)reserved + alignment - 1) & ~(alignment - 1));
+    if (block != reserved) {
+        munmap(reserved, block - reserved);
+    }
+    munmap(block + size, reserved + reserve_size - (block + size));
+
+    if (huge_pages) {
+        madvise(block, size, MADV_HUGEPAGE);
+    }
+    return block;
+}
+b8 platform_commit_memory(void* block, u64 size) {
+    return mprotect(block, size, PROT_READ | PROT_WRITE) == 0;
+}
+void platform_release_memory(void* block, u64 size) {
+    // The reservation was trimmed to exactly size, anything past it belongs to another mapping
+    munmap(block, size);
+}
+void platform_decommit_memory(void* block, u64 size) {
+    // MADV_FREE lets the kernel take the pages lazily, kernels before 4.5 only know MADV_DONTNEED
+    if (madvise(block, size, MADV_FREE) != 0) {
+        madvise(block, size, MADV_DONTNEED);
+    }
+}
+
 void 
 platfrom_console_write(const char* message, u8 color) {
 #ifdef SPARK_DEBUG
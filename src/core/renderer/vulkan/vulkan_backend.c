@@ -2,10 +2,12 @@
 #include "Spark/containers/darray.h"
 #include "Spark/core/smemory.h"
 #include "Spark/core/sstring.h"
+#include "Spark/core/string_intern.h"
 #include "Spark/defines.h"
 #include "Spark/math/mat4.h"
 #include "Spark/math/quat.h"
 #include "Spark/memory/block_allocator.h"
+#include "Spark/memory/frame_allocator.h"
 #include "Spark/memory/freelist.h"
 #include "Spark/renderer/material.h"
 #include "Spark/renderer/mesh.h"
@@ -35,6 +37,7 @@
 #include "Spark/resources/resource_loader.h"
 #include "Spark/resources/resource_types.h"
 #include "Spark/resources/resource_functions.h"
+#include <string.h>
 #include <vulkan/vulkan_core.h>
 
 vulkan_context_t* context = NULL;
@@ -69,11 +72,10 @@ b8 vulkan_renderer_initialize(const char* application_name, struct platform_stat
     // Create context
     context = linear_allocator_allocate(allocator, sizeof(vulkan_context_t));
     context->allocator = NULL;
-    block_allocator_create(2048, sizeof(vulkan_mesh_t    ), &context->mesh_allocator);
-    block_allocator_create(2048, sizeof(vulkan_shader_t  ), &context->shader_allocator);
-    block_allocator_create(2048, sizeof(vulkan_image_t   ), &context->image_allocator);
-    block_allocator_create(2048, sizeof(vulkan_material_t), &context->material_allocator);
-    darray_mat4_create(2048, &context->local_instance_buffer);
+    block_allocator_create(256, sizeof(vulkan_mesh_t    ), &context->mesh_allocator);
+    block_allocator_create(64,  sizeof(vulkan_shader_t  ), &context->shader_allocator);
+    block_allocator_create(256, sizeof(vulkan_image_t   ), &context->image_allocator);
+    block_allocator_create(256, sizeof(vulkan_material_t), &context->material_allocator);
 
     create_vulkan_instance(application_name);
     create_vulkan_debug_callback();
@@ -182,12 +184,12 @@ b8 vulkan_renderer_initialize(const char* application_name, struct platform_stat
             &context->default_texture);
 
     // Resource allocators
-    block_allocator_create(1024, sizeof(vulkan_buffer_t), &context->shader_buffer_allocator);
+    block_allocator_create(256, sizeof(vulkan_buffer_t), &context->shader_buffer_allocator);
 
     resource_t default_shader_res = resource_loader_get_resource("assets/shaders/default", true);
     shader_t* default_shader = resource_get_shader(&default_shader_res);
     context->default_types.shader = default_shader;
-    context->default_shader = (vulkan_shader_t*)context->shader_allocator.buffer + context->default_types.shader->internal_offset;
+    context->default_shader = block_allocator_get(&context->shader_allocator, context->default_types.shader->internal_offset);
 
     resource_t default_mat_res = resource_loader_get_resource("assets/resources/materials/default", true);
     material_t* default_material = resource_get_material(&default_mat_res);
@@ -203,13 +205,7 @@ b8 vulkan_renderer_shutdown() {
 
     SINFO("Shutting down vulkan renderer");
 
-    block_allocator_zero_unused_blocks(&context->shader_buffer_allocator);
-    for (u32 i = 0; i < context->shader_buffer_allocator.block_count; i++) {
-        vulkan_buffer_t* buffer = (vulkan_buffer_t*)context->shader_buffer_allocator.buffer + i;
-        if (buffer->handle) {
-            vulkan_buffer_destroy(context, buffer);
-        }
-    }
+    block_allocator_iterate(&context->shader_buffer_allocator, buffer, vulkan_buffer_destroy(context, buffer); );
 
     block_allocator_iterate(&context->shader_allocator, shader, vulkan_shader_destroy(context, shader); );
     block_allocator_iterate(&context->image_allocator, image, vulkan_image_destroy(context, image); );
@@ -219,7 +215,6 @@ b8 vulkan_renderer_shutdown() {
     block_allocator_destroy(&context->shader_allocator);
     block_allocator_destroy(&context->material_allocator);
     block_allocator_destroy(&context->image_allocator);
-    darray_mat4_destroy    (&context->local_instance_buffer);
     sfree(context->shader_text_buffer, context->text_buffer_size, MEMORY_TAG_ARRAY);
 
     vulkan_image_destroy(context, &context->default_texture);
@@ -361,10 +356,10 @@ void create_indirect_draw_commands(vulkan_renderpass_t* renderpass, vulkan_comma
         instance_count++;
         geometry_render_data_t* geometry = &renderpass_geo->geometry[i];
         SASSERT(geometry->mesh.internal_offset != INVALID_ID, "Cannot render invalid mesh");
-        vulkan_mesh_t* mesh = context->mesh_allocator.buffer + geometry->mesh.internal_offset;
+        vulkan_mesh_t* mesh = block_allocator_get(&context->mesh_allocator, geometry->mesh.internal_offset);
         vulkan_material_t* material = geometry->material->internal_data;
 
-        darray_mat4_push(&context->local_instance_buffer, geometry->model);
+        context->local_instance_buffer[context->local_instance_count++] = geometry->model;
 
         b8 is_instance = false;
         if (i < renderpass_geo->geometry_count - 1) {
@@ -428,7 +423,13 @@ b8 vulkan_renderer_draw_frame(render_packet_t* packet) {
     vulkan_indirect_render_info_t* indirect_info = &context->indirect_draw_infos[context->current_frame];
     indirect_info->draws.count = 0;
     indirect_info->commands.count = 0;
-    context->local_instance_buffer.count = 0;
+
+    u32 geometry_count = 0;
+    for (u32 i = 0; i < BUILTIN_RENDERPASS_ENUM_MAX; i++) {
+        geometry_count += packet->renderpass_geometry[i].geometry_count;
+    }
+    context->local_instance_buffer = FRAME_ALLOC(mat4, geometry_count);
+    context->local_instance_count = 0;
 
     // Update uniforms
     mat4 translation = mat4_translation(packet->view_pos);
@@ -450,7 +451,6 @@ b8 vulkan_renderer_draw_frame(render_packet_t* packet) {
 
     // Mesh instances
     darray_VkDrawIndexedIndirectCommand_clear(&indirect_info->commands);
-    darray_mat4_clear(&context->local_instance_buffer);
     darray_indirect_draw_info_clear(&indirect_info->draws);
 
     u32 instance_offset = 0;
@@ -465,7 +465,7 @@ b8 vulkan_renderer_draw_frame(render_packet_t* packet) {
     }
 
     vulkan_buffer_update(context, &indirect_info->buffer, indirect_info->commands.data, indirect_info->commands.count * sizeof(VkDrawIndexedIndirectCommand), 0);
-    vulkan_buffer_update(context, &context->instance_buffer, context->local_instance_buffer.data, context->local_instance_buffer.count * sizeof(mat4), 0);
+    vulkan_buffer_update(context, &context->instance_buffer, context->local_instance_buffer, context->local_instance_count * sizeof(mat4), 0);
     return true;
 }
 
@@ -532,14 +532,14 @@ mesh_t vulkan_create_mesh(const void* vertices, u32 vertex_count, u32 vertex_str
 
     // Get new index
     mesh_t mesh = {
-        .internal_offset = (void*)internal_mesh - context->mesh_allocator.buffer,
+        .internal_offset = block_allocator_index_of(&context->mesh_allocator, internal_mesh),
     };
 
     return mesh;
 }
 
 void vulkan_renderer_destroy_mesh(const mesh_t* mesh) {
-    vulkan_mesh_t* _mesh = context->mesh_allocator.buffer + mesh->internal_offset;
+    vulkan_mesh_t* _mesh = block_allocator_get(&context->mesh_allocator, mesh->internal_offset);
     freelist_free(&context->vertex_buffer_freelist, context->vertex_buffer_freelist.memory + _mesh->vertex_allocation);
     freelist_free(&context->index_buffer_freelist, context->index_buffer_freelist.memory + _mesh->index_allocation);
     block_allocator_free(&context->mesh_allocator, _mesh);
@@ -630,8 +630,10 @@ shader_t vulkan_create_shader(shader_config_t* config) {
     shader_t shader_base = {
         .resource_count  = config->resource_count,
         .attribute_count = config->attribute_count,
-        .internal_offset = (void*)shader - context->shader_allocator.buffer,
+        .internal_offset = block_allocator_index_of(&context->shader_allocator, shader),
         .renderpass      = config->type,
+        // Binary shader configs do not need to null terminate a name that fills the array
+        .name            = string_intern_n(config->name, strnlen(config->name, SHADER_CONFIG_MAX_NAME_LENGTH)),
     };
 
     scopy_memory(shader_base.attributes, config->attributes, sizeof(config->attributes));
@@ -645,7 +647,7 @@ texture_t vulkan_create_image_from_file(const char* path, texture_filter_t filte
     vulkan_image_create_from_file(context, path, filter, VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture);
 
     texture_t out_texture = {
-        .internal_offset = (void*)texture - context->image_allocator.buffer,
+        .internal_offset = block_allocator_index_of(&context->image_allocator, texture),
     };
 
     return out_texture;
@@ -657,7 +659,7 @@ texture_t vulkan_create_image_from_data(const char* data, u32 width, u32 height,
     vulkan_image_upload_pixels(context, VK_FORMAT_R8G8B8A8_SRGB, width, height, (const void*)data, texture);
 
     texture_t out_texture = {
-        .internal_offset = (void*)texture - context->image_allocator.buffer,
+        .internal_offset = block_allocator_index_of(&context->image_allocator, texture),
     };
 
     return out_texture;
@@ -671,10 +673,10 @@ material_t vulkan_create_material(material_config_t* config) {
     vulkan_shader_t* internal_shader = context->default_shader;
     shader_t* shader = shader_loader_get_shader(0);
 
-    if (config->shader_path[0] != 0) {
-        resource_t shader_res = resource_loader_get_resource(config->shader_path, true);
+    if (config->shader_path != STRING_ID_INVALID) {
+        resource_t shader_res = resource_loader_get_resource_by_id(config->shader_path, true);
         shader = resource_get_shader(&shader_res);
-        internal_shader = context->shader_allocator.buffer + shader->internal_offset;
+        internal_shader = block_allocator_get(&context->shader_allocator, shader->internal_offset);
     }
 
     // Allocate resources
@@ -791,7 +793,7 @@ material_t vulkan_create_material(material_config_t* config) {
                 vulkan_buffer_create_descriptor_write(config->resources[i].value, config->resources[i].binding, material->sets[set], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, &buffer_info[i], &descriptor_writes[i]);
                 break;
             case SHADER_RESOURCE_SAMPLER:
-                image = context->image_allocator.buffer + ((texture_t*)config->resources[i].value)->internal_offset;
+                image = block_allocator_get(&context->image_allocator, ((texture_t*)config->resources[i].value)->internal_offset);
                 image_infos[i].sampler     = image->sampler;
                 image_infos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
                 image_infos[i].imageView   = image->view;
@@ -813,14 +815,11 @@ material_t vulkan_create_material(material_config_t* config) {
     vkUpdateDescriptorSets(context->logical_device, config->resource_count, descriptor_writes, 0, NULL);
 
     material_t out_material = {
+        .name = config->name,
         .internal_data = material,
         .shader = shader,
     };
 
-#ifdef SPARK_DEBUG
-    string_copy(out_material.name, config->name);
-#endif
-
     return out_material;
 }
 
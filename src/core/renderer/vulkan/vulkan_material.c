@@ -19,7 +19,7 @@ void vulkan_material_destroy(struct vulkan_context* context, vulkan_material_t*
 }
 
 void vulkan_material_bind(vulkan_context_t* context, vulkan_command_buffer_t* command_buffer, material_t* material) {
-    vulkan_shader_t* shader = context->shader_allocator.buffer + material->shader->internal_offset;
+    vulkan_shader_t* shader = block_allocator_get(&context->shader_allocator, material->shader->internal_offset);
     vulkan_material_t* internal_material = material->internal_data;
     SASSERT(internal_material != NULL, "Cannot bind material (index: %d): No internal material created.", material->internal_data);
 
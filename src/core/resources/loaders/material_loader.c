@@ -43,7 +43,10 @@ resource_t material_loader_load_text_resouce(const char* text, u32 length, b8 au
         .ref_count = 1,
     };
 
-    material_config_t config = {};
+    material_config_t config = {
+        .name = string_intern(""),
+        .shader_path = STRING_ID_INVALID,
+    };
 
     const u32 arg_buffer_count = 8;
     const u32 arg_buffer_size = 48;
@@ -55,9 +58,9 @@ resource_t material_loader_load_text_resouce(const char* text, u32 length, b8 au
         loader_read_line(text, &text_offset, (char*)args, arg_buffer_count, arg_buffer_size, &arg_count);
 
         if (string_equal(args[0], "name")) {
-            string_copy(config.name, args[1]);
+            config.name = string_intern(args[1]);
         } else if (string_equal(args[0], "shader_path")) {
-            string_ncopy(config.shader_path, args[1], MATERIAL_CONFIG_MAX_NAME_LENGTH);
+            config.shader_path = string_intern(args[1]);
         } else if (string_equal(args[0], "texture")) {
             SASSERT(arg_count == 4, "Cannot load material texture: Invalid format, expected 4 args. Format: 'texture:path,binding,set'");
             u32 resource_index = config.resource_count++;
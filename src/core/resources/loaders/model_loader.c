@@ -1,5 +1,4 @@
 #include "Spark/resources/loaders/model_loader.h"
-#include "Spark/containers/generic/darray_ints.h"
 #include "Spark/core/smemory.h"
 #include "Spark/core/sstring.h"
 #include "Spark/defines.h"
@@ -9,6 +8,7 @@
 #include "Spark/ecs/entity.h"
 #include "Spark/memory/block_allocator.h"
 #include "Spark/memory/linear_allocator.h"
+#include "Spark/memory/stack_allocator.h"
 #include "Spark/platform/filesystem.h"
 #include "Spark/renderer/material.h"
 #include "Spark/renderer/model.h"
@@ -18,18 +18,25 @@
 #include "Spark/resources/loaders/loader_utils.h"
 #include "Spark/resources/loaders/material_loader.h"
 #include "Spark/resources/resource_types.h"
+#include "Spark/threading/mutex.h"
 #include "Spark/types/s3d.h"
 #include "Spark/types/transforms.h"
 #include <stb_image.h>
 
+// Address space for loading a model, only the part that is used gets committed
+#define MODEL_LOADER_SCRATCH_SIZE (1ull << 30)
+
 // Private types
 darray_type(model_t*, model_ptr);
 darray_impl(model_t*, model_ptr);
 
 typedef struct model_loader_state {
-    darray_u8_t file_buffer;
+    // File contents and per-load arrays, rewound once a model is created
+    stack_allocator_t scratch;
     block_allocator_t model_allocator;
     darray_model_ptr_t models;
+    // Guards models, instances are staged from loader threads while the main thread may grow the array
+    spark_mutex_t models_mutex;
 } model_loader_state_t;
 
 static model_loader_state_t* state = NULL;
@@ -41,13 +48,15 @@ void model_loader_initialzie(linear_allocator_t* allocator) {
     state = linear_allocator_allocate(allocator, sizeof(model_loader_state_t));
     block_allocator_create(1024, sizeof(model_t), &state->model_allocator);
     darray_model_ptr_create(1024, &state->models);
-    darray_u8_create(8192, &state->file_buffer);
+    mutex_create(&state->models_mutex);
+    stack_allocator_create(MODEL_LOADER_SCRATCH_SIZE, &state->scratch);
 }
 
 void model_loader_shutdown() {
     block_allocator_destroy(&state->model_allocator);
     darray_model_ptr_destroy(&state->models);
-    darray_u8_destroy(&state->file_buffer);
+    mutex_destroy(&state->models_mutex);
+    stack_allocator_destroy(&state->scratch);
 }
 
 // resource_t* model_loader_load_resouce(const char* path, b8 auto_delete);
@@ -83,30 +92,28 @@ resource_t create_model_from_config(model_config_t* config) {
     file_handle_t file_handle;
     SASSERT(filesystem_open(config->path, FILE_MODE_READ, true, &file_handle), "Failed to open model at path '%s'", config->path);
 
-    
+    // Everything allocated from the scratch stack is released at the end of the load
+    const stack_allocator_mark_t scratch_mark = stack_allocator_mark(&state->scratch);
+
     u64 file_size = 0;
     filesystem_get_file_size(&file_handle, &file_size);
-    darray_u8_reserve(&state->file_buffer, file_size);
-    sset_memory(&state->file_buffer, 0, state->file_buffer.count);
-    darray_u8_clear(&state->file_buffer);
+    u8* file_data = STACK_ALLOC(&state->scratch, u8, file_size);
+    SASSERT(file_data, "Model '%s' of %lu bytes does not fit in the model loader scratch memory.", config->path, file_size);
 
     u64 bytes_read = 0;
-    filesystem_read_all_bytes(&file_handle, state->file_buffer.data, &bytes_read);
+    filesystem_read_all_bytes(&file_handle, file_data, &bytes_read);
     filesystem_close(&file_handle);
 
     SASSERT(bytes_read > 0, "Failed to read data from model file at '%s'", config->path);
-    SASSERT(*(u32*)state->file_buffer.data == S3D_FILE_MAGIC, "Model '%s' is not an S3D mseh.", config->path);
-    s3d_t* header = (s3d_t*)state->file_buffer.data;
+    SASSERT(*(u32*)file_data == S3D_FILE_MAGIC, "Model '%s' is not an S3D mseh.", config->path);
+    s3d_t* header = (s3d_t*)file_data;
 
-    vertex_3d_t* vertices = (void*)state->file_buffer.data + header->vertex_offset;
-    void* indices = state->file_buffer.data + header->index_offset;
+    vertex_3d_t* vertices = (void*)file_data + header->vertex_offset;
+    void* indices = file_data + header->index_offset;
 
     // Load textures
     s3d_texture_t* s3d_textures = ((void*)header) + header->texture_offset;
-    const u32 max_texture_count = 64;
-    texture_t textures[max_texture_count] = {};
-
-    SASSERT(header->texture_count < max_texture_count, "S3d has too many textures, max of %d, got %d", max_texture_count, header->texture_count);
+    texture_t* textures = STACK_ALLOC(&state->scratch, texture_t, header->texture_count);
 
     for (u32 i = 0; i < header->texture_count; i++) {
         s32 width = 0;
@@ -120,19 +127,18 @@ resource_t create_model_from_config(model_config_t* config) {
 
     // Load materials
     s3d_material_t* s3d_materials = ((void*)header) + header->material_offset;
-    constexpr u32 max_material_count = 64;
-    material_t* materials[max_material_count] = {};
-
-    SASSERT(header->material_count < max_material_count, "S3d has too many materials, max of %d, got %d", max_material_count, header->material_count);
+    material_t** materials = STACK_ALLOC(&state->scratch, material_t*, header->material_count);
+    const string_id material_name = string_intern(config->path);
 
     for (u32 i = 0; i < header->material_count; i++) {
         // if (s3d_materials[i].texture_count <= 0) {
         //     continue;
         // }
         material_config_t material_config = {
+            .name = material_name,
+            .shader_path = STRING_ID_INVALID,
             .resource_count = s3d_materials[i].texture_count,
         };
-        string_copy(material_config.name, config->path);
 
         for (u32 t = 0; t < s3d_materials[i].texture_count; t++) {
             material_config.resources[t] = 
@@ -147,12 +153,11 @@ resource_t create_model_from_config(model_config_t* config) {
         materials[i] = material_loader_create_from_config(&material_config);
     }
 
-    constexpr u32 max_models = 1024;
-    model_t* models[max_models] = {};
+    model_t** models = STACK_ALLOC(&state->scratch, model_t*, header->object_count);
 
     u32 resource_index = 0;
     for (u32 i = 0; i < header->object_count; i++) {
-        s3d_object_t* object = (s3d_object_t*)((void*)state->file_buffer.data + sizeof(s3d_t) + sizeof(s3d_object_t) * i);
+        s3d_object_t* object = (s3d_object_t*)((void*)file_data + sizeof(s3d_t) + sizeof(s3d_object_t) * i);
         model_t* model = block_allocator_allocate(&state->model_allocator);
         models[i] = model;
         model->material = NULL;
@@ -170,12 +175,14 @@ resource_t create_model_from_config(model_config_t* config) {
                 child->next_child = model;
             }
         } else {
+            mutex_lock(state->models_mutex);
             resource_index = state->models.count;
             darray_model_ptr_push(&state->models, model);
+            mutex_unlock(state->models_mutex);
         }
 
         if (object->mesh_index != INVALID_ID_U16) {
-            s3d_mesh_t* mesh = (s3d_mesh_t*)(state->file_buffer.data + header->mesh_offset + sizeof(s3d_mesh_t) * object->mesh_index);
+            s3d_mesh_t* mesh = (s3d_mesh_t*)(file_data + header->mesh_offset + sizeof(s3d_mesh_t) * object->mesh_index);
 
             mesh_t out_mesh = renderer_create_mesh(vertices + mesh->vertex_offset, 
                     mesh->vertex_count, 
@@ -197,6 +204,7 @@ resource_t create_model_from_config(model_config_t* config) {
         model->rotation    = object->rotation;
     }
 
+    stack_allocator_rewind_to(&state->scratch, scratch_mark);
 
     resource_t resource = {
         .internal_index = resource_index,
@@ -241,7 +249,54 @@ entity_t load_model_entity_recursive(ecs_world_t* world, model_t* node, entity_t
     return e;
 }
 
+// Root model of a loaded resource. Models come from the block allocator and never move, only the array does
+static model_t* model_loader_root_model(u32 index) {
+    mutex_lock(state->models_mutex);
+    model_t* model = state->models.data[index];
+    mutex_unlock(state->models_mutex);
+    return model;
+}
+
 entity_t model_loader_instance_model(u32 index, u32 material_override_count, material_t* material_overrides[static material_override_count]) {
     ecs_world_t* world = ecs_world_get();
-    return load_model_entity_recursive(world, state->models.data[index], INVALID_ID, material_override_count, material_overrides);
+    return load_model_entity_recursive(world, model_loader_root_model(index), INVALID_ID, material_override_count, material_overrides);
+}
+
+entity_t stage_model_entity(ecs_command_buffer_t* buffer, ecs_world_t* world, model_t* model, entity_t parent, u32 material_count, material_t** materials) {
+    entity_t e = ecs_command_buffer_create_entity(buffer, world);
+
+    if (parent != INVALID_ID) {
+        ecs_command_buffer_add_child(buffer, parent, e);
+    }
+
+    if (model->mesh.internal_offset != INVALID_ID) {
+        ECS_COMMAND_SET_COMPONENT(buffer, e, mesh_t, model->mesh);
+
+        if (model->material_index <= material_count) {
+            ECS_COMMAND_SET_COMPONENT(buffer, e, material_t, *model->material);
+        } else {
+            ECS_COMMAND_SET_COMPONENT(buffer, e, material_t, *materials[model->material_index]);
+        }
+        ECS_COMMAND_SET_COMPONENT(buffer, e, aabb_t, model->bounds);
+    }
+
+    ecs_command_buffer_add_transforms(buffer, e, model->translation, model->scale, model->rotation);
+    return e;
+}
+
+entity_t stage_model_entity_recursive(ecs_command_buffer_t* buffer, ecs_world_t* world, model_t* node, entity_t parent, u32 material_override_count, material_t* material_overrides[static material_override_count]) {
+    entity_t e = stage_model_entity(buffer, world, node, parent, material_override_count, material_overrides);
+
+    model_t* child = node->children;
+    while (child) {
+        stage_model_entity_recursive(buffer, world, child, e, material_override_count, material_overrides);
+        child = child->next_child;
+    }
+
+    return e;
+}
+
+entity_t model_loader_stage_model(ecs_command_buffer_t* buffer, u32 index, u32 material_override_count, material_t* material_overrides[static material_override_count]) {
+    ecs_world_t* world = ecs_world_get();
+    return stage_model_entity_recursive(buffer, world, model_loader_root_model(index), INVALID_ID, material_override_count, material_overrides);
 }
@@ -4,6 +4,7 @@
 #include "Spark/core/logging.h"
 #include "Spark/core/smemory.h"
 #include "Spark/core/sstring.h"
+#include "Spark/core/string_intern.h"
 #include "Spark/defines.h"
 #include "Spark/memory/linear_allocator.h"
 #include "Spark/platform/filesystem.h"
@@ -22,8 +23,9 @@ darray_impl(resource_t, resource);
 
 darray_header(darray_resource_t, resource_set);
 
-hashmap_type(resource_map, const char*, resource_t);
-hashmap_impl(resource_map, const char*, resource_t, string_hash, string_compare, string_duplicate);
+// Keyed by the interned path, ids are dense so they are used as their own hash
+hashmap_type(resource_map, string_id, resource_t);
+hashmap_impl(resource_map, string_id, resource_t, hash_passthrough, u64_compare, hash_passthrough);
 
 typedef struct shader_loader_state {
     darray_u8_t resource_buffer;
@@ -65,10 +67,15 @@ void resource_loader_shutdown() {
 }
 
 resource_t resource_loader_get_resource(const char* path, b8 auto_delete) {
+    return resource_loader_get_resource_by_id(string_intern(path), auto_delete);
+}
+
+resource_t resource_loader_get_resource_by_id(string_id path_id, b8 auto_delete) {
     resource_t out_resource = (resource_t) { .type = RESOURCE_TYPE_NULL };
-    if (resource_map_try_get(&loader_state->resources, path, &out_resource)) {
+    if (resource_map_try_get(&loader_state->resources, path_id, &out_resource)) {
         return out_resource;
     }
+    const char* path = string_intern_get(path_id);
 
     // Load file
     // Load the bytes
@@ -120,7 +127,7 @@ resource_t resource_loader_get_resource(const char* path, b8 auto_delete) {
         }
     }
 
-    resource_map_insert(&loader_state->resources, path, out_resource);
+    resource_map_insert(&loader_state->resources, path_id, out_resource);
     return out_resource;
 }
 void resource_loader_destroy_resource(resource_t* resource) {
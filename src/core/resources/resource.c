@@ -25,3 +25,9 @@ entity_t resource_instance_model(resource_t* resource, u32 material_count, mater
     SASSERT(resource->type == RESOURCE_TYPE_MODEL, "Cannot load model from resource type. Resource is not a model, got type %d", resource->type);
     return model_loader_instance_model(resource->internal_index, material_count, materials);
 }
+
+entity_t resource_stage_model_instance(ecs_command_buffer_t* buffer, resource_t* resource, u32 material_count, material_t** materials) {
+    SASSERT(resource, "Cannot load null resource data");
+    SASSERT(resource->type == RESOURCE_TYPE_MODEL, "Cannot load model from resource type. Resource is not a model, got type %d", resource->type);
+    return model_loader_stage_model(buffer, resource->internal_index, material_count, materials);
+}
@@ -1,10 +1,10 @@
-#include "Spark/containers/darray.h"
 #include "Spark/core/logging.h"
 #include "Spark/ecs/ecs.h"
 #include "Spark/ecs/ecs_world.h"
 #include "Spark/ecs/entity.h"
 #include "Spark/math/mat4.h"
 #include "Spark/math/vec3.h"
+#include "Spark/memory/frame_allocator.h"
 #include "Spark/renderer/renderer_frontend.h"
 #include "Spark/renderer/renderer_types.h"
 #include "Spark/renderer/renderpasses.h"
@@ -18,15 +18,19 @@
 void render_camera(vec3 camera_position, quat camera_rotation, local_to_world_t local, mat4 view_matrix);
 void render_orthographic_cameras(ecs_iterator_t* iterator);
 void render_perspective_cameras(ecs_iterator_t* iterator);
-void render_entities(ecs_iterator_t* iterator);
 
 // Private Types
-darray_type(geometry_render_data_t, geometry_render_data);
-darray_impl(geometry_render_data_t, geometry_render_data);
+ECS_QUERY(render_entities, mesh_t, local_to_world_t, aabb_t, material_t);
+
+void render_entities(render_entities_query_t* entities);
 
 typedef struct render_system_state {
     ecs_query_t* render_entities_query;
-    darray_geometry_render_data_t render_data[BUILTIN_RENDERPASS_ENUM_MAX];
+    // Geometry of the camera in query order and the renderpass of each, allocated from the frame allocator
+    geometry_render_data_t* gathered_data;
+    u8* gathered_renderpasses;
+    u32 gathered_count;
+    u32 render_data_count[BUILTIN_RENDERPASS_ENUM_MAX];
     vec3 camera_pos;
     vec3 camera_forward;
     frustum_t view_frustum;
@@ -37,25 +41,8 @@ render_system_state_t render_state;
 
 // Function Impl
 void render_system_initialize(ecs_world_t* world) {
-
-    for (u32 i = 0; i < BUILTIN_RENDERPASS_ENUM_MAX; i++) {
-        darray_geometry_render_data_create(300, &render_state.render_data[i]);
-    }
-
     // Render Entities
-    const ecs_component_id render_entities_components[] = { 
-        ECS_COMPONENT_ID(mesh_t), 
-        ECS_COMPONENT_ID(local_to_world_t), 
-        ECS_COMPONENT_ID(aabb_t), 
-        ECS_COMPONENT_ID(material_t)
-    };
-
-    const ecs_query_create_info_t render_entities_create_info = {
-        .component_count = 4,
-        .components = render_entities_components,
-    };
-
-    render_state.render_entities_query = ecs_query_create(world, &render_entities_create_info);
+    render_state.render_entities_query = render_entities_query_create(world);
 
     // Render Perspective Cameras
     const ecs_system_create_info_t render_cameras_create_info = {
@@ -95,9 +82,6 @@ void render_system_initialize(ecs_world_t* world) {
 }
 
 void render_system_shutdown() {
-    for (u32 i = 0; i < BUILTIN_RENDERPASS_ENUM_MAX; i++) {
-        darray_geometry_render_data_destroy(&render_state.render_data[i]);
-    }
 }
 
 b32 sort_geometry(const void* a, const void* b) {
@@ -160,14 +144,31 @@ void render_camera(vec3 camera_position, quat camera_rotation, local_to_world_t
     render_state.camera_pos = camera_pos;
     render_state.camera_forward = camera_forward;
 
-    for (u32 i = 0; i < BUILTIN_RENDERPASS_ENUM_MAX; i++) {
-        darray_geometry_render_data_clear(&render_state.render_data[i]);
+    // Gather every entity once, the archetypes know how many there are so the frame memory is sized up front
+    const u32 entity_count = ecs_query_entity_count(render_state.render_entities_query);
+    render_state.gathered_data = FRAME_ALLOC(geometry_render_data_t, entity_count);
+    render_state.gathered_renderpasses = FRAME_ALLOC(u8, entity_count);
+    render_state.gathered_count = 0;
+    szero_memory(render_state.render_data_count, sizeof(render_state.render_data_count));
+
+    render_entities_query_t entities;
+    render_entities_query_iterator(render_state.render_entities_query, &entities);
+    while (render_entities_query_next(&entities)) {
+        render_entities(&entities);
     }
-    ecs_query_iterate(render_state.render_entities_query, render_entities);
 
+    // Give each renderpass a contiguous range, keeping the gathered order within a pass
+    geometry_render_data_t* render_data = FRAME_ALLOC(geometry_render_data_t, render_state.gathered_count);
+    u32 pass_offsets[BUILTIN_RENDERPASS_ENUM_MAX];
+    u32 offset = 0;
     for (u32 i = 0; i < BUILTIN_RENDERPASS_ENUM_MAX; i++) {
-        packet.renderpass_geometry[i].geometry_count = render_state.render_data[i].count;
-        packet.renderpass_geometry[i].geometry = render_state.render_data[i].data;
+        pass_offsets[i] = offset;
+        packet.renderpass_geometry[i].geometry_count = render_state.render_data_count[i];
+        packet.renderpass_geometry[i].geometry = render_data + offset;
+        offset += render_state.render_data_count[i];
+    }
+    for (u32 i = 0; i < render_state.gathered_count; i++) {
+        render_data[pass_offsets[render_state.gathered_renderpasses[i]]++] = render_state.gathered_data[i];
     }
 
     // qsort(packet.geometries, packet.geometry_count, sizeof(geometry_render_data_t), sort_geometry);
@@ -222,14 +223,14 @@ void render_perspective_cameras(ecs_iterator_t* iterator) {
     }
 }
 
-void render_entities(ecs_iterator_t* iterator) {
+void render_entities(render_entities_query_t* entities) {
     // Render each entity in the vameras view
-    mesh_t* meshes                 = ECS_ITERATOR_GET_COMPONENTS(iterator, 0);
-    local_to_world_t* locals       = ECS_ITERATOR_GET_COMPONENTS(iterator, 1);
-    aabb_t* bounds                 = ECS_ITERATOR_GET_COMPONENTS(iterator, 2);
-    material_t* materials          = ECS_ITERATOR_GET_COMPONENTS(iterator, 3);
+    mesh_t* meshes                 = entities->mesh_t;
+    local_to_world_t* locals       = entities->local_to_world_t;
+    aabb_t* bounds                 = entities->aabb_t;
+    material_t* materials          = entities->material_t;
 
-    for (u32 i = 0; i < iterator->entity_count; i++) {
+    for (u32 i = 0; i < entities->entity_count; i++) {
         vec3 geometry_pos = {
             locals[i].value.data[12],
             locals[i].value.data[13],
@@ -251,8 +252,10 @@ void render_entities(ecs_iterator_t* iterator) {
             },
         };
 
-        shader_t* shader = materials[i].shader;
-        SASSERT(shader, "Material '%s' shader is null.", materials[i].name);
-        darray_geometry_render_data_push(&render_state.render_data[shader->renderpass], render_data);
+        SASSERT(materials[i].shader, "Material '%s' shader is null.", string_intern_get(materials[i].name));
+        const u32 renderpass = materials[i].shader->renderpass;
+        render_state.gathered_data[render_state.gathered_count] = render_data;
+        render_state.gathered_renderpasses[render_state.gathered_count++] = renderpass;
+        render_state.render_data_count[renderpass]++;
     }
 }
@@ -93,12 +93,17 @@ void parent_entity(ecs_world_t* world, mat4 parent_matrix, entity_t child, b8 fo
     }
 }
 
+ECS_QUERY(transform_3d, translation_t, rotation_t, scale_t, local_to_world_t, dirty_transform_t);
+
 void create_world_to_local_matrix(ecs_iterator_t* iterator) {
-    translation_t* translations = ECS_ITERATOR_GET_COMPONENTS(iterator, 0);
-    rotation_t* rotations = ECS_ITERATOR_GET_COMPONENTS(iterator, 1);
-    scale_t* scales = ECS_ITERATOR_GET_COMPONENTS(iterator, 2);
-    local_to_world_t* locals = ECS_ITERATOR_GET_COMPONENTS(iterator, 3);
-    dirty_transform_t* dirty = ECS_ITERATOR_GET_COMPONENTS(iterator, 4);
+    transform_3d_query_t transforms;
+    transform_3d_query_from_iterator(iterator, &transforms);
+
+    translation_t* translations = transforms.translation_t;
+    rotation_t* rotations       = transforms.rotation_t;
+    scale_t* scales             = transforms.scale_t;
+    local_to_world_t* locals    = transforms.local_to_world_t;
+    dirty_transform_t* dirty    = transforms.dirty_transform_t;
 
     for (u32 i = 0; i < iterator->entity_count; i++) {
         // if (!dirty[i].dirty) {
@@ -152,16 +157,12 @@ void transform_system_initialize(ecs_world_t* world) {
     };
     ecs_system_create(world, &update_2d_create_info);
 
+    ecs_component_id transform_3d_components[transform_3d_query_component_count];
+    transform_3d_query_components(transform_3d_components);
     const ecs_system_create_info_t update_3d_create_info = {
         .query = {
-            .component_count = 5,
-            .components = (ecs_component_id[]) {
-                ECS_COMPONENT_ID(translation_t),
-                ECS_COMPONENT_ID(rotation_t),
-                ECS_COMPONENT_ID(scale_t),
-                ECS_COMPONENT_ID(local_to_world_t),
-                ECS_COMPONENT_ID(dirty_transform_t),
-            }
+            .component_count = transform_3d_query_component_count,
+            .components = transform_3d_components,
         },
         .phase = ECS_PHASE_TRANSFORM,
         .name = "Transform Update 3D",
@@ -1,4 +1,5 @@
 #include "Spark/threading/thread.h"
+#include "Spark/core/smemory.h"
 #include "Spark/defines.h"
 #include <bits/pthreadtypes.h>
 #include <pthread.h>
@@ -9,10 +10,20 @@
 typedef struct { 
     pthread_t thread;
     thread_state_t state;
+    void* (*function)(void* args);
+    void* args;
 } internal_thread_t;
 
 internal_thread_t internal_threads[MAX_THREAD_COUNT];
 
+// Runs the thread's function, then hands what the thread cached in the memory system back before it exits
+static void* thread_entry(void* internal_thread) {
+    const internal_thread_t* thread = internal_thread;
+    void* result = thread->function(thread->args);
+    memory_thread_shutdown();
+    return result;
+}
+
 void thread_create(void (*function(void* args)), void* args, thread_t* out_thread) {
     // Find valid thread ID
     u32 thread_id = INVALID_ID;
@@ -36,7 +47,9 @@ void thread_create(void (*function(void* args)), void* args, thread_t* out_threa
     out_thread->thread_id = thread_id;
 
     // Start the thread
-    pthread_create(&internal_threads[thread_id].thread, NULL, function, args);
+    internal_threads[thread_id].function = function;
+    internal_threads[thread_id].args = args;
+    pthread_create(&internal_threads[thread_id].thread, NULL, thread_entry, &internal_threads[thread_id]);
 }
 
 void thread_destroy(thread_t* thread) {
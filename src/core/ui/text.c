@@ -2,6 +2,7 @@
 #include "Spark/core/sstring.h"
 #include "Spark/ecs/entity.h"
 #include "Spark/math/mat4.h"
+#include "Spark/memory/frame_allocator.h"
 #include "Spark/renderer/mesh.h"
 #include "Spark/renderer/renderer_frontend.h"
 #include "Spark/types/transforms.h"
@@ -31,14 +32,11 @@ void text_update(ecs_world_t* world, entity_t entity, text_t text) {
         renderer_destroy_mesh(mesh);
     }
 
-    // Create new mesh
-    constexpr u32 max_vertex_count = 8192;
-    static vertex_2d_t vertices[max_vertex_count] = {};
-
-    constexpr u32 max_index_count = 8192 * 3;
-    static u32 indices[max_index_count] = {};
-
+    // Create new mesh, the geometry is only needed until it is uploaded
     const u32 text_len = string_length(text.value);
+    vertex_2d_t* vertices = FRAME_ALLOC(vertex_2d_t, text_len * 4);
+    u32* indices = FRAME_ALLOC(u32, text_len * 6);
+
     f32 x_offset = 0;
     f32 y_offset = 0;
 
@@ -0,0 +1,189 @@
+#include "Spark/containers/bitset.h"
+#include "Spark/containers/generic/darray_ints.h"
+#include "Spark/core/logging.h"
+#include "Spark/core/smemory.h"
+#include "Spark/math/smath.h"
+
+// Not a multiple of the block size, so the padding past the last bit is exercised
+#define BITSET_TEST_BIT_COUNT 1000
+
+static u32 bitset_test_random_state = 12345;
+
+static u32 bitset_test_random() {
+    bitset_test_random_state = bitset_test_random_state * 1664525u + 1013904223u;
+    return bitset_test_random_state >> 8;
+}
+
+// Compares every bit and the count with a plain bool array
+static b8 bitset_test_matches(const bitset_t* bitset, const b8* reference) {
+    u32 count = 0;
+    for (u32 i = 0; i < BITSET_TEST_BIT_COUNT; i++) {
+        if (bitset_test(bitset, i) != reference[i]) {
+            return false;
+        }
+        count += reference[i];
+    }
+    return bitset_count(bitset) == count && bitset_any(bitset) == (count > 0);
+}
+
+static void bitset_test_collect(u32 bit, void* user_data) {
+    darray_u32_t* bits = user_data;
+    darray_u32_push(bits, bit);
+}
+
+void bitset_tests() {
+    initialize_memory();
+
+    // Single bits and ranges, including ranges within one word and across many
+    {
+        bitset_t bitset;
+        bitset_create(BITSET_TEST_BIT_COUNT, &bitset);
+        b8 reference[BITSET_TEST_BIT_COUNT] = {0};
+
+        b8 success = bitset.word_count % BITSET_BLOCK_WORDS == 0 && !bitset_any(&bitset);
+        for (u32 i = 0; i < 2000 && success; i++) {
+            const u32 first = bitset_test_random() % BITSET_TEST_BIT_COUNT;
+            const u32 count = bitset_test_random() % (i % 2 ? 8 : BITSET_TEST_BIT_COUNT - first + 1);
+            const u32 operation = bitset_test_random() % 4;
+            if (operation == 0) {
+                bitset_set(&bitset, first);
+                reference[first] = true;
+            } else if (operation == 1) {
+                bitset_clear(&bitset, first);
+                reference[first] = false;
+            } else {
+                const u32 range_count = smin(count, BITSET_TEST_BIT_COUNT - first);
+                if (operation == 2) {
+                    bitset_set_range(&bitset, first, range_count);
+                } else {
+                    bitset_clear_range(&bitset, first, range_count);
+                }
+                for (u32 j = first; j < first + range_count; j++) {
+                    reference[j] = operation == 2;
+                }
+            }
+            success = bitset_test_matches(&bitset, reference);
+        }
+
+        bitset_set_range(&bitset, 0, BITSET_TEST_BIT_COUNT);
+        success &= bitset_count(&bitset) == BITSET_TEST_BIT_COUNT;
+        bitset_clear_all(&bitset);
+        success &= !bitset_any(&bitset);
+        bitset_destroy(&bitset);
+
+        if (!success) {
+            SERROR("Bitset range test failed.");
+        } else {
+            SINFO("Bitset range test success");
+        }
+    }
+
+    // Bulk operations and iteration over set bits
+    {
+        bitset_t a, b, result;
+        bitset_create(BITSET_TEST_BIT_COUNT, &a);
+        bitset_create(BITSET_TEST_BIT_COUNT, &b);
+        bitset_create(BITSET_TEST_BIT_COUNT, &result);
+        b8 reference_a[BITSET_TEST_BIT_COUNT];
+        b8 reference_b[BITSET_TEST_BIT_COUNT];
+        b8 expected[BITSET_TEST_BIT_COUNT];
+        for (u32 i = 0; i < BITSET_TEST_BIT_COUNT; i++) {
+            reference_a[i] = bitset_test_random() % 3 == 0;
+            reference_b[i] = bitset_test_random() % 2 == 0;
+            bitset_assign(&a, i, reference_a[i]);
+            bitset_assign(&b, i, reference_b[i]);
+        }
+
+        b8 success = true;
+        bitset_and(&result, &a, &b);
+        for (u32 i = 0; i < BITSET_TEST_BIT_COUNT; i++) {
+            expected[i] = reference_a[i] && reference_b[i];
+        }
+        success &= bitset_test_matches(&result, expected);
+
+        bitset_or(&result, &a, &b);
+        for (u32 i = 0; i < BITSET_TEST_BIT_COUNT; i++) {
+            expected[i] = reference_a[i] || reference_b[i];
+        }
+        success &= bitset_test_matches(&result, expected);
+
+        bitset_andnot(&result, &a, &b);
+        for (u32 i = 0; i < BITSET_TEST_BIT_COUNT; i++) {
+            expected[i] = reference_a[i] && !reference_b[i];
+        }
+        success &= bitset_test_matches(&result, expected);
+
+        // Both ways of iterating visit exactly the set bits in order
+        darray_u32_t bits;
+        darray_u32_create(BITSET_TEST_BIT_COUNT, &bits);
+        bitset_for_each(&result, bitset_test_collect, &bits);
+        u32 position = 0;
+        for (u32 i = bitset_next(&result, 0); i != INVALID_ID; i = bitset_next(&result, i + 1)) {
+            success &= position < bits.count && bits.data[position] == i && expected[i];
+            position++;
+        }
+        success &= position == bits.count && position == bitset_count(&result);
+        darray_u32_destroy(&bits);
+
+        // Shrinking clears the bits past the new end, growing keeps the rest
+        bitset_resize(&a, 100);
+        u32 expected_count = 0;
+        for (u32 i = 0; i < 100; i++) {
+            expected_count += reference_a[i];
+        }
+        success &= bitset_count(&a) == expected_count && bitset_next(&a, 100) == INVALID_ID;
+        bitset_resize(&a, 5000);
+        success &= bitset_count(&a) == expected_count && bitset_test(&a, 99) == reference_a[99];
+
+        bitset_destroy(&a);
+        bitset_destroy(&b);
+        bitset_destroy(&result);
+
+        if (!success) {
+            SERROR("Bitset operations test failed.");
+        } else {
+            SINFO("Bitset operations test success");
+        }
+    }
+
+    // The scalar paths give the same results as the AVX2 paths
+    {
+        bitset_t a, b, vector_result, scalar_result;
+        bitset_create(BITSET_TEST_BIT_COUNT, &a);
+        bitset_create(BITSET_TEST_BIT_COUNT, &b);
+        bitset_create(BITSET_TEST_BIT_COUNT, &vector_result);
+        bitset_create(BITSET_TEST_BIT_COUNT, &scalar_result);
+        for (u32 i = 0; i < BITSET_TEST_BIT_COUNT; i++) {
+            bitset_assign(&a, i, bitset_test_random() % 3 == 0);
+            bitset_assign(&b, i, bitset_test_random() % 2 == 0);
+        }
+
+        b8 success = true;
+        void (*operations[])(bitset_t*, const bitset_t*, const bitset_t*) = { bitset_and, bitset_or, bitset_andnot };
+        for (u32 i = 0; i < sizeof(operations) / sizeof(operations[0]); i++) {
+            bitset_set_avx2(true);
+            operations[i](&vector_result, &a, &b);
+            const u32 vector_count = bitset_count(&vector_result);
+            const b8 vector_any = bitset_any(&vector_result);
+
+            bitset_set_avx2(false);
+            operations[i](&scalar_result, &a, &b);
+            success &= scompare_memory(vector_result.words, scalar_result.words, sizeof(u64) * scalar_result.word_count);
+            success &= bitset_count(&scalar_result) == vector_count && bitset_any(&scalar_result) == vector_any;
+        }
+        bitset_clear_all(&scalar_result);
+        success &= !bitset_any(&scalar_result) && bitset_count(&scalar_result) == 0;
+        bitset_set_avx2(true);
+
+        bitset_destroy(&a);
+        bitset_destroy(&b);
+        bitset_destroy(&vector_result);
+        bitset_destroy(&scalar_result);
+
+        if (!success) {
+            SERROR("Bitset scalar / AVX2 test failed.");
+        } else {
+            SINFO("Bitset scalar / AVX2 test success");
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#include "Spark/core/logging.h"
+#include "Spark/core/smemory.h"
+#include "Spark/memory/block_allocator.h"
+
+typedef struct test_block {
+    u64 value;
+    u8 padding[40];
+} test_block_t;
+
+void block_allocator_tests() {
+    initialize_memory();
+
+    block_allocator_t allocator;
+    constexpr u32 page_block_count = 16;
+    block_allocator_create(page_block_count, sizeof(test_block_t), &allocator);
+
+    // Allocating past the first page adds pages without moving existing blocks
+    constexpr u32 block_count = page_block_count * 5 + 3;
+    test_block_t* blocks[block_count];
+    {
+        b8 success = true;
+        for (u32 i = 0; i < block_count; i++) {
+            blocks[i] = block_allocator_allocate(&allocator);
+            blocks[i]->value = i;
+            success &= ((size_t)blocks[i] & 15) == 0;
+        }
+
+        for (u32 i = 0; i < block_count; i++) {
+            const u32 index = block_allocator_index_of(&allocator, blocks[i]);
+            success &= blocks[i]->value == i && block_allocator_get(&allocator, index) == blocks[i];
+        }
+
+        u32 iterated_count = 0;
+        u64 value_sum = 0;
+        block_allocator_iterate(&allocator, block, iterated_count++; value_sum += ((test_block_t*)block)->value; );
+        success &= iterated_count == block_count && value_sum == (u64)block_count * (block_count - 1) / 2;
+
+        if (success) {
+            SINFO("Block allocator growth test success");
+        } else {
+            SERROR("Block allocator growth test failed.");
+        }
+    }
+
+    // Freed blocks are reused, and freed pages are given back once they are empty
+    {
+        test_block_t* freed = blocks[page_block_count + 1];
+        block_allocator_free(&allocator, freed);
+        b8 success = block_allocator_allocate(&allocator) == freed;
+
+        allocator.release_empty_pages = true;
+        for (u32 i = 0; i < page_block_count; i++) {
+            block_allocator_free(&allocator, blocks[i]);
+        }
+        success &= allocator.pages[0] == NULL;
+
+        u32 iterated_count = 0;
+        // Only blocks of the pages that are still there are visited
+        block_allocator_iterate(&allocator, block,
+                const u32 index = block_allocator_index_of(&allocator, block);
+                success &= block && index >= page_block_count && allocator.pages[index / page_block_count] &&
+                    block_allocator_get(&allocator, index) == block;
+                iterated_count++; );
+        success &= iterated_count == block_count - page_block_count;
+
+        // Once the last page is full, the released page's index is reused
+        for (u32 i = block_count; i < page_block_count * 6; i++) {
+            block_allocator_allocate(&allocator);
+        }
+        test_block_t* block = block_allocator_allocate(&allocator);
+        success &= allocator.pages[0] != NULL && block_allocator_index_of(&allocator, block) < page_block_count;
+
+        if (success) {
+            SINFO("Block allocator reuse test success");
+        } else {
+            SERROR("Block allocator reuse test failed.");
+        }
+    }
+
+    block_allocator_destroy(&allocator);
+}
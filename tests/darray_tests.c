@@ -0,0 +1,35 @@
+#include "Spark/containers/generic/darray_ints.h"
+#include "Spark/core/logging.h"
+
+#define DARRAY_TEST_COUNT 8
+
+void darray_tests() {
+    initialize_memory();
+
+    // Popping shifts the values after the index down by one, from the front, the middle and the end
+    {
+        darray_u32_t array;
+        darray_u32_create(2, &array);
+        for (u32 i = 0; i < DARRAY_TEST_COUNT; i++) {
+            darray_u32_push(&array, i);
+        }
+
+        b8 success = array.count == DARRAY_TEST_COUNT && array.capacity >= DARRAY_TEST_COUNT;
+        success &= darray_u32_pop(&array, 0) == 0;
+        success &= darray_u32_pop(&array, 3) == 4;
+        success &= darray_u32_pop(&array, array.count - 1) == DARRAY_TEST_COUNT - 1;
+
+        const u32 expected[] = { 1, 2, 3, 5, 6 };
+        success &= array.count == sizeof(expected) / sizeof(expected[0]);
+        for (u32 i = 0; i < array.count && success; i++) {
+            success &= array.data[i] == expected[i];
+        }
+        darray_u32_destroy(&array);
+
+        if (!success) {
+            SERROR("Darray pop test failed.");
+        } else {
+            SINFO("Darray pop test success");
+        }
+    }
+}
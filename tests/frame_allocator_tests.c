@@ -0,0 +1,79 @@
+#include "Spark/core/logging.h"
+#include "Spark/core/smemory.h"
+#include "Spark/memory/frame_allocator.h"
+
+void frame_allocator_tests() {
+    initialize_memory();
+    constexpr u64 frame_size = 1 * KB;
+    frame_allocator_initialize(frame_size);
+
+    // Allocations past the frame size still succeed and are reported once for the frame
+    {
+        u8* fitting = frame_alloc(frame_size / 2);
+        sset_memory(fitting, 0xAB, frame_size / 2);
+        for (u32 i = 0; i < 3; i++) {
+            u8* overflow = frame_alloc(frame_size);
+            sset_memory(overflow, 0xCD, frame_size);
+        }
+        frame_allocator_end_frame();
+
+        frame_allocator_stats_t overflowed;
+        frame_allocator_get_stats(&overflowed);
+
+        // A frame that fits reports no overflow
+        frame_alloc(frame_size / 4);
+        frame_allocator_end_frame();
+        frame_allocator_stats_t fitted;
+        frame_allocator_get_stats(&fitted);
+
+        const b8 success = overflowed.overflow_count == 3 && overflowed.overflow_bytes == frame_size * 3 &&
+            overflowed.used_bytes == frame_size / 2 + frame_size * 3 &&
+            fitted.overflow_count == 0 && fitted.overflow_bytes == 0 && fitted.used_bytes == frame_size / 4;
+
+        if (!success) {
+            SERROR("Frame allocator overflow test failed. %u overflows of %lu bytes.", overflowed.overflow_count, overflowed.overflow_bytes);
+        } else {
+            SINFO("Frame allocator overflow test success");
+        }
+    }
+
+    // Memory of frame N stays untouched while frame N + 1 allocates, and is reused from its start without being zeroed
+    {
+        constexpr u64 block_size = frame_size / 2;
+        u8* first = frame_alloc(block_size);
+        sset_memory(first, 0xAB, block_size);
+        frame_allocator_end_frame();
+
+        u8* second = frame_alloc(block_size);
+        sset_memory(second, 0xCD, block_size);
+        b8 success = second != first;
+        for (u32 i = 0; i < block_size; i++) {
+            success &= first[i] == 0xAB;
+        }
+        frame_allocator_end_frame();
+
+        // Resetting only moves the frame's offset back, the old contents are still there
+        u8* reused = frame_alloc(block_size);
+        success &= reused == first;
+        for (u32 i = 0; i < block_size; i++) {
+            success &= reused[i] == 0xAB;
+        }
+        frame_allocator_end_frame();
+        frame_allocator_stats_t reused_stats;
+        frame_allocator_get_stats(&reused_stats);
+
+        // A reused frame that allocates nothing reports no usage
+        frame_allocator_end_frame();
+        frame_allocator_stats_t empty_stats;
+        frame_allocator_get_stats(&empty_stats);
+        success &= reused_stats.used_bytes == block_size && empty_stats.used_bytes == 0;
+
+        if (!success) {
+            SERROR("Frame allocator reuse test failed.");
+        } else {
+            SINFO("Frame allocator reuse test success");
+        }
+    }
+
+    frame_allocator_shutdown();
+}
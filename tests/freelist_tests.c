@@ -2,13 +2,13 @@
 #include "Spark/memory/freelist.h"
 #include "Spark/platform/platform.h"
 
-#define get_first_block() ((freelist_block_t*)((void*)allocator.first_free_block - sizeof(freelist_block_t)))
 
 void freelist_tests() {
     freelist_t allocator;
     constexpr u32 memory_size = 16 * MB;
     freelist_create(platform_allocate(memory_size, true), memory_size, &allocator);
-    freelist_block_t block = *(freelist_block_t*)((void*)allocator.first_free_block - sizeof(freelist_block_t));
+    // Once everything is freed, coalescing should have restored this block
+    const u64 initial_size = freelist_largest_free_block(&allocator);
 
     // Allocate a value well under the limit
     constexpr u32 int_count = 64;
@@ -30,8 +30,8 @@ void freelist_tests() {
         freelist_free(&allocator, ints);
         freelist_check_health(&allocator);
         // New block size should be equal to the old block size due to defragmentation
-        if (block.size != get_first_block()->size) {
-            SERROR("Failed to defragment general allocator. Expected size of 0x%x, got 0x%x", block.size, get_first_block()->size);
+        if (initial_size != freelist_largest_free_block(&allocator)) {
+            SERROR("Failed to defragment general allocator. Expected size of 0x%x, got 0x%x", initial_size, freelist_largest_free_block(&allocator));
         } else {
             SINFO("Freelist basic alloc / dealloc success");
         }
@@ -66,10 +66,10 @@ void freelist_tests() {
         freelist_free(&allocator, ints[6]);
         freelist_check_health(&allocator);
 
-        if (block.size == get_first_block()->size) {
+        if (initial_size == freelist_largest_free_block(&allocator)) {
             SINFO("General allocator passed gap defragmentation test");
         } else {
-            SERROR("Failed to defragment general allocator. Expected size of 0x%x, got 0x%x. First Block: %p", block.size, get_first_block()->size, get_first_block());
+            SERROR("Failed to defragment general allocator. Expected size of 0x%x, got 0x%x.", initial_size, freelist_largest_free_block(&allocator));
         }
     }
 
@@ -86,8 +86,8 @@ void freelist_tests() {
             SASSERT(ints[i] == i, "This should not be possible");
         }
         freelist_free(&allocator, ints);
-        if (block.size != get_first_block()->size) {
-            SERROR("Failed to defragment general allocator. Expected size of 0x%x, got 0x%x", block.size, get_first_block()->size);
+        if (initial_size != freelist_largest_free_block(&allocator)) {
+            SERROR("Failed to defragment general allocator. Expected size of 0x%x, got 0x%x", initial_size, freelist_largest_free_block(&allocator));
         } else {
             SINFO("Freelist chunk overflow test success.");
         }
@@ -118,13 +118,231 @@ void freelist_tests() {
         }
 
         freelist_check_health(&allocator);
-        if (block.size != get_first_block()->size) {
-            SERROR("Failed to defragment general allocator. Expected size of 0x%x, got 0x%x", block.size, get_first_block()->size);
+        if (initial_size != freelist_largest_free_block(&allocator)) {
+            SERROR("Failed to defragment general allocator. Expected size of 0x%x, got 0x%x", initial_size, freelist_largest_free_block(&allocator));
         } else {
             SINFO("Freelist random deallocate success");
         }
     }
 
+    // Good fit test
+    // A small request should reuse the small gap instead of splitting the large one
+    {
+        void* small_gap = freelist_allocate(&allocator, 1024);
+        void* guard_0 = freelist_allocate(&allocator, 64);
+        void* large_gap = freelist_allocate(&allocator, 4096);
+        void* guard_1 = freelist_allocate(&allocator, 64);
+
+        freelist_free(&allocator, large_gap);
+        freelist_free(&allocator, small_gap);
+        void* reused = freelist_allocate(&allocator, 1000);
+        freelist_check_health(&allocator);
+
+        if (reused != small_gap) {
+            SERROR("Freelist did not pick the closest fitting block. Expected %p, got %p", small_gap, reused);
+        } else {
+            SINFO("Freelist good fit test success");
+        }
+
+        freelist_free(&allocator, reused);
+        freelist_free(&allocator, guard_0);
+        freelist_free(&allocator, guard_1);
+        freelist_check_health(&allocator);
+    }
+
+    // Reallocation test
+    // Growing into a free neighbour keeps the address, growing into a used one moves the block
+    {
+        constexpr u32 int_count = 256;
+        int* ints = freelist_allocate(&allocator, sizeof(int) * int_count);
+        for (u32 i = 0; i < int_count; i++) {
+            ints[i] = i;
+        }
+
+        int* grown = freelist_reallocate(&allocator, ints, sizeof(int) * int_count * 4);
+        void* neighbour = freelist_allocate(&allocator, 64);
+        int* moved = freelist_reallocate(&allocator, grown, sizeof(int) * int_count * 8);
+        freelist_check_health(&allocator);
+
+        b8 success = grown == ints && moved != grown && freelist_block_size(moved) >= sizeof(int) * int_count * 8;
+        for (u32 i = 0; i < int_count; i++) {
+            success &= moved[i] == i;
+        }
+
+        // Shrinking never moves
+        int* shrunk = freelist_reallocate(&allocator, moved, sizeof(int) * int_count);
+        success &= shrunk == moved;
+
+        freelist_free(&allocator, shrunk);
+        freelist_free(&allocator, neighbour);
+        freelist_check_health(&allocator);
+        if (!success || initial_size != freelist_largest_free_block(&allocator)) {
+            SERROR("Freelist reallocation test failed.");
+        } else {
+            SINFO("Freelist reallocation test success");
+        }
+    }
+
+    // Mixed size random alloc dealloc
+    {
+        constexpr int block_count = 512;
+        constexpr int iteration_count = 200000;
+        u8* blocks[block_count] = {};
+        for (u32 i = 0; i < iteration_count; i++) {
+            u32 index = random() % block_count;
+            if (blocks[index]) {
+                SASSERT(blocks[index][0] == (u8)index, "Freelist block was overwritten.");
+                freelist_free(&allocator, blocks[index]);
+                blocks[index] = NULL;
+            } else {
+                // Mostly small blocks with the occasional large one
+                u32 size = random() % 8 == 0 ? random() % (64 * KB) + 1 : random() % 512 + 1;
+                blocks[index] = freelist_allocate(&allocator, size);
+                blocks[index][0] = index;
+            }
+        }
+        freelist_check_health(&allocator);
+
+        for (u32 i = 0; i < block_count; i++) {
+            if (blocks[i]) {
+                freelist_free(&allocator, blocks[i]);
+            }
+        }
+
+        freelist_check_health(&allocator);
+        if (initial_size != freelist_largest_free_block(&allocator)) {
+            SERROR("Failed to defragment general allocator. Expected size of 0x%x, got 0x%x", initial_size, freelist_largest_free_block(&allocator));
+        } else {
+            SINFO("Freelist mixed size random deallocate success");
+        }
+    }
+
+    // Exhaustion test
+    // Fill the whole freelist, the last allocation has to fail without corrupting anything
+    {
+        constexpr u32 block_size = 64 * KB;
+        constexpr u32 max_block_count = memory_size / block_size;
+        void* blocks[max_block_count];
+        u32 block_count = 0;
+        while (block_count < max_block_count) {
+            void* block = freelist_try_allocate(&allocator, block_size);
+            if (!block) {
+                break;
+            }
+            blocks[block_count++] = block;
+        }
+        freelist_check_health(&allocator);
+
+        for (u32 i = 0; i < block_count; i += 2) {
+            freelist_free(&allocator, blocks[i]);
+        }
+        for (u32 i = 1; i < block_count; i += 2) {
+            freelist_free(&allocator, blocks[i]);
+        }
+
+        freelist_check_health(&allocator);
+        if (block_count != max_block_count - 1 || initial_size != freelist_largest_free_block(&allocator)) {
+            SERROR("Freelist exhaustion test failed. Allocated %d of %d blocks", block_count, max_block_count);
+        } else {
+            SINFO("Freelist exhaustion test success");
+        }
+    }
+
+    // Extend test
+    // A full freelist can allocate again once it is extended, and the added memory merges with free blocks
+    {
+        freelist_t extended;
+        constexpr u32 extended_size = 4 * MB;
+        constexpr u32 block_size = 64 * KB;
+        void* memory = platform_allocate(extended_size * 4, true);
+        freelist_create(memory, extended_size, &extended);
+
+        constexpr u32 max_block_count = extended_size * 2 / block_size;
+        void* blocks[max_block_count];
+        u32 block_count = 0;
+        while (block_count < max_block_count) {
+            void* block = freelist_try_allocate(&extended, block_size);
+            if (!block) {
+                break;
+            }
+            blocks[block_count++] = block;
+        }
+        const u32 full_count = block_count;
+
+        // The last block is allocated, the added memory becomes a new free block
+        freelist_extend(&extended, extended_size * 2);
+        freelist_check_health(&extended);
+        while (block_count < max_block_count) {
+            void* block = freelist_try_allocate(&extended, block_size);
+            if (!block) {
+                break;
+            }
+            blocks[block_count++] = block;
+        }
+        b8 success = block_count > full_count;
+
+        for (u32 i = 0; i < block_count; i++) {
+            freelist_free(&extended, blocks[i]);
+        }
+        freelist_check_health(&extended);
+
+        // The last block is free, the added memory is merged into it
+        freelist_extend(&extended, extended_size * 4);
+        freelist_check_health(&extended);
+        success &= freelist_largest_free_block(&extended) == ((extended_size * 4 - sizeof(freelist_block_t) * 4) & ~15u);
+
+        platform_free(memory, true);
+        if (!success) {
+            SERROR("Freelist extend test failed.");
+        } else {
+            SINFO("Freelist extend test success");
+        }
+    }
+
+    // Decommit test
+    // Pages given back inside free blocks can be allocated and written again, headers and footers are kept intact
+    {
+        freelist_t decommitting;
+        constexpr u32 decommit_memory_size = 16 * MB;
+        constexpr u32 block_size = 3 * MB;
+        constexpr u32 block_count = decommit_memory_size / block_size;
+        void* memory = platform_reserve_memory(decommit_memory_size, 0, false);
+        platform_commit_memory(memory, decommit_memory_size);
+        freelist_create(memory, decommit_memory_size, &decommitting);
+        decommitting.decommit_size = PLATFORM_HUGE_PAGE_SIZE;
+        const u64 decommit_initial_size = freelist_largest_free_block(&decommitting);
+
+        b8 success = true;
+        for (u32 round = 0; round < 2; round++) {
+            u8* blocks[block_count];
+            for (u32 i = 0; i < block_count; i++) {
+                blocks[i] = freelist_allocate(&decommitting, block_size);
+                sset_memory(blocks[i], i + 1, block_size);
+            }
+            for (u32 i = 0; i < block_count; i++) {
+                success &= blocks[i][0] == i + 1 && blocks[i][block_size - 1] == i + 1;
+            }
+
+            // Every other block first, so frees both with and without free neighbours are covered
+            for (u32 i = 0; i < block_count; i += 2) {
+                freelist_free(&decommitting, blocks[i]);
+            }
+            for (u32 i = 1; i < block_count; i += 2) {
+                freelist_free(&decommitting, blocks[i]);
+            }
+            freelist_check_health(&decommitting);
+        }
+        success &= freelist_largest_free_block(&decommitting) == decommit_initial_size;
+
+        freelist_destroy(&decommitting);
+        platform_release_memory(memory, decommit_memory_size);
+        if (!success) {
+            SERROR("Freelist decommit test failed.");
+        } else {
+            SINFO("Freelist decommit test success");
+        }
+    }
+
     // Overflow test
     // for (u32 i = 1; i <= 16; i++) {
     //     u32 alloc_size = 1024;
@@ -148,8 +366,8 @@ void freelist_tests() {
     //         }
     //     }
     //
-    //     if (block.size != get_first_block()->size) {
-    //         SERROR("Failed to defragment general allocator. Expected size of 0x%x, got 0x%x", block.size, get_first_block()->size);
+    //     if (initial_size != freelist_largest_free_block(&allocator)) {
+    //         SERROR("Failed to defragment general allocator. Expected size of 0x%x, got 0x%x", initial_size, freelist_largest_free_block(&allocator));
     //     } else {
     //         SINFO("Freelist overflow test success");
     //     }
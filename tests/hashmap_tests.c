@@ -32,5 +32,61 @@ void hashmap_tests() {
     }
 
     SDEBUG("Hashmap test success");
+
+    // Remove every other key, the remaining keys have to stay reachable after the shifts
+    {
+        b8 success = true;
+        for (u32 i = 0; i < value_count; i += 2) {
+            if (hashmap_contains(&map, rand_keys[i])) {
+                hashmap_remove(&map, rand_keys[i]);
+            }
+        }
+        for (u32 i = 0; i < value_count; i += 2) {
+            success &= !hashmap_contains(&map, rand_keys[i]);
+        }
+        for (u32 i = 1; i < value_count; i += 2) {
+            // Random keys can repeat, the last insert wins
+            u64 value = 0;
+            success &= hashmap_try_get(&map, rand_keys[i], &value);
+        }
+
+        if (!success) {
+            SERROR("Hashmap remove test failed.");
+        } else {
+            SDEBUG("Hashmap remove test success");
+        }
+    }
+    hashmap_destroy(&map);
+
+    // Clustered keys like component ids and addresses, with reinsertion after removal
+    {
+        constexpr u32 key_count = 50000;
+        hashmap_t clustered;
+        hashmap_create(0, &clustered);
+        for (u32 i = 0; i < key_count; i++) {
+            hashmap_insert(&clustered, (u64)i * 64, i);
+        }
+        for (u32 i = 0; i < key_count; i += 3) {
+            hashmap_remove(&clustered, (u64)i * 64);
+        }
+        for (u32 i = 0; i < key_count; i += 3) {
+            hashmap_insert(&clustered, (u64)i * 64, i + 1);
+        }
+        hashmap_insert(&clustered, 64, 7);
+
+        b8 success = clustered.count == key_count && *hashmap_get(&clustered, 64) == 7;
+        for (u32 i = 2; i < key_count; i++) {
+            const u64* value = hashmap_get(&clustered, (u64)i * 64);
+            success &= value && *value == (i % 3 == 0 ? i + 1 : i);
+        }
+        success &= !hashmap_contains(&clustered, (u64)key_count * 64);
+        hashmap_destroy(&clustered);
+
+        if (!success) {
+            SERROR("Hashmap clustered key test failed.");
+        } else {
+            SDEBUG("Hashmap clustered key test success");
+        }
+    }
 }
 
@@ -1,10 +1,32 @@
 
 void freelist_tests();
 void hashmap_tests();
+void slab_allocator_tests();
 void noise_tests();
+void block_allocator_tests();
+void pool_allocator_tests();
+void stack_allocator_tests();
+void frame_allocator_tests();
+void memory_stats_tests();
+void set_tests();
+void string_intern_tests();
+void ring_queue_tests();
+void bitset_tests();
+void darray_tests();
 
 int main(int argc, char** argv) {
     freelist_tests();
     hashmap_tests();
+    slab_allocator_tests();
     noise_tests();
+    block_allocator_tests();
+    pool_allocator_tests();
+    stack_allocator_tests();
+    frame_allocator_tests();
+    memory_stats_tests();
+    set_tests();
+    string_intern_tests();
+    ring_queue_tests();
+    bitset_tests();
+    darray_tests();
 }
@@ -0,0 +1,262 @@
+#include "Spark/core/logging.h"
+#include "Spark/core/smemory.h"
+#include "Spark/memory/dynamic_allocator.h"
+#include "Spark/threading/thread.h"
+#include "Spark/threading/thread_slots.h"
+
+#define MEMORY_STATS_TEST_ALLOCATION_COUNT 100
+
+static void* memory_stats_test_thread(void* args) {
+    void** blocks = args;
+    for (u32 i = 0; i < MEMORY_STATS_TEST_ALLOCATION_COUNT; i++) {
+        blocks[i] = sallocate(64, MEMORY_TAG_JOB);
+    }
+    return NULL;
+}
+
+// Leaves blocks in this thread's cache of the allocator and returns them before exiting
+static void* memory_thread_cache_test_thread(void* args) {
+    dynamic_allocator_t* allocator = args;
+    void* blocks[DYNAMIC_ALLOCATOR_CACHE_BATCH_SIZE];
+    for (u32 i = 0; i < DYNAMIC_ALLOCATOR_CACHE_BATCH_SIZE; i++) {
+        blocks[i] = dynamic_allocator_allocate(allocator, 1 * KB);
+    }
+    for (u32 i = 0; i < DYNAMIC_ALLOCATOR_CACHE_BATCH_SIZE; i++) {
+        dynamic_allocator_free(allocator, blocks[i]);
+    }
+    dynamic_allocator_flush_thread_cache(allocator);
+    return NULL;
+}
+
+void memory_stats_tests() {
+    initialize_memory();
+
+    // Blocks allocated on another thread and freed on this one are counted for both
+    {
+        void* blocks[MEMORY_STATS_TEST_ALLOCATION_COUNT];
+        memory_tag_stats_t before;
+        memory_get_tag_stats(MEMORY_TAG_JOB, &before);
+        memory_stats_end_frame();
+
+        thread_t thread;
+        thread_create(memory_stats_test_thread, blocks, &thread);
+        thread_join(thread);
+
+        memory_tag_stats_t allocated;
+        memory_get_tag_stats(MEMORY_TAG_JOB, &allocated);
+        for (u32 i = 0; i < MEMORY_STATS_TEST_ALLOCATION_COUNT; i++) {
+            sfree(blocks[i], 64, MEMORY_TAG_JOB);
+        }
+        memory_stats_end_frame();
+
+        memory_tag_stats_t freed;
+        memory_get_tag_stats(MEMORY_TAG_JOB, &freed);
+        const b8 success = allocated.current_bytes > before.current_bytes &&
+            freed.current_bytes == before.current_bytes &&
+            freed.peak_bytes >= allocated.current_bytes &&
+            freed.frame_allocation_count == MEMORY_STATS_TEST_ALLOCATION_COUNT &&
+            freed.frame_free_count == MEMORY_STATS_TEST_ALLOCATION_COUNT;
+
+        if (!success) {
+            SERROR("Memory stats cross thread test failed. %lu allocations, %lu frees in the frame.", freed.frame_allocation_count, freed.frame_free_count);
+        } else {
+            SINFO("Memory stats cross thread test success");
+        }
+    }
+
+    // Many live allocations with sampled backtraces, freed in a different order than they were allocated
+    {
+        constexpr u32 block_count = 200000;
+        memory_tag_stats_t before;
+        memory_get_tag_stats(MEMORY_TAG_ARRAY, &before);
+#ifdef SPARK_DEBUG
+        memory_tracking_set_backtrace_sample_rate(64);
+#endif
+
+        u32** blocks = sallocate(sizeof(u32*) * block_count, MEMORY_TAG_ARRAY);
+        for (u32 i = 0; i < block_count; i++) {
+            blocks[i] = sallocate(sizeof(u32) * (i % 64 + 1), MEMORY_TAG_ARRAY);
+            blocks[i][0] = i;
+        }
+
+        b8 success = true;
+        for (u32 i = 0; i < block_count; i++) {
+            const u32 index = (i * 7919u) % block_count;
+            success &= blocks[index][0] == index;
+            sfree(blocks[index], sizeof(u32) * (index % 64 + 1), MEMORY_TAG_ARRAY);
+        }
+        sfree(blocks, sizeof(u32*) * block_count, MEMORY_TAG_ARRAY);
+#ifdef SPARK_DEBUG
+        memory_tracking_set_backtrace_sample_rate(MEMORY_TRACKING_DEFAULT_BACKTRACE_SAMPLE_RATE);
+#endif
+
+        memory_tag_stats_t after;
+        memory_get_tag_stats(MEMORY_TAG_ARRAY, &after);
+        if (!success || after.current_bytes != before.current_bytes) {
+            SERROR("Memory tracking test failed.");
+        } else {
+            SINFO("Memory tracking test success");
+        }
+    }
+
+    // A frame without allocations resets the per-frame counts
+    {
+        memory_stats_end_frame();
+        memory_tag_stats_t tag_stats;
+        memory_get_tag_stats(MEMORY_TAG_JOB, &tag_stats);
+        if (tag_stats.frame_allocation_count != 0 || tag_stats.frame_free_count != 0) {
+            SERROR("Memory stats frame reset test failed.");
+        } else {
+            SINFO("Memory stats frame reset test success");
+        }
+    }
+
+    // The peak includes allocations that were freed before anything sampled the stats
+    {
+        constexpr u64 block_size = 256 * KB;
+        memory_tag_stats_t before;
+        memory_get_tag_stats(MEMORY_TAG_ARRAY, &before);
+        void* block = sallocate(block_size + before.peak_bytes, MEMORY_TAG_ARRAY);
+        sfree(block, block_size + before.peak_bytes, MEMORY_TAG_ARRAY);
+
+        memory_tag_stats_t after;
+        memory_get_tag_stats(MEMORY_TAG_ARRAY, &after);
+        if (after.peak_bytes < before.current_bytes + block_size + before.peak_bytes || after.current_bytes != before.current_bytes) {
+            SERROR("Memory stats peak test failed. Peak %lu bytes.", after.peak_bytes);
+        } else {
+            SINFO("Memory stats peak test success");
+        }
+    }
+
+    // Threads return their stats slots on exit, more threads than slots are all counted
+    {
+        constexpr u32 thread_count = MEMORY_STATS_MAX_THREADS * 2;
+        void* blocks[MEMORY_STATS_TEST_ALLOCATION_COUNT];
+        memory_tag_stats_t before;
+        memory_get_tag_stats(MEMORY_TAG_JOB, &before);
+
+        for (u32 i = 0; i < thread_count; i++) {
+            thread_t thread;
+            thread_create(memory_stats_test_thread, blocks, &thread);
+            thread_join(thread);
+            for (u32 j = 0; j < MEMORY_STATS_TEST_ALLOCATION_COUNT; j++) {
+                sfree(blocks[j], 64, MEMORY_TAG_JOB);
+            }
+        }
+
+        memory_tag_stats_t after;
+        memory_get_tag_stats(MEMORY_TAG_JOB, &after);
+        const b8 success = after.current_bytes == before.current_bytes &&
+            after.allocation_count - before.allocation_count == thread_count * MEMORY_STATS_TEST_ALLOCATION_COUNT &&
+            after.free_count - before.free_count == thread_count * MEMORY_STATS_TEST_ALLOCATION_COUNT;
+
+        if (!success) {
+            SERROR("Memory stats thread slot test failed.");
+        } else {
+            SINFO("Memory stats thread slot test success");
+        }
+    }
+
+    // Heaps keep their own memory and count going over a budget once per crossing
+    {
+        memory_heap_stats_t before;
+        memory_heap_get_stats(MEMORY_HEAP_STRING, &before);
+        memory_heap_set_budget(MEMORY_HEAP_STRING, before.used_bytes + 64 * KB);
+
+        constexpr u32 block_size = 16 * KB;
+        void* blocks[8];
+        for (u32 i = 0; i < 8; i++) {
+            blocks[i] = sallocate(block_size, MEMORY_TAG_STRING);
+        }
+        void* general = sallocate(block_size, MEMORY_TAG_GAME);
+        blocks[0] = sreallocate(blocks[0], block_size, block_size * 2, MEMORY_TAG_STRING);
+
+        memory_heap_stats_t allocated;
+        memory_heap_get_stats(MEMORY_HEAP_STRING, &allocated);
+        sfree(blocks[0], block_size * 2, MEMORY_TAG_STRING);
+        for (u32 i = 1; i < 8; i++) {
+            sfree(blocks[i], block_size, MEMORY_TAG_STRING);
+        }
+        sfree(general, block_size, MEMORY_TAG_GAME);
+        memory_heap_set_budget(MEMORY_HEAP_STRING, 0);
+
+        memory_heap_stats_t freed;
+        memory_heap_get_stats(MEMORY_HEAP_STRING, &freed);
+        const b8 success = memory_tag_heap(MEMORY_TAG_STRING) == MEMORY_HEAP_STRING &&
+            memory_tag_heap(MEMORY_TAG_GAME) == MEMORY_HEAP_GENERAL &&
+            allocated.used_bytes == before.used_bytes + block_size * 9 &&
+            allocated.over_budget_count == before.over_budget_count + 1 &&
+            freed.used_bytes == before.used_bytes && freed.budget == 0;
+
+        if (!success) {
+            SERROR("Memory heap budget test failed. %lu bytes used, went over budget %lu times.", allocated.used_bytes, allocated.over_budget_count);
+        } else {
+            SINFO("Memory heap budget test success");
+        }
+    }
+
+#ifdef SPARK_DEBUG
+    // A double free is reported and does not reach the allocator, which would hand the block out twice.
+    // Logs the errors it tests for.
+    {
+        void* block = sallocate(48, MEMORY_TAG_GAME);
+        sfree(block, 48, MEMORY_TAG_GAME);
+        sfree(block, 48, MEMORY_TAG_GAME);
+        void* first = sallocate(48, MEMORY_TAG_GAME);
+        void* second = sallocate(48, MEMORY_TAG_GAME);
+        b8 success = first != second;
+        sfree(first, 48, MEMORY_TAG_GAME);
+        sfree(second, 48, MEMORY_TAG_GAME);
+        // Reallocating a freed block fails instead of moving it
+        success &= sreallocate(first, 48, 96, MEMORY_TAG_GAME) == NULL;
+
+        if (!success) {
+            SERROR("Memory tracking double free test failed.");
+        } else {
+            SINFO("Memory tracking double free test success");
+        }
+    }
+#endif
+
+    // Released thread slots are handed out again, lowest first
+    {
+        thread_slots_t slots = {0};
+        b8 success = true;
+        for (u32 i = 0; i < THREAD_SLOTS_MAX; i++) {
+            success &= thread_slots_acquire(&slots) == i;
+        }
+        success &= thread_slots_acquire(&slots) == INVALID_ID;
+        thread_slots_release(&slots, 5);
+        thread_slots_release(&slots, 3);
+        success &= thread_slots_acquire(&slots) == 3 && thread_slots_acquire(&slots) == 5;
+        success &= thread_slots_high_water(&slots) == THREAD_SLOTS_MAX;
+
+        if (!success) {
+            SERROR("Thread slots test failed.");
+        } else {
+            SINFO("Thread slots test success");
+        }
+    }
+
+    // More threads than cache slots come and go, each returns its cached blocks and its slot when it exits
+    {
+        dynamic_allocator_t allocator;
+        dynamic_allocator_create(1 * MB, &allocator);
+        const u64 free_before = freelist_largest_free_block(&allocator.freelist);
+
+        for (u32 i = 0; i < THREAD_SLOTS_MAX * 2; i++) {
+            thread_t thread;
+            thread_create(memory_thread_cache_test_thread, &allocator, &thread);
+            thread_join(thread);
+        }
+
+        const b8 success = freelist_largest_free_block(&allocator.freelist) == free_before;
+        dynamic_allocator_destroy(&allocator);
+
+        if (!success) {
+            SERROR("Memory thread shutdown test failed.");
+        } else {
+            SINFO("Memory thread shutdown test success");
+        }
+    }
+}
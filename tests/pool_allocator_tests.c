@@ -0,0 +1,163 @@
+#include "Spark/core/logging.h"
+#include "Spark/core/smemory.h"
+#include "Spark/memory/pool_allocator.h"
+#include "Spark/threading/thread.h"
+
+#define POOL_TEST_THREAD_COUNT 4
+#define POOL_TEST_MAILBOX_SIZE 64
+
+typedef struct pool_test_block {
+    u64 stamp;
+    u64 check;
+} pool_test_block_t;
+
+typedef struct pool_test_thread {
+    pool_allocator_t* allocator;
+    // Blocks allocated by this thread, freed by the next one
+    pool_test_block_t* mailbox[POOL_TEST_MAILBOX_SIZE];
+    struct pool_test_thread* previous;
+    u32 index;
+    u32 block_count;
+    b8 success;
+} pool_test_thread_t;
+
+// Allocates blocks and hands them to the next thread, while freeing the blocks handed over by the previous one
+static void* pool_test_thread(void* args) {
+    pool_test_thread_t* thread = args;
+    u32 produced = 0;
+    u32 consumed = 0;
+    u32 mailbox_index = 0;
+    u32 previous_mailbox_index = 0;
+
+    while (produced < thread->block_count || consumed < thread->block_count) {
+        if (produced < thread->block_count && !__atomic_load_n(&thread->mailbox[mailbox_index], __ATOMIC_ACQUIRE)) {
+            pool_test_block_t* block = pool_allocator_allocate(thread->allocator);
+            if (block) {
+                block->stamp = ((u64)thread->index << 32) | produced;
+                block->check = ~block->stamp;
+                __atomic_store_n(&thread->mailbox[mailbox_index], block, __ATOMIC_RELEASE);
+                mailbox_index = (mailbox_index + 1) % POOL_TEST_MAILBOX_SIZE;
+                produced++;
+
+                // Some blocks are freed by the thread that allocated them
+                pool_test_block_t* local = pool_allocator_allocate(thread->allocator);
+                if (local) {
+                    pool_allocator_free(thread->allocator, local);
+                }
+            }
+        }
+
+        pool_test_block_t* block = __atomic_exchange_n(&thread->previous->mailbox[previous_mailbox_index], NULL, __ATOMIC_ACQUIRE);
+        if (block) {
+            thread->success &= block->stamp >> 32 == thread->previous->index && block->check == ~block->stamp;
+            pool_allocator_free(thread->allocator, block);
+            previous_mailbox_index = (previous_mailbox_index + 1) % POOL_TEST_MAILBOX_SIZE;
+            consumed++;
+        }
+    }
+
+    pool_allocator_flush_thread_cache(thread->allocator);
+    return NULL;
+}
+
+// Keeps blocks in its cache and exits without flushing, thread exit returns them
+static void* pool_test_exit_thread(void* args) {
+    pool_allocator_t* allocator = args;
+    void* blocks[POOL_ALLOCATOR_CACHE_BATCH_SIZE];
+    for (u32 i = 0; i < POOL_ALLOCATOR_CACHE_BATCH_SIZE; i++) {
+        blocks[i] = pool_allocator_allocate(allocator);
+    }
+    for (u32 i = 0; i < POOL_ALLOCATOR_CACHE_BATCH_SIZE; i++) {
+        if (blocks[i]) {
+            pool_allocator_free(allocator, blocks[i]);
+        }
+    }
+    return NULL;
+}
+
+static b8 pool_test_all_blocks_free(pool_allocator_t* allocator, u32 block_count) {
+    u8 seen[block_count];
+    szero_memory(seen, block_count);
+    void* blocks[block_count];
+    b8 success = true;
+    u32 allocated = 0;
+    for (; allocated < block_count; allocated++) {
+        u8* block = pool_allocator_allocate(allocator);
+        if (!block) {
+            success = false;
+            break;
+        }
+        const u32 index = (block - (u8*)allocator->memory) / allocator->block_size;
+        success &= ((u64)block & 15) == 0 && !seen[index];
+        seen[index] = true;
+        blocks[allocated] = block;
+    }
+    success &= pool_allocator_allocate(allocator) == NULL;
+    for (u32 i = 0; i < allocated; i++) {
+        pool_allocator_free(allocator, blocks[i]);
+    }
+    return success;
+}
+
+void pool_allocator_tests() {
+    initialize_memory();
+
+    pool_allocator_t allocator;
+    constexpr u32 block_count = 1024;
+    pool_allocator_create(sizeof(pool_test_block_t), block_count, &allocator);
+
+    // Blocks allocated on one thread and freed on another
+    {
+        pool_test_thread_t threads[POOL_TEST_THREAD_COUNT] = {};
+        thread_t handles[POOL_TEST_THREAD_COUNT];
+        for (u32 i = 0; i < POOL_TEST_THREAD_COUNT; i++) {
+            threads[i].allocator = &allocator;
+            threads[i].previous = &threads[(i + POOL_TEST_THREAD_COUNT - 1) % POOL_TEST_THREAD_COUNT];
+            threads[i].index = i;
+            threads[i].block_count = 100000;
+            threads[i].success = true;
+        }
+        for (u32 i = 0; i < POOL_TEST_THREAD_COUNT; i++) {
+            thread_create(pool_test_thread, &threads[i], &handles[i]);
+        }
+
+        b8 success = true;
+        for (u32 i = 0; i < POOL_TEST_THREAD_COUNT; i++) {
+            thread_join(handles[i]);
+            success &= threads[i].success;
+        }
+
+        if (!success) {
+            SERROR("Pool allocator cross thread free test failed, a block was corrupted.");
+        } else {
+            SINFO("Pool allocator cross thread free test success");
+        }
+    }
+
+    // Every block is back once the threads flushed their caches, and each one is handed out exactly once
+    {
+        if (!pool_test_all_blocks_free(&allocator, block_count)) {
+            SERROR("Pool allocator recovery test failed.");
+        } else {
+            SINFO("Pool allocator recovery test success");
+        }
+    }
+
+    // More threads than slots leave blocks cached when they exit, their slots and blocks come back
+    {
+        pool_allocator_flush_thread_cache(&allocator);
+        for (u32 i = 0; i < POOL_ALLOCATOR_MAX_THREADS * 2; i++) {
+            thread_t thread;
+            thread_create(pool_test_exit_thread, &allocator, &thread);
+            thread_join(thread);
+        }
+
+        if (!pool_test_all_blocks_free(&allocator, block_count)) {
+            SERROR("Pool allocator thread exit test failed.");
+        } else {
+            SINFO("Pool allocator thread exit test success");
+        }
+    }
+
+    pool_allocator_destroy(&allocator);
+}
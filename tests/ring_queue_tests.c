@@ -0,0 +1,142 @@
+#include "Spark/containers/ring_queue.h"
+#include "Spark/core/logging.h"
+#include "Spark/threading/thread.h"
+
+#define RING_QUEUE_TEST_THREAD_COUNT 4
+#define RING_QUEUE_TEST_VALUE_COUNT 200000
+#define RING_QUEUE_TEST_BATCH_SIZE 16
+
+spsc_queue_header(u64, test_u64);
+spsc_queue_impl(u64, test_u64);
+mpmc_queue_header(u64, test_u64);
+mpmc_queue_impl(u64, test_u64);
+
+typedef struct ring_queue_test_thread {
+    void* queue;
+    u32 index;
+    // Consumers: sum and count of the values they popped
+    u64 sum;
+    u64 count;
+    b8 success;
+} ring_queue_test_thread_t;
+
+static u64 mpmc_consumed_count;
+
+// Pushes single values and batches, the consumer checks that they arrive in order
+static void* spsc_test_producer(void* args) {
+    spsc_queue_test_u64_t* queue = args;
+    u64 values[RING_QUEUE_TEST_BATCH_SIZE];
+    u64 next = 0;
+    while (next < RING_QUEUE_TEST_VALUE_COUNT) {
+        if (next % 3 == 0) {
+            next += spsc_queue_test_u64_push(queue, next);
+            continue;
+        }
+        const u32 count = smin(RING_QUEUE_TEST_BATCH_SIZE, RING_QUEUE_TEST_VALUE_COUNT - next);
+        for (u32 i = 0; i < count; i++) {
+            values[i] = next + i;
+        }
+        next += spsc_queue_test_u64_push_batch(queue, values, count);
+    }
+    return NULL;
+}
+
+static void* mpmc_test_producer(void* args) {
+    ring_queue_test_thread_t* thread = args;
+    u64 values[RING_QUEUE_TEST_BATCH_SIZE];
+    u64 next = 0;
+    while (next < RING_QUEUE_TEST_VALUE_COUNT) {
+        // Values are unique over all producers
+        const u32 count = smin(1 + next % RING_QUEUE_TEST_BATCH_SIZE, RING_QUEUE_TEST_VALUE_COUNT - next);
+        for (u32 i = 0; i < count; i++) {
+            values[i] = (next + i) * RING_QUEUE_TEST_THREAD_COUNT + thread->index;
+        }
+        next += mpmc_queue_test_u64_push_batch(thread->queue, values, count);
+    }
+    return NULL;
+}
+
+static void* mpmc_test_consumer(void* args) {
+    ring_queue_test_thread_t* thread = args;
+    u64 values[RING_QUEUE_TEST_BATCH_SIZE];
+    const u64 total = (u64)RING_QUEUE_TEST_VALUE_COUNT * RING_QUEUE_TEST_THREAD_COUNT;
+    while (__atomic_load_n(&mpmc_consumed_count, __ATOMIC_RELAXED) < total) {
+        const u32 count = thread->index % 2 ? mpmc_queue_test_u64_pop_batch(thread->queue, values, RING_QUEUE_TEST_BATCH_SIZE) :
+            mpmc_queue_test_u64_pop(thread->queue, values);
+        for (u32 i = 0; i < count; i++) {
+            thread->sum += values[i];
+        }
+        thread->count += count;
+        __atomic_fetch_add(&mpmc_consumed_count, count, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+void ring_queue_tests() {
+    initialize_memory();
+
+    // One producer, the consumer pops on this thread
+    {
+        spsc_queue_test_u64_t queue;
+        spsc_queue_test_u64_create(100, &queue);
+        thread_t producer;
+        thread_create(spsc_test_producer, &queue, &producer);
+
+        b8 success = queue.mask == 127;
+        u64 values[RING_QUEUE_TEST_BATCH_SIZE];
+        u64 expected = 0;
+        while (expected < RING_QUEUE_TEST_VALUE_COUNT) {
+            const u32 count = expected % 2 ? spsc_queue_test_u64_pop_batch(&queue, values, RING_QUEUE_TEST_BATCH_SIZE) :
+                spsc_queue_test_u64_pop(&queue, values);
+            for (u32 i = 0; i < count; i++) {
+                success &= values[i] == expected++;
+            }
+        }
+        thread_join(producer);
+        success &= spsc_queue_test_u64_count(&queue) == 0 && !spsc_queue_test_u64_pop(&queue, values);
+        spsc_queue_test_u64_destroy(&queue);
+
+        if (!success) {
+            SERROR("SPSC queue order test failed.");
+        } else {
+            SINFO("SPSC queue order test success");
+        }
+    }
+
+    // Every value pushed by any producer is popped exactly once
+    {
+        mpmc_queue_test_u64_t queue;
+        mpmc_queue_test_u64_create(256, &queue);
+        mpmc_consumed_count = 0;
+
+        ring_queue_test_thread_t producers[RING_QUEUE_TEST_THREAD_COUNT];
+        ring_queue_test_thread_t consumers[RING_QUEUE_TEST_THREAD_COUNT];
+        thread_t threads[RING_QUEUE_TEST_THREAD_COUNT * 2];
+        for (u32 i = 0; i < RING_QUEUE_TEST_THREAD_COUNT; i++) {
+            producers[i] = (ring_queue_test_thread_t) { .queue = &queue, .index = i };
+            consumers[i] = (ring_queue_test_thread_t) { .queue = &queue, .index = i };
+            thread_create(mpmc_test_producer, &producers[i], &threads[i * 2]);
+            thread_create(mpmc_test_consumer, &consumers[i], &threads[i * 2 + 1]);
+        }
+        for (u32 i = 0; i < RING_QUEUE_TEST_THREAD_COUNT * 2; i++) {
+            thread_join(threads[i]);
+        }
+
+        const u64 total = (u64)RING_QUEUE_TEST_VALUE_COUNT * RING_QUEUE_TEST_THREAD_COUNT;
+        u64 sum = 0;
+        u64 count = 0;
+        for (u32 i = 0; i < RING_QUEUE_TEST_THREAD_COUNT; i++) {
+            sum += consumers[i].sum;
+            count += consumers[i].count;
+        }
+        u64 value;
+        const b8 success = count == total && sum == total * (total - 1) / 2 && !mpmc_queue_test_u64_pop(&queue, &value);
+        mpmc_queue_test_u64_destroy(&queue);
+
+        if (!success) {
+            SERROR("MPMC queue test failed. Popped %lu of %lu values.", count, total);
+        } else {
+            SINFO("MPMC queue test success");
+        }
+    }
+}
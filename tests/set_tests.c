@@ -0,0 +1,71 @@
+#include "Spark/containers/set.h"
+#include "Spark/core/logging.h"
+#include "Spark/utils/hashing.h"
+
+set_type(u32, test_set);
+set_impl(u32, test_set);
+
+static b8 set_test_sorted(const test_set_t* set) {
+    const u32* values = test_set_values(set);
+    for (u32 i = 1; i < set->count; i++) {
+        if (values[i - 1] >= values[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void set_tests() {
+    initialize_memory();
+
+    // Values that used to collide in the direct mapped table stay small and keep their insertion index
+    {
+        test_set_t set;
+        test_set_create(2, &set);
+        const u32 values[] = { 67, 3, 131, 35, 3 };
+        for (u32 i = 0; i < 5; i++) {
+            test_set_insert(&set, values[i]);
+        }
+
+        b8 success = set.count == 4 && set.capacity == 0 && set_test_sorted(&set);
+        for (u32 i = 0; i < 4; i++) {
+            success &= test_set_contains(&set, values[i]) && test_set_get_index(&set, values[i]) == i;
+        }
+        success &= !test_set_contains(&set, 4) && test_set_get_index(&set, 99) == INVALID_ID;
+        test_set_destroy(&set);
+
+        if (!success) {
+            SERROR("Set small test failed.");
+        } else {
+            SINFO("Set small test success");
+        }
+    }
+
+    // Growing past the inline values moves them to the heap without changing any index
+    {
+        constexpr u32 value_count = 200;
+        test_set_t set;
+        test_set_create(1, &set);
+        for (u32 i = 0; i < value_count; i++) {
+            test_set_insert(&set, (i * 7919u) % 1009);
+        }
+
+        b8 success = set.count == value_count && set.capacity >= value_count && set_test_sorted(&set);
+        for (u32 i = 0; i < value_count; i++) {
+            success &= test_set_get_index(&set, (i * 7919u) % 1009) == i;
+        }
+        const u32* values = test_set_values(&set);
+        const u32* indices = test_set_indices(&set);
+        for (u32 i = 0; i < set.count; i++) {
+            success &= test_set_get_index(&set, values[i]) == indices[i];
+        }
+        success &= !test_set_contains(&set, 1009);
+        test_set_destroy(&set);
+
+        if (!success) {
+            SERROR("Set promotion test failed.");
+        } else {
+            SINFO("Set promotion test success");
+        }
+    }
+}
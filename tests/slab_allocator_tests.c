@@ -0,0 +1,122 @@
+#include "Spark/core/logging.h"
+#include "Spark/memory/slab_allocator.h"
+#include "Spark/platform/platform.h"
+#include "Spark/threading/thread.h"
+
+typedef struct slab_test_thread_args {
+    slab_allocator_t* allocator;
+    b8 cached;
+} slab_test_thread_args_t;
+
+// Frees a block into the thread's cache, checks that it was cached and flushes it before exiting
+static void* slab_test_exit_thread(void* args) {
+    slab_test_thread_args_t* thread_args = args;
+    slab_allocator_t* allocator = thread_args->allocator;
+    slab_allocator_free(allocator, slab_allocator_allocate(allocator, 64));
+
+    u32 cached_count = 0;
+    for (u32 i = 0; i < SLAB_ALLOCATOR_MAX_THREADS; i++) {
+        cached_count += allocator->caches[i].bins[3].count;
+    }
+    thread_args->cached = cached_count > 0;
+    slab_allocator_flush_thread_cache(allocator);
+    return NULL;
+}
+
+void slab_allocator_tests() {
+    slab_allocator_t allocator;
+    slab_allocator_create(&allocator);
+
+    // Every size maps to a class that can hold it and blocks are aligned
+    {
+        b8 success = true;
+        for (u32 size = 1; size <= SLAB_ALLOCATOR_MAX_SIZE; size++) {
+            u8* block = slab_allocator_allocate(&allocator, size);
+            if (((size_t)block & 15) != 0 || slab_allocator_block_size(block) < size || !slab_allocator_owns(&allocator, block)) {
+                SERROR("Slab allocator returned invalid block %p for size %d (block size %d)", block, size, slab_allocator_block_size(block));
+                success = false;
+            }
+            sset_memory(block, 0xAB, size);
+            slab_allocator_free(&allocator, block);
+        }
+
+        void* foreign = platform_allocate(64, false);
+        if (slab_allocator_owns(&allocator, foreign)) {
+            SERROR("Slab allocator claims ownership of memory it did not allocate.");
+            success = false;
+        }
+        platform_free(foreign, false);
+
+        if (success) {
+            SINFO("Slab allocator size class test success");
+        }
+    }
+
+    // Freed blocks are reused before new ones are carved from a page
+    {
+        void* first = slab_allocator_allocate(&allocator, 24);
+        slab_allocator_free(&allocator, first);
+        void* second = slab_allocator_allocate(&allocator, 24);
+        if (first != second) {
+            SERROR("Slab allocator did not reuse freed block. %p != %p", first, second);
+        } else {
+            SINFO("Slab allocator reuse test success");
+        }
+        slab_allocator_free(&allocator, second);
+    }
+
+    // Fill more than one commit step, check that no blocks overlap and every page is returned
+    {
+        constexpr u32 block_count = SLAB_ALLOCATOR_COMMIT_SIZE / SLAB_ALLOCATOR_MAX_SIZE + 1024;
+        u32** blocks = platform_allocate(sizeof(u32*) * block_count, false);
+        for (u32 i = 0; i < block_count; i++) {
+            blocks[i] = slab_allocator_allocate(&allocator, SLAB_ALLOCATOR_MAX_SIZE);
+            *blocks[i] = i;
+        }
+
+        b8 success = allocator.committed_size > SLAB_ALLOCATOR_COMMIT_SIZE;
+        for (u32 i = 0; i < block_count; i++) {
+            if (*blocks[i] != i) {
+                SERROR("Slab allocator block %d was overwritten (%d)", i, *blocks[i]);
+                success = false;
+                break;
+            }
+        }
+
+        for (u32 i = 0; i < block_count; i++) {
+            slab_allocator_free(&allocator, blocks[i]);
+        }
+        platform_free(blocks, false);
+        slab_allocator_flush_thread_cache(&allocator);
+
+        // Only one empty page is kept per class, everything else goes back to the shared pages
+        const slab_page_t* page = allocator.classes[SLAB_ALLOCATOR_CLASS_COUNT - 1].partial_pages;
+        if (!success || !page || page->next || page->used_count != 0) {
+            SERROR("Slab allocator failed commit overflow test.");
+        } else {
+            SINFO("Slab allocator commit overflow test success");
+        }
+    }
+
+    // Blocks freed by a thread stay in its cache until it flushes, exited threads hand their slots to new ones
+    {
+        b8 success = true;
+        for (u32 i = 0; i < SLAB_ALLOCATOR_MAX_THREADS * 2; i++) {
+            slab_test_thread_args_t args = { .allocator = &allocator, .cached = false };
+            thread_t thread;
+            thread_create(slab_test_exit_thread, &args, &thread);
+            thread_join(thread);
+            thread_destroy(&thread);
+            success &= args.cached;
+        }
+
+        const slab_page_t* page = allocator.classes[3].partial_pages;
+        if (!success || !page || page->next || page->used_count != 0) {
+            SERROR("Slab allocator thread cache test failed.");
+        } else {
+            SINFO("Slab allocator thread cache test success");
+        }
+    }
+
+    slab_allocator_destroy(&allocator);
+}
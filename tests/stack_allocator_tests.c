@@ -0,0 +1,82 @@
+#include "Spark/core/logging.h"
+#include "Spark/core/smemory.h"
+#include "Spark/memory/stack_allocator.h"
+#include "Spark/platform/platform.h"
+
+void stack_allocator_tests() {
+    stack_allocator_t allocator;
+    constexpr u64 reserve_size = 4 * MB;
+    stack_allocator_create(reserve_size, &allocator);
+
+    // Nested marks release only what was allocated after them
+    {
+        u32* outer = STACK_ALLOC(&allocator, u32, 100);
+        for (u32 i = 0; i < 100; i++) {
+            outer[i] = i;
+        }
+
+        const stack_allocator_mark_t outer_mark = stack_allocator_mark(&allocator);
+        u8* inner = STACK_ALLOC(&allocator, u8, 3);
+        const stack_allocator_mark_t inner_mark = stack_allocator_mark(&allocator);
+        // Spans several commit steps
+        u8* large = STACK_ALLOC(&allocator, u8, STACK_ALLOCATOR_COMMIT_SIZE * 3 + 5);
+        sset_memory(large, 0xAB, STACK_ALLOCATOR_COMMIT_SIZE * 3 + 5);
+
+        b8 success = ((u64)inner & 15) == 0 && ((u64)large & 15) == 0;
+        stack_allocator_rewind_to(&allocator, inner_mark);
+        success &= STACK_ALLOC(&allocator, u8, 1) == large;
+
+        stack_allocator_rewind_to(&allocator, outer_mark);
+        success &= STACK_ALLOC(&allocator, u8, 1) == inner;
+        for (u32 i = 0; i < 100; i++) {
+            success &= outer[i] == i;
+        }
+
+        stack_allocator_rewind_to(&allocator, 0);
+        success &= stack_allocator_mark(&allocator) == 0 && STACK_ALLOC(&allocator, u32, 1) == outer;
+        stack_allocator_rewind_to(&allocator, 0);
+
+        if (!success) {
+            SERROR("Stack allocator mark / rewind test failed.");
+        } else {
+            SINFO("Stack allocator mark / rewind test success");
+        }
+    }
+
+    // Running out of the reserve fails without moving the stack
+    {
+        void* block = stack_allocator_allocate(&allocator, reserve_size - 16);
+        const stack_allocator_mark_t mark = stack_allocator_mark(&allocator);
+        b8 success = block && stack_allocator_allocate(&allocator, 32) == NULL && stack_allocator_mark(&allocator) == mark;
+        success &= stack_allocator_allocate(&allocator, 16) != NULL;
+        stack_allocator_rewind_to(&allocator, 0);
+
+        if (!success) {
+            SERROR("Stack allocator exhaustion test failed.");
+        } else {
+            SINFO("Stack allocator exhaustion test success");
+        }
+    }
+
+    stack_allocator_destroy(&allocator);
+
+    // Releasing a reserve smaller than a huge page leaves the memory after it mapped. The stack allocator rounds its
+    // reserve to STACK_ALLOCATOR_COMMIT_SIZE, so a release rounded up to the huge page size unmapped its neighbours
+    {
+        u8* block = platform_reserve_memory(PLATFORM_HUGE_PAGE_SIZE, 0, false);
+        b8 success = block && platform_commit_memory(block, PLATFORM_HUGE_PAGE_SIZE);
+        if (success) {
+            platform_release_memory(block, STACK_ALLOCATOR_COMMIT_SIZE);
+            // Faults if the release took more than it was given
+            sset_memory(block + STACK_ALLOCATOR_COMMIT_SIZE, 0x5A, PLATFORM_HUGE_PAGE_SIZE - STACK_ALLOCATOR_COMMIT_SIZE);
+            success = block[PLATFORM_HUGE_PAGE_SIZE - 1] == 0x5A;
+            platform_release_memory(block + STACK_ALLOCATOR_COMMIT_SIZE, PLATFORM_HUGE_PAGE_SIZE - STACK_ALLOCATOR_COMMIT_SIZE);
+        }
+
+        if (!success) {
+            SERROR("Stack allocator partial release test failed.");
+        } else {
+            SINFO("Stack allocator partial release test success");
+        }
+    }
+}
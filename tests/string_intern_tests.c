@@ -0,0 +1,63 @@
+#include "Spark/core/logging.h"
+#include "Spark/core/sstring.h"
+#include "Spark/core/string_intern.h"
+
+void string_intern_tests() {
+    initialize_memory();
+    string_intern_initialize();
+
+    // The same string always gets the same id, from any pointer
+    {
+        char path[] = "assets/resources/materials/default";
+        const string_id id = string_intern("assets/resources/materials/default");
+        const string_id other = string_intern("assets/shaders/default");
+        const u32 count = string_intern_count();
+
+        b8 success = id != other && string_intern(path) == id && string_intern_find(path) == id;
+        success &= string_intern_count() == count;
+        success &= string_equal(string_intern_get(id), path) && string_intern_length(id) == sizeof(path) - 1;
+        success &= string_intern_hash(id) == hash_bytes(path, sizeof(path) - 1);
+        success &= string_intern_n("assets/shaders/default_extra", 22) == other;
+        success &= string_intern_find("assets/never/interned") == STRING_ID_INVALID && string_intern_count() == count;
+
+        if (!success) {
+            SERROR("String intern id test failed.");
+        } else {
+            SINFO("String intern id test success");
+        }
+    }
+
+    // Strings stay where they are while the table grows, including ones that do not fit in a block
+    {
+        constexpr u32 string_count = 5000;
+        char buffer[64];
+        string_id ids[string_count];
+        const char* strings[string_count];
+        for (u32 i = 0; i < string_count; i++) {
+            string_format(buffer, "material_%u", i);
+            ids[i] = string_intern(buffer);
+            strings[i] = string_intern_get(ids[i]);
+        }
+
+        char* long_string = sallocate(STRING_INTERN_BLOCK_SIZE * 2, MEMORY_TAG_STRING);
+        sset_memory(long_string, 'a', STRING_INTERN_BLOCK_SIZE * 2 - 1);
+        long_string[STRING_INTERN_BLOCK_SIZE * 2 - 1] = 0;
+        const string_id long_id = string_intern(long_string);
+
+        b8 success = string_equal(string_intern_get(long_id), long_string);
+        for (u32 i = 0; i < string_count; i++) {
+            string_format(buffer, "material_%u", i);
+            success &= string_intern(buffer) == ids[i] && string_intern_get(ids[i]) == strings[i];
+            success &= string_equal(strings[i], buffer);
+        }
+        sfree(long_string, STRING_INTERN_BLOCK_SIZE * 2, MEMORY_TAG_STRING);
+
+        if (!success) {
+            SERROR("String intern growth test failed.");
+        } else {
+            SINFO("String intern growth test success");
+        }
+    }
+
+    string_intern_shutdown();
+}